@@ -0,0 +1,120 @@
+# Portable build of broadcaster for Linux and other POSIX hosts, along with the host-side tools used to exercise it
+# without a QNX target or a real RN2483: the emulator (rn2483sim) and the benchmark driver (bench).
+# Usage: make -f portable.mk [all|broadcaster|rn2483sim|bench|hexbench|compbench|fecbench|statsdump|recdump|ringbench|linkstat|logbench|packgen|packbench|toacheck|check|telemetry|clean]
+
+BUILD = build
+
+### WARNINGS ###
+# (see https://gcc.gnu.org/onlinedocs/gcc-6.3.0/gcc/Warning-Options.html)
+WARNINGS += -Wall -Wextra -Wshadow -Wundef -Wformat=2 -Wtrampolines -Wfloat-equal
+WARNINGS += -Wbad-function-cast -Wstrict-prototypes -Wpacked
+WARNINGS += -Wno-aggressive-loop-optimizations -Wmissing-prototypes -Winit-self
+WARNINGS += -Wmissing-declarations -Wmissing-format-attribute -Wunreachable-code
+WARNINGS += -Wshift-overflow=2 -Wduplicated-cond -Wpointer-arith -Wwrite-strings
+WARNINGS += -Wnested-externs -Wcast-align -Wredundant-decls
+WARNINGS += -Werror=implicit-function-declaration -Wlogical-not-parentheses
+WARNINGS += -Wlogical-op -Wold-style-definition -Wcast-qual -Wdouble-promotion
+WARNINGS += -Wunsuffixed-float-constants -Wmissing-include-dirs -Wnormalized
+WARNINGS += -Wdisabled-optimization
+CSTD = gnu11
+OPTIMIZATION = -O2
+CCFLAGS += -std=$(CSTD) $(WARNINGS) $(OPTIMIZATION) -D__DOXYGEN__=0
+
+# Extra target flags, for example -march=native to build the SIMD paths on an x86 host
+HOST_ARCH_FLAGS ?=
+CCFLAGS += $(HOST_ARCH_FLAGS)
+
+# Define program name for logging
+CCFLAGS += -DPROGNAME=broadcaster
+
+# POSIX message queue names must begin with a slash outside of QNX
+CCFLAGS += -DIN_QUEUE=\"/plogger-out\"
+
+LDLIBS += -lrt -lpthread
+
+### PROJECT INCLUDES ###
+PROJECT_ROOT = $(abspath .)
+INCLUDE_DIRS += $(PROJECT_ROOT)/src/include
+INCLUDE = $(patsubst %,-I%,$(INCLUDE_DIRS))
+
+### SOURCE FILES ###
+LOGGING_UTILS ?= $(PROJECT_ROOT)/logging-utils
+SRCFILES = $(wildcard $(PROJECT_ROOT)/src/*.c) $(LOGGING_UTILS)/logging.c
+
+all: $(BUILD)/broadcaster $(BUILD)/rn2483sim $(BUILD)/bench $(BUILD)/hexbench $(BUILD)/compbench $(BUILD)/fecbench \
+     $(BUILD)/statsdump $(BUILD)/recdump $(BUILD)/ringbench $(BUILD)/linkstat $(BUILD)/logbench \
+     $(BUILD)/packgen $(BUILD)/packbench $(BUILD)/toacheck
+
+broadcaster: $(BUILD)/broadcaster
+rn2483sim: $(BUILD)/rn2483sim
+bench: $(BUILD)/bench
+hexbench: $(BUILD)/hexbench
+compbench: $(BUILD)/compbench
+fecbench: $(BUILD)/fecbench
+statsdump: $(BUILD)/statsdump
+recdump: $(BUILD)/recdump
+ringbench: $(BUILD)/ringbench
+linkstat: $(BUILD)/linkstat
+logbench: $(BUILD)/logbench
+packgen: $(BUILD)/packgen
+packbench: $(BUILD)/packbench
+toacheck: $(BUILD)/toacheck
+
+# Runs the checks that exit with a failure on a wrong result
+check: $(BUILD)/toacheck $(BUILD)/packbench
+	$(BUILD)/toacheck
+	$(BUILD)/packbench
+
+# Regenerates the telemetry packer and unpacker after schema/telemetry.schema changes
+telemetry: $(BUILD)/packgen
+	$(BUILD)/packgen schema/telemetry.schema src/telemetry.c src/include/telemetry.h
+
+$(BUILD):
+	mkdir -p $(BUILD)
+
+$(BUILD)/broadcaster: $(SRCFILES) $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) $(SRCFILES) -o $@ $(LDLIBS)
+
+$(BUILD)/rn2483sim: tools/rn2483sim.c src/arq.c src/linkhdr.c src/radio.c src/stats.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/rn2483sim.c src/arq.c src/linkhdr.c src/radio.c src/stats.c -o $@ $(LDLIBS)
+
+$(BUILD)/bench: tools/bench.c src/aggregate.c src/compress.c src/fec.c src/fragment.c src/linkhdr.c src/ring.c src/stats.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/bench.c src/aggregate.c src/compress.c src/fec.c src/fragment.c src/linkhdr.c src/ring.c src/stats.c -o $@ $(LDLIBS)
+
+$(BUILD)/hexbench: tools/hexbench.c src/radio.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/hexbench.c src/radio.c -o $@ $(LDLIBS)
+
+$(BUILD)/compbench: tools/compbench.c src/aggregate.c src/compress.c src/radio.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/compbench.c src/aggregate.c src/compress.c src/radio.c -o $@ $(LDLIBS)
+
+$(BUILD)/fecbench: tools/fecbench.c src/fec.c src/radio.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/fecbench.c src/fec.c src/radio.c -o $@ $(LDLIBS)
+
+$(BUILD)/statsdump: tools/statsdump.c src/stats.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/statsdump.c src/stats.c -o $@ $(LDLIBS)
+
+$(BUILD)/recdump: tools/recdump.c src/record.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/recdump.c src/record.c -o $@ $(LDLIBS)
+
+$(BUILD)/ringbench: tools/ringbench.c src/ring.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/ringbench.c src/ring.c -o $@ $(LDLIBS)
+
+$(BUILD)/linkstat: tools/linkstat.c src/linkhdr.c src/stats.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/linkstat.c src/linkhdr.c src/stats.c -o $@ $(LDLIBS)
+
+$(BUILD)/logbench: tools/logbench.c src/evlog.c $(LOGGING_UTILS)/logging.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/logbench.c src/evlog.c $(LOGGING_UTILS)/logging.c -o $@ $(LDLIBS)
+
+$(BUILD)/packgen: tools/packgen.c | $(BUILD)
+	$(CC) $(CCFLAGS) tools/packgen.c -o $@ -lm
+
+$(BUILD)/packbench: tools/packbench.c src/telemetry.c src/radio.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/packbench.c src/telemetry.c src/radio.c -o $@ $(LDLIBS) -lm
+
+$(BUILD)/toacheck: tools/toacheck.c src/radio.c $(wildcard $(PROJECT_ROOT)/src/include/*.h) | $(BUILD)
+	$(CC) $(CCFLAGS) $(INCLUDE) tools/toacheck.c src/radio.c -o $@ $(LDLIBS)
+
+clean:
+	rm -rf $(BUILD)
+
+.PHONY: all broadcaster rn2483sim bench hexbench compbench fecbench statsdump recdump ringbench linkstat logbench packgen packbench toacheck check telemetry clean
@@ -0,0 +1,107 @@
+/**
+ * @file adapt.c
+ * @brief Implementation of the adaptive data rate profile ladder.
+ *
+ * Only the decision of which profile to use lives here. Reconfiguring the radio is left to the caller, which knows when
+ * the radio is between packets.
+ */
+#include "adapt.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/** The payload length used to check that each profile is faster than the one before. */
+#define COMPARE_PAYLOAD 32
+
+/** The longest ladder argument accepted. */
+#define LADDER_MAX 128
+
+/**
+ * Parses one profile of a ladder, of the form "sf[:bw[:cr]]". Omitted fields are kept from the previous profile.
+ * @param spec The profile.
+ * @param profile The previous profile, which is updated in place.
+ * @return 0 if valid, EINVAL if invalid.
+ */
+static int parse_profile(char *spec, struct lora_params_t *profile) {
+    char *save;
+    char *field = strtok_r(spec, ":", &save);
+    if (field == NULL || radio_validate_sf(field, profile)) return EINVAL;
+    field = strtok_r(NULL, ":", &save);
+    if (field == NULL) return 0;
+    if (radio_validate_bw(field, profile)) return EINVAL;
+    field = strtok_r(NULL, ":", &save);
+    if (field == NULL) return 0;
+    if (radio_validate_cr(field, profile)) return EINVAL;
+    return strtok_r(NULL, ":", &save) == NULL ? 0 : EINVAL;
+}
+
+/**
+ * Builds a ladder of profiles from the configured radio parameters and a command line ladder.
+ * @param adapt The state to initialize.
+ * @param base The configured radio parameters, which become profile 0.
+ * @param ladder The faster profiles, separated by commas and in order of increasing speed, each of the form
+ * "sf[:bw[:cr]]", for example "9,7:250,7:500:4/5". NULL disables adaptation.
+ * @return 0 if valid, EINVAL if a profile is invalid, is not faster than the one before or there are too many.
+ */
+int adapt_init(struct adapt_t *adapt, const struct lora_params_t *base, const char *ladder) {
+    memset(adapt, 0, sizeof(*adapt));
+    adapt->profiles[0] = *base;
+    adapt->count = 1;
+    if (ladder == NULL) return 0;
+
+    char copy[LADDER_MAX];
+    if (snprintf(copy, sizeof(copy), "%s", ladder) >= (int)sizeof(copy)) return EINVAL;
+
+    char *save;
+    for (char *spec = strtok_r(copy, ",", &save); spec != NULL; spec = strtok_r(NULL, ",", &save)) {
+        if (adapt->count == ADAPT_MAX_PROFILES) return EINVAL;
+        struct lora_params_t *profile = &adapt->profiles[adapt->count];
+        *profile = adapt->profiles[adapt->count - 1];
+        if (parse_profile(spec, profile)) return EINVAL;
+        if (radio_time_on_air(profile, COMPARE_PAYLOAD) >= radio_time_on_air(profile - 1, COMPARE_PAYLOAD)) {
+            return EINVAL;
+        }
+        adapt->count++;
+    }
+    return adapt->count > 1 ? 0 : EINVAL;
+}
+
+/**
+ * Decides which profile the next packet should be sent with, based on how far behind transmission is. The link steps
+ * at most one profile at a time, and stays on each for at least `ADAPT_HOLD_MS`.
+ * @param adapt The adaptive data rate state.
+ * @param depth The number of packets waiting to be sent.
+ * @param age_ms How long the longest waiting packet has waited, in milliseconds.
+ * @param now_ms The current time in milliseconds, on the same clock as later calls.
+ * @return The profile to announce, which is also stored as `adapt->next`.
+ */
+unsigned int adapt_decide(struct adapt_t *adapt, size_t depth, int64_t age_ms, int64_t now_ms) {
+    adapt->next = adapt->current;
+    if (adapt->switches > 0 && now_ms - adapt->switched_ms < ADAPT_HOLD_MS) return adapt->next;
+
+    if ((depth >= ADAPT_UP_DEPTH || age_ms >= ADAPT_UP_AGE_MS) && adapt->current + 1 < adapt->count) {
+        adapt->next = adapt->current + 1;
+    } else if (depth <= ADAPT_DOWN_DEPTH && age_ms <= ADAPT_DOWN_AGE_MS && adapt->current > 0) {
+        adapt->next = adapt->current - 1;
+    }
+    return adapt->next;
+}
+
+/**
+ * Gets the header byte for the next packet.
+ * @param adapt The adaptive data rate state.
+ * @return The profile the packet is sent with in the upper nibble, and the profile the following packet will be sent
+ * with in the lower nibble.
+ */
+uint8_t adapt_header(const struct adapt_t *adapt) { return (uint8_t)(adapt->current << 4 | adapt->next); }
+
+/**
+ * Records that the radio has been reconfigured with the announced profile.
+ * @param adapt The adaptive data rate state.
+ * @param now_ms The current time in milliseconds.
+ */
+void adapt_switched(struct adapt_t *adapt, int64_t now_ms) {
+    adapt->current = adapt->next;
+    adapt->switched_ms = now_ms;
+    adapt->switches++;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file aggregate.c
+ * @brief Implementation of length-prefixed message aggregation into radio frames.
+ *
+ * Aggregation amortizes the per-packet cost of a transmission (the `radio tx` command round trip, the LoRa preamble
+ * and header) over several messages.
+ */
+#include "aggregate.h"
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Empties a frame so it can be reused.
+ * @param frame The frame to reset.
+ * @param capacity The most bytes the frame may hold, up to `RADIO_MAX_PAYLOAD`. Less leaves room for later stages of
+ * the transmit path to add their own headers.
+ */
+void agg_reset(struct frame_t *frame, size_t capacity) {
+    frame->priority = 0;
+    frame->count = 0;
+    frame->len = 0;
+    frame->capacity = capacity < sizeof(frame->data) ? capacity : sizeof(frame->data);
+}
+
+/**
+ * Calculates the longest message that can still be appended to a frame.
+ * @param frame The frame being assembled.
+ * @return The maximum message length in bytes, or 0 if the frame is full.
+ */
+size_t agg_room(const struct frame_t *frame) {
+    size_t unused = frame->capacity - frame->len;
+    return unused > 1 ? unused - 1 : 0;
+}
+
+/**
+ * Appends a message to a frame.
+ * @param frame The frame being assembled.
+ * @param msg The message contents.
+ * @param len The length of the message in bytes.
+ * @param priority The priority of the message.
+ * @return 0 if the message was appended, or EMSGSIZE if it does not fit.
+ */
+int agg_append(struct frame_t *frame, const uint8_t *msg, size_t len, unsigned int priority) {
+    if (len > agg_room(frame)) return EMSGSIZE;
+
+    frame->data[frame->len++] = len;
+    memcpy(&frame->data[frame->len], msg, len);
+    frame->len += len;
+    frame->count++;
+    if (priority > frame->priority) frame->priority = priority;
+    return 0;
+}
+
+/**
+ * Reads the next message out of a received aggregated frame.
+ * @param frame The received frame.
+ * @param frame_len The length of the received frame in bytes.
+ * @param offset The offset of the next record, which should start at 0 and is advanced past the record read.
+ * @param msg Set to point to the message inside the frame.
+ * @param len Set to the length of the message.
+ * @return 0 if a message was read, ENOENT at the end of the frame, or EBADMSG if the frame is truncated.
+ */
+int agg_next(const uint8_t *frame, size_t frame_len, size_t *offset, const uint8_t **msg, size_t *len) {
+    if (*offset >= frame_len) return ENOENT;
+
+    size_t record_len = frame[*offset];
+    if (*offset + 1 + record_len > frame_len) return EBADMSG;
+
+    *msg = &frame[*offset + 1];
+    *len = record_len;
+    *offset += 1 + record_len;
+    return 0;
+}
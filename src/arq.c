@@ -0,0 +1,155 @@
+/**
+ * @file arq.c
+ * @brief Implementation of selective retransmission and the acknowledgements that drive it.
+ */
+#include "arq.h"
+#include "linkhdr.h"
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Prepares an empty retransmission buffer.
+ * @param arq The buffer to initialize.
+ */
+void arq_init(struct arq_t *arq) { memset(arq, 0, sizeof(*arq)); }
+
+/**
+ * Keeps a packet that has just been sent for the first time until it is acknowledged. If every slot is taken, the
+ * packet that was first sent longest ago is given up on to make room.
+ * @param arq The retransmission buffer.
+ * @param packet The packet.
+ * @param seq The link header sequence number it was sent with.
+ * @param now The current time in nanoseconds on the monotonic clock.
+ */
+void arq_track(struct arq_t *arq, const struct outgoing_t *packet, uint32_t seq, int64_t now) {
+    size_t slot = 0;
+    for (size_t i = 0; i < ARQ_SLOTS; i++) {
+        if (!arq->entries[i].used) {
+            slot = i;
+            break;
+        }
+        if (arq->entries[i].first_ns < arq->entries[slot].first_ns) slot = i;
+    }
+    if (arq->entries[slot].used) arq->abandoned++;
+    arq->entries[slot] = (struct arq_entry_t){.packet = *packet, .seq = seq, .first_ns = now, .sends = 1, .used = true};
+}
+
+/**
+ * Takes account of an attempt to send a packet again. An attempt that failed counts as a send too, so that a packet the
+ * radio keeps failing to send is given up on after `ARQ_MAX_SENDS`.
+ * @param arq The retransmission buffer.
+ * @param slot The slot `arq_next` gave for the packet.
+ * @param seq The link header sequence number it was sent with this time.
+ * @param sent Whether the radio sent it. One that was not is still missing at the ground station.
+ */
+void arq_resent(struct arq_t *arq, size_t slot, uint32_t seq, bool sent) {
+    struct arq_entry_t *entry = &arq->entries[slot];
+    entry->seq = seq;
+    entry->sends++;
+    entry->pending = !sent;
+    arq->retransmits++;
+}
+
+/**
+ * Takes account of an acknowledgement. Packets the ground station reports hearing are forgotten, and every other packet
+ * waiting is marked to be sent again, including ones sent too long before the newest frame heard to be reported on.
+ * @param arq The retransmission buffer.
+ * @param data The packet received in the receive window.
+ * @param len The length of the packet in bytes.
+ * @param last_seq The link header sequence number of the last frame sent, which the acknowledgement cannot be newer
+ * than.
+ * @return 0 if successful, EINVAL if the packet is not an acknowledgement.
+ */
+int arq_ack(struct arq_t *arq, const uint8_t *data, size_t len, uint32_t last_seq) {
+    if (len != ARQ_ACK_LEN || data[0] != ARQ_ACK_TYPE) return EINVAL;
+    uint16_t newest_low = data[1] | data[2] << 8;
+    uint32_t heard = (uint32_t)data[3] | (uint32_t)data[4] << 8 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 24;
+    uint32_t newest = last_seq - (uint16_t)(last_seq - newest_low);
+    arq->acks++;
+
+    for (size_t i = 0; i < ARQ_SLOTS; i++) {
+        struct arq_entry_t *entry = &arq->entries[i];
+        if (!entry->used) continue;
+        int32_t behind = (int32_t)(newest - entry->seq);
+        if (behind == 0 || (behind > 0 && behind <= ARQ_ACK_SPAN && heard >> (behind - 1) & 1)) {
+            entry->used = false;
+            arq->acked++;
+        } else {
+            entry->pending = true;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Takes account of a receive window passing without an acknowledgement, which means the ground station did not hear the
+ * frame that was just sent.
+ * @param arq The retransmission buffer.
+ * @param seq The link header sequence number of the frame.
+ */
+void arq_missed(struct arq_t *arq, uint32_t seq) {
+    for (size_t i = 0; i < ARQ_SLOTS; i++) {
+        if (arq->entries[i].used && arq->entries[i].seq == seq) arq->entries[i].pending = true;
+    }
+}
+
+/**
+ * Picks the packet to send again, giving up on packets that have expired or been sent too many times on the way.
+ * @param arq The retransmission buffer.
+ * @param now The current time in nanoseconds on the monotonic clock.
+ * @param slot Set to the slot of the packet that was first sent longest ago of those the ground station missed.
+ * @return True if there is a packet to send again.
+ */
+bool arq_next(struct arq_t *arq, int64_t now, size_t *slot) {
+    bool found = false;
+    for (size_t i = 0; i < ARQ_SLOTS; i++) {
+        struct arq_entry_t *entry = &arq->entries[i];
+        if (!entry->used) continue;
+        if (now - entry->first_ns > (int64_t)ARQ_EXPIRE_MS * 1000000 ||
+            (entry->pending && entry->sends >= ARQ_MAX_SENDS)) {
+            entry->used = false;
+            arq->abandoned++;
+            continue;
+        }
+        if (entry->pending && (!found || entry->first_ns < arq->entries[*slot].first_ns)) {
+            *slot = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * Takes account of a frame the ground station heard. A sequence number far behind the newest means the sender
+ * restarted, so what was heard before is forgotten.
+ * @param rx What the ground station has heard of the radio's frames.
+ * @param seq The link header sequence number of the frame.
+ */
+void arq_heard(struct arq_receiver_t *rx, uint32_t seq) {
+    int32_t ahead = (int32_t)(seq - rx->newest);
+    if (!rx->started || ahead < -LHDR_RESTART_GAP) {
+        *rx = (struct arq_receiver_t){.started = true, .newest = seq};
+    } else if (ahead > ARQ_ACK_SPAN) {
+        rx->newest = seq;
+        rx->heard = 0;
+    } else if (ahead > 0) {
+        rx->heard = (uint32_t)(((uint64_t)rx->heard << 1 | 1) << (ahead - 1));
+        rx->newest = seq;
+    } else if (ahead < 0 && ahead >= -ARQ_ACK_SPAN) {
+        rx->heard |= (uint32_t)1 << (-ahead - 1);
+    }
+}
+
+/**
+ * Writes the acknowledgement of what the ground station has heard.
+ * @param rx What the ground station has heard of the radio's frames.
+ * @param out Where to write the acknowledgement, with room for `ARQ_ACK_LEN` bytes.
+ * @return The number of bytes written.
+ */
+size_t arq_ack_encode(const struct arq_receiver_t *rx, uint8_t *out) {
+    out[0] = ARQ_ACK_TYPE;
+    out[1] = rx->newest & 0xff;
+    out[2] = rx->newest >> 8 & 0xff;
+    for (size_t i = 0; i < 4; i++) out[3 + i] = rx->heard >> (8 * i) & 0xff;
+    return ARQ_ACK_LEN;
+}
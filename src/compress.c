@@ -0,0 +1,320 @@
+/**
+ * @file compress.c
+ * @brief Implementation of frame compression and the reference decoder for the ground station.
+ *
+ * Frames are at most one radio payload long, so the LZ encoder can afford a greedy search of the earlier positions
+ * that share a three byte hash. The search state lives on the stack and nothing is allocated.
+ */
+#include "compress.h"
+#include <errno.h>
+#include <string.h>
+
+/** The shortest match worth encoding, since a match takes two bytes. */
+#define LZ_MIN_MATCH 3
+
+/** The longest match that can be encoded. */
+#define LZ_MAX_MATCH (255 + LZ_MIN_MATCH)
+
+/** The furthest back a match can start. */
+#define LZ_MAX_DIST 256
+
+/** The number of buckets in the match search hash table. */
+#define LZ_HASH_SIZE 256
+
+/** The most earlier positions examined for each match. */
+#define LZ_MAX_CHAIN 32
+
+/** The width of the sequence number in the header. */
+#define SEQ_MASK 0x0f
+
+/**
+ * Validates a compression mode argument.
+ * @param mode The mode argument, either "lz" or "delta".
+ * @param delta Set to whether the delta codec may be used.
+ * @return 0 if valid, EINVAL if invalid.
+ */
+int comp_validate_mode(const char *mode, bool *delta) {
+    if (!strcmp(mode, "lz")) *delta = false;
+    else if (!strcmp(mode, "delta")) *delta = true;
+    else return EINVAL;
+    return 0;
+}
+
+/**
+ * Hashes the three bytes a match would start with.
+ * @param p The first of the three bytes.
+ * @return The hash table bucket.
+ */
+static unsigned int lz_hash(const uint8_t *p) {
+    uint32_t key = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+    return (key * 2654435761u) >> 24;
+}
+
+/**
+ * LZ encodes a buffer, giving up as soon as the output would exceed a limit.
+ * @param in The bytes to encode.
+ * @param len The number of bytes to encode.
+ * @param out The buffer to write the encoding to.
+ * @param max_out The most bytes the encoding may take.
+ * @return The length of the encoding, or 0 if it would be longer than `max_out`.
+ */
+static size_t lz_encode(const uint8_t *in, size_t len, uint8_t *out, size_t max_out) {
+    int16_t head[LZ_HASH_SIZE];
+    int16_t prev[COMP_MAX_FRAME];
+    memset(head, 0xff, sizeof(head));
+
+    size_t o = 0;
+    size_t flags_at = 0;
+    unsigned int bit = 8;
+    size_t i = 0;
+    while (i < len) {
+        if (bit == 8) {
+            if (o >= max_out) return 0;
+            flags_at = o;
+            out[o++] = 0;
+            bit = 0;
+        }
+
+        /* Find the longest earlier match among positions with the same hash, nearest first. */
+        size_t best_len = 0, best_dist = 0;
+        if (i + LZ_MIN_MATCH <= len) {
+            size_t limit = len - i < LZ_MAX_MATCH ? len - i : LZ_MAX_MATCH;
+            int chain = 0;
+            for (int c = head[lz_hash(&in[i])]; c >= 0 && i - c <= LZ_MAX_DIST && chain < LZ_MAX_CHAIN;
+                 c = prev[c], chain++) {
+                size_t n = 0;
+                while (n < limit && in[c + n] == in[i + n]) n++;
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = i - c;
+                    if (n == limit) break;
+                }
+            }
+        }
+
+        size_t advance = 1;
+        if (best_len >= LZ_MIN_MATCH) {
+            if (o + 2 > max_out) return 0;
+            out[flags_at] |= 1u << bit;
+            out[o++] = best_dist - 1;
+            out[o++] = best_len - LZ_MIN_MATCH;
+            advance = best_len;
+        } else {
+            if (o + 1 > max_out) return 0;
+            out[o++] = in[i];
+        }
+        bit++;
+
+        for (; advance > 0; advance--, i++) {
+            if (i + LZ_MIN_MATCH > len) continue;
+            unsigned int h = lz_hash(&in[i]);
+            prev[i] = head[h];
+            head[h] = i;
+        }
+    }
+    return o;
+}
+
+/**
+ * Decodes an LZ encoded buffer.
+ * @param in The encoding.
+ * @param len The length of the encoding.
+ * @param out The buffer to write the decoded bytes to.
+ * @param max_out The size of the output buffer.
+ * @param out_len Set to the number of decoded bytes.
+ * @return 0 if successful, or EBADMSG if the encoding is corrupt.
+ */
+static int lz_decode(const uint8_t *in, size_t len, uint8_t *out, size_t max_out, size_t *out_len) {
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint8_t flags = in[i++];
+        for (unsigned int bit = 0; bit < 8 && i < len; bit++) {
+            if (!(flags & (1u << bit))) {
+                if (o >= max_out) return EBADMSG;
+                out[o++] = in[i++];
+                continue;
+            }
+
+            if (i + 2 > len) return EBADMSG;
+            size_t dist = (size_t)in[i] + 1;
+            size_t n = (size_t)in[i + 1] + LZ_MIN_MATCH;
+            i += 2;
+            if (dist > o || o + n > max_out) return EBADMSG;
+            for (; n > 0; n--, o++) out[o] = out[o - dist]; // Matches may overlap the bytes they produce
+        }
+    }
+    *out_len = o;
+    return 0;
+}
+
+/**
+ * Encodes the difference between a frame and the previous one as its length, a bitmap of the bytes that changed and
+ * the changed bytes, giving up as soon as the output would exceed a limit.
+ * @param frame The frame to encode.
+ * @param len The length of the frame.
+ * @param ref The previous frame.
+ * @param ref_len The length of the previous frame.
+ * @param out The buffer to write the encoding to.
+ * @param max_out The most bytes the encoding may take.
+ * @return The length of the encoding, or 0 if it would be longer than `max_out`.
+ */
+static size_t delta_encode(const uint8_t *frame, size_t len, const uint8_t *ref, size_t ref_len, uint8_t *out,
+                           size_t max_out) {
+    size_t o = 1 + (len + 7) / 8;
+    if (o > max_out) return 0;
+    memset(out, 0, o);
+    out[0] = len;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t diff = i < ref_len ? frame[i] ^ ref[i] : frame[i];
+        if (diff == 0) continue;
+        if (o >= max_out) return 0;
+        out[1 + i / 8] |= 1u << (i % 8);
+        out[o++] = diff;
+    }
+    return o;
+}
+
+/**
+ * Decodes the difference between a frame and the previous one.
+ * @param in The encoding.
+ * @param len The length of the encoding.
+ * @param ref The previous frame.
+ * @param ref_len The length of the previous frame.
+ * @param frame The buffer to write the frame to, which must hold `COMP_MAX_FRAME` bytes.
+ * @param frame_len Set to the length of the frame.
+ * @return 0 if successful, or EBADMSG if the encoding is corrupt.
+ */
+static int delta_decode(const uint8_t *in, size_t len, const uint8_t *ref, size_t ref_len, uint8_t *frame,
+                        size_t *frame_len) {
+    if (len < 1) return EBADMSG;
+    size_t n = in[0];
+    size_t i = 1 + (n + 7) / 8;
+    if (n > COMP_MAX_FRAME || i > len) return EBADMSG;
+
+    for (size_t k = 0; k < n; k++) {
+        uint8_t diff = 0;
+        if (in[1 + k / 8] & (1u << (k % 8))) {
+            if (i >= len) return EBADMSG;
+            diff = in[i++];
+        }
+        frame[k] = k < ref_len ? ref[k] ^ diff : diff;
+    }
+    if (i != len) return EBADMSG;
+    *frame_len = n;
+    return 0;
+}
+
+/**
+ * Prepares the sending side of a compressed link.
+ * @param enc The encoder state to initialize.
+ * @param delta Whether the delta codec may be used.
+ */
+void comp_encoder_init(struct comp_encoder_t *enc, bool delta) {
+    memset(enc, 0, sizeof(*enc));
+    enc->delta = delta;
+}
+
+/**
+ * Compresses a frame with whichever codec makes it smallest, or sends it raw if none shrink it.
+ * @param enc The encoder state.
+ * @param frame The frame to compress.
+ * @param len The length of the frame in bytes.
+ * @param out The buffer to write the compressed frame to, which must hold `COMP_MAX_ENCODED` bytes.
+ * @param out_len Set to the length of the compressed frame, header included.
+ * @return 0 if successful, or EMSGSIZE if the frame is longer than `COMP_MAX_FRAME`.
+ */
+int comp_encode(struct comp_encoder_t *enc, const uint8_t *frame, size_t len, uint8_t *out, size_t *out_len) {
+    if (len > COMP_MAX_FRAME) return EMSGSIZE;
+
+    Codec codec = COMP_RAW;
+    size_t best = len;
+    size_t n = len > 0 ? lz_encode(frame, len, &out[COMP_HEADER_LEN], best - 1) : 0;
+    if (n > 0) {
+        codec = COMP_LZ;
+        best = n;
+    }
+
+    if (enc->delta && enc->ref_len > 0 && enc->since_key < COMP_KEYFRAME_INTERVAL && best > 1) {
+        uint8_t encoded[COMP_MAX_FRAME];
+        n = delta_encode(frame, len, enc->ref, enc->ref_len, encoded, best - 1);
+        if (n > 0) {
+            codec = COMP_DELTA;
+            best = n;
+            memcpy(&out[COMP_HEADER_LEN], encoded, n);
+        }
+    }
+
+    if (codec == COMP_RAW) memcpy(&out[COMP_HEADER_LEN], frame, len);
+    out[0] = (uint8_t)(codec << 4 | enc->seq);
+    *out_len = COMP_HEADER_LEN + best;
+    enc->bytes_in += len;
+    enc->bytes_out += *out_len;
+
+    enc->since_key = codec == COMP_DELTA ? enc->since_key + 1 : 0;
+    enc->seq = (enc->seq + 1) & SEQ_MASK;
+    memcpy(enc->ref, frame, len);
+    enc->ref_len = len;
+    return 0;
+}
+
+/**
+ * Prepares the receiving side of a compressed link.
+ * @param dec The decoder state to initialize.
+ */
+void comp_decoder_init(struct comp_decoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+    dec->seq = -1;
+}
+
+/**
+ * Decompresses a received frame.
+ * @param dec The decoder state.
+ * @param in The received frame, header included.
+ * @param len The length of the received frame.
+ * @param frame The buffer to write the decompressed frame to, which must hold `COMP_MAX_FRAME` bytes.
+ * @param frame_len Set to the length of the decompressed frame.
+ * @return 0 if successful, ENOENT if the frame is delta coded against a frame that was not received, or EBADMSG if the
+ * frame is corrupt.
+ */
+int comp_decode(struct comp_decoder_t *dec, const uint8_t *in, size_t len, uint8_t *frame, size_t *frame_len) {
+    if (len < COMP_HEADER_LEN) return EBADMSG;
+    unsigned int codec = in[0] >> 4;
+    int seq = in[0] & SEQ_MASK;
+    const uint8_t *body = &in[COMP_HEADER_LEN];
+    size_t body_len = len - COMP_HEADER_LEN;
+
+    int err = 0;
+    switch (codec) {
+    case COMP_RAW:
+        if (body_len > COMP_MAX_FRAME) err = EBADMSG;
+        else {
+            memcpy(frame, body, body_len);
+            *frame_len = body_len;
+        }
+        break;
+    case COMP_LZ:
+        err = lz_decode(body, body_len, frame, COMP_MAX_FRAME, frame_len);
+        break;
+    case COMP_DELTA:
+        if (dec->seq != ((seq - 1) & SEQ_MASK)) {
+            err = ENOENT;
+            break;
+        }
+        err = delta_decode(body, body_len, dec->ref, dec->ref_len, frame, frame_len);
+        break;
+    default:
+        err = EBADMSG;
+        break;
+    }
+
+    /* Once a frame is missed, delta frames cannot be trusted until the next frame that is not delta coded. */
+    if (err) {
+        dec->seq = -1;
+        return err;
+    }
+    memcpy(dec->ref, frame, *frame_len);
+    dec->ref_len = *frame_len;
+    dec->seq = seq;
+    return 0;
+}
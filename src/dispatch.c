@@ -0,0 +1,274 @@
+/**
+ * @file dispatch.c
+ * @brief Implementation of spreading packets across radio links.
+ *
+ * The cost of a packet on a link is its time on air under the link's radio parameters plus its UART wire time, scaled
+ * up by the duty cycle if the link is paced. Each link keeps a running prediction of when it will have sent everything
+ * it has been given, which a packet is added to when it is placed and which restarts from the present whenever the link
+ * empties.
+ */
+#include "dispatch.h"
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Initializes a dispatcher with no links. Links are added by filling in `links` and `nlinks` before any thread uses it.
+ * @param d The dispatcher.
+ * @param mirror Whether high priority packets are sent on every link.
+ * @param top_priority The lowest priority that is mirrored.
+ * @return 0 if successful, otherwise the error from creating the lock or condition variable.
+ */
+int dispatch_init(struct dispatcher_t *d, bool mirror, unsigned int top_priority) {
+    memset(d, 0, sizeof(*d));
+    d->mirror = mirror;
+    d->top_priority = top_priority;
+    int err = pthread_mutex_init(&d->lock, NULL);
+    if (err) return err;
+    return pthread_cond_init(&d->changed, NULL);
+}
+
+/**
+ * Predicts how long a link will spend sending a packet.
+ * @param link The link.
+ * @param len The length of the packet in bytes.
+ * @return The predicted time in nanoseconds.
+ */
+static int64_t cost_ns(const struct radio_link_t *link, size_t len) {
+    int64_t air = (int64_t)radio_time_on_air(&link->params, len) * 1000;
+    if (link->pacer.duty_ppm) air = air * 1000000 / link->pacer.duty_ppm;
+    return air + (int64_t)radio_wire_time(link->radio.baud, len) * 1000;
+}
+
+/**
+ * Adds a packet to a link's outbox, which must have room.
+ * @param link The link.
+ * @param packet The packet.
+ * @param now The current time in nanoseconds.
+ */
+static void place(struct radio_link_t *link, const struct outgoing_t *packet, int64_t now) {
+    link->outbox[(link->head + link->count) % DISPATCH_SLOTS] = *packet;
+    link->count++;
+    if (link->free_at_ns < now) link->free_at_ns = now;
+    link->free_at_ns += cost_ns(link, packet->len);
+}
+
+/**
+ * Finds the link that is up, has room in its outbox and is predicted to finish sending a packet first.
+ * @param d The dispatcher.
+ * @param len The length of the packet in bytes.
+ * @param now The current time in nanoseconds.
+ * @return The link, or NULL if no link can take the packet.
+ */
+static struct radio_link_t *best_link(struct dispatcher_t *d, size_t len, int64_t now) {
+    struct radio_link_t *best = NULL;
+    int64_t best_finish = 0;
+    for (size_t i = 0; i < d->nlinks; i++) {
+        struct radio_link_t *link = &d->links[i];
+        if (!link->up || link->count >= DISPATCH_OUTBOX) continue;
+        int64_t finish = (link->free_at_ns > now ? link->free_at_ns : now) + cost_ns(link, len);
+        if (best == NULL || finish < best_finish) {
+            best = link;
+            best_finish = finish;
+        }
+    }
+    return best;
+}
+
+/**
+ * Places a packet with the link predicted to send it first, or with every link if it is mirrored, blocking until
+ * there is room. A mirrored packet waits until every link that is up has room.
+ * @param d The dispatcher.
+ * @param packet The packet.
+ * @return 0 if the packet was placed, or EPIPE if the dispatcher has been closed.
+ */
+int dispatch_submit(struct dispatcher_t *d, const struct outgoing_t *packet) {
+    bool mirrored = d->mirror && d->nlinks > 1 && packet->priority >= d->top_priority;
+
+    pthread_mutex_lock(&d->lock);
+    while (!d->closed) {
+        int64_t now = radio_now_ns();
+        if (!mirrored) {
+            struct radio_link_t *link = best_link(d, packet->len, now);
+            if (link != NULL) {
+                place(link, packet, now);
+                break;
+            }
+        } else {
+            size_t up = 0, ready = 0;
+            for (size_t i = 0; i < d->nlinks; i++) {
+                if (!d->links[i].up) continue;
+                up++;
+                if (d->links[i].count < DISPATCH_OUTBOX) ready++;
+            }
+            if (up > 0 && ready == up) {
+                for (size_t i = 0; i < d->nlinks; i++) {
+                    if (d->links[i].up) place(&d->links[i], packet, now);
+                }
+                break;
+            }
+        }
+        pthread_cond_wait(&d->changed, &d->lock);
+    }
+    int err = d->closed ? EPIPE : 0;
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    return err;
+}
+
+/**
+ * Counts the packets waiting in every outbox.
+ * @param d The dispatcher.
+ * @return The number of packets.
+ */
+static size_t waiting(const struct dispatcher_t *d) {
+    size_t total = 0;
+    for (size_t i = 0; i < d->nlinks; i++) total += d->links[i].count;
+    return total;
+}
+
+/**
+ * Moves packets left in the outboxes of links that are down to a link that is up, while it has room.
+ * @param d The dispatcher.
+ * @param link The link that is up.
+ * @param now The current time in nanoseconds.
+ */
+static void rescue(struct dispatcher_t *d, struct radio_link_t *link, int64_t now) {
+    for (size_t i = 0; i < d->nlinks && link->count < DISPATCH_OUTBOX; i++) {
+        struct radio_link_t *down = &d->links[i];
+        if (down->up) continue;
+        while (down->count > 0 && link->count < DISPATCH_OUTBOX) {
+            place(link, &down->outbox[down->head], now);
+            down->head = (down->head + 1) % DISPATCH_SLOTS;
+            down->count--;
+        }
+    }
+}
+
+/**
+ * Takes the next packet for a link to send, blocking until there is one unless told not to wait. A link that is up and
+ * has nothing to send takes over packets stranded on links that are down.
+ * @param d The dispatcher.
+ * @param link The link.
+ * @param packet Where to copy the packet.
+ * @param wait Whether to wait for a packet when a link that is up has none.
+ * @return 0 if a packet was taken, EAGAIN if there was none and `wait` is false, EPIPE if the dispatcher has been
+ * closed and every outbox is empty, or ENETDOWN if the link is down and must be recovered.
+ */
+int dispatch_take(struct dispatcher_t *d, struct radio_link_t *link, struct outgoing_t *packet, bool wait) {
+    pthread_mutex_lock(&d->lock);
+    int err = 0;
+    while (true) {
+        if (link->up && link->count == 0) rescue(d, link, radio_now_ns());
+        if (link->up && link->count > 0) {
+            *packet = link->outbox[link->head];
+            link->head = (link->head + 1) % DISPATCH_SLOTS;
+            link->count--;
+            pthread_cond_broadcast(&d->changed);
+            break;
+        }
+        if (!wait && link->up) {
+            err = EAGAIN;
+            break;
+        }
+        // A link whose work is done waits for the others, since any of them could go down and hand it packets
+        if (d->closed && waiting(d) == 0) {
+            err = EPIPE;
+            break;
+        }
+        if (!link->up) {
+            err = ENETDOWN;
+            break;
+        }
+        pthread_cond_wait(&d->changed, &d->lock);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return err;
+}
+
+/**
+ * Marks a link down and moves the packets waiting in its outbox to other links where there is room. Packets that find
+ * no room stay where they are, to be rescued by a link that runs out of work or sent once the link is back up.
+ * @param d The dispatcher, whose lock must be held.
+ * @param link The link.
+ * @param now The current time in nanoseconds.
+ */
+static void take_down(struct dispatcher_t *d, struct radio_link_t *link, int64_t now) {
+    link->up = false;
+    link->downs++;
+    link->down_since_ns = now;
+    size_t kept = 0;
+    for (size_t i = 0; i < link->count; i++) {
+        const struct outgoing_t *packet = &link->outbox[(link->head + i) % DISPATCH_SLOTS];
+        struct radio_link_t *other = best_link(d, packet->len, now);
+        if (other != NULL) place(other, packet, now);
+        else link->outbox[(link->head + kept++) % DISPATCH_SLOTS] = *packet;
+    }
+    link->count = kept;
+}
+
+/**
+ * Records that a link has finished with the packet it took, whether it was sent or its transmission failed. A radio
+ * that reports a failed transmission is still working, so the link stays up.
+ * @param d The dispatcher.
+ * @param link The link.
+ */
+void dispatch_done(struct dispatcher_t *d, struct radio_link_t *link) {
+    pthread_mutex_lock(&d->lock);
+    int64_t now = radio_now_ns();
+    if (link->count == 0) link->free_at_ns = now;
+
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * Records that a link could not send the packet it took because its radio stopped working. The link is marked down and
+ * the packet is handed back ahead of the others waiting in its outbox, so it is sent by another link or once this one
+ * recovers. A mirrored packet is not handed back, since its copies on the other links carry it.
+ * @param d The dispatcher.
+ * @param link The link.
+ * @param packet The packet, or NULL if it was not taken from the dispatcher and stays with the link.
+ */
+void dispatch_fail(struct dispatcher_t *d, struct radio_link_t *link, const struct outgoing_t *packet) {
+    bool mirrored = packet != NULL && d->mirror && d->nlinks > 1 && packet->priority >= d->top_priority;
+
+    pthread_mutex_lock(&d->lock);
+    if (packet != NULL && !mirrored) {
+        link->head = (link->head + DISPATCH_SLOTS - 1) % DISPATCH_SLOTS;
+        link->outbox[link->head] = *packet;
+        link->count++;
+    }
+    take_down(d, link, radio_now_ns());
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * Marks a link that was down as up again, once its radio has been recovered.
+ * @param d The dispatcher.
+ * @param link The link.
+ * @return How long the link was down, in nanoseconds.
+ */
+int64_t dispatch_up(struct dispatcher_t *d, struct radio_link_t *link) {
+    pthread_mutex_lock(&d->lock);
+    int64_t now = radio_now_ns();
+    int64_t down = now - link->down_since_ns;
+    link->up = true;
+    link->free_at_ns = now;
+    link->down_ns += down;
+    if (down > link->max_down_ns) link->max_down_ns = down;
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    return down;
+}
+
+/**
+ * Closes the dispatcher. Packets already placed are still sent, after which `dispatch_take` stops blocking.
+ * @param d The dispatcher.
+ */
+void dispatch_close(struct dispatcher_t *d) {
+    pthread_mutex_lock(&d->lock);
+    d->closed = true;
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file evlog.c
+ * @brief Implementation of the asynchronous event log.
+ *
+ * The ring is a bounded queue of slots each carrying a sequence number. A producer claims the slot at the head with a
+ * compare and swap when its sequence number says it is free at that position, writes the event, and then sets the
+ * sequence number one past the position to hand it to the background thread. The background thread, the only
+ * consumer, takes the slot at the tail once its sequence number says it is written, and frees it for the producer one
+ * lap later. No producer ever waits for another, or for the background thread.
+ *
+ * The background thread wakes up by itself every `EVLOG_POLL_MS`, so most events cost no system call at all. Only a
+ * producer that claims the first slot of either half of the ring wakes it early, so a burst does not fill the ring
+ * while it sleeps. That follows the shared memory ring: both sides store and then load sequentially
+ * consistent, so either the producer sees the background thread is sleeping, or the background thread sees the event.
+ */
+#include "evlog.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Gets the time on the monotonic clock.
+ * @return The time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Formats and writes one event.
+ * @param log The log.
+ * @param event The event.
+ */
+static void write_event(struct evlog_t *log, const struct evlog_event_t *event) {
+    char text[EVLOG_LINE_MAX];
+    log_level_e level = log->format(event, text, sizeof(text));
+    log_print(log->stream, level, "%s", text);
+}
+
+/**
+ * Writes how many times an event was repeated since one like it was last written.
+ * @param log The log.
+ * @param repeat The event being counted, which has been repeated at least once.
+ * @param now When the count ends, in nanoseconds on the monotonic clock.
+ */
+static void write_repeats(struct evlog_t *log, struct evlog_repeat_t *repeat, int64_t now) {
+    char text[EVLOG_LINE_MAX];
+    log_level_e level = log->format(&repeat->last, text, sizeof(text));
+    log_print(log->stream, level, "%s (repeated %llu time%s in %.1f s)", text, (unsigned long long)repeat->count,
+              repeat->count == 1 ? "" : "s", (double)(now - repeat->written_ns) / 1000000000);
+    repeat->written_ns = now;
+    repeat->count = 0;
+}
+
+/**
+ * Writes an event, unless one like it was written too recently, in which case it is only counted.
+ * @param log The log.
+ * @param event The event.
+ */
+static void handle_event(struct evlog_t *log, const struct evlog_event_t *event) {
+    struct evlog_repeat_t *repeat = NULL, *oldest = &log->repeats[0];
+    for (size_t i = 0; i < EVLOG_TRACKED; i++) {
+        struct evlog_repeat_t *r = &log->repeats[i];
+        if (!r->used || r->written_ns < oldest->written_ns) oldest = r;
+        if (r->used && r->last.code == event->code && r->last.err == event->err &&
+            (r->last.subject == event->subject ||
+             (r->last.subject != NULL && event->subject != NULL && !strcmp(r->last.subject, event->subject)))) {
+            repeat = r;
+            break;
+        }
+        if (!r->used) break;
+    }
+
+    if (repeat != NULL && event->time_ns - repeat->written_ns < (int64_t)EVLOG_REPEAT_MS * 1000000) {
+        repeat->last = *event;
+        repeat->count++;
+        atomic_fetch_add(&log->suppressed, 1);
+        return;
+    }
+    if (repeat != NULL && repeat->count > 0) write_repeats(log, repeat, event->time_ns);
+    if (repeat == NULL) {
+        // Forgetting an event that was being counted would lose its count
+        repeat = oldest;
+        if (repeat->used && repeat->count > 0) write_repeats(log, repeat, event->time_ns);
+    }
+
+    write_event(log, event);
+    repeat->last = *event;
+    repeat->written_ns = event->time_ns;
+    repeat->count = 0;
+    repeat->used = true;
+}
+
+/**
+ * Writes the counts of events whose period of being counted is over, or of every event being counted.
+ * @param log The log.
+ * @param all Whether to write every count, as when the log stops.
+ */
+static void flush_repeats(struct evlog_t *log, bool all) {
+    int64_t now = now_ns();
+    for (size_t i = 0; i < EVLOG_TRACKED; i++) {
+        struct evlog_repeat_t *repeat = &log->repeats[i];
+        if (repeat->used && repeat->count > 0 &&
+            (all || now - repeat->written_ns >= (int64_t)EVLOG_REPEAT_MS * 1000000)) {
+            write_repeats(log, repeat, now);
+        }
+    }
+}
+
+/**
+ * Takes the next event off the ring.
+ * @param log The log.
+ * @param event Set to the event.
+ * @return True if there was an event, false if the ring is empty.
+ */
+static bool take_event(struct evlog_t *log, struct evlog_event_t *event) {
+    struct evlog_slot_t *slot = &log->slots[log->tail & (EVLOG_CAPACITY - 1)];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != log->tail + 1) return false;
+    *event = slot->event;
+    atomic_store_explicit(&slot->seq, log->tail + EVLOG_CAPACITY, memory_order_release);
+    log->tail++;
+    return true;
+}
+
+/**
+ * Checks whether an event is waiting to be taken off the ring.
+ * @param log The log.
+ * @return True if the ring holds an event.
+ */
+static bool have_event(struct evlog_t *log) {
+    return atomic_load(&log->slots[log->tail & (EVLOG_CAPACITY - 1)].seq) == log->tail + 1;
+}
+
+/**
+ * Waits until the ring is half full, the log is stopped, or it is time to look at the ring again.
+ * @param log The log.
+ */
+static void wait_for_event(struct evlog_t *log) {
+    atomic_store(&log->sleeping, true);
+    if (!have_event(log) && !atomic_load(&log->closed)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += EVLOG_POLL_MS / 1000;
+        deadline.tv_nsec += (EVLOG_POLL_MS % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (sem_timedwait(&log->wake, &deadline) == -1 && errno == EINTR)
+            ;
+    }
+    atomic_store(&log->sleeping, false);
+}
+
+/**
+ * Writes events as they are posted until the log is stopped, then writes the rest.
+ * @param arg The log.
+ * @return NULL.
+ */
+static void *evlog_thread(void *arg) {
+    struct evlog_t *log = arg;
+    struct evlog_event_t event;
+    while (1) {
+        while (take_event(log, &event)) handle_event(log, &event);
+
+        uint64_t dropped = atomic_load(&log->dropped);
+        if (dropped > log->dropped_reported) {
+            log_print(log->stream, LOG_WARN, "Dropped %llu log events, the log was full",
+                      (unsigned long long)(dropped - log->dropped_reported));
+            log->dropped_reported = dropped;
+        }
+        flush_repeats(log, false);
+
+        if (atomic_load(&log->closed) && !have_event(log)) break;
+        wait_for_event(log);
+    }
+    flush_repeats(log, true);
+    return NULL;
+}
+
+/**
+ * Starts writing events in the background. Must be called before any event is posted.
+ * @param log The log, which must not be in use.
+ * @param stream Where to write events.
+ * @param format Turns events into text.
+ * @return 0 if successful, otherwise the error from creating the semaphore or thread.
+ */
+int evlog_start(struct evlog_t *log, FILE *stream, evlog_format_f format) {
+    log->stream = stream;
+    log->format = format;
+    atomic_init(&log->closed, false);
+    atomic_init(&log->posted, 0);
+    atomic_init(&log->dropped, 0);
+    atomic_init(&log->suppressed, 0);
+    atomic_init(&log->head, 0);
+    atomic_init(&log->sleeping, false);
+    log->tail = 0;
+    log->dropped_reported = 0;
+    memset(log->repeats, 0, sizeof(log->repeats));
+    for (size_t i = 0; i < EVLOG_CAPACITY; i++) atomic_init(&log->slots[i].seq, i);
+    if (sem_init(&log->wake, 0, 0)) return errno;
+
+    int err = pthread_create(&log->thread, NULL, evlog_thread, log);
+    if (err) {
+        sem_destroy(&log->wake);
+        return err;
+    }
+    log->started = true;
+    return 0;
+}
+
+/**
+ * Posts an event to be written in the background, or drops it if the log is full. Never blocks.
+ * @param log The log.
+ * @param event The event. Its time is set to now.
+ */
+void evlog_post(struct evlog_t *log, const struct evlog_event_t *event) {
+    if (atomic_load(&log->closed)) {
+        write_event(log, event);
+        return;
+    }
+    atomic_fetch_add_explicit(&log->posted, 1, memory_order_relaxed);
+
+    uint64_t pos = atomic_load_explicit(&log->head, memory_order_relaxed);
+    struct evlog_slot_t *slot;
+    while (1) {
+        slot = &log->slots[pos & (EVLOG_CAPACITY - 1)];
+        int64_t lag = (int64_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (lag < 0) {
+            // The slot still holds the event from a lap ago, so the ring is full
+            atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+            return;
+        }
+        if (lag == 0 && atomic_compare_exchange_weak_explicit(&log->head, &pos, pos + 1, memory_order_relaxed,
+                                                              memory_order_relaxed)) {
+            break;
+        }
+        // Another producer claimed the slot first, and a failed exchange has already reloaded the head
+        if (lag > 0) pos = atomic_load_explicit(&log->head, memory_order_relaxed);
+    }
+
+    slot->event = *event;
+    slot->event.time_ns = now_ns();
+    atomic_store(&slot->seq, pos + 1);
+    if (pos % (EVLOG_CAPACITY / 2) == 0 && atomic_load(&log->sleeping) && atomic_exchange(&log->sleeping, false)) {
+        sem_post(&log->wake);
+    }
+}
+
+/**
+ * Writes every event posted so far and stops the background thread. Events posted after this are written straight
+ * away, apart from any posted while it stops, which may be lost.
+ * @param log The log.
+ */
+void evlog_stop(struct evlog_t *log) {
+    if (!log->started) return;
+    atomic_store(&log->closed, true);
+    sem_post(&log->wake);
+    pthread_join(log->thread, NULL);
+}
@@ -0,0 +1,339 @@
+/**
+ * @file fec.c
+ * @brief Implementation of the packet erasure code and the reference decoder for the ground station.
+ *
+ * Parity packet `j` is the sum over the group of data symbol `i` multiplied by `1 / (x_j + y_i)`, with `x_j = 15 + j`
+ * and `y_i = i`. Every square submatrix of this Cauchy matrix is invertible, so any `k` packets of a group determine the
+ * rest. The coefficients do not depend on the group size, which lets a group be closed early and lets the encoder add
+ * each data packet to the parity as it is sent, without keeping it.
+ */
+#include "fec.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** The primitive polynomial GF(256) is generated from. */
+#define GF_POLY 0x11d
+
+/** Marks a parity packet in the index byte of the header. */
+#define PARITY_FLAG 0x80
+
+/** Powers of the generator, repeated so that sums of two logarithms can be looked up without reduction. */
+static uint8_t gf_exp[512];
+
+/** Discrete logarithms of every non-zero element. */
+static uint8_t gf_log[256];
+
+/**
+ * Fills the GF(256) exponent and logarithm tables, once.
+ */
+static void gf_init(void) {
+    if (gf_exp[0]) return;
+    unsigned int x = 1;
+    for (unsigned int i = 0; i < 255; i++) {
+        gf_exp[i] = gf_exp[i + 255] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) x ^= GF_POLY;
+    }
+}
+
+/**
+ * Multiplies two elements of GF(256).
+ * @param a The first element.
+ * @param b The second element.
+ * @return The product.
+ */
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+/**
+ * Inverts a non-zero element of GF(256).
+ * @param a The element.
+ * @return The multiplicative inverse.
+ */
+static uint8_t gf_inv(uint8_t a) { return gf_exp[255 - gf_log[a]]; }
+
+/**
+ * Adds a multiple of one symbol to another.
+ * @param dst The symbol to add to.
+ * @param src The symbol to multiply and add.
+ * @param coef The multiplier.
+ * @param len The length of the symbols.
+ */
+static void gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t coef, size_t len) {
+    if (coef == 0) return;
+    unsigned int log_coef = gf_log[coef];
+    for (size_t t = 0; t < len; t++) {
+        if (src[t]) dst[t] ^= gf_exp[gf_log[src[t]] + log_coef];
+    }
+}
+
+/**
+ * Gets the coefficient a data symbol is multiplied by in a parity symbol.
+ * @param j The index of the parity symbol.
+ * @param i The index of the data symbol.
+ * @return The coefficient.
+ */
+static uint8_t cauchy(unsigned int j, unsigned int i) { return gf_inv((uint8_t)((FEC_MAX_K + j) ^ i)); }
+
+/**
+ * Validates an FEC argument of the form "k:m" or "k:m:m_top".
+ * @param spec The argument.
+ * @param k Set to the number of data packets in a group, from 1 to `FEC_MAX_K`.
+ * @param m Set to the number of parity packets in a group, from 1 to `FEC_MAX_M`.
+ * @param m_top Set to the number of parity packets in a group holding a high priority packet, which defaults to `m`
+ * and may not be less.
+ * @return 0 if valid, EINVAL if invalid.
+ */
+int fec_validate(const char *spec, unsigned int *k, unsigned int *m, unsigned int *m_top) {
+    char *end;
+    unsigned long k_p = strtoul(spec, &end, 10);
+    if (end == spec || *end != ':') return EINVAL;
+    const char *next = end + 1;
+    unsigned long m_p = strtoul(next, &end, 10);
+    if (end == next) return EINVAL;
+    unsigned long m_top_p = m_p;
+    if (*end == ':') {
+        next = end + 1;
+        m_top_p = strtoul(next, &end, 10);
+        if (end == next) return EINVAL;
+    }
+    if (*end != '\0') return EINVAL;
+    if (k_p < 1 || k_p > FEC_MAX_K || m_p < 1 || m_p > FEC_MAX_M || m_top_p < m_p || m_top_p > FEC_MAX_M) {
+        return EINVAL;
+    }
+
+    *k = k_p;
+    *m = m_p;
+    *m_top = m_top_p;
+    return 0;
+}
+
+/**
+ * Prepares the sending side of a protected link.
+ * @param enc The encoder state to initialize.
+ * @param k The number of data packets in a full group.
+ * @param m The number of parity packets sent for a group.
+ * @param m_top The number of parity packets sent for a group holding a high priority packet.
+ */
+void fec_encoder_init(struct fec_encoder_t *enc, unsigned int k, unsigned int m, unsigned int m_top) {
+    gf_init();
+    memset(enc, 0, sizeof(*enc));
+    enc->k = k;
+    enc->m = m;
+    enc->m_top = m_top;
+}
+
+/**
+ * Adds a data packet to the current group and writes it out with its header, ready to be sent.
+ * @param enc The encoder state.
+ * @param data The packet contents.
+ * @param len The length of the packet in bytes.
+ * @param top Whether the packet is high priority, which closes the group early and gives it stronger protection.
+ * @param out The buffer to write the packet to, which must hold `FEC_HEADER_LEN` more bytes than the packet.
+ * @param out_len Set to the length of the packet written.
+ * @return 0 if successful, EMSGSIZE if the packet is longer than `FEC_MAX_DATA`, or ENOSPC if the group is full.
+ */
+int fec_add(struct fec_encoder_t *enc, const uint8_t *data, size_t len, bool top, uint8_t *out, size_t *out_len) {
+    if (len > FEC_MAX_DATA) return EMSGSIZE;
+    if (fec_full(enc)) return ENOSPC;
+
+    unsigned int i = enc->count;
+    for (unsigned int j = 0; j < enc->m_top; j++) {
+        uint8_t coef = cauchy(j, i);
+        enc->parity[j][0] ^= gf_mul(coef, len);
+        gf_mul_add(&enc->parity[j][1], data, coef, len);
+    }
+    if (len + 1 > enc->symbol_len) enc->symbol_len = len + 1;
+
+    out[0] = enc->group;
+    out[1] = i;
+    out[2] = enc->k << 4 | enc->m;
+    memcpy(&out[FEC_HEADER_LEN], data, len);
+    *out_len = FEC_HEADER_LEN + len;
+
+    enc->count++;
+    enc->top = enc->top || top;
+    return 0;
+}
+
+/**
+ * Checks whether the current group should be closed, which is when it is full or holds a high priority packet.
+ * @param enc The encoder state.
+ * @return True if the group's parity should be sent now.
+ */
+bool fec_full(const struct fec_encoder_t *enc) { return enc->count >= enc->k || (enc->top && enc->count > 0); }
+
+/**
+ * Writes out one of the parity packets of the current group, ready to be sent.
+ * @param enc The encoder state.
+ * @param j The index of the parity packet.
+ * @param out The buffer to write the packet to, which must hold `RADIO_MAX_PAYLOAD` bytes.
+ * @param out_len Set to the length of the packet written.
+ * @return 0 if successful, or ENOENT if the group is empty or has fewer parity packets.
+ */
+int fec_parity(const struct fec_encoder_t *enc, unsigned int j, uint8_t *out, size_t *out_len) {
+    unsigned int m = enc->top ? enc->m_top : enc->m;
+    if (enc->count == 0 || j >= m) return ENOENT;
+
+    out[0] = enc->group;
+    out[1] = PARITY_FLAG | j;
+    out[2] = enc->count << 4 | m;
+    memcpy(&out[FEC_HEADER_LEN], enc->parity[j], enc->symbol_len);
+    *out_len = FEC_HEADER_LEN + enc->symbol_len;
+    return 0;
+}
+
+/**
+ * Closes the current group and starts the next one.
+ * @param enc The encoder state.
+ */
+void fec_next_group(struct fec_encoder_t *enc) {
+    enc->group++;
+    enc->count = 0;
+    enc->top = false;
+    enc->symbol_len = 0;
+    memset(enc->parity, 0, sizeof(enc->parity));
+}
+
+/**
+ * Prepares the receiving side of a protected link.
+ * @param dec The decoder state to initialize.
+ */
+void fec_decoder_init(struct fec_decoder_t *dec) {
+    gf_init();
+    memset(dec, 0, sizeof(*dec));
+    dec->group = -1;
+}
+
+/**
+ * Accepts a received packet. Data packets can be read back with `fec_next` straight away, and packets rebuilt from
+ * parity once enough of their group has arrived.
+ * @param dec The decoder state.
+ * @param packet The received packet, header included.
+ * @param len The length of the received packet.
+ * @return 0 if the packet was accepted, EALREADY if it belongs to an earlier group or was already received, or EBADMSG
+ * if it is malformed.
+ */
+int fec_decode(struct fec_decoder_t *dec, const uint8_t *packet, size_t len) {
+    if (len < FEC_HEADER_LEN || len - FEC_HEADER_LEN > FEC_SYMBOL_MAX) return EBADMSG;
+    int group = packet[0];
+    bool parity = packet[1] & PARITY_FLAG;
+    unsigned int index = packet[1] & ~PARITY_FLAG;
+    unsigned int k = packet[2] >> 4;
+    if (parity ? index >= FEC_MAX_M || k == 0 : index >= FEC_MAX_K) return EBADMSG;
+    if (!parity && len - FEC_HEADER_LEN > FEC_MAX_DATA) return EBADMSG;
+
+    /* Group numbers wrap, so a group counts as newer if it is less than half the number space ahead. */
+    if (group != dec->group) {
+        if (dec->group >= 0 && (uint8_t)(group - dec->group) >= 128) return EALREADY;
+        dec->group = group;
+        dec->k = 0;
+        dec->symbol_len = 0;
+        memset(dec->have, 0, sizeof(dec->have));
+        memset(dec->delivered, 0, sizeof(dec->delivered));
+        memset(dec->symbols, 0, sizeof(dec->symbols));
+    }
+
+    unsigned int slot = parity ? FEC_MAX_K + index : index;
+    if (dec->have[slot]) return EALREADY;
+    dec->have[slot] = true;
+
+    uint8_t *symbol = dec->symbols[slot];
+    if (parity) {
+        dec->k = k;
+        dec->symbol_len = len - FEC_HEADER_LEN;
+        memcpy(symbol, &packet[FEC_HEADER_LEN], dec->symbol_len);
+    } else {
+        symbol[0] = len - FEC_HEADER_LEN;
+        memcpy(&symbol[1], &packet[FEC_HEADER_LEN], len - FEC_HEADER_LEN);
+    }
+    return 0;
+}
+
+/**
+ * Rebuilds the missing data packets of the current group if enough parity packets have arrived, by solving the
+ * equations of the parity packets for the missing symbols with Gaussian elimination.
+ * @param dec The decoder state.
+ */
+static void recover(struct fec_decoder_t *dec) {
+    if (dec->k == 0) return;
+
+    unsigned int missing[FEC_MAX_K], nmissing = 0;
+    for (unsigned int i = 0; i < dec->k; i++) {
+        if (!dec->have[i]) missing[nmissing++] = i;
+    }
+    if (nmissing == 0) return;
+
+    unsigned int rows[FEC_MAX_M], nrows = 0;
+    for (unsigned int j = 0; j < FEC_MAX_M && nrows < nmissing; j++) {
+        if (dec->have[FEC_MAX_K + j]) rows[nrows++] = j;
+    }
+    if (nrows < nmissing) return;
+
+    /* Take the known data symbols out of each parity symbol, leaving a combination of the missing ones. */
+    uint8_t matrix[FEC_MAX_K][FEC_MAX_K];
+    uint8_t syndromes[FEC_MAX_K][FEC_SYMBOL_MAX];
+    size_t len = dec->symbol_len;
+    for (unsigned int r = 0; r < nmissing; r++) {
+        memcpy(syndromes[r], dec->symbols[FEC_MAX_K + rows[r]], len);
+        for (unsigned int i = 0; i < dec->k; i++) {
+            if (dec->have[i]) gf_mul_add(syndromes[r], dec->symbols[i], cauchy(rows[r], i), len);
+        }
+        for (unsigned int c = 0; c < nmissing; c++) matrix[r][c] = cauchy(rows[r], missing[c]);
+    }
+
+    for (unsigned int c = 0; c < nmissing; c++) {
+        unsigned int pivot = c;
+        while (matrix[pivot][c] == 0) pivot++; // Cannot run off the end, since the matrix is invertible
+        if (pivot != c) {
+            uint8_t tmp[FEC_SYMBOL_MAX];
+            memcpy(tmp, matrix[c], sizeof(matrix[c]));
+            memcpy(matrix[c], matrix[pivot], sizeof(matrix[c]));
+            memcpy(matrix[pivot], tmp, sizeof(matrix[c]));
+            memcpy(tmp, syndromes[c], len);
+            memcpy(syndromes[c], syndromes[pivot], len);
+            memcpy(syndromes[pivot], tmp, len);
+        }
+
+        uint8_t scale = gf_inv(matrix[c][c]);
+        for (unsigned int t = 0; t < nmissing; t++) matrix[c][t] = gf_mul(matrix[c][t], scale);
+        for (size_t t = 0; t < len; t++) syndromes[c][t] = gf_mul(syndromes[c][t], scale);
+
+        for (unsigned int r = 0; r < nmissing; r++) {
+            uint8_t factor = matrix[r][c];
+            if (r == c || factor == 0) continue;
+            gf_mul_add(matrix[r], matrix[c], factor, nmissing);
+            gf_mul_add(syndromes[r], syndromes[c], factor, len);
+        }
+    }
+
+    for (unsigned int c = 0; c < nmissing; c++) {
+        if (syndromes[c][0] >= len) continue; // A corrupt length cannot be a real packet
+        memcpy(dec->symbols[missing[c]], syndromes[c], len);
+        dec->have[missing[c]] = true;
+        dec->recovered++;
+    }
+}
+
+/**
+ * Reads the next data packet of the current group that has been received or rebuilt and not yet read.
+ * @param dec The decoder state.
+ * @param data Set to point to the packet contents, which stay valid until the next call to `fec_decode`.
+ * @param len Set to the length of the packet.
+ * @return 0 if a packet was read, or ENOENT if there are none left to read.
+ */
+int fec_next(struct fec_decoder_t *dec, const uint8_t **data, size_t *len) {
+    recover(dec);
+    for (unsigned int i = 0; i < FEC_MAX_K; i++) {
+        if (!dec->have[i] || dec->delivered[i]) continue;
+        dec->delivered[i] = true;
+        *data = &dec->symbols[i][1];
+        *len = dec->symbols[i][0];
+        return 0;
+    }
+    return ENOENT;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file fragment.c
+ * @brief Implementation of message fragmentation and reassembly.
+ *
+ * The reassembler keeps each fragment of a partly received message where its index says it belongs, so fragments can
+ * arrive in any order and a duplicate is recognized by its bit already being set. Seven bit ids wrap around quickly, so
+ * a fragment that disagrees with the slot holding its id about the number of fragments, or about the length of one
+ * already received, starts a new message in that slot rather than being mixed into the old one.
+ */
+#include "fragment.h"
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Counts the frames a message is sent in.
+ * @param len The length of the message in bytes.
+ * @param capacity The most bytes a frame may hold, including the fragment header.
+ * @return The number of frames, 1 if the message is sent whole, or 0 if it is too long to fragment.
+ */
+unsigned int frag_count(size_t len, size_t capacity) {
+    if (len + FRAG_WHOLE_HEADER_LEN <= capacity) return 1;
+    if (capacity <= FRAG_HEADER_LEN) return 0;
+    size_t chunk = capacity - FRAG_HEADER_LEN;
+    size_t count = (len + chunk - 1) / chunk;
+    return count <= FRAG_MAX_PIECES ? count : 0;
+}
+
+/**
+ * Writes out one of the frames a message is sent in, with its fragment header.
+ * @param msg The message.
+ * @param len The length of the message in bytes.
+ * @param capacity The most bytes a frame may hold, including the fragment header.
+ * @param id The id of the message, which only matters if it is fragmented.
+ * @param index The index of the frame.
+ * @param out The buffer to write the frame to, which must hold `capacity` bytes.
+ * @param out_len Set to the length of the frame written.
+ * @return 0 if successful, EMSGSIZE if the message is too long to fragment, or ENOENT if it has fewer frames.
+ */
+int frag_piece(const uint8_t *msg, size_t len, size_t capacity, uint8_t id, unsigned int index, uint8_t *out,
+               size_t *out_len) {
+    unsigned int count = frag_count(len, capacity);
+    if (count == 0) return EMSGSIZE;
+    if (index >= count) return ENOENT;
+
+    if (count == 1) {
+        out[0] = 0;
+        memcpy(&out[FRAG_WHOLE_HEADER_LEN], msg, len);
+        *out_len = len + FRAG_WHOLE_HEADER_LEN;
+        return 0;
+    }
+
+    size_t chunk = capacity - FRAG_HEADER_LEN;
+    size_t offset = index * chunk;
+    size_t piece_len = len - offset < chunk ? len - offset : chunk;
+    out[0] = 0x80 | (id & 0x7f);
+    out[1] = index << 4 | (count - 1);
+    memcpy(&out[FRAG_HEADER_LEN], &msg[offset], piece_len);
+    *out_len = piece_len + FRAG_HEADER_LEN;
+    return 0;
+}
+
+/**
+ * Initializes a reassembler with no messages partly received.
+ * @param dec The reassembler.
+ * @param timeout_ms How long a message may take to arrive in full before it is given up on, in milliseconds.
+ */
+void frag_decoder_init(struct frag_decoder_t *dec, int64_t timeout_ms) {
+    memset(dec, 0, sizeof(*dec));
+    dec->timeout_ms = timeout_ms;
+}
+
+/**
+ * Gives up on messages whose first fragment arrived longer ago than the timeout.
+ * @param dec The reassembler.
+ * @param now_ms The current time in milliseconds.
+ */
+static void expire(struct frag_decoder_t *dec, int64_t now_ms) {
+    for (size_t i = 0; i < FRAG_SLOTS; i++) {
+        if (dec->slots[i].used && now_ms - dec->slots[i].started_ms > dec->timeout_ms) {
+            dec->slots[i].used = false;
+            dec->expired++;
+        }
+    }
+}
+
+/**
+ * Finds the slot holding a message, or a slot to start it in, giving up on the oldest message if every slot is used.
+ * @param dec The reassembler.
+ * @param id The id of the message.
+ * @return The slot.
+ */
+static struct frag_partial_t *find_slot(struct frag_decoder_t *dec, uint8_t id) {
+    struct frag_partial_t *empty = NULL, *oldest = NULL;
+    for (size_t i = 0; i < FRAG_SLOTS; i++) {
+        struct frag_partial_t *slot = &dec->slots[i];
+        if (!slot->used) {
+            if (empty == NULL) empty = slot;
+            continue;
+        }
+        if (slot->id == id) return slot;
+        if (oldest == NULL || slot->started_ms < oldest->started_ms) oldest = slot;
+    }
+    if (empty != NULL) return empty;
+    oldest->used = false;
+    dec->evicted++;
+    return oldest;
+}
+
+/**
+ * Takes in a frame with a fragment header, returning the message once it is complete.
+ * @param dec The reassembler.
+ * @param piece The frame.
+ * @param len The length of the frame in bytes.
+ * @param now_ms The current time in milliseconds, from any clock that only moves forwards.
+ * @param out The buffer to write the message to, which must hold `FRAG_MAX_MESSAGE` bytes.
+ * @param out_len Set to the length of the message.
+ * @return 0 if a message is complete, EAGAIN if more fragments are needed, or EINVAL if the header is not valid.
+ */
+int frag_decode(struct frag_decoder_t *dec, const uint8_t *piece, size_t len, int64_t now_ms, uint8_t *out,
+                size_t *out_len) {
+    expire(dec, now_ms);
+    if (len < FRAG_WHOLE_HEADER_LEN) return EINVAL;
+    if (piece[0] == 0) {
+        *out_len = len - FRAG_WHOLE_HEADER_LEN;
+        memcpy(out, &piece[FRAG_WHOLE_HEADER_LEN], *out_len);
+        return 0;
+    }
+    if (!(piece[0] & 0x80) || len < FRAG_HEADER_LEN) return EINVAL;
+
+    uint8_t id = piece[0] & 0x7f;
+    unsigned int index = piece[1] >> 4, count = (piece[1] & 0x0f) + 1;
+    size_t piece_len = len - FRAG_HEADER_LEN;
+    if (count < 2 || index >= count || piece_len > FRAG_PIECE_MAX) return EINVAL;
+
+    struct frag_partial_t *slot = find_slot(dec, id);
+    uint16_t bit = 1u << index;
+    if (slot->used && (slot->count != count || (slot->have & bit && slot->len[index] != piece_len))) {
+        slot->used = false;
+        dec->evicted++;
+    }
+    if (!slot->used) {
+        slot->used = true;
+        slot->id = id;
+        slot->count = count;
+        slot->have = 0;
+        slot->started_ms = now_ms;
+    }
+    if (slot->have & bit) {
+        dec->duplicates++;
+        return EAGAIN;
+    }
+    slot->have |= bit;
+    slot->len[index] = piece_len;
+    memcpy(slot->data[index], &piece[FRAG_HEADER_LEN], piece_len);
+    if (slot->have != (1u << count) - 1) return EAGAIN;
+
+    *out_len = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        memcpy(&out[*out_len], slot->data[i], slot->len[i]);
+        *out_len += slot->len[i];
+    }
+    slot->used = false;
+    dec->completed++;
+    return 0;
+}
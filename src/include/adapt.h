@@ -0,0 +1,62 @@
+/**
+ * @file adapt.h
+ * @brief Adaptive data rate: stepping along a ladder of radio profiles as the transmit backlog grows and shrinks.
+ *
+ * Profile 0 is the radio configuration given on the command line, and each later profile of the ladder has a shorter
+ * time on air. When packets queue up faster than they can be sent, the link steps up to the next faster profile, and
+ * once the backlog has cleared it steps back down, trading range for throughput only while it is needed.
+ *
+ * The receiver has to be tuned to a profile to hear anything at all, so every packet starts with a one byte header
+ * holding the profile it is sent with in the upper nibble and the profile the next packet will be sent with in the
+ * lower nibble. A switch is announced by the last packet sent before it, and the receiver retunes after that packet.
+ */
+#ifndef _ADAPT_H_
+#define _ADAPT_H_
+
+#include "radio.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of bytes the header adds to every packet. */
+#define ADAPT_HEADER_LEN 1
+
+/** The most profiles in a ladder, including the configured one. */
+#define ADAPT_MAX_PROFILES 8
+
+/** A backlog of this many packets steps up to a faster profile. */
+#define ADAPT_UP_DEPTH 16
+
+/** A packet waiting this long, in milliseconds, steps up to a faster profile. */
+#define ADAPT_UP_AGE_MS 1000
+
+/** The backlog must be down to this many packets to step down to a slower profile. */
+#define ADAPT_DOWN_DEPTH 2
+
+/** No packet may have waited longer than this, in milliseconds, to step down to a slower profile. */
+#define ADAPT_DOWN_AGE_MS 200
+
+/** The shortest time spent on a profile before switching again, in milliseconds, so the link does not flap. */
+#define ADAPT_HOLD_MS 2000
+
+/** The state of adaptive data rate. */
+struct adapt_t {
+    /** The ladder of profiles, slowest first. */
+    struct lora_params_t profiles[ADAPT_MAX_PROFILES];
+    /** The number of profiles in the ladder. */
+    unsigned int count;
+    /** The profile the radio is configured with. */
+    unsigned int current;
+    /** The profile announced for the next packet. */
+    unsigned int next;
+    /** When the radio last switched profile, in milliseconds since an arbitrary point. */
+    int64_t switched_ms;
+    /** The number of times the radio has switched profile. */
+    unsigned long switches;
+};
+
+int adapt_init(struct adapt_t *adapt, const struct lora_params_t *base, const char *ladder);
+unsigned int adapt_decide(struct adapt_t *adapt, size_t depth, int64_t age_ms, int64_t now_ms);
+uint8_t adapt_header(const struct adapt_t *adapt);
+void adapt_switched(struct adapt_t *adapt, int64_t now_ms);
+
+#endif // _ADAPT_H_
@@ -0,0 +1,38 @@
+/**
+ * @file aggregate.h
+ * @brief Packing of several small messages into a single radio frame.
+ *
+ * An aggregated frame is a sequence of records, each made of a one byte length followed by that many bytes of message.
+ * The receiver splits a frame back into messages by walking the records until the end of the frame.
+ */
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#include "radio.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The longest message that can be aggregated, which is one radio payload less its length prefix. */
+#define AGG_MAX_MESSAGE (RADIO_MAX_PAYLOAD - 1)
+
+/** A radio frame being assembled from messages. */
+struct frame_t {
+    /** The highest priority of any message in the frame. */
+    unsigned int priority;
+    /** The number of messages in the frame. */
+    unsigned int count;
+    /** The number of bytes used in `data`. */
+    size_t len;
+    /** The number of bytes of `data` the frame may use. */
+    size_t capacity;
+    /** The encoded frame. */
+    uint8_t data[RADIO_MAX_PAYLOAD];
+};
+
+void agg_reset(struct frame_t *frame, size_t capacity);
+size_t agg_room(const struct frame_t *frame);
+int agg_append(struct frame_t *frame, const uint8_t *msg, size_t len, unsigned int priority);
+int agg_next(const uint8_t *frame, size_t frame_len, size_t *offset, const uint8_t **msg, size_t *len);
+
+#endif // _AGGREGATE_H_
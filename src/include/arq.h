@@ -0,0 +1,96 @@
+/**
+ * @file arq.h
+ * @brief Selective retransmission of top priority packets, driven by acknowledgements the ground station sends back in
+ * short receive windows, and the reference ground-station side that builds those acknowledgements.
+ *
+ * After sending a top priority packet the radio listens for a few milliseconds. A ground station that has just heard a
+ * top priority frame answers with an acknowledgement: the byte `ARQ_ACK_TYPE`, the low 16 bits of the newest link
+ * header sequence number it has heard, then 32 bits in which bit i is set if it heard the frame i + 1 before the
+ * newest, both little-endian. Top priority packets are kept until they are acknowledged, and one the ground station missed is
+ * sent again under a new sequence number before any new packet. Packets are given up on after `ARQ_MAX_SENDS` sends or
+ * `ARQ_EXPIRE_MS`, whichever comes first, since telemetry that old is no longer worth the air time.
+ *
+ * A lost acknowledgement makes the sender resend a packet the ground station already has, so receivers may see some
+ * packets twice.
+ */
+#ifndef _ARQ_H_
+#define _ARQ_H_
+
+#include "dispatch.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of packets waiting for acknowledgement that are kept per radio. */
+#define ARQ_SLOTS 8
+
+/** The first byte of an acknowledgement. */
+#define ARQ_ACK_TYPE 0xac
+
+/** The length of an acknowledgement in bytes. */
+#define ARQ_ACK_LEN 7
+
+/** The number of frames before the newest that an acknowledgement reports on. */
+#define ARQ_ACK_SPAN 32
+
+/** The most times a packet is sent before it is given up on. */
+#define ARQ_MAX_SENDS 4
+
+/** How long after it was first sent a packet is given up on, in milliseconds. */
+#define ARQ_EXPIRE_MS 5000
+
+/** A packet waiting to be acknowledged. */
+struct arq_entry_t {
+    /** The packet, as it was handed to the radio link before its link header was added. */
+    struct outgoing_t packet;
+    /** The link header sequence number the packet was last sent with. */
+    uint32_t seq;
+    /** When the packet was first sent, in nanoseconds on the monotonic clock. */
+    int64_t first_ns;
+    /** The number of times the packet has been sent. */
+    unsigned int sends;
+    /** Whether the ground station is known to have missed the last send. */
+    bool pending;
+    /** Whether the entry holds a packet. */
+    bool used;
+};
+
+/** The packets one radio is waiting to have acknowledged, and counters of how the receive windows went. */
+struct arq_t {
+    /** The packets waiting for acknowledgement. */
+    struct arq_entry_t entries[ARQ_SLOTS];
+    /** The number of receive windows opened. */
+    uint64_t windows;
+    /** The number of acknowledgements received. */
+    uint64_t acks;
+    /** The number of packets acknowledged. */
+    uint64_t acked;
+    /** The number of packets sent again. */
+    uint64_t retransmits;
+    /** The number of packets given up on without being acknowledged. */
+    uint64_t abandoned;
+    /** The total time spent listening for acknowledgements, in nanoseconds. */
+    int64_t listen_ns;
+};
+
+/** What the ground station has heard of one radio's frames, from which it builds acknowledgements. */
+struct arq_receiver_t {
+    /** Whether a frame has been heard. */
+    bool started;
+    /** The sequence number of the newest frame heard. */
+    uint32_t newest;
+    /** Bit i is set if the frame i + 1 before the newest was heard. */
+    uint32_t heard;
+};
+
+void arq_init(struct arq_t *arq);
+void arq_track(struct arq_t *arq, const struct outgoing_t *packet, uint32_t seq, int64_t now);
+void arq_resent(struct arq_t *arq, size_t slot, uint32_t seq, bool sent);
+int arq_ack(struct arq_t *arq, const uint8_t *data, size_t len, uint32_t last_seq);
+void arq_missed(struct arq_t *arq, uint32_t seq);
+bool arq_next(struct arq_t *arq, int64_t now, size_t *slot);
+
+void arq_heard(struct arq_receiver_t *rx, uint32_t seq);
+size_t arq_ack_encode(const struct arq_receiver_t *rx, uint8_t *out);
+
+#endif // _ARQ_H_
@@ -0,0 +1,80 @@
+/**
+ * @file compress.h
+ * @brief Optional compression of radio frames before transmission.
+ *
+ * Every compressed frame starts with a one byte header. The upper four bits of the header select the codec the rest of
+ * the frame is encoded with, and the lower four bits are a sequence number that increments with every frame. Frames
+ * that do not get any smaller are sent raw behind the header.
+ *
+ * The LZ codec is an LZSS variant: groups of eight items, each group preceded by a flag byte whose bits, from least
+ * significant, mark an item as a literal byte (0) or a two byte match (1). A match is the distance back into the output
+ * less one, followed by the match length less three.
+ *
+ * The delta codec XORs a frame with the frame before it, so bytes that have not changed become zero, and sends only the
+ * bytes that did change: the frame length, then a bitmap with a bit set for every changed byte, then the changed
+ * bytes. It can only be decoded if the previous frame was received, which the receiver checks with the sequence
+ * number. Every `COMP_KEYFRAME_INTERVAL` frames a frame is sent without delta coding so that a receiver can
+ * recover from a lost frame.
+ */
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include "radio.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of bytes the header adds to every frame. */
+#define COMP_HEADER_LEN 1
+
+/** The longest frame that can be compressed, or produced by decompression. */
+#define COMP_MAX_FRAME RADIO_MAX_PAYLOAD
+
+/** The longest a compressed frame can be, which is a raw frame behind its header. */
+#define COMP_MAX_ENCODED (COMP_MAX_FRAME + COMP_HEADER_LEN)
+
+/** The most frames sent in a row with the delta codec. */
+#define COMP_KEYFRAME_INTERVAL 8
+
+/** The codecs a frame can be encoded with. */
+typedef enum {
+    COMP_RAW = 0,   /**< The frame is sent as is. */
+    COMP_LZ = 1,    /**< The frame is LZ encoded. */
+    COMP_DELTA = 2, /**< The bytes that changed since the previous frame are sent. */
+} Codec;
+
+/** The state of the sending side of a compressed link. */
+struct comp_encoder_t {
+    /** Whether the delta codec may be used. */
+    bool delta;
+    /** The sequence number of the next frame. */
+    uint8_t seq;
+    /** The number of frames sent with the delta codec since the last frame that was not. */
+    unsigned int since_key;
+    /** The previous frame, before compression. */
+    uint8_t ref[COMP_MAX_FRAME];
+    /** The length of the previous frame, or 0 if there is none. */
+    size_t ref_len;
+    /** The total number of bytes compressed. */
+    uint64_t bytes_in;
+    /** The total number of bytes produced, headers included. */
+    uint64_t bytes_out;
+};
+
+/** The state of the receiving side of a compressed link. */
+struct comp_decoder_t {
+    /** The previous frame that was decoded. */
+    uint8_t ref[COMP_MAX_FRAME];
+    /** The length of the previous frame. */
+    size_t ref_len;
+    /** The sequence number of the previous frame, or -1 if none has been decoded. */
+    int seq;
+};
+
+int comp_validate_mode(const char *mode, bool *delta);
+void comp_encoder_init(struct comp_encoder_t *enc, bool delta);
+int comp_encode(struct comp_encoder_t *enc, const uint8_t *frame, size_t len, uint8_t *out, size_t *out_len);
+void comp_decoder_init(struct comp_decoder_t *dec);
+int comp_decode(struct comp_decoder_t *dec, const uint8_t *in, size_t len, uint8_t *frame, size_t *frame_len);
+
+#endif // _COMPRESS_H_
@@ -0,0 +1,120 @@
+/**
+ * @file dispatch.h
+ * @brief Spreading outgoing packets across several radios, each driven by its own I/O thread.
+ *
+ * Each radio link has a small outbox of packets ready to send. The dispatcher places every packet with the link
+ * predicted to finish sending it first, from the time on air and UART wire time of the packets already assigned to each
+ * link under its own radio parameters, so a faster or idle radio takes more of the traffic. High priority packets can
+ * instead be mirrored to every link for redundancy.
+ *
+ * A link whose radio stops working is marked down: it is given no more packets, and the packets waiting in its outbox
+ * are moved to the links that are still up. The link's thread is expected to recover the radio and mark it up again,
+ * so one wedged module never holds up the others. The packet it was sending is handed back to be sent once a link is
+ * up, and the time each link spends down is measured. A packet whose transmission failed after every retry, as a
+ * working radio reports with `radio_err`, is given up on and the link stays up.
+ */
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+#include "pacer.h"
+#include "radio.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The most radios that can be driven at once. */
+#define DISPATCH_MAX_LINKS 4
+
+/**
+ * The number of packets each link can have waiting to be sent. Kept small so that packets are chosen from the priority
+ * queue as late as possible, and a high priority packet never waits behind many low priority ones already dispatched.
+ */
+#define DISPATCH_OUTBOX 2
+
+/** The number of packets an outbox holds: one more than are placed in it, so a packet handed back always fits. */
+#define DISPATCH_SLOTS (DISPATCH_OUTBOX + 1)
+
+/** A packet that is ready to be sent. */
+struct outgoing_t {
+    /** The priority of the packet. */
+    unsigned int priority;
+    /** The number of bytes in `data`. */
+    size_t len;
+    /** When the oldest message in the packet was queued, in nanoseconds on the monotonic clock. */
+    int64_t queued_ns;
+    /** When the packet's first message was taken off the queue, in nanoseconds on the monotonic clock. */
+    int64_t dequeued_ns;
+    /** The number of the recorded entry of the packet's first message. */
+    uint64_t record_first;
+    /** The number of recorded messages in the packet, which is 0 for parity packets or when not recording. */
+    size_t records;
+    /** The packet contents. */
+    uint8_t data[RADIO_MAX_PAYLOAD];
+};
+
+/** One radio and the packets waiting to be sent with it. */
+struct radio_link_t {
+    /** The position of the link in the dispatcher. */
+    unsigned int index;
+    /** The device name of the radio's tty. */
+    const char *device;
+    /** The parameters the radio is configured with, from which the cost of its packets is predicted. */
+    struct lora_params_t params;
+    /** The connection to the radio. */
+    struct radio_t radio;
+    /** Spaces out the radio's transmissions to respect the duty cycle. */
+    struct pacer_t pacer;
+    /** The I/O thread driving the radio. */
+    pthread_t thread;
+    /** Whether the link is given packets. */
+    bool up;
+    /** Packets waiting to be sent, as a ring buffer. */
+    struct outgoing_t outbox[DISPATCH_SLOTS];
+    /** The index of the oldest packet in `outbox`. */
+    size_t head;
+    /** The number of packets in `outbox`. */
+    size_t count;
+    /** When the radio is predicted to have sent every packet assigned to it, in nanoseconds on the monotonic clock. */
+    int64_t free_at_ns;
+    /** The number of times the link has gone down. */
+    unsigned long downs;
+    /** When the link last went down, in nanoseconds on the monotonic clock. */
+    int64_t down_since_ns;
+    /** The total time the link has spent down before coming back up, in nanoseconds. */
+    int64_t down_ns;
+    /** The longest time the link has spent down before coming back up, in nanoseconds. */
+    int64_t max_down_ns;
+    /** The sequence number the link header of the next packet sent on the link carries. Only used by its thread. */
+    uint32_t seq;
+    /** The number of link header bytes in the packets the link has sent. Only written by its thread. */
+    uint64_t header_bytes;
+};
+
+/** The set of radio links packets are spread across. */
+struct dispatcher_t {
+    /** Protects every member, and the outboxes and state of every link. */
+    pthread_mutex_t lock;
+    /** Signalled when a packet is added to an outbox, room is made in one, a link changes state, or on close. */
+    pthread_cond_t changed;
+    /** The radio links. */
+    struct radio_link_t links[DISPATCH_MAX_LINKS];
+    /** The number of radio links. */
+    size_t nlinks;
+    /** Whether packets at or above `top_priority` are sent on every link. */
+    bool mirror;
+    /** The lowest priority that is mirrored. */
+    unsigned int top_priority;
+    /** Whether no more packets will be submitted. */
+    bool closed;
+};
+
+int dispatch_init(struct dispatcher_t *d, bool mirror, unsigned int top_priority);
+int dispatch_submit(struct dispatcher_t *d, const struct outgoing_t *packet);
+int dispatch_take(struct dispatcher_t *d, struct radio_link_t *link, struct outgoing_t *packet, bool wait);
+void dispatch_done(struct dispatcher_t *d, struct radio_link_t *link);
+void dispatch_fail(struct dispatcher_t *d, struct radio_link_t *link, const struct outgoing_t *packet);
+int64_t dispatch_up(struct dispatcher_t *d, struct radio_link_t *link);
+void dispatch_close(struct dispatcher_t *d);
+
+#endif // _DISPATCH_H_
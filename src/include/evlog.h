@@ -0,0 +1,131 @@
+/**
+ * @file evlog.h
+ * @brief An asynchronous log of events for the threads packets pass through, which never blocks or formats text on the
+ * thread the event happened on.
+ *
+ * An event is a fixed-size binary record: a code, an error number, a subject such as a device or queue name, a few
+ * numbers and a timestamp. Posting one stamps it, claims a slot in a lock-free ring that any number of threads post to
+ * and copies the record in. If the ring is full the event is dropped and counted, so a flood of errors never slows the
+ * thread that posts them. A background thread takes events off the ring, turns them into text with a formatter given
+ * by the owner of the codes, and writes them with `log_print`, at most `EVLOG_POLL_MS` after they were posted. Once the
+ * log is stopped, events are written straight away instead.
+ *
+ * The background thread also limits the rate of repeated events. An event with the same code, error and subject as one
+ * written less than `EVLOG_REPEAT_MS` before is only counted, and once that time has passed the count is written as a
+ * single summary with the last repeat's text. A steady stream of the same error therefore costs one line per period.
+ */
+#ifndef _EVLOG_H_
+#define _EVLOG_H_
+
+#include "../../logging-utils/logging.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The number of events the ring holds, a power of two. */
+#define EVLOG_CAPACITY 256
+
+/** The number of numbers an event carries. */
+#define EVLOG_ARGS 4
+
+/** How often the background thread looks for events when the ring is not filling up, in milliseconds. */
+#define EVLOG_POLL_MS 100
+
+/** How long repeats of an event are counted rather than written, in milliseconds. */
+#define EVLOG_REPEAT_MS 1000
+
+/** The number of different events whose repeats are counted at once. */
+#define EVLOG_TRACKED 16
+
+/** The longest line an event is formatted to, including its terminating null. */
+#define EVLOG_LINE_MAX 256
+
+/** Keeps the positions written by producers and the consumer from sharing a cache line. */
+#define EVLOG_CACHE_LINE 64
+
+/** One event. */
+struct evlog_event_t {
+    /** When the event was posted, in nanoseconds on the monotonic clock. */
+    int64_t time_ns;
+    /** What happened, as defined by the owner of the formatter. */
+    unsigned int code;
+    /** The error number that goes with it, or 0. */
+    int err;
+    /** What it happened to, such as a device name, or NULL. Must stay valid for as long as the log runs. */
+    const char *subject;
+    /** Numbers that go with it, whose meaning depends on the code. */
+    uint64_t args[EVLOG_ARGS];
+};
+
+/**
+ * Turns an event into text.
+ * @param event The event.
+ * @param text Where to write the text.
+ * @param size The size of `text` in bytes.
+ * @return The level to log the event at.
+ */
+typedef log_level_e (*evlog_format_f)(const struct evlog_event_t *event, char *text, size_t size);
+
+/** A slot in the ring. */
+struct evlog_slot_t {
+    /** The position the slot can next be claimed at by a producer, or one more than it once the event is written. */
+    atomic_uint_fast64_t seq;
+    /** The event. */
+    struct evlog_event_t event;
+};
+
+/** An event being counted rather than written. */
+struct evlog_repeat_t {
+    /** The event last written or counted. */
+    struct evlog_event_t last;
+    /** When an event like it was last written, in nanoseconds on the monotonic clock. */
+    int64_t written_ns;
+    /** The number of events like it counted since then. */
+    uint64_t count;
+    /** Whether the entry is in use. */
+    bool used;
+};
+
+/** An event log. */
+struct evlog_t {
+    /** Where events are written. */
+    FILE *stream;
+    /** Turns events into text. */
+    evlog_format_f format;
+    /** The background thread. */
+    pthread_t thread;
+    /** Whether the background thread was started. */
+    bool started;
+    /** Set once no more events will be written. */
+    atomic_bool closed;
+    /** Posted to wake the background thread. */
+    sem_t wake;
+    /** The number of events ever posted, dropped ones included. */
+    atomic_uint_fast64_t posted;
+    /** The number of events dropped because the ring was full. */
+    atomic_uint_fast64_t dropped;
+    /** The number of events counted as repeats rather than written. */
+    atomic_uint_fast64_t suppressed;
+    /** The number of slots producers have claimed. */
+    _Alignas(EVLOG_CACHE_LINE) atomic_uint_fast64_t head;
+    /** The number of slots the background thread has taken. Only it changes this. */
+    _Alignas(EVLOG_CACHE_LINE) uint64_t tail;
+    /** Set by the background thread while it waits, or is about to wait, on `wake`. */
+    atomic_bool sleeping;
+    /** The number of dropped events already reported. */
+    uint64_t dropped_reported;
+    /** The events being counted rather than written. */
+    struct evlog_repeat_t repeats[EVLOG_TRACKED];
+    /** The ring. */
+    _Alignas(EVLOG_CACHE_LINE) struct evlog_slot_t slots[EVLOG_CAPACITY];
+};
+
+int evlog_start(struct evlog_t *log, FILE *stream, evlog_format_f format);
+void evlog_post(struct evlog_t *log, const struct evlog_event_t *event);
+void evlog_stop(struct evlog_t *log);
+
+#endif // _EVLOG_H_
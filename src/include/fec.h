@@ -0,0 +1,88 @@
+/**
+ * @file fec.h
+ * @brief Forward error correction across packets, so that the ground station can rebuild packets lost over the air.
+ *
+ * Outgoing packets are grouped, and after the data packets of a group are sent, parity packets computed from them with
+ * a systematic Reed-Solomon erasure code over GF(256) are sent too. Any `k` of the data and parity packets of a group
+ * of `k` data packets are enough to rebuild every data packet in it.
+ *
+ * Every packet starts with a header of three bytes: the group number, the index of the packet within its group with
+ * the top bit set for parity packets, and the number of data and parity packets in the group in the upper and lower
+ * nibbles. Data packets are sent before the group is complete, so their header holds the configured group size, while
+ * parity packets hold the actual size of the group they protect.
+ *
+ * Parity packets protect each data packet prefixed with its length and padded with zeroes to the longest in the group,
+ * so they are one byte longer than the longest data packet.
+ */
+#ifndef _FEC_H_
+#define _FEC_H_
+
+#include "radio.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of bytes the header adds to every packet. */
+#define FEC_HEADER_LEN 3
+
+/** The most data packets in a group. */
+#define FEC_MAX_K 15
+
+/** The most parity packets in a group. */
+#define FEC_MAX_M 15
+
+/** The longest data packet that can be protected, leaving room for the header and length prefix of parity packets. */
+#define FEC_MAX_DATA (RADIO_MAX_PAYLOAD - FEC_HEADER_LEN - 1)
+
+/** The length of a coded symbol: a data packet prefixed with its length. */
+#define FEC_SYMBOL_MAX (FEC_MAX_DATA + 1)
+
+/** The state of the sending side of a protected link. */
+struct fec_encoder_t {
+    /** The number of data packets in a full group. */
+    unsigned int k;
+    /** The number of parity packets sent for a group. */
+    unsigned int m;
+    /** The number of parity packets sent for a group holding a high priority packet. */
+    unsigned int m_top;
+    /** The number of the current group. */
+    uint8_t group;
+    /** The number of data packets added to the current group. */
+    unsigned int count;
+    /** Whether the current group holds a high priority packet. */
+    bool top;
+    /** The length of the longest symbol in the current group. */
+    size_t symbol_len;
+    /** The parity symbols of the current group, accumulated as data packets are added. */
+    uint8_t parity[FEC_MAX_M][FEC_SYMBOL_MAX];
+};
+
+/** The state of the receiving side of a protected link. */
+struct fec_decoder_t {
+    /** The number of the group being received, or -1 before the first packet. */
+    int group;
+    /** The number of data packets in the group, or 0 until a parity packet has been received. */
+    unsigned int k;
+    /** The length of the group's symbols, known once a parity packet has been received. */
+    size_t symbol_len;
+    /** Whether each packet of the group has been received. */
+    bool have[FEC_MAX_K + FEC_MAX_M];
+    /** Whether each data packet of the group has been returned by `fec_next`. */
+    bool delivered[FEC_MAX_K];
+    /** The symbols of the group's packets, each padded with zeroes. */
+    uint8_t symbols[FEC_MAX_K + FEC_MAX_M][FEC_SYMBOL_MAX];
+    /** The number of data packets that were rebuilt from parity. */
+    unsigned long recovered;
+};
+
+int fec_validate(const char *spec, unsigned int *k, unsigned int *m, unsigned int *m_top);
+void fec_encoder_init(struct fec_encoder_t *enc, unsigned int k, unsigned int m, unsigned int m_top);
+int fec_add(struct fec_encoder_t *enc, const uint8_t *data, size_t len, bool top, uint8_t *out, size_t *out_len);
+bool fec_full(const struct fec_encoder_t *enc);
+int fec_parity(const struct fec_encoder_t *enc, unsigned int j, uint8_t *out, size_t *out_len);
+void fec_next_group(struct fec_encoder_t *enc);
+void fec_decoder_init(struct fec_decoder_t *dec);
+int fec_decode(struct fec_decoder_t *dec, const uint8_t *packet, size_t len);
+int fec_next(struct fec_decoder_t *dec, const uint8_t **data, size_t *len);
+
+#endif // _FEC_H_
@@ -0,0 +1,81 @@
+/**
+ * @file fragment.h
+ * @brief Splitting messages longer than a radio frame into fragments, and the reference reassembler for them.
+ *
+ * Every queued message starts with a fragment header. A message that fits in one frame is sent whole behind a single
+ * zero byte. A longer message is split into up to 16 fragments, each behind a two byte header: the top bit set with a
+ * seven bit message id, then the index of the fragment and the number of fragments less one in the upper and lower
+ * nibbles. Every fragment but the last carries the same number of bytes.
+ *
+ * Fragments are queued as separate messages at the priority of the message they came from, so they are interleaved
+ * with other traffic and spread across radios like any other message. The reassembler therefore accepts them in any
+ * order, and gives up on a message whose fragments have not all arrived within a timeout.
+ */
+#ifndef _FRAGMENT_H_
+#define _FRAGMENT_H_
+
+#include "radio.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of bytes the header adds to a message sent whole. */
+#define FRAG_WHOLE_HEADER_LEN 1
+
+/** The number of bytes the header adds to each fragment. */
+#define FRAG_HEADER_LEN 2
+
+/** The most fragments a message can be split into. */
+#define FRAG_MAX_PIECES 16
+
+/** The longest part of a message a fragment can carry. */
+#define FRAG_PIECE_MAX (RADIO_MAX_PAYLOAD - FRAG_HEADER_LEN)
+
+/** The longest message that can be fragmented, when each fragment has a whole radio frame to itself. */
+#define FRAG_MAX_MESSAGE (FRAG_MAX_PIECES * FRAG_PIECE_MAX)
+
+/** The number of messages the reassembler can hold partly received at once. */
+#define FRAG_SLOTS 8
+
+/** A message the reassembler has received some fragments of. */
+struct frag_partial_t {
+    /** Whether the slot holds a message. */
+    bool used;
+    /** The id of the message. */
+    uint8_t id;
+    /** The number of fragments the message was split into. */
+    unsigned int count;
+    /** A bit for each fragment that has been received. */
+    uint16_t have;
+    /** When the first fragment was received, in milliseconds. */
+    int64_t started_ms;
+    /** The length of each fragment received. */
+    size_t len[FRAG_MAX_PIECES];
+    /** The contents of each fragment received. */
+    uint8_t data[FRAG_MAX_PIECES][FRAG_PIECE_MAX];
+};
+
+/** The state of the receiving side of a fragmenting link. */
+struct frag_decoder_t {
+    /** How long a message may take to arrive in full before it is given up on, in milliseconds. */
+    int64_t timeout_ms;
+    /** The messages partly received. */
+    struct frag_partial_t slots[FRAG_SLOTS];
+    /** The number of fragmented messages rebuilt. */
+    unsigned long completed;
+    /** The number of fragments received more than once. */
+    unsigned long duplicates;
+    /** The number of messages given up on because their fragments did not all arrive in time. */
+    unsigned long expired;
+    /** The number of messages given up on to make room for newer ones. */
+    unsigned long evicted;
+};
+
+unsigned int frag_count(size_t len, size_t capacity);
+int frag_piece(const uint8_t *msg, size_t len, size_t capacity, uint8_t id, unsigned int index, uint8_t *out,
+               size_t *out_len);
+void frag_decoder_init(struct frag_decoder_t *dec, int64_t timeout_ms);
+int frag_decode(struct frag_decoder_t *dec, const uint8_t *piece, size_t len, int64_t now_ms, uint8_t *out,
+                size_t *out_len);
+
+#endif // _FRAGMENT_H_
@@ -0,0 +1,88 @@
+/**
+ * @file linkhdr.h
+ * @brief A compact header numbering and timestamping every radio frame, and the reference receiver-side analyzer that
+ * measures loss and latency from it.
+ *
+ * Each radio numbers its frames from zero. The header is the frame's sequence number shifted left by two with the
+ * frame's priority (capped at 3) in the low two bits, as a little-endian base 128 varint, then the low 16 bits of the
+ * time the frame was first handed to the radio in milliseconds, then how long the oldest message in the frame had been
+ * queued by then in milliseconds, as another varint. It is 4 bytes for the first 32 frames, 5 bytes up to frame 4095,
+ * and a byte more while messages wait longer than 127 ms.
+ *
+ * A receiver that has lost frames sees gaps in the sequence numbers, and the length of each gap is the length of a
+ * burst of loss. The queue wait gives the latency from queue to air exactly, with no clock shared between the ends.
+ * Given receive times on the sender's clock, the send time also gives the latency from queue to reception, as long as
+ * frames arrive within 65 seconds of being sent.
+ */
+#ifndef _LINKHDR_H_
+#define _LINKHDR_H_
+
+#include "stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The most bytes the header can take. */
+#define LHDR_MAX_LEN 10
+
+/** The longest queue wait the header can carry, in milliseconds. Longer waits are carried as this. */
+#define LHDR_MAX_WAIT_MS ((1 << 21) - 1)
+
+/** The highest priority the header distinguishes. Higher priorities are carried as this. */
+#define LHDR_MAX_PRIORITY 3
+
+/** The longest burst of loss counted on its own. Longer bursts are counted with it. */
+#define LHDR_MAX_BURST 16
+
+/** A sequence number this far behind the last one means the sender restarted, rather than a late frame. */
+#define LHDR_RESTART_GAP 1024
+
+/** The contents of a link header. */
+struct lhdr_t {
+    /** The number of the frame on its radio. */
+    uint32_t seq;
+    /** The priority of the frame. */
+    unsigned int priority;
+    /** The low 16 bits of when the frame was handed to the radio, in milliseconds on the sender's monotonic clock. */
+    uint16_t sent_ms;
+    /** How long the oldest message in the frame had been queued when the frame was handed to the radio, in ms. */
+    uint32_t wait_ms;
+};
+
+/** What a receiver has measured from the link headers of one radio's frames. */
+struct lhdr_stats_t {
+    /** Whether a frame has been seen. */
+    bool started;
+    /** The sequence number the next frame should have. */
+    uint32_t next_seq;
+    /** The number of frames received. */
+    uint64_t received;
+    /** The number of frames missing from the sequence. */
+    uint64_t lost;
+    /** The number of frames received again, or too late to fill their gap. */
+    uint64_t duplicates;
+    /** The number of times the sender was seen to start numbering again. */
+    uint64_t restarts;
+    /** The number of runs of consecutive frames lost, by length. The last also counts every longer run. */
+    uint64_t bursts[LHDR_MAX_BURST + 1];
+    /** The longest run of consecutive frames lost. */
+    uint64_t max_burst;
+    /** The number of frames received at each priority. */
+    uint64_t priorities[LHDR_MAX_PRIORITY + 1];
+    /** The number of header bytes received. */
+    uint64_t header_bytes;
+    /** The number of bytes received in all, headers included. */
+    uint64_t frame_bytes;
+    /** The latency from the oldest message in a frame being queued to the frame being handed to the radio. */
+    struct stats_hist_t wait;
+    /** The latency from the oldest message in a frame being queued to the frame being received. */
+    struct stats_hist_t age;
+};
+
+size_t lhdr_encode(const struct lhdr_t *header, uint8_t *out);
+int lhdr_decode(const uint8_t *data, size_t len, struct lhdr_t *header, size_t *header_len);
+void lhdr_observe(struct lhdr_stats_t *stats, const struct lhdr_t *header, size_t header_len, size_t frame_len,
+                  int64_t received_ms);
+double lhdr_loss(const struct lhdr_stats_t *stats);
+
+#endif // _LINKHDR_H_
@@ -0,0 +1,27 @@
+/**
+ * @file pacer.h
+ * @brief Scheduling of transmissions to stay within a duty cycle limit.
+ *
+ * The 433MHz and 868MHz bands limit the fraction of time a device may spend transmitting. The pacer spaces out
+ * transmissions using the predicted time on air of each packet, so that the limit is respected up front instead of
+ * being discovered through errors.
+ */
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/** Paces transmissions to a duty cycle. */
+struct pacer_t {
+    /** The permitted fraction of time on air in parts per million, or 0 if pacing is disabled. */
+    uint32_t duty_ppm;
+    /** The earliest monotonic time at which the next transmission may start. */
+    struct timespec next;
+};
+
+int pacer_init(struct pacer_t *pacer, const char *duty);
+void pacer_wait(const struct pacer_t *pacer);
+void pacer_record(struct pacer_t *pacer, uint32_t time_on_air_us);
+
+#endif // _PACER_H_
@@ -0,0 +1,131 @@
+/**
+ * @file pqueue.h
+ * @brief A bounded, thread-safe priority buffer of packets waiting to be transmitted.
+ *
+ * The buffer decouples reading input from transmitting over the radio. Packets are stored in fixed slots inside the
+ * buffer struct so that no memory is allocated at runtime. When the buffer is full, the oldest packet of the lowest
+ * queued priority is dropped to make room, but packets at or above the configured top priority are never dropped.
+ *
+ * Packets can come from several sources, each with a weight. Within a priority level, sources share transmission in
+ * proportion to their weights by weighted fair queuing: every packet is tagged with the virtual time at which its
+ * source would finish sending it if each source had its share of the link, and the earliest tag leaves first. When a
+ * level must drop a packet, it is taken from the source with the most queued bytes for its weight, so a chatty source
+ * neither delays nor displaces the others.
+ *
+ * A packet can also carry a key naming the stream of periodic state it samples. Only the newest packet of each key and
+ * source is kept: a packet whose key is already queued replaces the older one in place, so the stream's backlog never
+ * grows beyond one packet and the fresh sample leaves when the stale one would have.
+ */
+#ifndef _PQUEUE_H_
+#define _PQUEUE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/** The number of packets the buffer can hold. */
+#define PQ_CAPACITY 64
+
+/** The number of distinct priority levels. Higher priorities are treated as the highest level. */
+#define PQ_PRIORITIES 32
+
+/** The maximum length of a packet in bytes. */
+#define PQ_PACKET_MAX 512
+
+/** The number of input sources that are scheduled fairly against each other. */
+#define PQ_SOURCES 8
+
+/** The largest weight a source can be given. */
+#define PQ_MAX_WEIGHT 1000
+
+/** The key of a packet that belongs to no stream and is never replaced. */
+#define PQ_NO_KEY -1
+
+/** A packet waiting for transmission. */
+struct packet_t {
+    /** The priority the packet was received with. */
+    unsigned int priority;
+    /** The input source the packet came from. */
+    unsigned int source;
+    /** The number of bytes in `data`. */
+    size_t len;
+    /** When the packet was queued, on the monotonic clock. */
+    struct timespec queued;
+    /** The packet contents. */
+    uint8_t data[PQ_PACKET_MAX];
+};
+
+/** A snapshot of the buffer's counters. */
+struct pq_stats_t {
+    /** The number of packets currently queued at each priority. */
+    size_t depth[PQ_PRIORITIES];
+    /** The number of packets accepted at each priority. */
+    uint64_t enqueued[PQ_PRIORITIES];
+    /** The number of packets dropped at each priority due to overload. */
+    uint64_t dropped[PQ_PRIORITIES];
+    /** The number of packets at each priority replaced by a newer packet of the same key. */
+    uint64_t superseded[PQ_PRIORITIES];
+    /** The largest number of packets that have been queued at once. */
+    size_t high_water;
+    /** The number of packets accepted from each source. */
+    uint64_t source_enqueued[PQ_SOURCES];
+    /** The number of packets from each source dropped due to overload. */
+    uint64_t source_dropped[PQ_SOURCES];
+    /** The number of packets from each source replaced by a newer packet of the same key. */
+    uint64_t source_superseded[PQ_SOURCES];
+    /** The number of bytes from each source removed for transmission. */
+    uint64_t source_bytes[PQ_SOURCES];
+};
+
+/** The priority buffer. */
+struct pqueue_t {
+    /** Protects every other member. */
+    pthread_mutex_t lock;
+    /** Signalled when a packet is added or the buffer is closed. */
+    pthread_cond_t not_empty;
+    /** Signalled when a packet is removed or the buffer is closed. */
+    pthread_cond_t not_full;
+    /** Packet storage. */
+    struct packet_t slots[PQ_CAPACITY];
+    /** The index of the next slot in the same list, or -1. */
+    int next[PQ_CAPACITY];
+    /** The virtual finish time of the packet in each slot. */
+    uint64_t tag[PQ_CAPACITY];
+    /** The key of the packet in each slot, or `PQ_NO_KEY`. */
+    int key[PQ_CAPACITY];
+    /** The oldest queued slot at each priority, or -1. */
+    int head[PQ_PRIORITIES];
+    /** The newest queued slot at each priority, or -1. */
+    int tail[PQ_PRIORITIES];
+    /** The first unused slot, or -1. */
+    int free;
+    /** The total number of queued packets. */
+    size_t count;
+    /** Priorities at or above this value are never dropped. */
+    unsigned int top_priority;
+    /** The share of transmission each source is entitled to, relative to the others. */
+    unsigned int weight[PQ_SOURCES];
+    /** The virtual finish time of the last packet queued from each source. */
+    uint64_t finish[PQ_SOURCES];
+    /** The virtual time, which is the tag of the last packet removed. */
+    uint64_t virtual_time;
+    /** Whether the producer has finished. */
+    bool closed;
+    /** Counters. */
+    struct pq_stats_t stats;
+};
+
+int pq_init(struct pqueue_t *q, unsigned int top_priority);
+int pq_set_weight(struct pqueue_t *q, unsigned int source, unsigned int weight);
+int pq_push(struct pqueue_t *q, const uint8_t *data, size_t len, unsigned int priority, unsigned int source);
+int pq_push_keyed(struct pqueue_t *q, const uint8_t *data, size_t len, unsigned int priority, unsigned int source,
+                  int key);
+int pq_pop(struct pqueue_t *q, struct packet_t *packet);
+int pq_pop_timed(struct pqueue_t *q, struct packet_t *packet, size_t max_len, const struct timespec *deadline);
+void pq_close(struct pqueue_t *q);
+void pq_stats(struct pqueue_t *q, struct pq_stats_t *stats);
+size_t pq_backlog(struct pqueue_t *q, struct timespec *oldest);
+
+#endif // _PQUEUE_H_
@@ -10,9 +10,40 @@
 #define _RADIO_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <termios.h>
 
+/** The largest payload in bytes that the RN2483 can transmit in one packet. */
+#define RADIO_MAX_PAYLOAD 255
+
+/** The size of the buffer holding bytes received from the radio that have not yet been read as lines. */
+#define RADIO_RX_BUFFER 1024
+
+/** The length of the longest `radio tx` command: the prefix, two hex digits per payload byte and the terminator. */
+#define RADIO_TX_COMMAND_MAX (9 + 2 * RADIO_MAX_PAYLOAD + 2)
+
+/** The longest command or response line handled, excluding `radio tx` commands. */
+#define RADIO_LINE_MAX 64
+
+/** The UART baud rate the RN2483 starts up with. */
+#define RADIO_DEFAULT_BAUD 57600
+
+/** The number of commands that are sent ahead of their responses when configuring the radio. */
+#define RADIO_PIPELINE_DEPTH 4
+
+/** The number of settings broadcaster configures on the radio. */
+#define RADIO_SETTINGS 11
+
+/** How long the radio is given to respond to a command, in microseconds. */
+#define RADIO_RESPONSE_TIMEOUT_US 250000
+
+/** How long past the predicted end of a transmission the radio is given to report its result, in microseconds. */
+#define RADIO_TX_MARGIN_US 100000
+
+/** How long the radio is given to come back up after `sys reset`, in microseconds. */
+#define RADIO_RESET_TIMEOUT_US 500000
+
 /** Represents the possible choices for modulation. */
 typedef enum {
     LORA, /**< Lora modulation. */
@@ -51,6 +82,63 @@ struct lora_params_t {
     uint64_t sync_word;
 };
 
+/** The RN2483 name and value of one radio setting, as used by `radio set` and `radio get`. */
+struct radio_setting_t {
+    /** The name of the setting. */
+    const char *name;
+    /** The value of the setting. */
+    char value[24];
+};
+
+/** The stages of the radio's response to commands. */
+typedef enum {
+    RADIO_IDLE,   /**< The radio can accept a command. */
+    RADIO_ON_AIR, /**< A transmission was accepted and its result has not been received. */
+} RadioState;
+
+/** Monotonic timestamps in nanoseconds of the stages of the last transmission attempt, from `radio_now_ns`. */
+struct radio_timing_t {
+    /** When assembly of the `radio tx` command started. */
+    int64_t started;
+    /** When the command was assembled. */
+    int64_t assembled;
+    /** When the UART finished sending the command. */
+    int64_t written;
+    /** When the radio answered "ok". */
+    int64_t accepted;
+    /** When the radio reported the result of the transmission. */
+    int64_t done;
+};
+
+/** The state of the UART connection to an RN2483 LoRa radio module. */
+struct radio_t {
+    /** The file descriptor of the radio's tty. */
+    int fd;
+    /** The UART baud rate the link is running at. */
+    unsigned int baud;
+    /** The parameters the radio is configured with, used to predict time on air. */
+    const struct lora_params_t *params;
+    /** Where the radio is in responding to the last command. */
+    RadioState state;
+    /**
+     * Whether the radio answered "ok" to the last transmission attempt, in which case an EIO from it is a `radio_err`
+     * reported by a working radio rather than a fault in the radio or the link to it.
+     */
+    bool accepted;
+    /** The monotonic time in microseconds at which the current transmission is predicted to end. */
+    int64_t busy_until;
+    /** Ring buffer of received bytes that have not yet been read as lines. */
+    char rx[RADIO_RX_BUFFER];
+    /** The index of the oldest byte in `rx`. */
+    size_t rx_head;
+    /** The number of bytes in `rx`. */
+    size_t rx_len;
+    /** Preallocated buffer that `radio tx` commands are assembled in. */
+    char tx[RADIO_TX_COMMAND_MAX];
+    /** When each stage of the last transmission attempt ended. */
+    struct radio_timing_t timing;
+};
+
 /* PARAMETER VALIDATION. */
 int radio_validate_mod(const char *mod, struct lora_params_t *params);
 int radio_validate_freq(const char *freq, struct lora_params_t *params);
@@ -60,14 +148,30 @@ int radio_validate_cr(const char *coding_rate, struct lora_params_t *params);
 int radio_validate_prlen(const char *prlen, struct lora_params_t *params);
 int radio_validate_bw(const char *bandwidth, struct lora_params_t *params);
 int radio_validate_sync(const char *sync, struct lora_params_t *params);
+int radio_validate_baud(const char *baud, unsigned int *rate);
+
+/* RADIO PERFORMANCE. */
+const char *radio_coding_rate_str(CodingRate coding_rate);
+uint32_t radio_time_on_air(const struct lora_params_t *params, size_t payload_len);
+uint32_t radio_wire_time(unsigned int baud, size_t payload_len);
+uint16_t radio_rx_window(const struct lora_params_t *params, uint32_t window_us);
 
 /* RADIO SETUP. */
 void radio_setup_tty(struct termios *tty);
-int radio_set_params(int radio_fd, const struct lora_params_t *params);
+void radio_init(struct radio_t *radio, int radio_fd, const struct lora_params_t *params);
+int radio_set_baud(struct radio_t *radio, unsigned int baud);
+int radio_reset(struct radio_t *radio);
+int radio_set_params(struct radio_t *radio, const struct lora_params_t *params);
+int radio_sync_params(struct radio_t *radio, const struct lora_params_t *params, size_t *changed);
+int radio_switch_params(struct radio_t *radio, const struct lora_params_t *params, size_t *changed);
 
 /* RADIO COMMUNICATION */
-int wait_for_ok(int radio_fd);
-int radio_tx(int radio_fd, const char *data);
-int radio_tx_bytes(int radio_fd, const uint8_t *data, size_t nbytes);
+int64_t radio_now_ns(void);
+size_t radio_hex_encode(char *dst, const uint8_t *data, size_t nbytes);
+int radio_read_line(struct radio_t *radio, char *line, size_t len, int64_t deadline);
+int wait_for_ok(struct radio_t *radio);
+int radio_tx(struct radio_t *radio, const char *data);
+int radio_tx_bytes(struct radio_t *radio, const uint8_t *data, size_t nbytes);
+int radio_rx(struct radio_t *radio, uint32_t window_us, uint8_t *data, size_t size, size_t *len);
 
 #endif // _RADIO_H_
@@ -0,0 +1,42 @@
+/**
+ * @file reader.h
+ * @brief Reading length-prefixed binary frames from a file or pipe.
+ *
+ * Each frame is a one byte priority and a two byte big-endian payload length, followed by the payload. A regular file
+ * is mapped into memory and read in place, while a pipe or terminal is read through a large buffer, so frames cost no
+ * system calls beyond the occasional refill and payloads are never copied or converted before they are queued.
+ */
+#ifndef _READER_H_
+#define _READER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The size of the buffer pipes are read through. */
+#define READER_BUFFER 65536
+
+/** The number of bytes before each frame's payload. */
+#define READER_HEADER_LEN 3
+
+/** Reads frames from a file descriptor. */
+struct reader_t {
+    /** The file descriptor frames are read from. */
+    int fd;
+    /** The whole file if it could be mapped, otherwise NULL. */
+    void *map;
+    /** The bytes read so far, starting at `buf` or `map`. */
+    const uint8_t *window;
+    /** The offset of the next unread byte in `window`. */
+    size_t pos;
+    /** The number of bytes in `window`. */
+    size_t end;
+    /** The buffer pipes are read through. */
+    uint8_t buf[READER_BUFFER];
+};
+
+int reader_open(struct reader_t *reader, int fd);
+int reader_next(struct reader_t *reader, size_t max_len, const uint8_t **data, size_t *len, unsigned int *priority);
+void reader_close(struct reader_t *reader);
+
+#endif // _READER_H_
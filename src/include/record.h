@@ -0,0 +1,107 @@
+/**
+ * @file record.h
+ * @brief Recording the messages taken off the transmit queue to a memory-mapped file, and reading recordings back.
+ *
+ * A recording is a file holding a header followed by a ring of fixed-size entries, each a message with the time it was
+ * queued and dequeued, its priority, its input and whether the frame carrying it was sent. The file is mapped shared,
+ * so appending an entry is a copy into memory with no system call, and whatever was recorded survives broadcaster
+ * exiting or crashing. Once the ring is full, the oldest entries are overwritten.
+ *
+ * Recordings are replayed by feeding their messages back into the transmit queue with their original spacing, sped up
+ * or as fast as possible, which together with the emulator gives a realistic workload for comparing settings.
+ */
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include "pqueue.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The bytes every recording starts with. */
+#define RECORD_MAGIC "BCREC01"
+
+/** The number of entries a recording holds unless told otherwise. */
+#define RECORD_DEFAULT_ENTRIES 4096
+
+/** The most entries a recording can hold, so that a replay can order them without allocating. */
+#define RECORD_MAX_ENTRIES 65536
+
+/** What became of a recorded message. */
+typedef enum {
+    OUTCOME_PENDING, /**< The frame carrying the message has not been sent yet. */
+    OUTCOME_SENT,    /**< The frame carrying the message was sent on at least one radio. */
+    OUTCOME_FAILED,  /**< The frame carrying the message could not be sent. */
+} Outcome;
+
+/** The header at the start of a recording. */
+struct record_header_t {
+    /** `RECORD_MAGIC`, including its terminating null. */
+    char magic[8];
+    /** The size of each entry in bytes. */
+    uint32_t entry_size;
+    /** The number of entries the ring holds. */
+    uint32_t capacity;
+    /** The number of entries ever appended, the newest being `count - 1`. */
+    uint64_t count;
+};
+
+/** One recorded message. */
+struct record_entry_t {
+    /** The number of the entry, counting every entry ever appended. */
+    uint64_t seq;
+    /** When the message was queued, in nanoseconds on the monotonic clock. */
+    int64_t queued_ns;
+    /** When the message was taken off the queue, in nanoseconds on the monotonic clock. */
+    int64_t dequeued_ns;
+    /** The priority of the message. */
+    uint32_t priority;
+    /** The number of bytes in `data`. */
+    uint16_t len;
+    /** The input the message came from. */
+    uint8_t source;
+    /** What became of the message, an `Outcome`. */
+    uint8_t outcome;
+    /** The message contents. */
+    uint8_t data[PQ_PACKET_MAX];
+};
+
+/** Appends to a recording. */
+struct recorder_t {
+    /** Protects the entries, since outcomes are filled in by the radio threads. */
+    pthread_mutex_t lock;
+    /** The mapped header. */
+    struct record_header_t *header;
+    /** The mapped ring of entries. */
+    struct record_entry_t *entries;
+    /** The size of the mapping in bytes. */
+    size_t map_len;
+};
+
+/** A recording mapped for reading. */
+struct recording_t {
+    /** The whole mapped file. */
+    void *map;
+    /** The mapped header. */
+    const struct record_header_t *header;
+    /** The mapped ring of entries. */
+    const struct record_entry_t *entries;
+    /** The size of the mapping in bytes. */
+    size_t map_len;
+    /** The number of the oldest entry still in the ring. */
+    uint64_t first;
+    /** The number of entries still in the ring. */
+    uint64_t count;
+};
+
+int record_open(struct recorder_t *rec, const char *path, size_t capacity);
+uint64_t record_append(struct recorder_t *rec, const struct packet_t *packet, int64_t dequeued_ns);
+void record_outcome(struct recorder_t *rec, uint64_t first, size_t count, bool sent);
+void record_flush(struct recorder_t *rec);
+int record_load(struct recording_t *recording, const char *path);
+const struct record_entry_t *record_entry(const struct recording_t *recording, uint64_t index);
+void record_order(const struct recording_t *recording, uint32_t *order);
+void record_unload(struct recording_t *recording);
+
+#endif // _RECORD_H_
@@ -0,0 +1,99 @@
+/**
+ * @file ring.h
+ * @brief A single-producer, single-consumer ring of messages in POSIX shared memory, as an input to broadcaster that
+ * avoids a system call and a copy per message.
+ *
+ * The producer creates the ring, as it would create a message queue, and broadcaster maps it. Messages are written
+ * into the ring as records: a length and priority followed by the payload, padded to eight bytes. A record never wraps
+ * around the end of the ring; if it would, the rest of the ring is skipped with a padding record and the message starts
+ * again at the beginning, so every payload can be read in place as one contiguous block.
+ *
+ * The producer and consumer each own one position, counted in bytes ever written or read, which only they advance.
+ * The consumer only sleeps when the ring is empty, on a process-shared semaphore in the ring, and says so first, so the
+ * producer only makes the system call to wake it when it is actually asleep.
+ */
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The bytes every ring starts with. */
+#define RING_MAGIC "BCRING1"
+
+/** The smallest ring, in bytes of records. */
+#define RING_MIN_SIZE 4096
+
+/** The largest ring, in bytes of records. */
+#define RING_MAX_SIZE (16 * 1024 * 1024)
+
+/** The size of the ring a producer creates unless it has a reason to choose otherwise. */
+#define RING_DEFAULT_SIZE (256 * 1024)
+
+/** The length of a record that skips to the start of the ring. */
+#define RING_PAD UINT32_MAX
+
+/** Keeps members written by different processes from sharing a cache line. */
+#define RING_CACHE_LINE 64
+
+/** The header of one record. */
+struct ring_record_t {
+    /** The length of the payload in bytes, or `RING_PAD`. */
+    uint32_t len;
+    /** The priority of the message. */
+    uint32_t priority;
+};
+
+/** The part of the ring in shared memory. */
+struct ring_shared_t {
+    /** `RING_MAGIC`, including its terminating null. */
+    char magic[8];
+    /** The size of `data` in bytes, a power of two. */
+    uint32_t size;
+    /** Set by the producer once it will write no more messages. */
+    atomic_bool closed;
+    /** Posted by the producer to wake the consumer. */
+    sem_t wake;
+    /** The number of bytes the producer has written. */
+    _Alignas(RING_CACHE_LINE) atomic_uint_fast64_t head;
+    /** The number of bytes the consumer has read. */
+    _Alignas(RING_CACHE_LINE) atomic_uint_fast64_t tail;
+    /** Set by the consumer while it waits, or is about to wait, on `wake`. */
+    atomic_bool sleeping;
+    /** The records. */
+    _Alignas(RING_CACHE_LINE) uint8_t data[];
+};
+
+/** One side's mapping of a ring. */
+struct ring_t {
+    /** The mapped ring. */
+    struct ring_shared_t *shared;
+    /** The size of the mapping in bytes. */
+    size_t map_len;
+    /** The producer's or consumer's own copy of its position, which only it changes. */
+    uint64_t pos;
+    /** The producer's last sight of the consumer's position, or the consumer's of the producer's. */
+    uint64_t other;
+    /** The size of the record the consumer is reading, or the producer has reserved. */
+    size_t pending;
+};
+
+/* PRODUCER. */
+int ring_create(struct ring_t *ring, const char *name, size_t size);
+int ring_reserve(struct ring_t *ring, size_t len, uint8_t **data);
+void ring_commit(struct ring_t *ring, size_t len, unsigned int priority);
+int ring_send(struct ring_t *ring, const void *data, size_t len, unsigned int priority);
+void ring_close(struct ring_t *ring);
+
+/* CONSUMER. */
+int ring_open(struct ring_t *ring, const char *name);
+int ring_peek(struct ring_t *ring, const uint8_t **data, size_t *len, unsigned int *priority);
+void ring_release(struct ring_t *ring);
+
+void ring_unmap(struct ring_t *ring);
+int ring_unlink(const char *name);
+
+#endif // _RING_H_
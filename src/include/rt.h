@@ -0,0 +1,40 @@
+/**
+ * @file rt.h
+ * @brief Real-time mode: fixed priority scheduling, locked memory and pre-faulted stacks for the transmit path.
+ *
+ * The threads on the path from the transmit queue to the UART, the transmit thread and each radio's thread, run under
+ * `SCHED_FIFO` at the configured priority, optionally pinned to one CPU, so that other work on the flight computer
+ * cannot delay a packet between being taken off the queue and being written to the radio. The input threads run one
+ * priority lower, so input keeps draining without ever preempting a transmission in progress.
+ *
+ * Every buffer a packet passes through is static or on a thread's stack. All memory is locked, which faults in the
+ * static buffers up front, and each real-time thread touches its stack as it starts, so the steady state path never
+ * takes a page fault. Threads are created with a small fixed stack, since locked stacks take real memory.
+ */
+#ifndef _RT_H_
+#define _RT_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/** The size of each thread's stack in real-time mode. */
+#define RT_STACK_SIZE (256 * 1024)
+
+/** How much of its stack each real-time thread touches as it starts. */
+#define RT_STACK_PREFAULT (64 * 1024)
+
+/** Real-time settings. */
+struct rt_config_t {
+    /** Whether real-time mode is enabled. */
+    bool enabled;
+    /** The `SCHED_FIFO` priority of the transmit path. The input threads run one lower. */
+    int priority;
+    /** The CPU the transmit path is pinned to, or -1 to let it run on any. */
+    int cpu;
+};
+
+int rt_parse(const char *spec, struct rt_config_t *rt);
+int rt_enter(const struct rt_config_t *rt, pthread_attr_t *attr);
+int rt_thread(const struct rt_config_t *rt);
+
+#endif // _RT_H_
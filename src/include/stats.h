@@ -0,0 +1,113 @@
+/**
+ * @file stats.h
+ * @brief Latency histograms and counters for each stage a packet passes through on its way to the air.
+ *
+ * The stages of a packet are timed from monotonic timestamps taken when it is queued, when it is taken off the queue,
+ * when its `radio tx` command has been assembled, when the command has left the UART, when the radio accepts it with
+ * "ok" and when the radio reports "radio_tx_ok". Each stage has a histogram per priority with buckets that grow
+ * geometrically, four to every doubling, so recording a sample is a few instructions and the histograms have a fixed
+ * size at any resolution from nanoseconds to minutes.
+ *
+ * The statistics live in one struct that can be placed in a shared memory segment, so that they can be read by another
+ * process while broadcaster runs. Updates are bracketed by a sequence number so that readers can take a consistent
+ * snapshot without locking, and writers in different threads take turns.
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The name of the shared memory segment the statistics are published in. */
+#define STATS_SHM_NAME "/broadcaster-stats"
+
+/** The number of histogram buckets. The last one also holds every longer sample, from about 69 seconds. */
+#define STATS_BUCKETS 140
+
+/** The number of priorities tracked separately. Higher priorities are counted with the highest. */
+#define STATS_PRIORITIES 4
+
+/** The number of radios whose transmissions are counted separately. */
+#define STATS_RADIOS 4
+
+/** The stages of a packet's journey that are timed. */
+typedef enum {
+    STAGE_QUEUE,    /**< From being queued to being taken off the queue. */
+    STAGE_FRAME,    /**< From being taken off the queue to transmission starting, including aggregation and pacing. */
+    STAGE_ASSEMBLE, /**< Assembling the `radio tx` command. */
+    STAGE_UART,     /**< Writing the command until the UART has sent it. */
+    STAGE_ACCEPT,   /**< From the command being sent to the radio answering "ok". */
+    STAGE_AIR,      /**< From "ok" to "radio_tx_ok", the time on air. */
+    STAGE_TOTAL,    /**< From the oldest packet in a frame being queued to "radio_tx_ok". */
+    STATS_STAGES,   /**< The number of stages. */
+} Stage;
+
+/** A latency histogram. */
+struct stats_hist_t {
+    /** The number of samples. */
+    uint64_t count;
+    /** The sum of all samples in nanoseconds. */
+    uint64_t sum_ns;
+    /** The longest sample in nanoseconds. */
+    uint64_t max_ns;
+    /** The number of samples in each bucket. */
+    uint64_t buckets[STATS_BUCKETS];
+};
+
+/** Counters of radio transmissions at one priority. */
+struct stats_counters_t {
+    /** The number of packets the radio transmitted. */
+    uint64_t packets;
+    /** The number of payload bytes the radio transmitted. */
+    uint64_t bytes;
+    /** The number of transmission attempts that were retried. */
+    uint64_t retries;
+    /** The number of packets given up on after every retry failed. */
+    uint64_t failures;
+};
+
+/** Every statistic collected. */
+struct stats_t {
+    /** Odd while an update is in progress, and incremented by two by each update. */
+    atomic_uint seq;
+    /** The latency histograms of each stage at each priority. */
+    struct stats_hist_t hist[STATS_STAGES][STATS_PRIORITIES];
+    /** The transmission counters at each priority. */
+    struct stats_counters_t counters[STATS_PRIORITIES];
+    /** The transmission counters of each radio, across all priorities. */
+    struct stats_counters_t radios[STATS_RADIOS];
+};
+
+/** A summary of a histogram. Percentiles are the upper bound of the bucket they fall in, so within 19%. */
+struct stats_summary_t {
+    /** The number of samples. */
+    uint64_t count;
+    /** The mean sample in nanoseconds. */
+    uint64_t mean_ns;
+    /** The median in nanoseconds. */
+    uint64_t p50_ns;
+    /** The 90th percentile in nanoseconds. */
+    uint64_t p90_ns;
+    /** The 99th percentile in nanoseconds. */
+    uint64_t p99_ns;
+    /** The longest sample in nanoseconds. */
+    uint64_t max_ns;
+};
+
+extern const char *const STATS_STAGE_NAMES[STATS_STAGES];
+
+struct stats_t *stats_open(const char *name);
+void stats_close(struct stats_t *stats, const char *name);
+const struct stats_t *stats_attach(const char *name);
+void stats_begin(struct stats_t *stats);
+void stats_end(struct stats_t *stats);
+void stats_record(struct stats_t *stats, Stage stage, unsigned int priority, int64_t ns);
+void stats_add(struct stats_hist_t *hist, int64_t ns);
+struct stats_counters_t *stats_counters(struct stats_t *stats, unsigned int priority);
+struct stats_counters_t *stats_radio(struct stats_t *stats, unsigned int radio);
+void stats_snapshot(const struct stats_t *stats, struct stats_t *copy);
+uint64_t stats_bucket_limit(size_t bucket);
+void stats_summarize(const struct stats_hist_t *hist, struct stats_summary_t *summary);
+
+#endif // _STATS_H_
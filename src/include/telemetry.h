@@ -0,0 +1,82 @@
+/**
+ * @file telemetry.h
+ * @brief Bit-packing of the records in schema/telemetry.schema, generated by tools/packgen. Do not edit.
+ *
+ * A record is a message whose first byte is the id of its type, followed by its fields as laid out in the
+ * schema. A packed record starts with the id with `TELEMETRY_PACKED` set, followed by each field packed into
+ * the bits it needs, least significant bit first.
+ */
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Set in the id byte of a packed record. */
+#define TELEMETRY_PACKED 0x80
+
+/** The number of record types. */
+#define TELEMETRY_RECORDS 6
+
+/** The most fields a record type has. */
+#define TELEMETRY_MAX_FIELDS 10
+
+/** The longest record, including its id byte. */
+#define TELEMETRY_MAX_RAW 18
+
+/** The longest packed record, including its id byte. */
+#define TELEMETRY_MAX_PACKED 16
+
+/** The types a field can have. */
+typedef enum {
+    TELEMETRY_U8,
+    TELEMETRY_U16,
+    TELEMETRY_U32,
+    TELEMETRY_I8,
+    TELEMETRY_I16,
+    TELEMETRY_I32,
+    TELEMETRY_F32,
+    TELEMETRY_BOOL,
+    TELEMETRY_PAD,
+} TelemetryType;
+
+/** A field of a record type. */
+struct telemetry_field_t {
+    /** The name of the field. */
+    const char *name;
+    /** The type of the field. */
+    TelemetryType type;
+    /** Where the field starts in the record, counting the id byte. */
+    size_t offset;
+    /** The width of the packed field, in bits. */
+    unsigned int bits;
+    /** Whether the field is clamped to a range and rounded to steps. */
+    int ranged;
+    /** The range and step of an integer field. */
+    int64_t min, max, step;
+    /** The range and step of a float field. */
+    float fmin, fmax, fstep;
+};
+
+/** A record type. */
+struct telemetry_record_t {
+    /** The name of the record type. */
+    const char *name;
+    /** The id byte its records start with. */
+    uint8_t id;
+    /** The length of a record, including its id byte. */
+    size_t raw_len;
+    /** The length of a packed record, including its id byte. */
+    size_t packed_len;
+    /** The number of fields. */
+    size_t nfields;
+    /** The fields, in the order they are laid out. */
+    struct telemetry_field_t fields[TELEMETRY_MAX_FIELDS];
+};
+
+extern const struct telemetry_record_t TELEMETRY_SCHEMA[TELEMETRY_RECORDS];
+
+size_t telemetry_pack(const uint8_t *raw, size_t len, uint8_t *out);
+size_t telemetry_unpack(const uint8_t *packed, size_t len, uint8_t *out);
+
+#endif // _TELEMETRY_H_
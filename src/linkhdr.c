@@ -0,0 +1,124 @@
+/**
+ * @file linkhdr.c
+ * @brief Implementation of the link header and its analyzer.
+ *
+ * Losses are only seen once a later frame arrives, so frames lost at the very end of a capture are not counted.
+ */
+#include "linkhdr.h"
+#include <errno.h>
+
+/**
+ * Writes a number as a little-endian base 128 varint, seven bits to a byte with the top bit set on all but the last.
+ * @param value The number.
+ * @param out Where to write it.
+ * @return The number of bytes written.
+ */
+static size_t put_varint(uint64_t value, uint8_t *out) {
+    size_t len = 0;
+    for (; value >= 0x80; value >>= 7) out[len++] = (uint8_t)(value | 0x80);
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+/**
+ * Reads a little-endian base 128 varint.
+ * @param data The bytes to read it from.
+ * @param len The number of bytes available.
+ * @param max_bytes The most bytes the varint may take.
+ * @param value Set to the number.
+ * @return The number of bytes read, or 0 if the varint is cut short or too long.
+ */
+static size_t get_varint(const uint8_t *data, size_t len, size_t max_bytes, uint64_t *value) {
+    *value = 0;
+    for (size_t i = 0; i < len && i < max_bytes; i++) {
+        *value |= (uint64_t)(data[i] & 0x7f) << (7 * i);
+        if (!(data[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+/**
+ * Writes a link header.
+ * @param header The header.
+ * @param out Where to write the header, with room for `LHDR_MAX_LEN` bytes.
+ * @return The number of bytes written.
+ */
+size_t lhdr_encode(const struct lhdr_t *header, uint8_t *out) {
+    unsigned int priority = header->priority < LHDR_MAX_PRIORITY ? header->priority : LHDR_MAX_PRIORITY;
+    uint32_t wait_ms = header->wait_ms < LHDR_MAX_WAIT_MS ? header->wait_ms : LHDR_MAX_WAIT_MS;
+    size_t len = put_varint((uint64_t)header->seq << 2 | priority, out);
+    out[len++] = header->sent_ms & 0xff;
+    out[len++] = header->sent_ms >> 8;
+    return len + put_varint(wait_ms, &out[len]);
+}
+
+/**
+ * Reads the link header at the start of a frame.
+ * @param data The frame.
+ * @param len The length of the frame in bytes.
+ * @param header Set to the header.
+ * @param header_len Set to the number of bytes the header takes, which the rest of the frame follows.
+ * @return 0 if successful, EBADMSG if the frame does not start with a valid header.
+ */
+int lhdr_decode(const uint8_t *data, size_t len, struct lhdr_t *header, size_t *header_len) {
+    uint64_t value;
+    size_t at = get_varint(data, len, 5, &value);
+    if (at == 0 || at + 2 >= len || value >> 34) return EBADMSG;
+    header->seq = (uint32_t)(value >> 2);
+    header->priority = value & LHDR_MAX_PRIORITY;
+    header->sent_ms = data[at] | data[at + 1] << 8;
+    at += 2;
+
+    size_t wait_len = get_varint(&data[at], len - at, 3, &value);
+    if (wait_len == 0) return EBADMSG;
+    header->wait_ms = (uint32_t)value;
+    *header_len = at + wait_len;
+    return 0;
+}
+
+/**
+ * Takes account of a received frame's link header.
+ * @param stats What has been measured so far from the frames of the radio that sent it.
+ * @param header The header.
+ * @param header_len The number of bytes the header took.
+ * @param frame_len The length of the frame in bytes, header included.
+ * @param received_ms When the frame was received, in milliseconds on the sender's monotonic clock, or -1 if unknown.
+ */
+void lhdr_observe(struct lhdr_stats_t *stats, const struct lhdr_t *header, size_t header_len, size_t frame_len,
+                  int64_t received_ms) {
+    stats->header_bytes += header_len;
+    stats->frame_bytes += frame_len;
+
+    int32_t gap = (int32_t)(header->seq - stats->next_seq);
+    if (stats->started && gap < -LHDR_RESTART_GAP) {
+        stats->restarts++;
+    } else if (stats->started && gap < 0) {
+        stats->duplicates++;
+        return;
+    } else if (stats->started && gap > 0) {
+        stats->lost += gap;
+        stats->bursts[gap < LHDR_MAX_BURST ? gap : LHDR_MAX_BURST]++;
+        if ((uint64_t)gap > stats->max_burst) stats->max_burst = gap;
+    }
+    stats->started = true;
+    stats->next_seq = header->seq + 1;
+    stats->received++;
+    stats->priorities[header->priority]++;
+
+    stats_add(&stats->wait, (int64_t)header->wait_ms * 1000000);
+    if (received_ms >= 0) {
+        // Only the low bits of the send time are known, which is enough while frames arrive within their range
+        uint16_t transit_ms = (uint16_t)((uint64_t)received_ms - header->sent_ms);
+        stats_add(&stats->age, ((int64_t)transit_ms + header->wait_ms) * 1000000);
+    }
+}
+
+/**
+ * Gets the fraction of frames lost.
+ * @param stats What has been measured.
+ * @return The number of frames lost as a fraction of those sent, or 0 if none have been received.
+ */
+double lhdr_loss(const struct lhdr_stats_t *stats) {
+    uint64_t sent = stats->received + stats->lost;
+    return sent ? (double)stats->lost / (double)sent : 0;
+}
@@ -1,13 +1,35 @@
 #include "../logging-utils/logging.h"
+#include "adapt.h"
+#include "aggregate.h"
+#include "arq.h"
+#include "compress.h"
+#include "dispatch.h"
+#include "evlog.h"
+#include "fec.h"
+#include "fragment.h"
+#include "linkhdr.h"
+#include "pacer.h"
+#include "pqueue.h"
 #include "radio.h"
+#include "reader.h"
+#include "record.h"
+#include "ring.h"
+#include "rt.h"
+#include "stats.h"
+#include "telemetry.h"
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 /** The priority above which all messages will be guaranteed to be sent. */
@@ -15,10 +37,10 @@
 
 /**
  * The read buffer size for incoming data.
- * Since no radio packet can be greater than 512 bytes, and data is provided in ASCII encoding for hex symbols, one byte
- * of data will be one ASCII hex character. So a 512 character buffer is sufficient for all packet sizes.
+ * The longest message is one that can be fragmented, and as hex lines each byte of it takes two characters, followed
+ * by a newline and the terminating null.
  */
-#define BUFFER_SIZE 512
+#define BUFFER_SIZE (2 * FRAG_MAX_MESSAGE + 2)
 
 /** How many times broadcaster will attempt to transmit a packet before giving up. */
 #define RETRY_LIMIT 3
@@ -26,17 +48,219 @@
 /** How many times broadcaster will attempt to transmit a high priority packet before giving up. */
 #define TOP_PRIOR_RETRY_LIMIT 10
 
-/** The name of the message queue to read input from. */
+/**
+ * How many attempts in a row may fail because the radio stopped working, rather than because the transmission failed,
+ * before the radio is taken out of use and recovered instead of being retried.
+ */
+#define FAULT_LIMIT 2
+
+/** The longest time a frame can wait for more messages to aggregate, in milliseconds. */
+#define MAX_LINGER_MS 10000
+
+/** The longest receive window for acknowledgements that can be given on the command line, in milliseconds. */
+#define MAX_ACK_WINDOW_MS 10000
+
+/** How long to wait between attempts to recover a radio once every recovery step has failed, in seconds. */
+#define RECOVERY_BACKOFF_S 1
+
+/** The steps taken to recover a radio that stopped working, from the quickest to the most thorough. */
+typedef enum {
+    RECOVER_SYNC,   /**< Read back the radio's settings and restore any it lost, such as after a brown-out. */
+    RECOVER_RESET,  /**< Reset the module with `sys reset` and apply every setting again. */
+    RECOVER_REOPEN, /**< Close and reopen the tty, then reset the module and apply every setting again. */
+} RecoveryStep;
+
+/** The number of recovery steps. */
+#define RECOVERY_STEPS 3
+
+/** The events the threads packets pass through log asynchronously, since any of them can happen for every packet. */
+typedef enum {
+    EV_QUEUE_TOO_LONG,     /**< A message too long to queue was discarded. Args: length. */
+    EV_FRAGMENT_TOO_LONG,  /**< A message too long to fragment was discarded. Args: length. */
+    EV_LOOKS_PACKED,       /**< A message that would pass for a packed record was discarded. Args: first byte. */
+    EV_QUEUE_READ_FAILED,  /**< Reading an input message queue failed. Subject: queue. */
+    EV_LINE_TOO_LONG,      /**< An input line too long to read was discarded. */
+    EV_LINE_NOT_HEX,       /**< An input line that is not valid hex was discarded. */
+    EV_RING_TOO_LONG,      /**< A message too long to queue was discarded from a ring. Subject: ring. Args: length. */
+    EV_FRAME_TOO_LONG,     /**< An input frame too long to queue was discarded. Args: length. */
+    EV_FRAME_CUT_SHORT,    /**< An input frame cut short by the end of input was discarded. */
+    EV_AGGREGATE_TOO_LONG, /**< A message too long to aggregate was discarded. Args: length. */
+    EV_COMPRESS_TOO_LONG,  /**< A frame too long to compress was discarded. Args: length. */
+    EV_FEC_TOO_LONG,       /**< A frame too long to protect with FEC was discarded. Args: length. */
+    EV_RADIO_TOO_LONG,     /**< A packet too long for the radio was discarded. Args: length. */
+    EV_HEADERS_TOO_LONG,   /**< A packet too long for its headers was discarded. Args: length. */
+    EV_RADIO_STOPPED,      /**< A radio stopped working and is being recovered. Subject: device. Args: tries. */
+    EV_TRANSMIT_FAILED,    /**< A packet could not be transmitted. Subject: device. Args: tries. */
+    EV_RECOVERY_FAILED,    /**< A recovery step failed. Subject: device. Args: step, attempt. */
+    EV_BAUD_FAILED,        /**< A recovered radio kept a fallback baud rate. Subject: device. Args: wanted, actual. */
+    EV_RECOVERED,          /**< A radio recovered. Subject: device. Args: step, time down in ns, attempt, changes. */
+} Event;
+
+/** The longest an FEC group is kept open waiting for more packets, in milliseconds. */
+#define FEC_FLUSH_MS 250
+
+/** The name of the message queue to read input from. Overridable for hosts that require a leading slash. */
+#ifndef IN_QUEUE
 #define IN_QUEUE "plogger-out"
+#endif
 
-/** The read buffer for input. */
-char buffer[BUFFER_SIZE];
+/** A message queue or shared memory ring input is read from. */
+struct input_t {
+    /** The name of the message queue or ring. */
+    const char *name;
+    /** The input's share of transmission relative to the other inputs. */
+    unsigned int weight;
+    /** Whether the input is a shared memory ring rather than a message queue. */
+    bool shm;
+    /** The message queue descriptor. */
+    mqd_t q;
+    /** The mapped ring. */
+    struct ring_t ring;
+    /** The thread reading the input. */
+    pthread_t thread;
+};
 
-/** Whether to read from a message queue or from stdin. Queue by default. */
+/** Whether to read from message queues or from stdin. Queues by default. */
 bool from_q = true;
 
-/** Input message queue file descriptor. */
-mqd_t input_q;
+/** The file to read binary frames from, "-" for stdin, or NULL to read ASCII hex lines from stdin. */
+char *frames_path = NULL;
+
+/** Reads binary frames from `frames_path`. */
+struct reader_t frame_reader;
+
+/** The recording to replay as input, as given on the command line, or NULL. */
+char *replay_path = NULL;
+
+/** The recording being replayed. */
+struct recording_t replay;
+
+/** How many times faster than it was recorded a recording is replayed, or 0 for as fast as possible. */
+double replay_speed = 1;
+
+/** The entries of the recording being replayed, in the order they were queued. */
+uint32_t replay_order[RECORD_MAX_ENTRIES];
+
+/** The file messages taken off the transmit queue are recorded to, as given on the command line, or NULL. */
+char *record_path = NULL;
+
+/** Records the messages taken off the transmit queue. */
+struct recorder_t recorder;
+
+/** The message queues and rings to read input from, each a source scheduled fairly against the others. */
+struct input_t inputs[PQ_SOURCES];
+
+/** The number of message queues and rings to read input from. */
+size_t ninputs = 0;
+
+/** The number of inputs that have not ended. A ring ends when its producer closes it, a message queue never does. */
+atomic_uint open_inputs;
+
+/** Whether to pack several messages into each radio frame. */
+bool aggregate = false;
+
+/** How long to wait for more messages to fill an aggregated frame, in milliseconds. */
+unsigned long linger_ms = 0;
+
+/** Whether to split messages too long for one frame into fragments. */
+bool fragment = false;
+
+/** The id of the next message to be fragmented, shared by every input. */
+atomic_uint fragment_id;
+
+/** Whether the first byte of each message names a stream of which only the newest queued message is kept. */
+bool keyed = false;
+
+/** Whether to compress frames before transmission. */
+bool compress = false;
+
+/** The state of frame compression. */
+struct comp_encoder_t encoder;
+
+/** Whether to bit-pack the telemetry records described in schema/telemetry.schema before they are queued. */
+bool bitpack = false;
+
+/** The number of messages bit-packed, and their total length before and after, counted over every input. */
+atomic_uint_fast64_t packed_records, packed_bytes_in, packed_bytes_out;
+
+/** Whether to send parity packets that let lost packets be rebuilt. */
+bool fec = false;
+
+/** The state of forward error correction. */
+struct fec_encoder_t fec_encoder;
+
+/** When the current FEC group must be closed, on the monotonic clock. */
+struct timespec fec_deadline;
+
+/** The faster radio profiles to step up to when transmission falls behind, as given on the command line, or NULL. */
+char *ladder = NULL;
+
+/** The state of adaptive data rate. */
+struct adapt_t adapt;
+
+/** Whether to number and timestamp every frame with a link header. */
+bool link_header = false;
+
+/** How long each radio listens for an acknowledgement after sending a top priority packet in ms, or 0 not to. */
+unsigned long ack_window_ms = 0;
+
+/** Whether to print the capacity of the configured radio parameters and exit. */
+bool plan = false;
+
+/** The duty cycle transmissions are paced to, as given on the command line, or NULL for no pacing. */
+char *duty_cycle = NULL;
+
+/** The pacing every radio starts with, each keeping its own duty cycle. */
+struct pacer_t pacer;
+
+/** Whether top priority packets are sent on every radio. */
+bool mirror = false;
+
+/** Real-time scheduling of the transmit path, disabled unless given on the command line. */
+struct rt_config_t rt = {.cpu = -1};
+
+/** The LoRa radios and the packets waiting to be sent on each. */
+struct dispatcher_t dispatcher;
+
+/** Packets read from input that are waiting to be transmitted. */
+struct pqueue_t tx_queue;
+
+/** Latency histograms and transmission counters, published in shared memory if possible. */
+struct stats_t *stats;
+
+/** Where statistics are kept if they cannot be published in shared memory. */
+struct stats_t local_stats;
+
+/** When the oldest packet in the frame being sent was queued, in nanoseconds on the monotonic clock. */
+int64_t frame_queued_ns;
+
+/** When the first packet in the frame being sent was taken off the queue, in nanoseconds on the monotonic clock. */
+int64_t frame_dequeued_ns;
+
+/** The recorded entry of the first message in the frame being sent. */
+uint64_t frame_record_first;
+
+/** The number of recorded messages in the frame being sent. */
+size_t frame_records;
+
+/** When broadcaster started, on the monotonic clock. */
+struct timespec start_time;
+
+/** Set once a packet has been transmitted on any radio. */
+atomic_flag first_sent = ATOMIC_FLAG_INIT;
+
+/** The names of the recovery steps, as they are logged. */
+const char *const RECOVERY_NAMES[RECOVERY_STEPS] = {[RECOVER_SYNC] = "re-sync", [RECOVER_RESET] = "reset",
+                                                    [RECOVER_REOPEN] = "reopen"};
+
+/** The number of times each radio was recovered by each step. Only written by the radio's own thread. */
+unsigned long recovered_by[DISPATCH_MAX_LINKS][RECOVERY_STEPS];
+
+/** The top priority packets each radio is waiting to have acknowledged. Only used by the radio's own thread. */
+struct arq_t arqs[DISPATCH_MAX_LINKS];
+
+/** Where the threads packets pass through log events, so that writing them never holds up a packet. */
+struct evlog_t events;
 
 /**
  * A macro for exiting with a failure when validation fails.
@@ -49,8 +273,8 @@ mqd_t input_q;
         exit(EXIT_FAILURE);                                                                                            \
     }
 
-/** The device name of the serial port connected to the LoRa radio. */
-char *serial_port = NULL;
+/** The UART baud rate to move the link to the radio to. */
+unsigned int baud_rate = RADIO_DEFAULT_BAUD;
 
 /** The default radio parameters. */
 struct lora_params_t radio_parameters = {.modulation = LORA,
@@ -64,10 +288,1190 @@ struct lora_params_t radio_parameters = {.modulation = LORA,
                                          .iqi = false,
                                          .sync_word = 0x43};
 
+/**
+ * Decodes a line of ASCII hex into bytes.
+ * @param hex The hex characters, optionally terminated by a newline.
+ * @param out The buffer to write the decoded bytes into.
+ * @param len Set to the number of decoded bytes.
+ * @return 0 if the line was valid hex, EINVAL otherwise.
+ */
+static int hex_decode(const char *hex, uint8_t *out, size_t *len) {
+    size_t nchars = strcspn(hex, "\r\n");
+    if (nchars % 2 || strspn(hex, "0123456789abcdefABCDEF") < nchars) return EINVAL;
+
+    for (size_t i = 0; i < nchars; i += 2) {
+        char byte[3] = {hex[i], hex[i + 1], '\0'};
+        out[i / 2] = strtoul(byte, NULL, 16);
+    }
+    *len = nchars / 2;
+    return 0;
+}
+
+/**
+ * Gets the most bytes a frame may hold, after the headers added to it on the way to the radio.
+ * @return The frame capacity in bytes.
+ */
+static size_t frame_capacity(void) {
+    size_t capacity = fec ? FEC_MAX_DATA : RADIO_MAX_PAYLOAD;
+    if (ladder != NULL) capacity -= ADAPT_HEADER_LEN;
+    if (link_header) capacity -= LHDR_MAX_LEN;
+    return compress ? capacity - COMP_HEADER_LEN : capacity;
+}
+
+/**
+ * Turns a logged event into text.
+ * @param event The event, with a code from `Event`.
+ * @param text Where to write the text.
+ * @param size The size of `text` in bytes.
+ * @return The level to log the event at.
+ */
+static log_level_e describe_event(const struct evlog_event_t *event, char *text, size_t size) {
+    const char *error = event->err ? strerror(event->err) : "";
+    const uint64_t *args = event->args;
+    switch ((Event)event->code) {
+    case EV_QUEUE_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte message, which is too long to queue", (unsigned long long)args[0]);
+        break;
+    case EV_FRAGMENT_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte message, which is too long to fragment",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_LOOKS_PACKED:
+        snprintf(text, size, "Discarding message starting 0x%02llx, which would be unpacked as a record",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_QUEUE_READ_FAILED:
+        snprintf(text, size, "Failed to read from queue %s: %s", event->subject, error);
+        break;
+    case EV_LINE_TOO_LONG:
+        snprintf(text, size, "Discarding input line longer than %d characters", BUFFER_SIZE - 2);
+        break;
+    case EV_LINE_NOT_HEX:
+        snprintf(text, size, "Discarding input line that is not valid hex");
+        break;
+    case EV_RING_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte message from ring %s, which is too long",
+                 (unsigned long long)args[0], event->subject);
+        break;
+    case EV_FRAME_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte input frame, which is too long", (unsigned long long)args[0]);
+        break;
+    case EV_FRAME_CUT_SHORT:
+        snprintf(text, size, "Discarding input frame cut short by the end of input");
+        break;
+    case EV_AGGREGATE_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte message, which is too long to aggregate",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_COMPRESS_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte frame, which is too long to compress", (unsigned long long)args[0]);
+        break;
+    case EV_FEC_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte frame, which is too long to protect with FEC",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_RADIO_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte packet, which is too long for the radio",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_HEADERS_TOO_LONG:
+        snprintf(text, size, "Discarding %llu byte packet, which is too long for its headers",
+                 (unsigned long long)args[0]);
+        break;
+    case EV_RADIO_STOPPED:
+        snprintf(text, size, "Radio on %s stopped working after %llu tries, recovering it: %s", event->subject,
+                 (unsigned long long)args[0], error);
+        break;
+    case EV_TRANSMIT_FAILED:
+        snprintf(text, size, "Failed to transmit on %s after %llu tries: %s", event->subject,
+                 (unsigned long long)args[0], error);
+        break;
+    case EV_RECOVERY_FAILED:
+        snprintf(text, size, "Radio on %s is down, %s failed: %s", event->subject, RECOVERY_NAMES[args[0]], error);
+        return args[1] == 1 ? LOG_WARN : LOG_INFO;
+    case EV_BAUD_FAILED:
+        snprintf(text, size, "Could not switch recovered radio on %s to %llu baud, staying at %llu: %s",
+                 event->subject, (unsigned long long)args[0], (unsigned long long)args[1], error);
+        return LOG_WARN;
+    case EV_RECOVERED:
+        snprintf(text, size, "Radio on %s recovered by %s in %.1f ms after %llu attempt%s, %llu settings changed",
+                 event->subject, RECOVERY_NAMES[args[0]], (double)args[1] / 1000000, (unsigned long long)args[2],
+                 args[2] == 1 ? "" : "s", (unsigned long long)args[3]);
+        return LOG_INFO;
+    default:
+        snprintf(text, size, "Unknown event %u: %s", event->code, error);
+        break;
+    }
+    return LOG_ERROR;
+}
+
+/**
+ * Adds a message to the transmit queue. With bit-packing, a telemetry record is queued packed, and any other message
+ * whose first byte has `TELEMETRY_PACKED` set is discarded, since the ground station would unpack it. With
+ * fragmentation, the message is queued behind a fragment header, split into as many fragments as it takes to fit each
+ * in a frame of its own. With keyed streams, the message replaces the queued message of its stream from the same
+ * input, which is named by its id byte before packing.
+ * @param data The message.
+ * @param len The length of the message in bytes.
+ * @param priority The priority of the message.
+ * @param source The input the message came from.
+ */
+static void queue_message(const uint8_t *data, size_t len, unsigned int priority, unsigned int source) {
+    int key = keyed && len > 0 ? data[0] : PQ_NO_KEY;
+    uint8_t packed[TELEMETRY_MAX_PACKED];
+    size_t packed_len = bitpack ? telemetry_pack(data, len, packed) : 0;
+    if (packed_len > 0) {
+        atomic_fetch_add_explicit(&packed_records, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&packed_bytes_in, len, memory_order_relaxed);
+        atomic_fetch_add_explicit(&packed_bytes_out, packed_len, memory_order_relaxed);
+        data = packed;
+        len = packed_len;
+    } else if (bitpack && len > 0 && (data[0] & TELEMETRY_PACKED)) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_LOOKS_PACKED, .args = {data[0]}});
+        return;
+    }
+    if (!fragment) {
+        // Overload drops are counted by the queue and visible in the stats dump
+        if (pq_push_keyed(&tx_queue, data, len, priority, source, key) == EMSGSIZE) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_QUEUE_TOO_LONG, .args = {len}});
+        }
+        return;
+    }
+
+    // An aggregated fragment still needs its length prefix to fit
+    size_t capacity = frame_capacity() - (aggregate ? 1 : 0);
+    unsigned int count = frag_count(len, capacity);
+    if (count == 0) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_FRAGMENT_TOO_LONG, .args = {len}});
+        return;
+    }
+    uint8_t id = count > 1 ? atomic_fetch_add(&fragment_id, 1) : 0;
+    // Fragments of one message would replace each other, so only a message sent whole belongs to its stream
+    if (count > 1) key = PQ_NO_KEY;
+    uint8_t piece[RADIO_MAX_PAYLOAD];
+    size_t piece_len;
+    for (unsigned int i = 0; frag_piece(data, len, capacity, id, i, piece, &piece_len) == 0; i++) {
+        pq_push_keyed(&tx_queue, piece, piece_len, priority, source, key);
+    }
+}
+
+/**
+ * Reads packets from an input source into the transmit queue until input ends. Each message queue has a thread of its
+ * own blocked in `mq_receive`, so every queue is waited on at once without polling.
+ * @param arg The message queue to read, or NULL to read stdin.
+ * @return NULL.
+ */
+static void *ingest_thread(void *arg) {
+    const struct input_t *input = arg;
+    unsigned int source = input != NULL ? (unsigned int)(input - inputs) : 0;
+    char buffer[BUFFER_SIZE];
+    uint8_t packet[FRAG_MAX_MESSAGE];
+    const uint8_t *data = packet;
+    size_t nbytes;
+    unsigned int priority = 0;
+
+    while (1) {
+        if (input != NULL) {
+            nbytes = mq_receive(input->q, buffer, BUFFER_SIZE, &priority);
+            if (nbytes == (size_t)-1) {
+                evlog_post(&events,
+                           &(struct evlog_event_t){.code = EV_QUEUE_READ_FAILED, .err = errno, .subject = input->name});
+                // Don't quit, just continue
+                continue;
+            }
+            data = (const uint8_t *)buffer;
+        } else {
+            // End of input stream triggers program exit
+            if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) break;
+            if (strchr(buffer, '\n') == NULL && !feof(stdin)) {
+                evlog_post(&events, &(struct evlog_event_t){.code = EV_LINE_TOO_LONG});
+                int c;
+                while ((c = getchar()) != '\n' && c != EOF)
+                    ;
+                continue;
+            }
+            if (hex_decode(buffer, packet, &nbytes)) {
+                evlog_post(&events, &(struct evlog_event_t){.code = EV_LINE_NOT_HEX});
+                continue;
+            }
+            if (nbytes == 0) continue;
+        }
+
+        queue_message(data, nbytes, priority, source);
+    }
+
+    pq_close(&tx_queue);
+    return NULL;
+}
+
+/**
+ * Reads messages from a shared memory ring into the transmit queue until its producer closes it. Each message is
+ * queued straight from the ring, and its room is only handed back to the producer once it has been. Input ends when
+ * the last input does.
+ * @param arg The ring's input.
+ * @return NULL.
+ */
+static void *ring_thread(void *arg) {
+    struct input_t *input = arg;
+    unsigned int source = input - inputs;
+    const uint8_t *data;
+    size_t len;
+    unsigned int priority;
+    int err;
+
+    size_t max_len = fragment ? FRAG_MAX_MESSAGE : PQ_PACKET_MAX;
+    while ((err = ring_peek(&input->ring, &data, &len, &priority)) == 0) {
+        if (len > max_len) {
+            evlog_post(&events,
+                       &(struct evlog_event_t){.code = EV_RING_TOO_LONG, .subject = input->name, .args = {len}});
+        } else if (len > 0) {
+            queue_message(data, len, priority, source);
+        }
+        ring_release(&input->ring);
+    }
+    if (err != EPIPE) log_print(stderr, LOG_ERROR, "Stopped reading ring %s: %s", input->name, strerror(err));
+
+    if (atomic_fetch_sub(&open_inputs, 1) == 1) pq_close(&tx_queue);
+    return NULL;
+}
+
+/**
+ * Reads binary frames into the transmit queue until input ends. Each payload is queued straight from where it was read.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *frames_thread(void *arg) {
+    (void)arg;
+    const uint8_t *data;
+    size_t len;
+    unsigned int priority;
+    int err;
+
+    size_t max_len = fragment ? FRAG_MAX_MESSAGE : PQ_PACKET_MAX;
+    while ((err = reader_next(&frame_reader, max_len, &data, &len, &priority)) != EPIPE) {
+        if (err == EMSGSIZE) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_FRAME_TOO_LONG, .args = {len}});
+            continue;
+        }
+        if (err == EBADMSG) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_FRAME_CUT_SHORT});
+            break;
+        }
+        if (err) {
+            log_print(stderr, LOG_ERROR, "Stopped reading input frames: %s", strerror(err));
+            break;
+        }
+        if (len > 0) queue_message(data, len, priority, 0);
+    }
+
+    reader_close(&frame_reader);
+    pq_close(&tx_queue);
+    return NULL;
+}
+
+/**
+ * Feeds the messages of a recording into the transmit queue in the order they were queued, keeping their recorded
+ * spacing divided by the replay speed, until the recording ends.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *replay_thread(void *arg) {
+    (void)arg;
+    record_order(&replay, replay_order);
+    int64_t start = radio_now_ns(), recorded_start = 0;
+
+    for (uint64_t i = 0; i < replay.count; i++) {
+        const struct record_entry_t *entry = record_entry(&replay, replay_order[i]);
+        if (i == 0) recorded_start = entry->queued_ns;
+        if (replay_speed > 0) {
+            int64_t due = start + (int64_t)((double)(entry->queued_ns - recorded_start) / replay_speed);
+            struct timespec when = {.tv_sec = due / 1000000000, .tv_nsec = due % 1000000000};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR)
+                ;
+        }
+        queue_message(entry->data, entry->len, entry->priority, entry->source);
+    }
+
+    pq_close(&tx_queue);
+    return NULL;
+}
+
+/**
+ * Measures the time that has passed since broadcaster started.
+ * @return The elapsed time in milliseconds.
+ */
+static double ms_since_start(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start_time.tv_sec) * 1000 + (double)(now.tv_nsec - start_time.tv_nsec) / 1000000;
+}
+
+/**
+ * Records that a packet has been taken off the transmit queue to be sent in the current frame, and appends it to the
+ * recording if there is one.
+ * @param packet The packet.
+ * @param first Whether the packet starts a new frame.
+ */
+static void dequeued(const struct packet_t *packet, bool first) {
+    int64_t now = radio_now_ns();
+    int64_t queued = (int64_t)packet->queued.tv_sec * 1000000000 + packet->queued.tv_nsec;
+    stats_begin(stats);
+    stats_record(stats, STAGE_QUEUE, packet->priority, now - queued);
+    stats_end(stats);
+
+    if (record_path != NULL) {
+        uint64_t entry = record_append(&recorder, packet, now);
+        if (first) {
+            frame_record_first = entry;
+            frame_records = 0;
+        }
+        frame_records++;
+    }
+
+    if (first) {
+        frame_dequeued_ns = now;
+        frame_queued_ns = queued;
+    } else if (queued < frame_queued_ns) {
+        frame_queued_ns = queued;
+    }
+}
+
+/**
+ * Adds a transmission outcome to a set of counters.
+ * @param counters The counters.
+ * @param len The length of the packet in bytes.
+ * @param tries The number of attempts made.
+ * @param err 0 if the last attempt succeeded, otherwise the error it failed with.
+ */
+static void count_sent(struct stats_counters_t *counters, size_t len, unsigned int tries, int err) {
+    counters->retries += tries - 1;
+    if (err) {
+        counters->failures++;
+    } else {
+        counters->packets++;
+        counters->bytes += len;
+    }
+}
+
+/**
+ * Records the outcome of sending a packet on a radio, and how long each stage of the successful attempt took. The
+ * outcome is also filled in for the packet's recorded messages.
+ * @param link The radio the packet was sent on.
+ * @param packet The packet.
+ * @param len The number of bytes sent, including any header added to the packet.
+ * @param tries The number of attempts made.
+ * @param err 0 if the last attempt succeeded, otherwise the error it failed with.
+ */
+static void record_sent(const struct radio_link_t *link, const struct outgoing_t *packet, size_t len,
+                        unsigned int tries, int err) {
+    const struct radio_timing_t *t = &link->radio.timing;
+    unsigned int priority = packet->priority;
+    stats_begin(stats);
+    count_sent(stats_counters(stats, priority), len, tries, err);
+    count_sent(stats_radio(stats, link->index), len, tries, err);
+    if (!err) {
+        stats_record(stats, STAGE_FRAME, priority, t->started - packet->dequeued_ns);
+        stats_record(stats, STAGE_ASSEMBLE, priority, t->assembled - t->started);
+        stats_record(stats, STAGE_UART, priority, t->written - t->assembled);
+        stats_record(stats, STAGE_ACCEPT, priority, t->accepted - t->written);
+        stats_record(stats, STAGE_AIR, priority, t->done - t->accepted);
+        stats_record(stats, STAGE_TOTAL, priority, t->done - packet->queued_ns);
+    }
+    stats_end(stats);
+    if (packet->records > 0) record_outcome(&recorder, packet->record_first, packet->records, err == 0);
+}
+
+/**
+ * Moves a radio to the profile announced in the last packet, logging the switch.
+ * @param link The radio.
+ */
+static void switch_profile(struct radio_link_t *link) {
+    const struct lora_params_t *profile = &adapt.profiles[adapt.next];
+    size_t changed = 0;
+    int err = 0;
+    for (uint8_t tries = 0; tries < RETRY_LIMIT; tries++) {
+        err = radio_switch_params(&link->radio, profile, &changed);
+        if (!err) break;
+    }
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not switch to radio profile %u, staying on %u: %s", adapt.next,
+                  adapt.current, strerror(err));
+        return;
+    }
+
+    int64_t now_ms = ms_since_start();
+    adapt_switched(&adapt, now_ms);
+    log_print(stderr, LOG_INFO, "Switched to radio profile %u (SF%u, %u kHz, CR %s), %zu settings changed",
+              adapt.current, profile->spread_factor, profile->bandwidth, radio_coding_rate_str(profile->coding_rate),
+              changed);
+}
+
+/**
+ * Decides which radio profile the packet after the next one is sent with, from how far behind transmission is.
+ * @return The header byte announcing the decision.
+ */
+static uint8_t next_profile(void) {
+    struct timespec now, oldest;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    oldest = now;
+    size_t depth = pq_backlog(&tx_queue, &oldest);
+    int64_t age_ms = (int64_t)(now.tv_sec - oldest.tv_sec) * 1000 + (now.tv_nsec - oldest.tv_nsec) / 1000000;
+    int64_t now_ms = ms_since_start();
+    adapt_decide(&adapt, depth, age_ms, now_ms);
+    return adapt_header(&adapt);
+}
+
+/**
+ * Calculates a deadline a number of milliseconds from now.
+ * @param deadline Set to the deadline on the monotonic clock.
+ * @param ms The number of milliseconds from now.
+ */
+static void deadline_after(struct timespec *deadline, unsigned long ms) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * Tells whether a failed transmission attempt was caused by the radio or the link to it not working, as opposed to the
+ * radio reporting that the transmission itself failed. A radio that times out, reports that it is busy or rejects a
+ * well-formed packet has usually been reset by a brown-out and lost its settings or `mac pause`, which retrying the
+ * packet cannot fix.
+ * @param link The radio.
+ * @param err The error the attempt failed with.
+ * @return True if the attempt failed because of a fault.
+ */
+static bool link_fault(const struct radio_link_t *link, int err) {
+    return err && !(link->radio.accepted && err == EIO);
+}
+
+/**
+ * Puts the headers enabled in front of a packet: the profile header, then the link header stamped with the time now.
+ * @param packet The packet.
+ * @param profile The profile header.
+ * @param header The link header, whose sequence number is already set.
+ * @param out Where to write the frame, with room for `RADIO_MAX_PAYLOAD` bytes.
+ * @param header_len Set to the length of the link header in bytes.
+ * @return The length of the frame in bytes, or 0 if the headers leave no room for the packet.
+ */
+static size_t add_headers(const struct outgoing_t *packet, uint8_t profile, struct lhdr_t *header, uint8_t *out,
+                          size_t *header_len) {
+    size_t len = 0;
+    *header_len = 0;
+    if (ladder != NULL) out[len++] = profile;
+    if (link_header) {
+        int64_t now = radio_now_ns();
+        header->sent_ms = (uint16_t)(now / 1000000);
+        header->wait_ms = now > packet->queued_ns ? (now - packet->queued_ns) / 1000000 : 0;
+        *header_len = lhdr_encode(header, &out[len]);
+        len += *header_len;
+    }
+    if (len + packet->len > RADIO_MAX_PAYLOAD) return 0;
+    memcpy(&out[len], packet->data, packet->len);
+    return len + packet->len;
+}
+
+/**
+ * Sends a packet on a radio, retrying a number of times that depends on its priority. Retrying stops early once
+ * `FAULT_LIMIT` attempts in a row fail because of a fault, so that the radio is recovered rather than retried. With
+ * adaptive data rate, the packet is prefixed with the profile header, and the radio switches profile afterwards if the
+ * header announced it. With the link header, it is numbered and stamped as it is first handed to the radio, and every
+ * retry carries the same header.
+ * @param link The radio.
+ * @param packet The packet.
+ * @param fault Set to whether the last attempt failed because of a fault.
+ * @return 0 if the packet was sent or discarded, otherwise the error the last attempt to send it failed with.
+ */
+static int send_packet(struct radio_link_t *link, const struct outgoing_t *packet, bool *fault) {
+    uint8_t framed[RADIO_MAX_PAYLOAD];
+    const uint8_t *data = packet->data;
+    size_t len = packet->len, header_len = 0;
+    uint8_t profile = ladder != NULL ? next_profile() : 0;
+    struct lhdr_t header = {.seq = link->seq++, .priority = packet->priority};
+
+    unsigned int retry_limit = packet->priority >= TOP_PRIORITY ? TOP_PRIOR_RETRY_LIMIT : RETRY_LIMIT;
+    uint8_t transmission_tries = 0;
+    unsigned int faults = 0;
+    int err = 0;
+    for (; transmission_tries < retry_limit && faults < FAULT_LIMIT; transmission_tries++) {
+        pacer_wait(&link->pacer);
+        if (transmission_tries == 0 && (ladder != NULL || link_header)) {
+            data = framed;
+            len = add_headers(packet, profile, &header, framed, &header_len);
+            if (len == 0) {
+                evlog_post(&events, &(struct evlog_event_t){.code = EV_HEADERS_TOO_LONG, .args = {packet->len}});
+                return 0;
+            }
+        }
+        err = radio_tx_bytes(&link->radio, data, len);
+        // An attempt the radio accepted went on air even if it then failed, so it counts against the duty cycle
+        if (link->radio.accepted) pacer_record(&link->pacer, radio_time_on_air(link->radio.params, len));
+        if (!err) break;
+        faults = link_fault(link, err) ? faults + 1 : 0;
+    }
+    *fault = faults > 0;
+    record_sent(link, packet, len, err ? transmission_tries : transmission_tries + 1, err);
+    if (!err) link->header_bytes += header_len;
+    if (!err && !atomic_flag_test_and_set(&first_sent)) {
+        log_print(stderr, LOG_INFO, "First packet sent %.1f ms after startup", ms_since_start());
+    }
+
+    if (faults >= FAULT_LIMIT) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_RADIO_STOPPED, .err = err, .subject = link->device,
+                                                    .args = {transmission_tries}});
+    } else if (transmission_tries >= retry_limit) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_TRANSMIT_FAILED, .err = err, .subject = link->device,
+                                                    .args = {transmission_tries}});
+    }
+
+    // Only a switch the receiver was told about can be made
+    if (!err && ladder != NULL && adapt.next != adapt.current) switch_profile(link);
+    return err;
+}
+
+/**
+ * Hands a packet to the dispatcher to be sent on whichever radio is predicted to send it first.
+ * @param data The packet contents.
+ * @param len The length of the packet in bytes.
+ * @param priority The priority of the packet.
+ */
+static void submit(const uint8_t *data, size_t len, unsigned int priority) {
+    static struct outgoing_t packet;
+    if (len > RADIO_MAX_PAYLOAD) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_RADIO_TOO_LONG, .args = {len}});
+        return;
+    }
+    packet.priority = priority;
+    packet.len = len;
+    packet.queued_ns = frame_queued_ns;
+    packet.dequeued_ns = frame_dequeued_ns;
+    packet.record_first = frame_record_first;
+    packet.records = frame_records;
+    memcpy(packet.data, data, len);
+    dispatch_submit(&dispatcher, &packet);
+}
+
+/**
+ * Sends the parity packets of the current FEC group and starts the next group.
+ */
+static void send_parity(void) {
+    static uint8_t parity[RADIO_MAX_PAYLOAD];
+    size_t len;
+    unsigned int priority = fec_encoder.top ? TOP_PRIORITY : 0;
+
+    // Parity is only computed once the group closes, so it is timed from then, and carries no recorded messages
+    frame_dequeued_ns = frame_queued_ns = radio_now_ns();
+    frame_records = 0;
+    for (unsigned int j = 0; fec_parity(&fec_encoder, j, parity, &len) == 0; j++) submit(parity, len, priority);
+    fec_next_group(&fec_encoder);
+}
+
+/**
+ * Transmits a frame, compressing it and adding it to an FEC group first if enabled. The group's parity packets follow
+ * once the group is complete.
+ * @param data The frame contents.
+ * @param len The length of the frame in bytes.
+ * @param priority The priority of the frame.
+ */
+static void transmit(const uint8_t *data, size_t len, unsigned int priority) {
+    static uint8_t compressed[COMP_MAX_ENCODED];
+    static uint8_t coded[RADIO_MAX_PAYLOAD + FEC_HEADER_LEN];
+    if (compress) {
+        if (comp_encode(&encoder, data, len, compressed, &len)) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_COMPRESS_TOO_LONG, .args = {len}});
+            return;
+        }
+        data = compressed;
+    }
+    if (!fec) {
+        submit(data, len, priority);
+        return;
+    }
+
+    if (fec_add(&fec_encoder, data, len, priority >= TOP_PRIORITY, coded, &len)) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_FEC_TOO_LONG, .args = {len}});
+        return;
+    }
+    if (fec_encoder.count == 1) deadline_after(&fec_deadline, FEC_FLUSH_MS);
+    submit(coded, len, priority);
+    if (fec_full(&fec_encoder)) send_parity();
+}
+
+/**
+ * Takes the next packet from the transmit queue. If an FEC group is open and no packet arrives before it must close,
+ * its parity is sent while waiting.
+ * @param packet Where to copy the packet.
+ * @return 0 if a packet was removed, or EPIPE if the queue has been closed and is empty.
+ */
+static int next_packet(struct packet_t *packet) {
+    if (fec && fec_encoder.count > 0) {
+        int err = pq_pop_timed(&tx_queue, packet, PQ_PACKET_MAX, &fec_deadline);
+        if (err != ETIMEDOUT && err != EPIPE) return err;
+        send_parity();
+        if (err == EPIPE) return err;
+    }
+    return pq_pop(&tx_queue, packet);
+}
+
+/**
+ * Fills a frame with queued messages until it is full, the linger time since the first message expires, or a top
+ * priority message is added. Already queued messages are still packed after a top priority message, but no more are
+ * waited for.
+ * @param frame The frame to fill, which already contains its first message.
+ */
+static void fill_frame(struct frame_t *frame) {
+    static struct packet_t packet;
+    struct timespec deadline;
+    deadline_after(&deadline, frame->priority < TOP_PRIORITY ? linger_ms : 0);
+
+    while (agg_room(frame) > 0 && pq_pop_timed(&tx_queue, &packet, agg_room(frame), &deadline) == 0) {
+        dequeued(&packet, false);
+        agg_append(frame, packet.data, packet.len, packet.priority);
+        if (packet.priority >= TOP_PRIORITY) clock_gettime(CLOCK_MONOTONIC, &deadline);
+    }
+}
+
+/**
+ * Makes the calling thread part of the real-time transmit path, if real-time mode is enabled.
+ * @param name What the thread does, for logging.
+ */
+static void join_rt(const char *name) {
+    if (!rt.enabled) return;
+    int err = rt_thread(&rt);
+    if (err) log_print(stderr, LOG_WARN, "Could not make the %s thread real-time: %s", name, strerror(err));
+}
+
+/**
+ * Frames packets from the transmit queue, highest priority first, and hands them to the radios until the queue is
+ * closed and empty.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *transmit_thread(void *arg) {
+    (void)arg;
+    static struct packet_t packet;
+    static struct frame_t frame;
+    join_rt("transmit");
+
+    while (next_packet(&packet) == 0) {
+        dequeued(&packet, true);
+        if (!aggregate) {
+            transmit(packet.data, packet.len, packet.priority);
+            continue;
+        }
+
+        agg_reset(&frame, frame_capacity());
+        if (agg_append(&frame, packet.data, packet.len, packet.priority)) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_AGGREGATE_TOO_LONG, .args = {packet.len}});
+            continue;
+        }
+        fill_frame(&frame);
+        transmit(frame.data, frame.len, frame.priority);
+    }
+
+    // Input has ended, so wake the main thread to exit once every radio has sent what it was given
+    dispatch_close(&dispatcher);
+    for (size_t i = 0; i < dispatcher.nlinks; i++) pthread_join(dispatcher.links[i].thread, NULL);
+    kill(getpid(), SIGTERM);
+    return NULL;
+}
+
+/**
+ * Opens a radio's tty and sets it up for the RN2483.
+ * @param link The radio.
+ * @return 0 if successful, otherwise the error from opening or setting up the tty.
+ */
+static int open_tty(struct radio_link_t *link) {
+    int radio_fd = open(link->device, O_RDWR | O_NDELAY | O_NOCTTY);
+    if (radio_fd == -1) return errno;
+
+    /* O_NDELAY only keeps open() from waiting on carrier detect; writes should block until there is buffer space. */
+    fcntl(radio_fd, F_SETFL, fcntl(radio_fd, F_GETFL) & ~O_NDELAY);
+
+    /* Set up device using correct UART settings. */
+    struct termios tty;
+    if (tcgetattr(radio_fd, &tty) != 0) {
+        int err = errno;
+        close(radio_fd);
+        return err;
+    }
+
+    radio_setup_tty(&tty);
+
+    if (tcsetattr(radio_fd, TCSANOW, &tty) != 0) {
+        int err = errno;
+        close(radio_fd);
+        return err;
+    }
+
+    radio_init(&link->radio, radio_fd, &link->params);
+    return 0;
+}
+
+/**
+ * Opens a radio's tty and sets it up for the RN2483, exiting if that is not possible.
+ * @param link The radio.
+ */
+static void open_link(struct radio_link_t *link) {
+    int err = open_tty(link);
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not open tty %s with error %s.", link->device, strerror(err));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Takes one step to bring a radio that stopped working back into use.
+ * @param link The radio.
+ * @param step The recovery step.
+ * @param changed Set to the number of settings that had to be applied.
+ * @return 0 if the radio responded and has its settings, otherwise the error that occurred.
+ */
+static int recovery_step(struct radio_link_t *link, RecoveryStep step, size_t *changed) {
+    const struct lora_params_t *params = link->radio.params;
+    if (step == RECOVER_SYNC) return radio_sync_params(&link->radio, params, changed);
+
+    if (step == RECOVER_REOPEN) {
+        close(link->radio.fd);
+        link->radio.fd = -1;
+        int err = open_tty(link);
+        if (err) return err;
+    }
+    int err = radio_reset(&link->radio);
+    if (err) return err;
+    if (baud_rate != RADIO_DEFAULT_BAUD) {
+        // The radio still works at the rate it fell back to, so the recovery goes on
+        err = radio_set_baud(&link->radio, baud_rate);
+        if (err) {
+            evlog_post(&events, &(struct evlog_event_t){.code = EV_BAUD_FAILED, .err = err, .subject = link->device,
+                                                        .args = {baud_rate, link->radio.baud}});
+        }
+    }
+    *changed = RADIO_SETTINGS;
+    return radio_set_params(&link->radio, params);
+}
+
+/**
+ * Picks the step to start recovering a radio with from the error that took it out of use. A radio that stopped
+ * answering while running faster than the default baud rate has most likely browned out and fallen back to the default
+ * rate, where only a reset reaches it.
+ * @param link The radio.
+ * @param err The error the last attempt to send with the radio failed with.
+ * @return The first recovery step.
+ */
+static RecoveryStep first_step(const struct radio_link_t *link, int err) {
+    return err == ETIMEDOUT && link->radio.baud != RADIO_DEFAULT_BAUD ? RECOVER_RESET : RECOVER_SYNC;
+}
+
+/**
+ * Tries to bring a radio that stopped working back into use, escalating through the recovery steps from the first:
+ * restoring lost settings, then resetting the module, then on every attempt after that reopening its tty as well.
+ * @param link The radio.
+ * @param first The step the first attempt takes.
+ * @param attempt The number of the attempt, counting from 1.
+ * @return True if the radio responded and is back in use, false otherwise.
+ */
+static bool recover_link(struct radio_link_t *link, RecoveryStep first, unsigned long attempt) {
+    RecoveryStep step = first + attempt - 1 < RECOVERY_STEPS ? first + attempt - 1 : RECOVER_REOPEN;
+    size_t changed = 0;
+    int err = recovery_step(link, step, &changed);
+    if (err) {
+        evlog_post(&events, &(struct evlog_event_t){.code = EV_RECOVERY_FAILED, .err = err, .subject = link->device,
+                                                    .args = {step, attempt}});
+        return false;
+    }
+    int64_t down_ns = dispatch_up(&dispatcher, link);
+    recovered_by[link->index][step]++;
+    evlog_post(&events, &(struct evlog_event_t){.code = EV_RECOVERED, .subject = link->device,
+                                                .args = {step, down_ns, attempt, changed}});
+    return true;
+}
+
+/**
+ * Listens for the ground station's acknowledgement of the top priority frame a radio has just sent, and takes account
+ * of which of the packets waiting for acknowledgement it heard.
+ * @param link The radio.
+ */
+static void listen_for_ack(struct radio_link_t *link) {
+    struct arq_t *arq = &arqs[link->index];
+    uint32_t seq = link->seq - 1;
+    uint8_t ack[ARQ_ACK_LEN];
+    size_t len = 0;
+    int64_t start_ns = radio_now_ns();
+    int err = radio_rx(&link->radio, ack_window_ms * 1000, ack, sizeof(ack), &len);
+    arq->listen_ns += radio_now_ns() - start_ns;
+    arq->windows++;
+    if (err || arq_ack(arq, ack, len, seq)) arq_missed(arq, seq);
+}
+
+/**
+ * Sends the packets the dispatcher gives one radio until the dispatcher is closed and they have all been sent. If the
+ * radio stops working, the packet it was sending is handed back and the radio is recovered while the other radios
+ * carry its traffic. Every recovery step is tried straight away, and only once all of them have failed are attempts
+ * spaced out. With acknowledgements, top priority packets the ground station missed are sent again before any new
+ * packet is taken, except that a packet that just failed to be sent again lets a new packet waiting go first.
+ * @param arg The radio link.
+ * @return NULL.
+ */
+static void *radio_thread(void *arg) {
+    struct radio_link_t *link = arg;
+    struct arq_t *arq = &arqs[link->index];
+    struct outgoing_t packet;
+    RecoveryStep first = RECOVER_SYNC;
+    unsigned long attempts = 0;
+    bool up = true, yield = false;
+    join_rt("radio");
+    arq_init(arq);
+
+    while (1) {
+        size_t slot;
+        bool missed = ack_window_ms > 0 && up && arq_next(arq, radio_now_ns(), &slot);
+        int err = missed && !yield ? EAGAIN : dispatch_take(&dispatcher, link, &packet, !missed);
+        bool resend = err == EAGAIN;
+        if (resend) {
+            packet = arq->entries[slot].packet;
+            err = 0;
+        }
+        if (err == EPIPE) break;
+        if (err == ENETDOWN) {
+            // Checking back with the dispatcher between attempts lets a radio that stays down exit once idle
+            if (first + attempts >= RECOVERY_STEPS) sleep(RECOVERY_BACKOFF_S);
+            up = recover_link(link, first, attempts + 1);
+            attempts = up ? 0 : attempts + 1;
+            continue;
+        }
+        bool fault = false;
+        err = send_packet(link, &packet, &fault);
+        first = err && fault ? first_step(link, err) : RECOVER_SYNC;
+        up = !(err && fault);
+        // A packet being sent again stays with this radio, so that it is not tracked twice
+        if (err && fault) dispatch_fail(&dispatcher, link, resend ? NULL : &packet);
+        else dispatch_done(&dispatcher, link);
+
+        if (resend) arq_resent(arq, slot, link->seq - 1, err == 0);
+        yield = resend && err;
+        if (err || ack_window_ms == 0 || packet.priority < TOP_PRIORITY) continue;
+        if (!resend) arq_track(arq, &packet, link->seq - 1, radio_now_ns());
+        listen_for_ack(link);
+    }
+    return NULL;
+}
+
+/**
+ * Converts a duration to milliseconds for printing.
+ * @param ns The duration in nanoseconds.
+ * @return The duration in milliseconds.
+ */
+static double ns_to_ms(uint64_t ns) { return (double)ns / 1000000; }
+
+/**
+ * Prints the state, UART wire time per command and transmission counters of each radio.
+ * @param snapshot A snapshot of the statistics.
+ */
+static void dump_links(const struct stats_t *snapshot) {
+    uint32_t default_wire_us = radio_wire_time(RADIO_DEFAULT_BAUD, RADIO_MAX_PAYLOAD);
+    for (size_t i = 0; i < dispatcher.nlinks; i++) {
+        const struct radio_link_t *link = &dispatcher.links[i];
+        pthread_mutex_lock(&dispatcher.lock);
+        bool up = link->up;
+        size_t waiting = link->count;
+        unsigned long downs = link->downs;
+        int64_t down_ns = link->down_ns, max_down_ns = link->max_down_ns;
+        pthread_mutex_unlock(&dispatcher.lock);
+
+        uint32_t wire_us = radio_wire_time(link->radio.baud, RADIO_MAX_PAYLOAD);
+        log_print(stderr, LOG_INFO,
+                  "Radio %zu on %s: UART at %u baud, %.3f ms per %d byte radio tx command, %.3f ms at %d baud", i,
+                  link->device, link->radio.baud, (double)wire_us / 1000, RADIO_MAX_PAYLOAD,
+                  (double)default_wire_us / 1000, RADIO_DEFAULT_BAUD);
+
+        const struct stats_counters_t *counters = &snapshot->radios[i < STATS_RADIOS ? i : STATS_RADIOS - 1];
+        log_print(stderr, LOG_INFO,
+                  "Radio %zu on %s: %u Hz, SF%u, %u kHz, %s with %zu waiting, down %lu times, %llu packets, %llu "
+                  "bytes, %llu retries, %llu failures",
+                  i, link->device, link->params.frequency, link->params.spread_factor, link->params.bandwidth,
+                  up ? "up" : "down", waiting, downs, (unsigned long long)counters->packets,
+                  (unsigned long long)counters->bytes, (unsigned long long)counters->retries,
+                  (unsigned long long)counters->failures);
+        if (downs > 0) {
+            const unsigned long *by = recovered_by[i];
+            log_print(stderr, LOG_INFO,
+                      "Radio %zu on %s: recovered by re-sync %lu, reset %lu, reopen %lu times, down %.1f ms in total, "
+                      "%.1f ms at most",
+                      i, link->device, by[RECOVER_SYNC], by[RECOVER_RESET], by[RECOVER_REOPEN], ns_to_ms(down_ns),
+                      ns_to_ms(max_down_ns));
+        }
+        if (link_header && counters->packets > 0) {
+            log_print(stderr, LOG_INFO, "Radio %zu on %s: link header %.2f bytes per packet, %.1f%% of bytes sent", i,
+                      link->device, (double)link->header_bytes / (double)counters->packets,
+                      (double)link->header_bytes * 100 / (double)counters->bytes);
+        }
+        const struct arq_t *arq = &arqs[i];
+        if (ack_window_ms > 0 && arq->windows > 0) {
+            log_print(stderr, LOG_INFO,
+                      "Radio %zu on %s: %llu receive windows, %.1f ms listening, %llu acknowledgements, %llu packets "
+                      "acknowledged, %llu sent again, %llu given up on",
+                      i, link->device, (unsigned long long)arq->windows, ns_to_ms(arq->listen_ns),
+                      (unsigned long long)arq->acks, (unsigned long long)arq->acked,
+                      (unsigned long long)arq->retransmits, (unsigned long long)arq->abandoned);
+        }
+    }
+}
+
+/**
+ * Prints the state of each radio, the compression and bit-packing ratios, the radio profile, the transmit queue depth,
+ * drop counts and superseded counts by priority and by input queue, the transmission counters, the events logged and a
+ * summary of every stage's latency for every priority that has seen traffic.
+ */
+static void dump_stats(void) {
+    static struct stats_t snapshot;
+    stats_snapshot(stats, &snapshot);
+    dump_links(&snapshot);
+
+    struct pq_stats_t queue_stats;
+    pq_stats(&tx_queue, &queue_stats);
+    if (compress && encoder.bytes_in > 0) {
+        log_print(stderr, LOG_INFO, "Compression: %llu bytes in, %llu bytes out (%.1f%%)",
+                  (unsigned long long)encoder.bytes_in, (unsigned long long)encoder.bytes_out,
+                  (double)encoder.bytes_out * 100 / (double)encoder.bytes_in);
+    }
+    uint64_t records = atomic_load(&packed_records);
+    if (bitpack && records > 0) {
+        uint64_t bytes_in = atomic_load(&packed_bytes_in), bytes_out = atomic_load(&packed_bytes_out);
+        log_print(stderr, LOG_INFO, "Bit-packing: %llu records, %llu bytes in, %llu bytes out (%.1f%%)",
+                  (unsigned long long)records, (unsigned long long)bytes_in, (unsigned long long)bytes_out,
+                  (double)bytes_out * 100 / (double)bytes_in);
+    }
+    if (ladder != NULL) {
+        log_print(stderr, LOG_INFO, "Adaptive data rate: on profile %u of %u, %lu switches", adapt.current, adapt.count,
+                  adapt.switches);
+    }
+    log_print(stderr, LOG_INFO, "Transmit queue high water mark: %zu/%d", queue_stats.high_water, PQ_CAPACITY);
+    if (atomic_load(&events.posted) > 0) {
+        log_print(stderr, LOG_INFO, "Logged %llu events, %llu counted as repeats, %llu dropped",
+                  (unsigned long long)atomic_load(&events.posted), (unsigned long long)atomic_load(&events.suppressed),
+                  (unsigned long long)atomic_load(&events.dropped));
+    }
+    for (size_t i = 0; i < ninputs && ninputs > 1; i++) {
+        log_print(stderr, LOG_INFO,
+                  "Input %s (weight %u): enqueued %llu, dropped %llu, superseded %llu, %llu bytes taken to send",
+                  inputs[i].name, inputs[i].weight, (unsigned long long)queue_stats.source_enqueued[i],
+                  (unsigned long long)queue_stats.source_dropped[i],
+                  (unsigned long long)queue_stats.source_superseded[i],
+                  (unsigned long long)queue_stats.source_bytes[i]);
+    }
+    for (unsigned int p = 0; p < PQ_PRIORITIES; p++) {
+        if (queue_stats.enqueued[p] == 0 && queue_stats.dropped[p] == 0) continue;
+        log_print(stderr, LOG_INFO, "Priority %u: depth %zu, enqueued %llu, dropped %llu, superseded %llu", p,
+                  queue_stats.depth[p], (unsigned long long)queue_stats.enqueued[p],
+                  (unsigned long long)queue_stats.dropped[p], (unsigned long long)queue_stats.superseded[p]);
+    }
+
+    for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+        const struct stats_counters_t *counters = &snapshot.counters[p];
+        if (counters->packets == 0 && counters->failures == 0) continue;
+        log_print(stderr, LOG_INFO, "Sent at priority %u%s: %llu packets, %llu bytes, %llu retries, %llu failures", p,
+                  p == STATS_PRIORITIES - 1 ? "+" : "", (unsigned long long)counters->packets,
+                  (unsigned long long)counters->bytes, (unsigned long long)counters->retries,
+                  (unsigned long long)counters->failures);
+    }
+    for (unsigned int stage = 0; stage < STATS_STAGES; stage++) {
+        for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+            struct stats_summary_t summary;
+            stats_summarize(&snapshot.hist[stage][p], &summary);
+            if (summary.count == 0) continue;
+            log_print(stderr, LOG_INFO,
+                      "Stage %s at priority %u%s: %llu samples, mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, "
+                      "max %.3f ms",
+                      STATS_STAGE_NAMES[stage], p, p == STATS_PRIORITIES - 1 ? "+" : "",
+                      (unsigned long long)summary.count, ns_to_ms(summary.mean_ns), ns_to_ms(summary.p50_ns),
+                      ns_to_ms(summary.p90_ns), ns_to_ms(summary.p99_ns), ns_to_ms(summary.max_ns));
+        }
+    }
+}
+
+/**
+ * Prints the time on air and the maximum packet and byte rates of the configured radio parameters, and of every faster
+ * profile of the adaptive data rate ladder, for a range of payload sizes, taking the duty cycle limit into account.
+ */
+static void print_plan(void) {
+    static const size_t sizes[] = {8, 16, 32, 64, 128, RADIO_MAX_PAYLOAD};
+    uint64_t duty_ppm = pacer.duty_ppm ? pacer.duty_ppm : 1000000;
+
+    for (unsigned int p = 0; p < adapt.count; p++) {
+        const struct lora_params_t *profile = &adapt.profiles[p];
+        if (adapt.count > 1) printf("%sProfile %u: ", p > 0 ? "\n" : "", p);
+        printf("SF%u, %u kHz, CR %s, preamble %u, CRC %s, duty cycle %.4g%%\n", profile->spread_factor,
+               profile->bandwidth, radio_coding_rate_str(profile->coding_rate), profile->preamble_len,
+               profile->cyclic_redundancy ? "on" : "off", (double)duty_ppm / 10000);
+        printf("%8s %14s %12s %12s\n", "payload", "time on air", "packets/s", "bytes/s");
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            uint32_t toa = radio_time_on_air(profile, sizes[i]);
+            double packets = (double)duty_ppm / toa;
+            printf("%8zu %11.3f ms %12.3f %12.1f\n", sizes[i], (double)toa / 1000, packets, packets * sizes[i]);
+        }
+    }
+}
+
+/**
+ * Parses an input message queue given on the command line as its name, optionally followed by a colon and its weight.
+ * @param spec The input queue, which is split in place.
+ * @param input Set up with the queue's name and weight.
+ * @return 0 if the input queue is valid, EINVAL otherwise.
+ */
+static int parse_input(char *spec, struct input_t *input) {
+    input->name = spec;
+    input->weight = 1;
+    char *weight = strrchr(spec, ':');
+    if (weight == NULL) return 0;
+    *weight++ = '\0';
+    char *end;
+    unsigned long value = strtoul(weight, &end, 10);
+    if (*spec == '\0' || *weight == '\0' || *end != '\0' || value == 0 || value > PQ_MAX_WEIGHT) return EINVAL;
+    input->weight = value;
+    return 0;
+}
+
+/**
+ * Parses a recording to write given on the command line as its path, optionally followed by a colon and the number of
+ * entries it holds.
+ * @param spec The recording, which is split in place.
+ * @param entries Set to the number of entries.
+ * @return 0 if the recording is valid, EINVAL otherwise.
+ */
+static int parse_record(char *spec, unsigned long *entries) {
+    *entries = RECORD_DEFAULT_ENTRIES;
+    char *count = strrchr(spec, ':');
+    if (count == NULL) return 0;
+    *count++ = '\0';
+    char *end;
+    unsigned long value = strtoul(count, &end, 10);
+    if (*spec == '\0' || *count == '\0' || *end != '\0' || value == 0 || value > RECORD_MAX_ENTRIES) return EINVAL;
+    *entries = value;
+    return 0;
+}
+
+/**
+ * Parses the time a frame waits for more messages to aggregate given on the command line.
+ * @param linger The time in milliseconds, which may be 0 to send what has arrived straight away.
+ * @param ms Set to the time in milliseconds.
+ * @return 0 if the time is valid, EINVAL otherwise.
+ */
+static int parse_linger(const char *linger, unsigned long *ms) {
+    char *end;
+    unsigned long value = strtoul(linger, &end, 10);
+    if (!isdigit((unsigned char)*linger) || *end != '\0' || value > MAX_LINGER_MS) return EINVAL;
+    *ms = value;
+    return 0;
+}
+
+/**
+ * Parses the length of the receive window for acknowledgements given on the command line.
+ * @param window The window in milliseconds.
+ * @param ms Set to the window in milliseconds.
+ * @return 0 if the window is valid, EINVAL otherwise.
+ */
+static int parse_ack_window(const char *window, unsigned long *ms) {
+    char *end;
+    unsigned long value = strtoul(window, &end, 10);
+    if (*window == '\0' || *end != '\0' || value == 0 || value > MAX_ACK_WINDOW_MS) return EINVAL;
+    *ms = value;
+    return 0;
+}
+
+/**
+ * Parses a recording to replay given on the command line as its path, optionally followed by a colon and the speed to
+ * replay it at, either a factor of the recorded speed or "max" for as fast as possible.
+ * @param spec The recording, which is split in place.
+ * @param speed Set to the speed factor, or 0 for as fast as possible.
+ * @return 0 if the recording is valid, EINVAL otherwise.
+ */
+static int parse_replay(char *spec, double *speed) {
+    *speed = 1;
+    char *factor = strrchr(spec, ':');
+    if (factor == NULL) return 0;
+    *factor++ = '\0';
+    if (!strcmp(factor, "max")) {
+        *speed = 0;
+        return 0;
+    }
+    char *end;
+    double value = strtod(factor, &end);
+    if (*spec == '\0' || *factor == '\0' || *end != '\0' || !(value > 0)) return EINVAL;
+    *speed = value;
+    return 0;
+}
+
+/**
+ * Parses a radio given on the command line as its device name, optionally followed by the frequency, spread factor
+ * and bandwidth it uses instead of the common radio parameters, separated by commas. Empty fields keep the common
+ * parameter.
+ * @param spec The radio, which is split into fields in place.
+ * @param link Set up with the radio's device name and parameters.
+ * @return 0 if the radio is valid, EINVAL otherwise.
+ */
+static int parse_link(char *spec, struct radio_link_t *link) {
+    static int (*const validators[])(const char *, struct lora_params_t *) = {radio_validate_freq, radio_validate_sf,
+                                                                              radio_validate_bw};
+    link->params = radio_parameters;
+    link->device = spec;
+    spec = strchr(spec, ',');
+    for (size_t i = 0; spec != NULL; i++) {
+        *spec++ = '\0';
+        char *field = spec;
+        spec = strchr(spec, ',');
+        if (spec != NULL) *spec = '\0';
+        if (i >= sizeof(validators) / sizeof(validators[0])) return EINVAL;
+        if (*field != '\0' && validators[i](field, &link->params)) return EINVAL;
+    }
+    return 0;
+}
+
+/**
+ * Moves a radio to the requested baud rate and sets its parameters, marking it up if that succeeds.
+ * @param link The radio, which must be open.
+ * @return 0 if the radio was configured, otherwise the error from setting its parameters.
+ */
+static int configure_link(struct radio_link_t *link) {
+    /* Shorten the time each command spends on the wire if a faster link was asked for */
+    if (baud_rate != RADIO_DEFAULT_BAUD) {
+        int err = radio_set_baud(&link->radio, baud_rate);
+        if (err) {
+            log_print(stderr, LOG_WARN, "Could not switch radio on %s to %u baud, staying at %u: %s", link->device,
+                      baud_rate, link->radio.baud, strerror(err));
+        }
+    }
+
+    /* Set radio parameters, skipping any the radio already has from a previous run */
+    uint8_t count = 0;
+    size_t changed = 0;
+    int err;
+    for (; count < RETRY_LIMIT; count++) {
+        err = radio_sync_params(&link->radio, &link->params, &changed);
+        if (!err) break;
+    }
+    if (count == RETRY_LIMIT) {
+        log_print(stderr, LOG_ERROR, "Failed to set radio parameters on %s: %s", link->device, strerror(err));
+        return err;
+    }
+    log_print(stderr, LOG_INFO, "Radio on %s configured in %.1f ms, %zu of %d settings changed", link->device,
+              ms_since_start(), changed, RADIO_SETTINGS);
+    link->up = true;
+    return 0;
+}
+
 int main(int argc, char **argv) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
 
     int c;
-    while ((c = getopt(argc, argv, ":m:f:p:s:r:b:l:cqy:i")) != -1) {
+    bool delta = false, from_stdin = false;
+    unsigned long record_entries = 0;
+    unsigned int fec_k = 0, fec_m = 0, fec_m_top = 0;
+    while ((c = getopt(argc, argv, ":m:f:p:s:r:b:l:cqy:iI:a:d:PB:z:F:A:MQ:S:GKHXR:W:T:N:")) != -1) {
         switch (c) {
         case 'm':
             validate_param(radio_validate_mod, "Invalid modulation type '%s'\n");
@@ -101,6 +1505,104 @@ int main(int argc, char **argv) {
             break;
         case 'i':
             from_q = false;
+            from_stdin = true;
+            break;
+        case 'I':
+            from_q = false;
+            frames_path = optarg;
+            break;
+        case 'a':
+            if (parse_linger(optarg, &linger_ms)) {
+                fprintf(stderr, "Invalid linger time '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            aggregate = true;
+            break;
+        case 'd':
+            duty_cycle = optarg;
+            break;
+        case 'P':
+            plan = true;
+            break;
+        case 'A':
+            ladder = optarg;
+            break;
+        case 'M':
+            mirror = true;
+            break;
+        case 'G':
+            fragment = true;
+            break;
+        case 'K':
+            keyed = true;
+            break;
+        case 'H':
+            link_header = true;
+            break;
+        case 'X':
+            bitpack = true;
+            break;
+        case 'N':
+            if (parse_ack_window(optarg, &ack_window_ms)) {
+                fprintf(stderr, "Invalid acknowledgement window '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            link_header = true; // Acknowledgements refer to frames by their link header sequence numbers
+            break;
+        case 'T':
+            if (rt_parse(optarg, &rt)) {
+                fprintf(stderr, "Invalid real-time priority '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'R':
+            if (parse_replay(optarg, &replay_speed)) {
+                fprintf(stderr, "Invalid recording to replay '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            from_q = false;
+            replay_path = optarg;
+            break;
+        case 'W':
+            if (parse_record(optarg, &record_entries)) {
+                fprintf(stderr, "Invalid recording '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            record_path = optarg;
+            break;
+        case 'Q':
+            if (ninputs == PQ_SOURCES || parse_input(optarg, &inputs[ninputs])) {
+                fprintf(stderr, "Invalid input queue '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            ninputs++;
+            break;
+        case 'S':
+            if (ninputs == PQ_SOURCES || parse_input(optarg, &inputs[ninputs])) {
+                fprintf(stderr, "Invalid input ring '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            inputs[ninputs++].shm = true;
+            break;
+        case 'F':
+            if (fec_validate(optarg, &fec_k, &fec_m, &fec_m_top)) {
+                fprintf(stderr, "Invalid FEC group '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            fec = true;
+            break;
+        case 'z':
+            if (comp_validate_mode(optarg, &delta)) {
+                fprintf(stderr, "Invalid compression mode '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            compress = true;
+            break;
+        case 'B':
+            if (radio_validate_baud(optarg, &baud_rate)) {
+                fprintf(stderr, "Invalid baud rate '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
             break;
         case ':':
             fprintf(stderr, "Option -%c requires an argument.", optopt);
@@ -113,101 +1615,197 @@ int main(int argc, char **argv) {
         }
     }
 
-    /* Positional argument for device descriptor. */
+    comp_encoder_init(&encoder, delta);
+    fec_encoder_init(&fec_encoder, fec_k, fec_m, fec_m_top);
+
+    if (adapt_init(&adapt, &radio_parameters, ladder)) {
+        fprintf(stderr, "Invalid profile ladder '%s'\n", ladder);
+        exit(EXIT_FAILURE);
+    }
+
+    if (pacer_init(&pacer, duty_cycle)) {
+        fprintf(stderr, "Invalid duty cycle '%s'\n", duty_cycle);
+        exit(EXIT_FAILURE);
+    }
+
+    if (plan) {
+        print_plan();
+        exit(EXIT_SUCCESS);
+    }
+
+    /* Positional arguments for the radios' device descriptors, each with optional parameters of its own. */
     if (optind >= argc) {
         fprintf(stderr, "LoRa module device descriptor is required.\n");
         exit(EXIT_FAILURE);
     }
-    serial_port = argv[optind];
-
-    /* Open message queue for input if not reading from stdin. */
-    if (from_q) {
-        input_q = mq_open(IN_QUEUE, O_RDONLY);
-        if (input_q == -1) {
-            log_print(stderr, LOG_ERROR, "Could not open input message queue %s: %s", IN_QUEUE, strerror(errno));
+    if (argc - optind > DISPATCH_MAX_LINKS) {
+        fprintf(stderr, "At most %d radios can be used.\n", DISPATCH_MAX_LINKS);
+        exit(EXIT_FAILURE);
+    }
+    if (ladder != NULL && argc - optind > 1) {
+        fprintf(stderr, "Adaptive data rate can only be used with a single radio.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (delta && (mirror || argc - optind > 1)) {
+        // Delta frames are only decoded in strict sequence, which frames spread across or mirrored on radios break
+        fprintf(stderr, "Delta compression can only be used with a single radio and without mirroring.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (delta && ack_window_ms > 0) {
+        // A frame sent again is delta coded against a frame the receiver has moved past, so it could not be decoded
+        fprintf(stderr, "Delta compression cannot be used with acknowledgements.\n");
+        exit(EXIT_FAILURE);
+    }
+    dispatch_init(&dispatcher, mirror, TOP_PRIORITY);
+    for (int i = optind; i < argc; i++) {
+        struct radio_link_t *link = &dispatcher.links[dispatcher.nlinks];
+        if (parse_link(argv[i], link)) {
+            fprintf(stderr, "Invalid radio '%s'\n", argv[i]);
             exit(EXIT_FAILURE);
         }
+        link->index = dispatcher.nlinks++;
+        link->pacer = pacer;
     }
 
-    /* Open radio for reading and writing. */
-    int radio = open(serial_port, O_RDWR | O_NDELAY | O_NOCTTY);
-    if (radio == -1) {
-        log_print(stderr, LOG_ERROR, "Could not open tty with error %s.", strerror(errno));
+    /* The ladder steps up from the radio's own parameters, which may differ from the common ones */
+    if (ladder != NULL && adapt_init(&adapt, &dispatcher.links[0].params, ladder)) {
+        fprintf(stderr, "Invalid profile ladder '%s' for radio %s\n", ladder, dispatcher.links[0].device);
         exit(EXIT_FAILURE);
     }
 
-    /* Set up device using correct UART settings. */
-    struct termios tty;
-    if (tcgetattr(radio, &tty) != 0) {
-        log_print(stderr, LOG_ERROR, "Failed to get tty attributes with error %s", strerror(errno));
-        close(radio);
+    /* Open the message queues for input if not reading from stdin. */
+    if (!from_q && ninputs > 0) {
+        fprintf(stderr, "Input cannot be read from both stdin and message queues or rings.\n");
         exit(EXIT_FAILURE);
     }
-
-    radio_setup_tty(&tty);
-
-    if (tcsetattr(radio, TCSANOW, &tty) != 0) {
-        log_print(stderr, LOG_ERROR, "Failed to set tty attrs with error %s", strerror(errno));
-        close(radio);
+    if (replay_path != NULL && (from_stdin || frames_path != NULL)) {
+        fprintf(stderr, "Input cannot be both replayed and read from stdin.\n");
         exit(EXIT_FAILURE);
     }
-
-    /* Set radio parameters */
-    uint8_t count = 0;
-    int err;
-    for (; count < RETRY_LIMIT; count++) {
-        err = radio_set_params(radio, &radio_parameters);
-        if (!err) break;
+    if (from_q && ninputs == 0) {
+        inputs[ninputs++] = (struct input_t){.name = IN_QUEUE, .weight = 1};
     }
-    if (count == RETRY_LIMIT) {
-        close(radio);
-        log_print(stderr, LOG_ERROR, "Failed to set radio parameters: %s", strerror(err));
+    if (frames_path != NULL) {
+        int fd = strcmp(frames_path, "-") ? open(frames_path, O_RDONLY) : STDIN_FILENO;
+        int err = fd == -1 ? errno : reader_open(&frame_reader, fd);
+        if (err) {
+            log_print(stderr, LOG_ERROR, "Could not read input frames from %s: %s", frames_path, strerror(err));
+            exit(EXIT_FAILURE);
+        }
     }
-
-    /* Read input stream data line by line. */
-    unsigned int priority = 0;
-    while (1) {
-
-        uint8_t transmission_tries = 0;
-
-        if (from_q) {
-
-            size_t nbytes;
-            nbytes = mq_receive(input_q, buffer, BUFFER_SIZE, &priority);
-            if (nbytes == (size_t)-1) {
-                log_print(stderr, LOG_ERROR, "Failed to read from queue: %s", strerror(errno));
-                // Don't quit, just continue
-                continue;
+    if (replay_path != NULL) {
+        int err = record_load(&replay, replay_path);
+        if (err) {
+            log_print(stderr, LOG_ERROR, "Could not replay recording %s: %s", replay_path, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (record_path != NULL) {
+        int err = record_open(&recorder, record_path, record_entries);
+        if (err) {
+            log_print(stderr, LOG_ERROR, "Could not record to %s: %s", record_path, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < ninputs; i++) {
+        if (inputs[i].shm) {
+            int err = ring_open(&inputs[i].ring, inputs[i].name);
+            if (err) {
+                log_print(stderr, LOG_ERROR, "Could not open input ring %s: %s", inputs[i].name, strerror(err));
+                exit(EXIT_FAILURE);
             }
+            continue;
+        }
+        inputs[i].q = mq_open(inputs[i].name, O_RDONLY);
+        if (inputs[i].q == -1) {
+            log_print(stderr, LOG_ERROR, "Could not open input message queue %s: %s", inputs[i].name,
+                      strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    atomic_init(&open_inputs, ninputs);
 
-            unsigned int retry_limit = priority >= TOP_PRIORITY ? TOP_PRIOR_RETRY_LIMIT : RETRY_LIMIT;
-            for (; transmission_tries < retry_limit; transmission_tries++) {
-                err = radio_tx_bytes(radio, (uint8_t *)buffer, nbytes);
-                if (!err) break;
-            }
+    /* A radio that cannot be configured starts down and is recovered by its thread, as long as one other can be. */
+    size_t configured = 0;
+    for (size_t i = 0; i < dispatcher.nlinks; i++) {
+        open_link(&dispatcher.links[i]);
+        if (configure_link(&dispatcher.links[i]) == 0) configured++;
+    }
+    if (configured == 0) {
+        for (size_t i = 0; i < dispatcher.nlinks; i++) close(dispatcher.links[i].radio.fd);
+        exit(EXIT_FAILURE);
+    }
 
-            if (transmission_tries >= retry_limit) {
-                log_print(stderr, LOG_ERROR, "Failed to transmit after %u tries: %s", transmission_tries,
-                          strerror(err));
-            }
+    /* Publish statistics for other processes to read, or keep them to ourselves if that is not possible. */
+    stats = stats_open(STATS_SHM_NAME);
+    if (stats == NULL) {
+        log_print(stderr, LOG_WARN, "Could not publish statistics in shared memory %s: %s", STATS_SHM_NAME,
+                  strerror(errno));
+        stats = &local_stats;
+    }
 
-        } else {
+    /* Signals are handled by the main thread only, so block them before any other thread starts. */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
 
-            // End of input stream triggers program exit
-            if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) break;
+    /* Decouple reading input from transmitting, so the input queue keeps draining while the radio is busy. */
+    int err = pq_init(&tx_queue, TOP_PRIORITY);
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not create transmit queue: %s", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < ninputs; i++) pq_set_weight(&tx_queue, i, inputs[i].weight);
 
-            for (; transmission_tries < RETRY_LIMIT; transmission_tries++) {
-                err = radio_tx(radio, buffer);
-                if (!err) break;
-            }
-        }
+    // Started before real-time mode, so that writing events never competes with sending packets
+    err = evlog_start(&events, stderr, describe_event);
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not start event log: %s", strerror(err));
+        exit(EXIT_FAILURE);
+    }
 
-        // If transmission fails just log and continue
-        if (transmission_tries >= RETRY_LIMIT) {
-            log_print(stderr, LOG_ERROR, "Failed to transmit after %u tries: %s", transmission_tries, strerror(err));
+    // Everything is allocated by now, so locking memory faults in every buffer the transmit path will use
+    static pthread_attr_t rt_attr;
+    pthread_attr_t *attr = NULL;
+    if (rt.enabled) {
+        err = rt_enter(&rt, &rt_attr);
+        if (err) {
+            log_print(stderr, LOG_ERROR, "Could not enter real-time mode: %s", strerror(err));
+            exit(EXIT_FAILURE);
         }
+        attr = &rt_attr;
+    }
+
+    pthread_t ingest, transmit;
+    for (size_t i = 0; i < dispatcher.nlinks && !err; i++) {
+        err = pthread_create(&dispatcher.links[i].thread, attr, radio_thread, &dispatcher.links[i]);
+    }
+    if (!err) err = pthread_create(&transmit, attr, transmit_thread, NULL);
+    if (!err && !from_q) {
+        void *(*reader)(void *) = replay_path ? replay_thread : frames_path ? frames_thread : ingest_thread;
+        err = pthread_create(&ingest, attr, reader, NULL);
+    }
+    for (size_t i = 0; i < ninputs && !err; i++) {
+        err = pthread_create(&inputs[i].thread, attr, inputs[i].shm ? ring_thread : ingest_thread, &inputs[i]);
+    }
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not start threads: %s", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    /* SIGUSR1 dumps statistics, anything else exits. */
+    int sig;
+    while (sigwait(&signals, &sig) == 0 && sig == SIGUSR1) {
+        dump_stats();
     }
+    evlog_stop(&events);
+    dump_stats();
 
-    close(radio);
+    if (stats != &local_stats) stats_close(stats, STATS_SHM_NAME);
+    if (record_path != NULL) record_flush(&recorder);
+    for (size_t i = 0; i < dispatcher.nlinks; i++) close(dispatcher.links[i].radio.fd);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,62 @@
+/**
+ * @file pacer.c
+ * @brief Implementation of duty cycle pacing for transmissions.
+ *
+ * After a transmission with time on air T at duty cycle D, the next transmission may start T / D after this one
+ * started. Transmissions are recorded when the radio reports that they have ended, so the radio must stay quiet for
+ * T / D - T from then.
+ */
+#include "pacer.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Parts per million in one percent. */
+#define PPM_PER_PERCENT 10000
+
+/**
+ * Initializes a pacer from a command line duty cycle.
+ * @param pacer The pacer to initialize.
+ * @param duty The duty cycle as a percentage, for example "1" or "0.1". NULL disables pacing.
+ * @return 0 if valid, EINVAL if invalid.
+ */
+int pacer_init(struct pacer_t *pacer, const char *duty) {
+    memset(pacer, 0, sizeof(*pacer));
+    if (duty == NULL) return 0;
+
+    char *end;
+    double percent = strtod(duty, &end);
+    if (duty == end || *end != '\0' || !(percent > 0) || percent > 100) return EINVAL;
+
+    pacer->duty_ppm = percent * PPM_PER_PERCENT;
+    if (pacer->duty_ppm == 0) return EINVAL;
+    return 0;
+}
+
+/**
+ * Blocks until the next transmission is allowed to start.
+ * @param pacer The pacer.
+ */
+void pacer_wait(const struct pacer_t *pacer) {
+    if (pacer->duty_ppm == 0) return;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &pacer->next, NULL) == EINTR)
+        ;
+}
+
+/**
+ * Records a transmission that has just ended, delaying the next one as the duty cycle requires.
+ * @param pacer The pacer.
+ * @param time_on_air_us The time on air of the transmission in microseconds.
+ */
+void pacer_record(struct pacer_t *pacer, uint32_t time_on_air_us) {
+    if (pacer->duty_ppm == 0) return;
+
+    uint64_t period_ns = (uint64_t)time_on_air_us * 1000 * (100 * PPM_PER_PERCENT - pacer->duty_ppm) / pacer->duty_ppm;
+    clock_gettime(CLOCK_MONOTONIC, &pacer->next);
+    pacer->next.tv_sec += period_ns / 1000000000;
+    pacer->next.tv_nsec += period_ns % 1000000000;
+    if (pacer->next.tv_nsec >= 1000000000) {
+        pacer->next.tv_sec++;
+        pacer->next.tv_nsec -= 1000000000;
+    }
+}
@@ -0,0 +1,413 @@
+/**
+ * @file pqueue.c
+ * @brief Implementation of the bounded priority buffer between input and radio transmission.
+ *
+ * Each priority level is a list threaded through the fixed slot array in the order packets arrived, with unused slots
+ * kept on a free list. The highest priority packet is always removed first, and among packets of equal priority the one
+ * with the earliest virtual finish tag, so a single source's packets still leave in the order they arrived.
+ *
+ * Tags follow self-clocked fair queuing: a packet finishes `len * PQ_MAX_WEIGHT / weight` after the later of its
+ * source's previous packet and the tag of the packet last removed, which stands in for the virtual time. A source that
+ * has been idle therefore starts level with the others instead of with credit it saved up. When a packet is dropped,
+ * its cost is refunded to the packets its source queued after it, so a source is never charged for what it did not
+ * send. A keyed packet that replaces an older one takes over its slot and tag, and only the difference in length is
+ * charged, the same way.
+ */
+#include "pqueue.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Clamps a priority to the levels the buffer tracks.
+ * @param priority The priority of a packet.
+ * @return The priority level it is queued at.
+ */
+static unsigned int clamp_priority(unsigned int priority) {
+    return priority < PQ_PRIORITIES ? priority : PQ_PRIORITIES - 1;
+}
+
+/**
+ * Clamps a source to the sources the buffer tracks.
+ * @param source The input source of a packet.
+ * @return The source it is scheduled as.
+ */
+static unsigned int clamp_source(unsigned int source) { return source < PQ_SOURCES ? source : PQ_SOURCES - 1; }
+
+/**
+ * Calculates what a source is charged in virtual time for sending a packet.
+ * @param q The priority buffer.
+ * @param source The source.
+ * @param len The length of the packet in bytes.
+ * @return The cost of the packet.
+ */
+static uint64_t cost_of(const struct pqueue_t *q, unsigned int source, size_t len) {
+    return (uint64_t)len * PQ_MAX_WEIGHT / q->weight[source];
+}
+
+/**
+ * Changes what a source is charged for a queued packet, moving the tags of the packets it queued after that one and
+ * its finish time by the same amount. The caller must hold the lock.
+ * @param q The priority buffer.
+ * @param slot The slot the packet occupies.
+ * @param cost The change in the packet's cost, which is negative for a refund.
+ */
+static void recharge(struct pqueue_t *q, int slot, int64_t cost) {
+    unsigned int source = q->slots[slot].source;
+    for (unsigned int p = 0; p < PQ_PRIORITIES; p++) {
+        for (int i = q->head[p]; i != -1; i = q->next[i]) {
+            if (q->slots[i].source == source && q->tag[i] > q->tag[slot]) q->tag[i] += cost;
+        }
+    }
+    q->finish[source] += cost;
+}
+
+/**
+ * Removes a packet from a priority level and returns its slot to the free list. The caller must hold the lock.
+ * @param q The priority buffer.
+ * @param priority The priority level to remove from.
+ * @param prev The slot before the packet in the level's list, or -1 if it is the oldest.
+ * @param slot The slot the packet occupies.
+ */
+static void unlink_slot(struct pqueue_t *q, unsigned int priority, int prev, int slot) {
+    if (prev == -1) q->head[priority] = q->next[slot];
+    else q->next[prev] = q->next[slot];
+    if (q->tail[priority] == slot) q->tail[priority] = prev;
+    q->next[slot] = q->free;
+    q->free = slot;
+    q->count--;
+    q->stats.depth[priority]--;
+}
+
+/**
+ * Finds the oldest packet of a source at a priority level. The caller must hold the lock.
+ * @param q The priority buffer.
+ * @param priority The priority level.
+ * @param source The source, which must have a packet at the level.
+ * @param prev Set to the slot before the packet in the level's list, or -1 if it is the oldest.
+ * @return The slot the packet occupies.
+ */
+static int oldest_of(const struct pqueue_t *q, unsigned int priority, unsigned int source, int *prev) {
+    *prev = -1;
+    int slot = q->head[priority];
+    while (q->slots[slot].source != source) {
+        *prev = slot;
+        slot = q->next[slot];
+    }
+    return slot;
+}
+
+/**
+ * Drops the oldest packet of the source with the most bytes queued at a priority level for its weight. The caller must
+ * hold the lock and ensure the level is not empty.
+ * @param q The priority buffer.
+ * @param priority The priority level to drop from.
+ */
+static void drop_from(struct pqueue_t *q, unsigned int priority) {
+    uint64_t backlog[PQ_SOURCES] = {0};
+    for (int slot = q->head[priority]; slot != -1; slot = q->next[slot]) {
+        backlog[q->slots[slot].source] += q->slots[slot].len;
+    }
+    unsigned int source = 0;
+    for (unsigned int s = 1; s < PQ_SOURCES; s++) {
+        if (backlog[s] * q->weight[source] > backlog[source] * q->weight[s]) source = s;
+    }
+
+    int prev;
+    int slot = oldest_of(q, priority, source, &prev);
+    recharge(q, slot, -(int64_t)cost_of(q, source, q->slots[slot].len));
+    unlink_slot(q, priority, prev, slot);
+    q->stats.dropped[priority]++;
+    q->stats.source_dropped[source]++;
+}
+
+/**
+ * Finds the queued packet of a source with a key. The caller must hold the lock.
+ * @param q The priority buffer.
+ * @param source The source.
+ * @param key The key.
+ * @param priority Set to the priority level of the packet.
+ * @param prev Set to the slot before the packet in the level's list, or -1 if it is the oldest.
+ * @return The slot the packet occupies, or -1 if there is none.
+ */
+static int find_key(const struct pqueue_t *q, unsigned int source, int key, unsigned int *priority, int *prev) {
+    for (unsigned int p = 0; p < PQ_PRIORITIES; p++) {
+        *prev = -1;
+        for (int slot = q->head[p]; slot != -1; *prev = slot, slot = q->next[slot]) {
+            if (q->key[slot] == key && q->slots[slot].source == source) {
+                *priority = p;
+                return slot;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * Makes room in a full buffer for a packet by dropping a packet of the lowest queued priority, if that priority is
+ * droppable and not above the incoming packet's. The caller must hold the lock.
+ * @param q The priority buffer.
+ * @param priority The priority level of the incoming packet.
+ * @return 0 if a slot was freed, EAGAIN if the incoming packet should be dropped instead, or EBUSY if nothing may be
+ * dropped and the caller must wait.
+ */
+static int make_room(struct pqueue_t *q, unsigned int priority) {
+    for (unsigned int p = 0; p < PQ_PRIORITIES && p < q->top_priority; p++) {
+        if (q->head[p] == -1) continue;
+        if (p > priority) return EAGAIN;
+        drop_from(q, p);
+        return 0;
+    }
+    return priority < q->top_priority ? EAGAIN : EBUSY;
+}
+
+/**
+ * Initializes an empty priority buffer.
+ * @param q The priority buffer to initialize.
+ * @param top_priority Packets at or above this priority are never dropped.
+ * @return 0 if successful, otherwise the error that occurred.
+ */
+int pq_init(struct pqueue_t *q, unsigned int top_priority) {
+    memset(q, 0, sizeof(*q));
+    q->top_priority = top_priority;
+    q->free = 0;
+    for (int i = 0; i < PQ_CAPACITY; i++) q->next[i] = i + 1 < PQ_CAPACITY ? i + 1 : -1;
+    for (int p = 0; p < PQ_PRIORITIES; p++) q->head[p] = q->tail[p] = -1;
+    for (int s = 0; s < PQ_SOURCES; s++) q->weight[s] = 1;
+
+    int err = pthread_mutex_init(&q->lock, NULL);
+    if (err) return err;
+
+    /* Timed waits are measured against the monotonic clock so that wall clock changes cannot stretch them. */
+    pthread_condattr_t attr;
+    err = pthread_condattr_init(&attr);
+    if (err) return err;
+    err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (!err) err = pthread_cond_init(&q->not_empty, &attr);
+    if (!err) err = pthread_cond_init(&q->not_full, &attr);
+    pthread_condattr_destroy(&attr);
+    return err;
+}
+
+/**
+ * Sets the share of transmission an input source is entitled to. Every source starts with a weight of 1.
+ * @param q The priority buffer.
+ * @param source The input source.
+ * @param weight The weight, from 1 to `PQ_MAX_WEIGHT`.
+ * @return 0 if successful, EINVAL if the source or weight is out of range.
+ */
+int pq_set_weight(struct pqueue_t *q, unsigned int source, unsigned int weight) {
+    if (source >= PQ_SOURCES || weight == 0 || weight > PQ_MAX_WEIGHT) return EINVAL;
+    pthread_mutex_lock(&q->lock);
+    q->weight[source] = weight;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+/**
+ * Adds a packet to the buffer, dropping lower priority data if the buffer is full. Only blocks when the buffer is full
+ * of packets that may not be dropped and the new packet may not be dropped either.
+ * @param q The priority buffer.
+ * @param data The packet contents.
+ * @param len The number of bytes in the packet.
+ * @param priority The priority of the packet.
+ * @param source The input source the packet came from. Sources past the last tracked are scheduled as it.
+ * @return 0 if the packet was queued, EAGAIN if it was dropped due to overload, EMSGSIZE if it is too long or EPIPE if
+ * the buffer has been closed.
+ */
+int pq_push(struct pqueue_t *q, const uint8_t *data, size_t len, unsigned int priority, unsigned int source) {
+    return pq_push_keyed(q, data, len, priority, source, PQ_NO_KEY);
+}
+
+/**
+ * Adds a packet of a stream to the buffer, replacing the packet of the same key and source that is already queued. At
+ * the same priority the packet takes the older one's place, otherwise the older one is removed and the packet is queued
+ * as usual, dropping lower priority data if the buffer is full.
+ * @param q The priority buffer.
+ * @param data The packet contents.
+ * @param len The number of bytes in the packet.
+ * @param priority The priority of the packet.
+ * @param source The input source the packet came from. Sources past the last tracked are scheduled as it.
+ * @param key The stream the packet belongs to, or `PQ_NO_KEY` if it should never be replaced.
+ * @return 0 if the packet was queued, EAGAIN if it was dropped due to overload, EMSGSIZE if it is too long or EPIPE if
+ * the buffer has been closed.
+ */
+int pq_push_keyed(struct pqueue_t *q, const uint8_t *data, size_t len, unsigned int priority, unsigned int source,
+                  int key) {
+    if (len > PQ_PACKET_MAX) return EMSGSIZE;
+    unsigned int level = clamp_priority(priority);
+    source = clamp_source(source);
+
+    pthread_mutex_lock(&q->lock);
+    unsigned int old_level;
+    int prev, slot = key == PQ_NO_KEY || q->closed ? -1 : find_key(q, source, key, &old_level, &prev);
+    if (slot != -1) {
+        q->stats.superseded[old_level]++;
+        q->stats.source_superseded[source]++;
+        int64_t cost = (int64_t)cost_of(q, source, len) - (int64_t)cost_of(q, source, q->slots[slot].len);
+        if (old_level == level) {
+            recharge(q, slot, cost);
+            q->tag[slot] += cost;
+            q->slots[slot].priority = priority;
+            q->slots[slot].len = len;
+            clock_gettime(CLOCK_MONOTONIC, &q->slots[slot].queued);
+            memcpy(q->slots[slot].data, data, len);
+            q->stats.enqueued[level]++;
+            q->stats.source_enqueued[source]++;
+            pthread_mutex_unlock(&q->lock);
+            return 0;
+        }
+        recharge(q, slot, -(int64_t)cost_of(q, source, q->slots[slot].len));
+        unlink_slot(q, old_level, prev, slot);
+    }
+
+    while (q->count == PQ_CAPACITY && !q->closed) {
+        int err = make_room(q, level);
+        if (err == EAGAIN) {
+            q->stats.dropped[level]++;
+            q->stats.source_dropped[source]++;
+            pthread_mutex_unlock(&q->lock);
+            return EAGAIN;
+        }
+        if (err == EBUSY) pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return EPIPE;
+    }
+
+    slot = q->free;
+    q->free = q->next[slot];
+    q->next[slot] = -1;
+    q->slots[slot].priority = priority;
+    q->slots[slot].source = source;
+    q->slots[slot].len = len;
+    q->key[slot] = key;
+    uint64_t start = q->finish[source] > q->virtual_time ? q->finish[source] : q->virtual_time;
+    q->tag[slot] = q->finish[source] = start + cost_of(q, source, len);
+    clock_gettime(CLOCK_MONOTONIC, &q->slots[slot].queued);
+    memcpy(q->slots[slot].data, data, len);
+
+    if (q->tail[level] == -1) q->head[level] = slot;
+    else q->next[q->tail[level]] = slot;
+    q->tail[level] = slot;
+
+    q->count++;
+    q->stats.depth[level]++;
+    q->stats.enqueued[level]++;
+    q->stats.source_enqueued[source]++;
+    if (q->count > q->stats.high_water) q->stats.high_water = q->count;
+
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+/**
+ * Removes the next packet of the highest queued priority, blocking until one is available.
+ * @param q The priority buffer.
+ * @param packet Where to copy the packet.
+ * @return 0 if a packet was removed, or EPIPE if the buffer has been closed and is empty.
+ */
+int pq_pop(struct pqueue_t *q, struct packet_t *packet) { return pq_pop_timed(q, packet, PQ_PACKET_MAX, NULL); }
+
+/**
+ * Removes the packet of the highest queued priority with the earliest tag if it is no longer than a limit, blocking
+ * until one is available or a deadline passes.
+ * @param q The priority buffer.
+ * @param packet Where to copy the packet.
+ * @param max_len The longest packet the caller can accept. A longer packet is left in the buffer.
+ * @param deadline The CLOCK_MONOTONIC time to stop waiting at, or NULL to wait indefinitely.
+ * @return 0 if a packet was removed, ETIMEDOUT if the deadline passed, EMSGSIZE if the next packet is longer than
+ * `max_len`, or EPIPE if the buffer has been closed and is empty.
+ */
+int pq_pop_timed(struct pqueue_t *q, struct packet_t *packet, size_t max_len, const struct timespec *deadline) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        if (deadline == NULL) {
+            pthread_cond_wait(&q->not_empty, &q->lock);
+        } else if (pthread_cond_timedwait(&q->not_empty, &q->lock, deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&q->lock);
+            return ETIMEDOUT;
+        }
+    }
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return EPIPE;
+    }
+
+    unsigned int p = PQ_PRIORITIES;
+    while (q->head[--p] == -1)
+        ;
+    int prev = -1, slot = q->head[p];
+    for (int before = slot, next = q->next[slot]; next != -1; before = next, next = q->next[next]) {
+        if (q->tag[next] < q->tag[slot]) {
+            prev = before;
+            slot = next;
+        }
+    }
+    if (q->slots[slot].len > max_len) {
+        pthread_mutex_unlock(&q->lock);
+        return EMSGSIZE;
+    }
+
+    unlink_slot(q, p, prev, slot);
+    if (q->tag[slot] > q->virtual_time) q->virtual_time = q->tag[slot];
+    q->stats.source_bytes[q->slots[slot].source] += q->slots[slot].len;
+    packet->priority = q->slots[slot].priority;
+    packet->source = q->slots[slot].source;
+    packet->len = q->slots[slot].len;
+    packet->queued = q->slots[slot].queued;
+    memcpy(packet->data, q->slots[slot].data, packet->len);
+
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+/**
+ * Marks the buffer as closed. Queued packets can still be removed, after which `pq_pop` stops blocking.
+ * @param q The priority buffer.
+ */
+void pq_close(struct pqueue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Takes a consistent snapshot of the buffer's counters.
+ * @param q The priority buffer.
+ * @param stats Where to copy the counters.
+ */
+void pq_stats(struct pqueue_t *q, struct pq_stats_t *stats) {
+    pthread_mutex_lock(&q->lock);
+    *stats = q->stats;
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Measures how far behind transmission is.
+ * @param q The priority buffer.
+ * @param oldest Set to when the longest waiting packet was queued, on the monotonic clock. Left unchanged if the buffer
+ * is empty.
+ * @return The number of queued packets.
+ */
+size_t pq_backlog(struct pqueue_t *q, struct timespec *oldest) {
+    pthread_mutex_lock(&q->lock);
+    const struct timespec *first = NULL;
+    for (unsigned int p = 0; p < PQ_PRIORITIES; p++) {
+        if (q->head[p] == -1) continue;
+        const struct timespec *queued = &q->slots[q->head[p]].queued;
+        if (first == NULL || queued->tv_sec < first->tv_sec ||
+            (queued->tv_sec == first->tv_sec && queued->tv_nsec < first->tv_nsec)) {
+            first = queued;
+        }
+    }
+    if (first != NULL) *oldest = *first;
+    size_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
@@ -9,16 +9,33 @@
  * and validating them.
  */
 #include "radio.h"
-#include <devctl.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <ioctl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __QNX__
+#include <devctl.h>
+#include <ioctl.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/** QNX's success error code, which other POSIX systems do not define. */
+#ifndef EOK
+#define EOK 0
+#endif
+
 /** Macro to calculate compile time array length. */
 #define array_len(a) (sizeof(a) / sizeof(a[0]))
 
@@ -58,6 +75,46 @@ static const uint8_t H_SF = 12;
 /** Valid bandwidth choices. */
 static const uint16_t BANDWIDTHS[] = {125, 250, 500};
 
+/** The baud rates the RN2483 can be switched to with auto-baud detection, and their termios speeds. */
+static const struct {
+    unsigned int baud;
+    speed_t speed;
+} BAUD_RATES[] = {
+    {57600, B57600},
+    {115200, B115200},
+#ifdef B230400
+    {230400, B230400},
+#endif
+};
+
+/** Symbol time in nanoseconds above which the RN2483 enables low data rate optimization. */
+static const uint64_t LDRO_SYMBOL_NS = 16000000;
+
+/** The RN2483's default FSK bit rate, which broadcaster does not change. */
+static const uint32_t FSK_BITRATE = 50000;
+
+#if (defined(__aarch64__) && defined(__ARM_NEON)) || defined(__SSSE3__)
+/** Hexadecimal digits, indexed by nibble value, as a vector lookup table. */
+static const char HEX_DIGITS[16] = "0123456789abcdef";
+#endif
+
+/** The two hexadecimal digits of every byte value, so that each byte is encoded with a single lookup. */
+static const char HEX_PAIRS[512] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/** The prefix of a transmit command. */
+static const char TX_PREFIX[] = "radio tx ";
+
+/** The prefix of the response carrying a packet received in a receive window. */
+static const char RX_PREFIX[] = "radio_rx";
+
 /**
  * Validates and sets a command line argument for modulation.
  * @param mod The command line argument for modulation.
@@ -85,7 +142,7 @@ int radio_validate_freq(const char *freq, struct lora_params_t *params) {
     uint32_t p_freq = strtoul(freq, &end, 10);
     if (errno || freq == end) return EINVAL;
 
-    if (!(LL_FREQ <= p_freq && p_freq <= LH_FREQ) && !(HL_FREQ <= p_freq && p_freq <= HH_FREQ)) return false;
+    if (!(LL_FREQ <= p_freq && p_freq <= LH_FREQ) && !(HL_FREQ <= p_freq && p_freq <= HH_FREQ)) return EINVAL;
 
     params->frequency = p_freq;
     return 0;
@@ -164,16 +221,16 @@ int radio_validate_prlen(const char *prlen, struct lora_params_t *params) {
 int radio_validate_bw(const char *bandwidth, struct lora_params_t *params) {
     char *end;
     uint16_t bw_p = strtoul(bandwidth, &end, 10);
-    if (errno || bandwidth == end) return false; // Call failed
+    if (errno || bandwidth == end) return EINVAL; // Call failed
 
     // Check if it's an option
     for (uint8_t i = 0; i < array_len(BANDWIDTHS); i++) {
         if (bw_p == BANDWIDTHS[i]) {
             params->bandwidth = bw_p;
-            return EINVAL;
+            return 0;
         }
     }
-    return 0;
+    return EINVAL;
 }
 
 /**
@@ -191,161 +248,701 @@ int radio_validate_sync(const char *sync, struct lora_params_t *params) {
 }
 
 /**
- * Sets the required parameters for UART communication to work with the LoRa module.
+ * Validates a UART baud rate argument for the link to the radio.
+ * @param baud The baud rate argument.
+ * @param rate Where to store the baud rate if it is valid.
+ * @return 0 if valid, EINVAL if the rate is not one the radio and tty can both be switched to.
+ */
+int radio_validate_baud(const char *baud, unsigned int *rate) {
+    char *end;
+    unsigned long baud_p = strtoul(baud, &end, 10);
+    if (baud == end || *end != '\0') return EINVAL;
+    for (size_t i = 0; i < array_len(BAUD_RATES); i++) {
+        if (BAUD_RATES[i].baud == baud_p) {
+            *rate = baud_p;
+            return 0;
+        }
+    }
+    return EINVAL;
+}
+
+/**
+ * Gets the string representation of a coding rate.
+ * @param coding_rate The coding rate.
+ * @return The coding rate as it is written on the command line and to the radio, such as "4/7".
+ */
+const char *radio_coding_rate_str(CodingRate coding_rate) { return CODING_RATES[coding_rate]; }
+
+/**
+ * Calculates how long a packet occupies the air, using the LoRa formula from Semtech application note AN1200.13. The
+ * RN2483 always sends an explicit header, and enables low data rate optimization whenever a symbol lasts longer than
+ * 16ms. FSK packets are estimated as preamble, three sync bytes, a length byte, the payload and a CRC at 50kbps.
+ * @param params The radio parameters the packet is transmitted with.
+ * @param payload_len The length of the payload in bytes.
+ * @return The time on air in microseconds.
+ */
+uint32_t radio_time_on_air(const struct lora_params_t *params, size_t payload_len) {
+    if (params->modulation == FSK) {
+        uint64_t bits = 8 * ((uint64_t)params->preamble_len + 3 + 1 + payload_len + (params->cyclic_redundancy ? 2 : 0));
+        return bits * 1000000 / FSK_BITRATE;
+    }
+
+    uint64_t tsym = ((uint64_t)1 << params->spread_factor) * 1000000 / params->bandwidth;
+    int64_t ldro = tsym > LDRO_SYMBOL_NS;
+    int64_t num = 8 * (int64_t)payload_len - 4 * params->spread_factor + 28 + (params->cyclic_redundancy ? 16 : 0);
+    int64_t den = 4 * (params->spread_factor - 2 * ldro);
+    uint64_t symbols = num > 0 ? (num + den - 1) / den * (params->coding_rate + 5) : 0;
+
+    /* The preamble is followed by 4.25 symbols of sync word and start frame delimiter. */
+    uint64_t ns = (4 * (uint64_t)params->preamble_len + 17) * tsym / 4 + (8 + symbols) * tsym;
+    return ns / 1000;
+}
+
+/**
+ * Calculates how long a `radio tx` command spends crossing the UART before the radio can start transmitting it.
+ * @param baud The UART baud rate.
+ * @param payload_len The length of the payload in bytes.
+ * @return The wire time in microseconds, with every character framed by a start and stop bit.
+ */
+uint32_t radio_wire_time(unsigned int baud, size_t payload_len) {
+    uint64_t chars = sizeof(TX_PREFIX) - 1 + 2 * payload_len + 2;
+    return chars * 10 * 1000000 / baud;
+}
+
+/**
+ * Converts the length of a receive window to the size `radio rx` takes, which is a number of symbols with LoRa
+ * modulation and a number of milliseconds with FSK. A window is at least one unit long.
+ * @param params The radio parameters the window is opened with.
+ * @param window_us The length of the window in microseconds.
+ * @return The window size, at most 65535.
+ */
+uint16_t radio_rx_window(const struct lora_params_t *params, uint32_t window_us) {
+    uint64_t size;
+    if (params->modulation == FSK) {
+        size = ((uint64_t)window_us + 999) / 1000;
+    } else {
+        uint64_t tsym = ((uint64_t)1 << params->spread_factor) * 1000000 / params->bandwidth;
+        size = ((uint64_t)window_us * 1000 + tsym - 1) / tsym;
+    }
+    if (size == 0) size = 1;
+    return size > UINT16_MAX ? UINT16_MAX : (uint16_t)size;
+}
+
+/**
+ * Sets the required parameters for UART communication to work with the LoRa module. The line is put in raw mode, since
+ * responses are split into lines by `radio_read_line` rather than by the terminal driver.
  * @param tty The termios tty struct containing information about the tty params.
  */
 void radio_setup_tty(struct termios *tty) {
-    cfsetispeed(tty, B57600);         // Set in speed to 57600bps
-    cfsetospeed(tty, B57600);         // Set in speed to 57600bps
-    tty->c_cc[VMIN] = 0;              // No minimum amount of bytes to read
-    tty->c_cc[VTIME] = 5;             // 0.5s before read times out
-    tty->c_lflag &= ~(ECHO | ECHONL); // No echo
-    tty->c_cflag &= ~PARENB;          // No parity
-    tty->c_cflag &= ~CSTOPB;          // Only one stop bit
+    cfsetispeed(tty, B57600);                          // Set in speed to 57600bps
+    cfsetospeed(tty, B57600);                          // Set in speed to 57600bps
+    tty->c_cc[VMIN] = 0;                               // No minimum amount of bytes to read
+    tty->c_cc[VTIME] = 0;                              // Reads never block, poll() waits for data instead
+    tty->c_lflag &= ~(ICANON | ECHO | ECHONL | ISIG);  // Raw input with no echo
+    tty->c_iflag &= ~(ICRNL | INLCR | IGNCR | IXON);   // No translation of line endings or flow control characters
+    tty->c_oflag &= ~OPOST;                            // Commands are written exactly as given
+    tty->c_cflag &= ~PARENB;                           // No parity
+    tty->c_cflag &= ~CSTOPB;                           // Only one stop bit
+}
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in microseconds.
+ */
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Gets the current monotonic time at full resolution, for timing the stages of a transmission.
+ * @return The current monotonic time in nanoseconds.
+ */
+int64_t radio_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
 /**
- * Set parameters on the LoRa radio.
+ * Prepares the connection state for a LoRa radio whose tty has already been opened and set up.
+ * @param radio The connection state to initialize.
  * @param radio_fd The file descriptor to the LoRa radio device.
- * @param params A pointer to the struct of LoRa radio parameters to be set.
- * @return 0 if successful, otherwise the type of error that occurred.
+ * @param params The radio parameters the module is (or will be) configured with, used to predict time on air.
  */
-int radio_set_params(int radio_fd, const struct lora_params_t *params) {
+void radio_init(struct radio_t *radio, int radio_fd, const struct lora_params_t *params) {
+    memset(radio, 0, sizeof(*radio));
+    radio->fd = radio_fd;
+    radio->baud = RADIO_DEFAULT_BAUD;
+    radio->params = params;
+    radio->state = RADIO_IDLE;
+}
 
-    int err;
+/**
+ * Reads the next non-empty line sent by the LoRa radio, waiting until it arrives or a deadline passes. Lines may arrive
+ * split across several reads or several to a read; any bytes after the returned line are kept for the next call.
+ * @param radio The connection state of the LoRa radio.
+ * @param line The buffer to copy the line into, without its line terminator. Long lines are truncated.
+ * @param len The size of the line buffer.
+ * @param deadline The monotonic time in microseconds to give up at.
+ * @return 0 if a line was read, ETIMEDOUT if the deadline passed, otherwise the error that occurred.
+ */
+int radio_read_line(struct radio_t *radio, char *line, size_t len, int64_t deadline) {
+    while (1) {
+        for (size_t i = 0; i < radio->rx_len; i++) {
+            if (radio->rx[(radio->rx_head + i) % RADIO_RX_BUFFER] != '\n') continue;
+
+            size_t copied = 0;
+            for (size_t j = 0; j < i && copied < len - 1; j++) {
+                char c = radio->rx[(radio->rx_head + j) % RADIO_RX_BUFFER];
+                if (c != '\r') line[copied++] = c;
+            }
+            line[copied] = '\0';
+            radio->rx_head = (radio->rx_head + i + 1) % RADIO_RX_BUFFER;
+            radio->rx_len -= i + 1;
+            if (copied > 0) return 0;
+            i = (size_t)-1; // Skip empty lines and keep scanning what remains
+        }
 
-    if (dprintf(radio_fd, "radio set mod %s\n", MODULATIONS[params->modulation]) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+        // A full buffer without a line terminator is garbage, so make room rather than stall
+        if (radio->rx_len == RADIO_RX_BUFFER) radio->rx_len = 0;
+
+        int64_t remaining = deadline - now_us();
+        if (remaining <= 0) return ETIMEDOUT;
+
+        struct pollfd pfd = {.fd = radio->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, (remaining + 999) / 1000);
+        if (ready == -1 && errno == EINTR) continue;
+        if (ready == -1) return errno;
+        if (ready == 0) continue;
+        if (pfd.revents & (POLLERR | POLLNVAL)) return EIO;
+
+        size_t tail = (radio->rx_head + radio->rx_len) % RADIO_RX_BUFFER;
+        size_t space = RADIO_RX_BUFFER - radio->rx_len;
+        if (space > RADIO_RX_BUFFER - tail) space = RADIO_RX_BUFFER - tail;
+        ssize_t nread = read(radio->fd, &radio->rx[tail], space);
+        if (nread == -1 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (nread == -1) return errno;
+        if (nread == 0 && (pfd.revents & POLLHUP)) return EIO;
+        radio->rx_len += nread;
+    }
+}
 
-    if (dprintf(radio_fd, "radio set freq %u\n", params->frequency) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+/**
+ * Handles the second-stage response to a transmission, if the line is one.
+ * @param radio The connection state of the LoRa radio.
+ * @param line A line received from the LoRa radio.
+ * @param err Set to 0 for `radio_tx_ok` or EIO for `radio_err`.
+ * @return True if the line was a second-stage response.
+ */
+static bool handle_tx_result(struct radio_t *radio, const char *line, int *err) {
+    if (!strcmp(line, "radio_tx_ok")) *err = 0;
+    else if (!strcmp(line, "radio_err")) *err = EIO;
+    else return false;
 
-    if (dprintf(radio_fd, "radio set pwr %d\n", params->power) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+    radio->state = RADIO_IDLE;
+    return true;
+}
 
-    if (dprintf(radio_fd, "radio set sf sf%u\n", params->spread_factor) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+/**
+ * Waits for the current transmission to finish, which is when the LoRa radio can accept another command.
+ * @param radio The connection state of the LoRa radio.
+ * @return 0 if the transmission succeeded or there was none, EIO if it failed, ETIMEDOUT if the radio did not report
+ * a result by the expected end of transmission, otherwise the error that occurred.
+ */
+static int wait_for_tx_done(struct radio_t *radio) {
+    char line[RADIO_LINE_MAX];
+    int err = 0;
+    while (radio->state == RADIO_ON_AIR) {
+        err = radio_read_line(radio, line, sizeof(line), radio->busy_until + RADIO_TX_MARGIN_US);
+        if (err) {
+            // The result may still arrive late, in which case it is discarded as stale
+            radio->state = RADIO_IDLE;
+            return err;
+        }
+        handle_tx_result(radio, line, &err);
+    }
+    return err;
+}
 
-    if (dprintf(radio_fd, "radio set cr %s\n", CODING_RATES[params->coding_rate]) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+/**
+ * Wait for the LoRa radio module to respond with "ok". Second-stage responses to an earlier transmission that arrive
+ * first are consumed on the way.
+ * @param radio The connection state of the LoRa radio.
+ * @return 0 if The radio responded with an okay status, EINVAL if it reported an invalid parameter, EBUSY if it was
+ * busy, ETIMEDOUT if it did not respond in time, otherwise the error that occurred.
+ */
+int wait_for_ok(struct radio_t *radio) {
+    char line[RADIO_LINE_MAX];
+    int64_t deadline = now_us() + RADIO_RESPONSE_TIMEOUT_US;
+    while (1) {
+        int err = radio_read_line(radio, line, sizeof(line), deadline);
+        return_err(err);
+
+        if (!strcmp(line, "ok")) return 0;
+        if (!strcmp(line, "invalid_param")) return EINVAL;
+        if (!strcmp(line, "busy")) return EBUSY;
+        // A packet received too late for a receive window that was given up on is stale
+        if (!strncmp(line, RX_PREFIX, sizeof(RX_PREFIX) - 1)) continue;
+        if (!handle_tx_result(radio, line, &err)) return EIO;
+    }
+}
 
-    if (dprintf(radio_fd, "radio set bw %u\n", params->bandwidth) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+/**
+ * Writes a whole buffer to the LoRa radio and waits for it to be sent over the UART.
+ * @param radio The connection state of the LoRa radio.
+ * @param data The bytes to write.
+ * @param len The number of bytes to write.
+ * @return 0 if successful, otherwise the error that occurred.
+ */
+static int write_all(struct radio_t *radio, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(radio->fd, data, len);
+        if (written == -1 && errno == EINTR) continue;
+        if (written == -1) return errno;
+        data += written;
+        len -= written;
+    }
+    if (tcdrain(radio->fd)) return errno; // Wait for radio to receive the whole command
+    return 0;
+}
 
-    if (dprintf(radio_fd, "radio set prlen %u\n", params->preamble_len) < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
+/**
+ * Moves the UART link to a new baud rate using the RN2483's auto-baud detection: the tty is switched to the new rate,
+ * then a break condition followed by 0x55 lets the radio measure it. The link is checked with `sys get ver`.
+ * @param radio The connection state of the LoRa radio.
+ * @param baud The baud rate to switch to.
+ * @return 0 if the radio answered at the new rate, otherwise the error that occurred.
+ */
+static int autobaud(struct radio_t *radio, unsigned int baud) {
+    size_t i = 0;
+    while (i < array_len(BAUD_RATES) && BAUD_RATES[i].baud != baud) i++;
+    if (i == array_len(BAUD_RATES)) return EINVAL;
+
+    struct termios tty;
+    if (tcgetattr(radio->fd, &tty)) return errno;
+    cfsetispeed(&tty, BAUD_RATES[i].speed);
+    cfsetospeed(&tty, BAUD_RATES[i].speed);
+    if (tcsetattr(radio->fd, TCSADRAIN, &tty)) return errno;
+    if (tcsendbreak(radio->fd, 0)) return errno;
+    int err = write_all(radio, "\x55", 1);
     return_err(err);
 
-    if (dprintf(radio_fd, "radio set crc %s\n", params->cyclic_redundancy ? "on" : "off") < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+    /* Anything received around the switch was clocked in at the wrong rate. */
+    tcflush(radio->fd, TCIFLUSH);
+    radio->rx_len = 0;
 
-    if (dprintf(radio_fd, "radio set iqi %s\n", params->iqi ? "on" : "off") < 0) return errno;
-    err = tcdrain(radio_fd);
+    err = write_all(radio, "sys get ver\r\n", 13);
     return_err(err);
-    err = wait_for_ok(radio_fd);
+    char line[RADIO_LINE_MAX];
+    err = radio_read_line(radio, line, sizeof(line), now_us() + RADIO_RESPONSE_TIMEOUT_US);
     return_err(err);
+    if (strncmp(line, "RN2483", 6)) return EIO;
 
-    if (dprintf(radio_fd, "radio set sync %lx\n", params->sync_word) < 0) return errno;
-    err = tcdrain(radio_fd);
+    radio->baud = baud;
+    return 0;
+}
+
+/**
+ * Switches the UART link to the radio to a different baud rate. If the radio does not answer at the new rate, the link
+ * falls back to the default rate so that it remains usable.
+ * @param radio The connection state of the LoRa radio.
+ * @param baud The baud rate to switch to.
+ * @return 0 if the link is running at the new rate, otherwise the error that occurred. `radio->baud` holds the rate the
+ * link ended up at.
+ */
+int radio_set_baud(struct radio_t *radio, unsigned int baud) {
+    int err = autobaud(radio, baud);
+    if (err && baud != RADIO_DEFAULT_BAUD) autobaud(radio, RADIO_DEFAULT_BAUD);
+    return err;
+}
+
+/**
+ * Resets the RN2483 with `sys reset`, which restores its power-on settings: the link is first moved to the default
+ * baud rate with auto-baud detection, since a module that browned out will have fallen back to it, and a module that
+ * did not is told to switch. The module is at the default rate after the reset, so the link is left there.
+ * @param radio The connection state of the LoRa radio.
+ * @return 0 if the radio came back up, ETIMEDOUT if it did not announce itself in time, otherwise the error that
+ * occurred.
+ */
+int radio_reset(struct radio_t *radio) {
+    radio->state = RADIO_IDLE; // Whatever was on the air is lost with the reset
+    int err = autobaud(radio, RADIO_DEFAULT_BAUD);
     return_err(err);
-    err = wait_for_ok(radio_fd);
+    err = write_all(radio, "sys reset\r\n", 11);
     return_err(err);
 
+    /* The module announces itself with its version once it has restarted. */
+    char line[RADIO_LINE_MAX];
+    int64_t deadline = now_us() + RADIO_RESET_TIMEOUT_US;
+    do {
+        err = radio_read_line(radio, line, sizeof(line), deadline);
+        return_err(err);
+    } while (strncmp(line, "RN2483", 6));
+    return 0;
+}
+
+/**
+ * Converts the response to a configuration command into an error code.
+ * @param response The response line.
+ * @return 0 for "ok", EINVAL for "invalid_param", EBUSY for "busy", otherwise EIO.
+ */
+static int response_err(const char *response) {
+    if (!strcmp(response, "ok")) return 0;
+    if (!strcmp(response, "invalid_param")) return EINVAL;
+    if (!strcmp(response, "busy")) return EBUSY;
+    return EIO;
+}
+
+/**
+ * Sends a batch of commands to the LoRa radio, keeping up to `RADIO_PIPELINE_DEPTH` of them in flight rather than
+ * waiting out a full round trip per command. The radio answers commands in order, so the nth line received is the
+ * response to the nth command. If the radio stops responding, no further commands are sent.
+ * @param radio The connection state of the LoRa radio.
+ * @param commands The commands, without line terminators.
+ * @param responses Where to copy the response to each command.
+ * @param n The number of commands.
+ * @return 0 if every command was answered, otherwise the error that occurred.
+ */
+static int radio_pipeline(struct radio_t *radio, char (*commands)[RADIO_LINE_MAX], char (*responses)[RADIO_LINE_MAX],
+                          size_t n) {
+    wait_for_tx_done(radio); // The outcome of an earlier transmission is not these commands' concern
+
+    size_t sent = 0, received = 0;
+    while (received < n) {
+        /* Top up the pipeline with as many commands as it has room for, in a single write. */
+        char batch[RADIO_PIPELINE_DEPTH * (RADIO_LINE_MAX + 2)];
+        size_t len = 0;
+        for (; sent < n && sent - received < RADIO_PIPELINE_DEPTH; sent++) {
+            size_t command_len = strnlen(commands[sent], RADIO_LINE_MAX);
+            memcpy(&batch[len], commands[sent], command_len);
+            len += command_len;
+            batch[len++] = '\r';
+            batch[len++] = '\n';
+        }
+        if (len > 0) {
+            int err = write_all(radio, batch, len);
+            return_err(err);
+        }
+
+        int err = radio_read_line(radio, responses[received], RADIO_LINE_MAX, now_us() + RADIO_RESPONSE_TIMEOUT_US);
+        return_err(err);
+        if (!handle_tx_result(radio, responses[received], &err)) received++;
+    }
+    return 0;
+}
+
+/**
+ * Lists the RN2483 settings corresponding to a set of radio parameters. Values are formatted the way the RN2483 both
+ * accepts them in `radio set` and reports them in `radio get`.
+ * @param params The radio parameters.
+ * @param settings The settings, in the order they should be applied.
+ */
+static void radio_settings(const struct lora_params_t *params, struct radio_setting_t settings[RADIO_SETTINGS]) {
+    const size_t len = sizeof(settings[0].value);
+    size_t i = 0;
+
+    settings[i].name = "mod";
+    snprintf(settings[i++].value, len, "%s", MODULATIONS[params->modulation]);
+    settings[i].name = "freq";
+    snprintf(settings[i++].value, len, "%u", params->frequency);
+    settings[i].name = "pwr";
+    snprintf(settings[i++].value, len, "%d", params->power);
+    settings[i].name = "sf";
+    snprintf(settings[i++].value, len, "sf%u", params->spread_factor);
+    settings[i].name = "cr";
+    snprintf(settings[i++].value, len, "%s", CODING_RATES[params->coding_rate]);
+    settings[i].name = "bw";
+    snprintf(settings[i++].value, len, "%u", params->bandwidth);
+    settings[i].name = "prlen";
+    snprintf(settings[i++].value, len, "%u", params->preamble_len);
+    settings[i].name = "crc";
+    snprintf(settings[i++].value, len, "%s", params->cyclic_redundancy ? "on" : "off");
+    settings[i].name = "iqi";
+    snprintf(settings[i++].value, len, "%s", params->iqi ? "on" : "off");
+    settings[i].name = "sync";
+    snprintf(settings[i++].value, len, "%llx", (unsigned long long)params->sync_word);
+
     // Turn off the watchdog so our params don't reset with inactivity
-    if (dprintf(radio_fd, "radio set wdt 0\n") < 0) return errno;
-    err = tcdrain(radio_fd);
-    return_err(err);
-    err = wait_for_ok(radio_fd);
-    return_err(err);
+    settings[i].name = "wdt";
+    snprintf(settings[i++].value, len, "0");
+}
+
+/**
+ * Applies settings to the LoRa radio in one pipelined batch, optionally followed by `mac pause` so that the LoRaWAN
+ * stack does not reset them.
+ * @param radio The connection state of the LoRa radio.
+ * @param settings The settings to apply.
+ * @param n The number of settings.
+ * @param pause Whether to pause the LoRaWAN stack afterwards.
+ * @return 0 if successful, otherwise the type of error that occurred.
+ */
+static int apply_settings(struct radio_t *radio, const struct radio_setting_t *settings, size_t n, bool pause) {
+    char commands[RADIO_SETTINGS + 1][RADIO_LINE_MAX];
+    char responses[RADIO_SETTINGS + 1][RADIO_LINE_MAX];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(commands[i], RADIO_LINE_MAX, "radio set %s %s", settings[i].name, settings[i].value);
+    }
+
+    // Mac pause will pause for 4294967245ms, or about 49 days. Repeating it while already paused is harmless.
+    if (pause) snprintf(commands[n], RADIO_LINE_MAX, "mac pause");
 
-    // Mac pause will pause for 4294967245ms, or about 49 days. So we'll only do this once.
-    if (dprintf(radio_fd, "mac pause\n") < 0) return errno; // Mac pause to not reset parameters
-    err = tcdrain(radio_fd);                                // Wait for radio to process mac pause command
+    size_t total = pause ? n + 1 : n;
+    if (total == 0) return 0;
+    int err = radio_pipeline(radio, commands, responses, total);
     return_err(err);
+    for (size_t i = 0; i < n; i++) {
+        err = response_err(responses[i]);
+        return_err(err);
+    }
 
     // Check that mac pause returned non-0 (success)
-    char buffer[10] = {0};
-    read(radio_fd, buffer, sizeof(buffer));
-    if (!strcmp(buffer, "0")) return EIO;
+    if (pause && !strcmp(responses[n], "0")) return EIO;
+    return 0;
+}
+
+/**
+ * Set parameters on the LoRa radio. Every setting is sent, whatever the radio is currently configured with.
+ * @param radio The connection state of the LoRa radio.
+ * @param params A pointer to the struct of LoRa radio parameters to be set.
+ * @return 0 if successful, otherwise the type of error that occurred.
+ */
+int radio_set_params(struct radio_t *radio, const struct lora_params_t *params) {
+    struct radio_setting_t settings[RADIO_SETTINGS];
+    radio_settings(params, settings);
 
+    int err = apply_settings(radio, settings, RADIO_SETTINGS, true);
+    return_err(err);
+    radio->params = params;
     return 0;
 }
 
 /**
- * Wait for the LoRa radio module to respond with "ok".
- * @param radio_fd The file descriptor to the LoRa radio device.
- * @return 0 if The radio responded with an okay status, otherwise return error that occurred.
- */
-int wait_for_ok(int radio_fd) {
-    char buffer[25] = {0};
-    for (uint8_t i = 0; i < 3; i++) {
-        read(radio_fd, buffer, sizeof(buffer));
-        if (strstr(buffer, "ok") != NULL) {
-            return tcflush(radio_fd, TCIFLUSH);
+ * Brings the LoRa radio's configuration in line with a set of parameters, sending only the settings that differ. The
+ * current configuration is read back from the radio rather than remembered, so it stays correct if the module was reset
+ * or reconfigured by something else. If it cannot be read back, every setting is sent.
+ * @param radio The connection state of the LoRa radio.
+ * @param params A pointer to the struct of LoRa radio parameters to be set.
+ * @param changed If not NULL, set to the number of settings that had to be changed.
+ * @return 0 if successful, otherwise the type of error that occurred.
+ */
+int radio_sync_params(struct radio_t *radio, const struct lora_params_t *params, size_t *changed) {
+    struct radio_setting_t settings[RADIO_SETTINGS];
+    radio_settings(params, settings);
+
+    char commands[RADIO_SETTINGS][RADIO_LINE_MAX];
+    char responses[RADIO_SETTINGS][RADIO_LINE_MAX];
+    for (size_t i = 0; i < RADIO_SETTINGS; i++) {
+        snprintf(commands[i], RADIO_LINE_MAX, "radio get %s", settings[i].name);
+    }
+
+    /* Keep only the settings the radio does not already have. */
+    size_t n = RADIO_SETTINGS;
+    if (radio_pipeline(radio, commands, responses, RADIO_SETTINGS) == 0) {
+        n = 0;
+        for (size_t i = 0; i < RADIO_SETTINGS; i++) {
+            if (strcasecmp(responses[i], settings[i].value)) settings[n++] = settings[i];
         }
-        memset(buffer, 0, sizeof(buffer));
     }
-    return EIO;
+    if (changed != NULL) *changed = n;
+
+    int err = apply_settings(radio, settings, n, true);
+    return_err(err);
+    radio->params = params;
+    return 0;
 }
 
 /**
- * Transmits the passed data over LoRa radio.
- * @param radio_fd The file descriptor to the LoRa radio device.
- * @param data A pointer to the data to be sent over radio.
+ * Moves the LoRa radio from the parameters it was last configured with to another set, sending only the settings that
+ * differ between the two. Unlike `radio_sync_params`, nothing is read back, so this is quick enough to do between
+ * packets.
+ * @param radio The connection state of the LoRa radio, which must already have been configured.
+ * @param params A pointer to the struct of LoRa radio parameters to switch to, which must stay valid while in use.
+ * @param changed If not NULL, set to the number of settings that were changed.
+ * @return 0 if successful, otherwise the type of error that occurred. On error the radio may have only some of the
+ * new settings.
+ */
+int radio_switch_params(struct radio_t *radio, const struct lora_params_t *params, size_t *changed) {
+    struct radio_setting_t current[RADIO_SETTINGS];
+    struct radio_setting_t settings[RADIO_SETTINGS];
+    radio_settings(radio->params, current);
+    radio_settings(params, settings);
+
+    size_t n = 0;
+    for (size_t i = 0; i < RADIO_SETTINGS; i++) {
+        if (strcmp(current[i].value, settings[i].value)) settings[n++] = settings[i];
+    }
+    if (changed != NULL) *changed = n;
+
+    int err = apply_settings(radio, settings, n, false);
+    return_err(err);
+    radio->params = params;
+    return 0;
+}
+
+/**
+ * Transmits an assembled `radio tx` command and follows it through both stages of the radio's response: "ok" when the
+ * transmission starts, then "radio_tx_ok" or "radio_err" when it ends. The end is expected after the predicted time on
+ * air, so the radio is known to be free as soon as this returns.
+ * @param radio The connection state of the LoRa radio.
+ * @param command The complete command, including line terminator.
+ * @param len The length of the command.
+ * @param payload_len The length of the payload being transmitted in bytes.
  * @return 0 if transmission was successful, otherwise return the error that occurred.
  */
-int radio_tx(int radio_fd, const char *data) {
-    int err;
-    if (dprintf(radio_fd, "radio tx %s\n", data) < 0) return errno; // Transmit data
-    err = tcdrain(radio_fd);                                        // Wait for radio to process transmit request
+static int transmit_command(struct radio_t *radio, const char *command, size_t len, size_t payload_len) {
+    radio->timing.assembled = radio_now_ns();
+    radio->accepted = false;
+    wait_for_tx_done(radio);
+    int err = write_all(radio, command, len);
+    return_err(err);
+    radio->timing.written = radio_now_ns();
+    err = wait_for_ok(radio);
     return_err(err);
-    return wait_for_ok(radio_fd); // Return result of radio response
+    radio->timing.accepted = radio_now_ns();
+    radio->accepted = true;
+
+    radio->state = RADIO_ON_AIR;
+    radio->busy_until = now_us() + radio_time_on_air(radio->params, payload_len);
+    err = wait_for_tx_done(radio);
+    radio->timing.done = radio_now_ns();
+    return err;
 }
 
 /**
- * Transmits the passed binary data over LoRa radio.
- * @param radio_fd The file descriptor to the LoRa radio device.
+ * Encodes bytes as lowercase ASCII hex. Blocks of 16 bytes are encoded with SIMD table lookups where the target
+ * supports it (NEON on aarch64, SSSE3 on x86), and the remainder with a lookup table of digit pairs.
+ * @param dst The buffer to write into, which must have room for `2 * nbytes` characters. No terminator is written.
+ * @param data The bytes to encode.
+ * @param nbytes The number of bytes to encode.
+ * @return The number of characters written.
+ */
+size_t radio_hex_encode(char *dst, const uint8_t *data, size_t nbytes) {
+    size_t i = 0;
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    uint8x16_t digits = vld1q_u8((const uint8_t *)HEX_DIGITS);
+    for (; i + 16 <= nbytes; i += 16) {
+        uint8x16_t in = vld1q_u8(&data[i]);
+        uint8x16_t hi = vqtbl1q_u8(digits, vshrq_n_u8(in, 4));
+        uint8x16_t lo = vqtbl1q_u8(digits, vandq_u8(in, vdupq_n_u8(0x0f)));
+        uint8x16x2_t out = vzipq_u8(hi, lo);
+        vst1q_u8((uint8_t *)&dst[2 * i], out.val[0]);
+        vst1q_u8((uint8_t *)&dst[2 * i + 16], out.val[1]);
+    }
+#elif defined(__SSSE3__)
+    __m128i digits = _mm_loadu_si128((const __m128i *)HEX_DIGITS);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= nbytes; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)&data[i]);
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(in, mask));
+        _mm_storeu_si128((__m128i *)&dst[2 * i], _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)&dst[2 * i + 16], _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+
+    for (; i < nbytes; i++) {
+        memcpy(&dst[2 * i], &HEX_PAIRS[2 * data[i]], 2);
+    }
+    return 2 * nbytes;
+}
+
+/**
+ * Transmits the passed data over LoRa radio.
+ * @param radio The connection state of the LoRa radio.
+ * @param data A pointer to the data to be sent over radio, as ASCII hex.
+ * @return 0 if transmission was successful, otherwise return the error that occurred.
+ */
+int radio_tx(struct radio_t *radio, const char *data) {
+    radio->timing.started = radio_now_ns();
+    size_t hex_len = strlen(data);
+    if (hex_len > 2 * RADIO_MAX_PAYLOAD) return EMSGSIZE;
+
+    size_t len = sizeof(TX_PREFIX) - 1;
+    memcpy(radio->tx, TX_PREFIX, len);
+    memcpy(&radio->tx[len], data, hex_len);
+    len += hex_len;
+    radio->tx[len++] = '\r';
+    radio->tx[len++] = '\n';
+    return transmit_command(radio, radio->tx, len, hex_len / 2);
+}
+
+/**
+ * Transmits the passed binary data over LoRa radio. The whole command is assembled in the radio's preallocated command
+ * buffer and handed to the UART in a single write.
+ * @param radio The connection state of the LoRa radio.
  * @param data A pointer to the data to be sent over radio.
  * @param nbytes The number of bytes in the `data` pointer to transmit.
  * @return 0 if transmission was successful, otherwise return the error that occurred.
  */
-int radio_tx_bytes(int radio_fd, const uint8_t *data, size_t nbytes) {
-    int err;
-    int sent = 0;
+int radio_tx_bytes(struct radio_t *radio, const uint8_t *data, size_t nbytes) {
+    radio->timing.started = radio_now_ns();
+    if (nbytes > RADIO_MAX_PAYLOAD) return EMSGSIZE;
+
+    size_t len = sizeof(TX_PREFIX) - 1;
+    memcpy(radio->tx, TX_PREFIX, len);
+    len += radio_hex_encode(&radio->tx[len], data, nbytes);
+    radio->tx[len++] = '\r';
+    radio->tx[len++] = '\n';
+    return transmit_command(radio, radio->tx, len, nbytes);
+}
 
-    char buffer[550];
-    sent += sprintf(&buffer[sent], "radio tx ");
-    for (size_t i = 0; i < nbytes; i++) {
-        sent += sprintf(&buffer[sent], "%02x", data[i]);
-    }
-    sent += sprintf(&buffer[sent], "\n");
-    buffer[sent] = '\0';
+/**
+ * Gets the value of a hexadecimal digit.
+ * @param c The digit.
+ * @return The value, or -1 if the character is not a hexadecimal digit.
+ */
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-    write(radio_fd, buffer, sent);
-    err = tcdrain(radio_fd); // Wait for radio to process transmit request
+/**
+ * Listens for a packet in a receive window with `radio rx`. The radio answers "radio_rx" followed by the packet as hex
+ * if one arrives, or "radio_err" once the window has passed without one. A radio that reports neither in time is told
+ * to stop listening with `radio rxstop`, so that it can transmit again.
+ * @param radio The connection state of the LoRa radio.
+ * @param window_us How long to wait for a packet to start arriving, in microseconds.
+ * @param data Where to copy the packet.
+ * @param size The size of `data` in bytes, which is also the longest packet that is waited for.
+ * @param len Set to the length of the packet in bytes.
+ * @return 0 if a packet was received, ETIMEDOUT if none arrived in the window, EMSGSIZE if it was longer than `size` or
+ * EIO if it was garbled, otherwise the error that occurred.
+ */
+int radio_rx(struct radio_t *radio, uint32_t window_us, uint8_t *data, size_t size, size_t *len) {
+    char command[RADIO_LINE_MAX];
+    int command_len = snprintf(command, sizeof(command), "radio rx %u\r\n", radio_rx_window(radio->params, window_us));
+    wait_for_tx_done(radio);
+    int err = write_all(radio, command, command_len);
+    return_err(err);
+    err = wait_for_ok(radio);
     return_err(err);
-    return wait_for_ok(radio_fd); // Return result of radio response
+
+    // Room for the longest packet the radio can receive, so a reply that fills the line was cut short
+    char line[sizeof(RX_PREFIX) + 2 + 2 * RADIO_MAX_PAYLOAD + 1];
+    int64_t deadline = now_us() + window_us + radio_time_on_air(radio->params, size) + RADIO_TX_MARGIN_US;
+    do {
+        err = radio_read_line(radio, line, sizeof(line), deadline);
+        if (err == ETIMEDOUT) {
+            if (!write_all(radio, "radio rxstop\r\n", 14)) wait_for_ok(radio);
+            return ETIMEDOUT;
+        }
+        return_err(err);
+        if (!strcmp(line, "radio_err")) return ETIMEDOUT;
+    } while (strncmp(line, RX_PREFIX, sizeof(RX_PREFIX) - 1));
+
+    if (strlen(line) == sizeof(line) - 1) return EMSGSIZE;
+    const char *hex = &line[sizeof(RX_PREFIX) - 1];
+    while (*hex == ' ') hex++;
+    for (*len = 0; hex[0] != '\0'; hex += 2) {
+        int high = hex_value(hex[0]), low = hex_value(hex[1]);
+        if (high < 0 || low < 0) return EIO;
+        if (*len == size) return EMSGSIZE;
+        data[(*len)++] = (uint8_t)(high << 4 | low);
+    }
+    return 0;
 }
@@ -0,0 +1,131 @@
+/**
+ * @file reader.c
+ * @brief Implementation of reading length-prefixed binary frames.
+ *
+ * When reading through the buffer, the unread tail is moved to the front before each refill, so a frame never wraps
+ * and its payload can be handed out as a pointer into the buffer. Frames that are too long are skipped, which keeps the
+ * reader in step with the stream.
+ */
+#include "reader.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Starts reading frames from a file descriptor, mapping it into memory if it is a regular file.
+ * @param reader The reader.
+ * @param fd The file descriptor.
+ * @return 0 if successful, otherwise the error from inspecting the file descriptor.
+ */
+int reader_open(struct reader_t *reader, int fd) {
+    reader->fd = fd;
+    reader->map = NULL;
+    reader->window = reader->buf;
+    reader->pos = reader->end = 0;
+
+    struct stat st;
+    if (fstat(fd, &st)) return errno;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            reader->map = map;
+            reader->window = map;
+            reader->end = st.st_size;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Makes sure a number of unread bytes are in the window, reading more if needed. A mapped file is always complete.
+ * @param reader The reader.
+ * @param need The number of bytes needed, at most `READER_BUFFER`.
+ * @return 0 if successful, even if input ended with fewer bytes, otherwise the error from reading.
+ */
+static int fill(struct reader_t *reader, size_t need) {
+    if (reader->map != NULL || reader->end - reader->pos >= need) return 0;
+
+    memmove(reader->buf, &reader->buf[reader->pos], reader->end - reader->pos);
+    reader->end -= reader->pos;
+    reader->pos = 0;
+    while (reader->end < need) {
+        ssize_t n = read(reader->fd, &reader->buf[reader->end], READER_BUFFER - reader->end);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        reader->end += n;
+    }
+    return 0;
+}
+
+/**
+ * Skips bytes of input, reading through as many refills as it takes.
+ * @param reader The reader.
+ * @param count The number of bytes to skip.
+ * @return 0 if successful, EBADMSG if input ended first, otherwise the error from reading.
+ */
+static int skip(struct reader_t *reader, size_t count) {
+    while (count > 0) {
+        int err = fill(reader, 1);
+        if (err) return err;
+        size_t available = reader->end - reader->pos;
+        if (available == 0) return EBADMSG;
+        size_t n = available < count ? available : count;
+        reader->pos += n;
+        count -= n;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next frame. The payload is left where it was read and stays valid until the next call.
+ * @param reader The reader.
+ * @param max_len The longest payload accepted, at most `READER_BUFFER - READER_HEADER_LEN`. Longer frames are skipped.
+ * @param data Set to the payload.
+ * @param len Set to the length of the payload, including for a frame that was skipped.
+ * @param priority Set to the priority of the frame.
+ * @return 0 if a frame was read, EMSGSIZE if it was longer than `max_len` and skipped, EPIPE if input ended between
+ * frames, EBADMSG if it ended partway through one, or the error from reading.
+ */
+int reader_next(struct reader_t *reader, size_t max_len, const uint8_t **data, size_t *len, unsigned int *priority) {
+    int err = fill(reader, READER_HEADER_LEN);
+    if (err) return err;
+    size_t available = reader->end - reader->pos;
+    if (available == 0) return EPIPE;
+    if (available < READER_HEADER_LEN) {
+        reader->pos = reader->end;
+        return EBADMSG;
+    }
+
+    const uint8_t *header = &reader->window[reader->pos];
+    *priority = header[0];
+    *len = (size_t)header[1] << 8 | header[2];
+    reader->pos += READER_HEADER_LEN;
+    if (*len > max_len) {
+        err = skip(reader, *len);
+        return err ? err : EMSGSIZE;
+    }
+
+    err = fill(reader, *len);
+    if (err) return err;
+    if (reader->end - reader->pos < *len) {
+        reader->pos = reader->end;
+        return EBADMSG;
+    }
+    *data = &reader->window[reader->pos];
+    reader->pos += *len;
+    return 0;
+}
+
+/**
+ * Stops reading frames, unmapping the file if it was mapped. The file descriptor is left open.
+ * @param reader The reader.
+ */
+void reader_close(struct reader_t *reader) {
+    if (reader->map != NULL) munmap(reader->map, reader->end);
+    reader->map = NULL;
+}
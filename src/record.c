@@ -0,0 +1,182 @@
+/**
+ * @file record.c
+ * @brief Implementation of recording dequeued messages and reading recordings.
+ *
+ * The header's count is only advanced once an entry has been written in full, so a recording cut short by a crash ends
+ * with its last complete entry. Each entry also holds its own number, which lets an outcome that arrives after the ring
+ * has wrapped around be recognized as belonging to an entry that was overwritten.
+ */
+#include "record.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Creates a recording, replacing any file at the path, and maps it for appending.
+ * @param rec The recorder.
+ * @param path The path of the recording.
+ * @param capacity The number of entries the ring holds, at most `RECORD_MAX_ENTRIES`.
+ * @return 0 if successful, EINVAL if the capacity is out of range, otherwise the error from creating or mapping the
+ * file.
+ */
+int record_open(struct recorder_t *rec, const char *path, size_t capacity) {
+    if (capacity == 0 || capacity > RECORD_MAX_ENTRIES) return EINVAL;
+    int err = pthread_mutex_init(&rec->lock, NULL);
+    if (err) return err;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return errno;
+    rec->map_len = sizeof(struct record_header_t) + capacity * sizeof(struct record_entry_t);
+    if (ftruncate(fd, rec->map_len)) {
+        err = errno;
+        close(fd);
+        return err;
+    }
+    void *map = mmap(NULL, rec->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (map == MAP_FAILED) return err;
+
+    rec->header = map;
+    rec->entries = (struct record_entry_t *)(rec->header + 1);
+    memcpy(rec->header->magic, RECORD_MAGIC, sizeof(rec->header->magic));
+    rec->header->entry_size = sizeof(struct record_entry_t);
+    rec->header->capacity = capacity;
+    rec->header->count = 0;
+    return 0;
+}
+
+/**
+ * Appends a message taken off the transmit queue to a recording, with its outcome pending.
+ * @param rec The recorder.
+ * @param packet The message.
+ * @param dequeued_ns When the message was taken off the queue, in nanoseconds on the monotonic clock.
+ * @return The number of the entry, for filling in its outcome.
+ */
+uint64_t record_append(struct recorder_t *rec, const struct packet_t *packet, int64_t dequeued_ns) {
+    pthread_mutex_lock(&rec->lock);
+    uint64_t seq = rec->header->count;
+    struct record_entry_t *entry = &rec->entries[seq % rec->header->capacity];
+    entry->seq = seq;
+    entry->queued_ns = (int64_t)packet->queued.tv_sec * 1000000000 + packet->queued.tv_nsec;
+    entry->dequeued_ns = dequeued_ns;
+    entry->priority = packet->priority;
+    entry->len = packet->len;
+    entry->source = packet->source;
+    entry->outcome = OUTCOME_PENDING;
+    memcpy(entry->data, packet->data, packet->len);
+    rec->header->count = seq + 1;
+    pthread_mutex_unlock(&rec->lock);
+    return seq;
+}
+
+/**
+ * Fills in whether a frame carrying recorded messages was sent. A message sent on any radio stays sent, even if a copy
+ * of it failed on another.
+ * @param rec The recorder.
+ * @param first The number of the first entry in the frame.
+ * @param count The number of entries in the frame, which follow each other.
+ * @param sent Whether the frame was sent.
+ */
+void record_outcome(struct recorder_t *rec, uint64_t first, size_t count, bool sent) {
+    pthread_mutex_lock(&rec->lock);
+    for (uint64_t seq = first; seq < first + count; seq++) {
+        struct record_entry_t *entry = &rec->entries[seq % rec->header->capacity];
+        if (entry->seq != seq || entry->outcome == OUTCOME_SENT) continue;
+        entry->outcome = sent ? OUTCOME_SENT : OUTCOME_FAILED;
+    }
+    pthread_mutex_unlock(&rec->lock);
+}
+
+/**
+ * Writes a recording out to its file. The recording stays mapped, so threads still appending to it are unaffected.
+ * @param rec The recorder.
+ */
+void record_flush(struct recorder_t *rec) { msync(rec->header, rec->map_len, MS_SYNC); }
+
+/**
+ * Maps a recording for reading. Every entry is checked to hold no more bytes than fit, so that a corrupt or foreign
+ * recording is never read past the end of an entry.
+ * @param recording Set up to read the recording.
+ * @param path The path of the recording.
+ * @return 0 if successful, EINVAL if the file is not a recording, is cut short or has an entry that is too long,
+ * otherwise the error from opening or mapping the file.
+ */
+int record_load(struct recording_t *recording, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return errno;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    if ((size_t)st.st_size < sizeof(struct record_header_t)) {
+        close(fd);
+        return EINVAL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) return err;
+
+    recording->map = map;
+    recording->map_len = st.st_size;
+    recording->header = map;
+    recording->entries = (const struct record_entry_t *)(recording->header + 1);
+    const struct record_header_t *header = recording->header;
+    if (memcmp(header->magic, RECORD_MAGIC, sizeof(header->magic)) ||
+        header->entry_size != sizeof(struct record_entry_t) || header->capacity == 0 ||
+        header->capacity > RECORD_MAX_ENTRIES ||
+        recording->map_len < sizeof(*header) + (size_t)header->capacity * sizeof(struct record_entry_t)) {
+        record_unload(recording);
+        return EINVAL;
+    }
+    recording->count = header->count < header->capacity ? header->count : header->capacity;
+    recording->first = header->count - recording->count;
+    for (uint64_t i = 0; i < recording->count; i++) {
+        if (record_entry(recording, i)->len > PQ_PACKET_MAX) {
+            record_unload(recording);
+            return EINVAL;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Gets an entry of a recording, counting from the oldest still in the ring.
+ * @param recording The recording.
+ * @param index The index of the entry, less than `count`.
+ * @return The entry.
+ */
+const struct record_entry_t *record_entry(const struct recording_t *recording, uint64_t index) {
+    return &recording->entries[(recording->first + index) % recording->header->capacity];
+}
+
+/**
+ * Lists the entries of a recording in the order their messages were queued, which differs from the order they were
+ * taken off the queue when priorities overtook each other. Entries are nearly in order already, so they are sorted by
+ * insertion.
+ * @param recording The recording.
+ * @param order Set to the index of each entry in queued order, which must hold `count` indices.
+ */
+void record_order(const struct recording_t *recording, uint32_t *order) {
+    for (uint32_t i = 0; i < recording->count; i++) {
+        int64_t queued = record_entry(recording, i)->queued_ns;
+        uint32_t j = i;
+        for (; j > 0 && record_entry(recording, order[j - 1])->queued_ns > queued; j--) order[j] = order[j - 1];
+        order[j] = i;
+    }
+}
+
+/**
+ * Unmaps a recording.
+ * @param recording The recording.
+ */
+void record_unload(struct recording_t *recording) {
+    munmap(recording->map, recording->map_len);
+    recording->map = NULL;
+}
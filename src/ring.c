@@ -0,0 +1,268 @@
+/**
+ * @file ring.c
+ * @brief Implementation of the shared memory message ring.
+ *
+ * Each side caches the other's position and only reads the shared one again when the cached value says the ring is
+ * full or empty, so the cache line the other side writes is touched about once per batch rather than once per message.
+ * Positions are published with release stores and read with acquire loads, which orders the records themselves.
+ * Going to sleep and waking up is a store followed by a load on each side, which only works with both sequentially
+ * consistent: either the producer sees the consumer is sleeping, or the consumer sees the new message before it sleeps.
+ */
+#include "ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Gets the space a record takes in the ring.
+ * @param len The length of the payload in bytes.
+ * @return The size of the record in bytes, including its header and padding.
+ */
+static size_t record_size(size_t len) { return (sizeof(struct ring_record_t) + len + 7) & ~(size_t)7; }
+
+/**
+ * Creates a ring in shared memory and maps it for writing messages, replacing any ring of the same name.
+ * @param ring Set up to write to the ring.
+ * @param name The name of the shared memory segment.
+ * @param size The number of bytes of records the ring holds, a power of two from `RING_MIN_SIZE` to `RING_MAX_SIZE`.
+ * @return 0 if successful, EINVAL if the size is not valid, otherwise the error from creating the segment.
+ */
+int ring_create(struct ring_t *ring, const char *name, size_t size) {
+    if (size < RING_MIN_SIZE || size > RING_MAX_SIZE || (size & (size - 1))) return EINVAL;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) return errno;
+    ring->map_len = sizeof(struct ring_shared_t) + size;
+    if (ftruncate(fd, ring->map_len)) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        return err;
+    }
+    void *map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return err;
+    }
+
+    struct ring_shared_t *shared = map;
+    shared->size = size;
+    atomic_init(&shared->closed, false);
+    atomic_init(&shared->head, 0);
+    atomic_init(&shared->tail, 0);
+    atomic_init(&shared->sleeping, false);
+    if (sem_init(&shared->wake, 1, 0)) {
+        err = errno;
+        munmap(map, ring->map_len);
+        shm_unlink(name);
+        return err;
+    }
+    // The consumer only trusts the ring once the magic is there, so it goes in last
+    atomic_thread_fence(memory_order_release);
+    memcpy(shared->magic, RING_MAGIC, sizeof(shared->magic));
+
+    ring->shared = shared;
+    ring->pos = 0;
+    ring->other = 0;
+    ring->pending = 0;
+    return 0;
+}
+
+/**
+ * Reserves room for a message in the ring, to be written in place and then committed with `ring_commit`.
+ * @param ring The producer's side of the ring.
+ * @param len The most bytes the message will hold.
+ * @param data Set to where to write the message.
+ * @return 0 if successful, EAGAIN if the ring does not have room until the consumer catches up, or EMSGSIZE if the
+ * message could never fit.
+ */
+int ring_reserve(struct ring_t *ring, size_t len, uint8_t **data) {
+    struct ring_shared_t *shared = ring->shared;
+    size_t size = shared->size;
+    size_t rec = record_size(len);
+    if (len >= RING_PAD || rec > size) return EMSGSIZE;
+
+    /* A record that would run past the end of the ring also needs the rest of the ring for padding. */
+    size_t offset = ring->pos & (size - 1);
+    size_t needed = rec <= size - offset ? rec : size - offset + rec;
+    if (ring->pos + needed - ring->other > size) {
+        ring->other = atomic_load_explicit(&shared->tail, memory_order_acquire);
+        if (ring->pos + needed - ring->other > size) return EAGAIN;
+    }
+
+    if (needed > rec) {
+        struct ring_record_t pad = {.len = RING_PAD};
+        memcpy(&shared->data[offset], &pad, sizeof(pad));
+        ring->pos += size - offset;
+        offset = 0;
+    }
+    ring->pending = rec;
+    *data = &shared->data[offset + sizeof(struct ring_record_t)];
+    return 0;
+}
+
+/**
+ * Makes a message written into room reserved with `ring_reserve` visible to the consumer, waking it if it is asleep.
+ * @param ring The producer's side of the ring.
+ * @param len The number of bytes written, at most the number reserved.
+ * @param priority The priority of the message.
+ */
+void ring_commit(struct ring_t *ring, size_t len, unsigned int priority) {
+    struct ring_shared_t *shared = ring->shared;
+    struct ring_record_t header = {.len = len, .priority = priority};
+    memcpy(&shared->data[ring->pos & (shared->size - 1)], &header, sizeof(header));
+    ring->pos += record_size(len);
+    ring->pending = 0;
+
+    atomic_store(&shared->head, ring->pos);
+    if (atomic_load(&shared->sleeping)) sem_post(&shared->wake);
+}
+
+/**
+ * Copies a message into the ring.
+ * @param ring The producer's side of the ring.
+ * @param data The message.
+ * @param len The length of the message in bytes.
+ * @param priority The priority of the message.
+ * @return 0 if successful, EAGAIN if the ring does not have room until the consumer catches up, or EMSGSIZE if the
+ * message could never fit.
+ */
+int ring_send(struct ring_t *ring, const void *data, size_t len, unsigned int priority) {
+    uint8_t *slot;
+    int err = ring_reserve(ring, len, &slot);
+    if (err) return err;
+    memcpy(slot, data, len);
+    ring_commit(ring, len, priority);
+    return 0;
+}
+
+/**
+ * Tells the consumer no more messages will be written. It reads those already in the ring first.
+ * @param ring The producer's side of the ring.
+ */
+void ring_close(struct ring_t *ring) {
+    atomic_store(&ring->shared->closed, true);
+    sem_post(&ring->shared->wake);
+}
+
+/**
+ * Maps a ring created by a producer, for reading messages.
+ * @param ring Set up to read the ring.
+ * @param name The name of the shared memory segment.
+ * @return 0 if successful, EINVAL if the segment is not a ring, otherwise the error from opening or mapping it.
+ */
+int ring_open(struct ring_t *ring, const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) return errno;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    if ((size_t)st.st_size < sizeof(struct ring_shared_t)) {
+        close(fd);
+        return EINVAL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) return err;
+
+    struct ring_shared_t *shared = map;
+    ring->shared = shared;
+    ring->map_len = st.st_size;
+    if (memcmp(shared->magic, RING_MAGIC, sizeof(shared->magic)) || shared->size < RING_MIN_SIZE ||
+        shared->size > RING_MAX_SIZE || (shared->size & (shared->size - 1)) ||
+        ring->map_len < sizeof(*shared) + shared->size) {
+        ring_unmap(ring);
+        return EINVAL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    ring->pos = atomic_load_explicit(&shared->tail, memory_order_relaxed);
+    ring->other = atomic_load_explicit(&shared->head, memory_order_acquire);
+    ring->pending = 0;
+    return 0;
+}
+
+/**
+ * Waits for the next message in the ring and gets where it is, without copying it. The message stays in place until
+ * it is released with `ring_release`.
+ * @param ring The consumer's side of the ring.
+ * @param data Set to the message.
+ * @param len Set to the length of the message in bytes.
+ * @param priority Set to the priority of the message.
+ * @return 0 if a message was read, EPIPE if the producer closed the ring and every message has been read, or EBADMSG if
+ * the ring holds a record that cannot be valid.
+ */
+int ring_peek(struct ring_t *ring, const uint8_t **data, size_t *len, unsigned int *priority) {
+    struct ring_shared_t *shared = ring->shared;
+    size_t size = shared->size;
+    while (1) {
+        if (ring->pos == ring->other) {
+            bool closed = atomic_load(&shared->closed);
+            ring->other = atomic_load_explicit(&shared->head, memory_order_acquire);
+            if (ring->pos == ring->other && closed) return EPIPE;
+        }
+        if (ring->pos == ring->other) {
+            atomic_store(&shared->sleeping, true);
+            ring->other = atomic_load(&shared->head);
+            if (ring->pos == ring->other && !atomic_load(&shared->closed)) {
+                while (sem_wait(&shared->wake) && errno == EINTR)
+                    ;
+            }
+            atomic_store_explicit(&shared->sleeping, false, memory_order_relaxed);
+            continue;
+        }
+
+        size_t offset = ring->pos & (size - 1);
+        struct ring_record_t header;
+        memcpy(&header, &shared->data[offset], sizeof(header));
+        if (header.len == RING_PAD) {
+            ring->pos += size - offset;
+            atomic_store_explicit(&shared->tail, ring->pos, memory_order_release);
+            continue;
+        }
+        if (record_size(header.len) > size - offset || ring->pos + record_size(header.len) > ring->other) {
+            return EBADMSG;
+        }
+
+        *data = &shared->data[offset + sizeof(header)];
+        *len = header.len;
+        *priority = header.priority;
+        ring->pending = record_size(header.len);
+        return 0;
+    }
+}
+
+/**
+ * Hands the room taken by the message returned by `ring_peek` back to the producer.
+ * @param ring The consumer's side of the ring.
+ */
+void ring_release(struct ring_t *ring) {
+    ring->pos += ring->pending;
+    ring->pending = 0;
+    atomic_store_explicit(&ring->shared->tail, ring->pos, memory_order_release);
+}
+
+/**
+ * Unmaps either side of a ring. The ring itself stays until it is unlinked.
+ * @param ring The ring.
+ */
+void ring_unmap(struct ring_t *ring) {
+    munmap(ring->shared, ring->map_len);
+    ring->shared = NULL;
+}
+
+/**
+ * Removes a ring's shared memory segment, once neither side needs to map it again.
+ * @param name The name of the segment.
+ * @return 0 if successful, otherwise the error from removing it.
+ */
+int ring_unlink(const char *name) { return shm_unlink(name) ? errno : 0; }
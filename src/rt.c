@@ -0,0 +1,95 @@
+/**
+ * @file rt.c
+ * @brief Implementation of real-time mode.
+ */
+#define _GNU_SOURCE
+#include "rt.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __QNX__
+#include <sys/neutrino.h>
+#endif
+
+/**
+ * Parses real-time settings given on the command line as a priority, optionally followed by a colon and a CPU.
+ * @param spec The settings.
+ * @param rt Set to the settings, enabled.
+ * @return 0 if the settings are valid, EINVAL otherwise.
+ */
+int rt_parse(const char *spec, struct rt_config_t *rt) {
+    char *end;
+    long priority = strtol(spec, &end, 10);
+    // The input threads run one priority lower, which must still be a real-time priority
+    if (end == spec || priority < sched_get_priority_min(SCHED_FIFO) + 1 ||
+        priority > sched_get_priority_max(SCHED_FIFO)) {
+        return EINVAL;
+    }
+
+    long cpu = -1;
+    if (*end == ':') {
+        const char *field = end + 1;
+        cpu = strtol(field, &end, 10);
+        if (end == field || cpu < 0 || cpu >= sysconf(_SC_NPROCESSORS_CONF) || cpu >= 32) return EINVAL;
+    }
+    if (*end != '\0') return EINVAL;
+
+    rt->enabled = true;
+    rt->priority = priority;
+    rt->cpu = cpu;
+    return 0;
+}
+
+/**
+ * Locks the process's memory, moves the calling thread to the input threads' priority, and sets up the attributes
+ * every thread is to be created with. Must be called before any other thread is created.
+ * @param rt The real-time settings.
+ * @param attr Initialized with a fixed stack size and inherited scheduling.
+ * @return 0 if successful, otherwise the error from locking memory or changing scheduling.
+ */
+int rt_enter(const struct rt_config_t *rt, pthread_attr_t *attr) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) return errno;
+    struct sched_param param = {.sched_priority = rt->priority - 1};
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) return err;
+
+    err = pthread_attr_init(attr);
+    if (!err) err = pthread_attr_setstacksize(attr, RT_STACK_SIZE);
+    if (!err) err = pthread_attr_setinheritsched(attr, PTHREAD_INHERIT_SCHED);
+    return err;
+}
+
+/**
+ * Touches the first part of the calling thread's stack, so that it is faulted in before it is needed.
+ */
+__attribute__((noinline)) static void prefault_stack(void) {
+    volatile uint8_t stack[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 1024) stack[i] = 0;
+}
+
+/**
+ * Makes the calling thread part of the real-time transmit path: raises it to the real-time priority, pins it to the
+ * configured CPU if there is one, and faults in its stack.
+ * @param rt The real-time settings.
+ * @return 0 if successful, otherwise the error from changing scheduling or affinity.
+ */
+int rt_thread(const struct rt_config_t *rt) {
+    struct sched_param param = {.sched_priority = rt->priority};
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (!err && rt->cpu >= 0) {
+#ifdef __QNX__
+        if (ThreadCtl(_NTO_TCTL_RUNMASK, (void *)(uintptr_t)(1u << rt->cpu)) == -1) err = errno;
+#else
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(rt->cpu, &cpus);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    }
+    prefault_stack();
+    return err;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file stats.c
+ * @brief Implementation of the per-stage latency histograms and transmission counters.
+ *
+ * A sample of n nanoseconds falls in bucket n for n < 4. Above that, each doubling from 2^e to 2^(e+1) is split into
+ * four equal buckets by the two bits below the most significant one, so a bucket is never wider than a quarter of its
+ * lower bound.
+ */
+#include "stats.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** The names of the stages, as they are reported. */
+const char *const STATS_STAGE_NAMES[STATS_STAGES] = {"queue", "frame", "assemble", "uart", "accept", "air", "total"};
+
+/** Keeps updates from different threads from interleaving, which the sequence number alone cannot. */
+static pthread_mutex_t writer = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Creates the shared memory segment the statistics are published in, replacing any left by an earlier run.
+ * @param name The name of the segment.
+ * @return The zeroed statistics in the segment, or NULL if it could not be created.
+ */
+struct stats_t *stats_open(const char *name) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return NULL;
+    if (ftruncate(fd, sizeof(struct stats_t))) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    struct stats_t *stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+    memset(stats, 0, sizeof(*stats));
+    return stats;
+}
+
+/**
+ * Unmaps the statistics and removes their shared memory segment.
+ * @param stats The statistics returned by `stats_open`.
+ * @param name The name of the segment.
+ */
+void stats_close(struct stats_t *stats, const char *name) {
+    munmap(stats, sizeof(*stats));
+    shm_unlink(name);
+}
+
+/**
+ * Maps statistics published by another process, for reading only.
+ * @param name The name of the segment.
+ * @return The statistics, or NULL if the segment does not exist or is not the expected size.
+ */
+const struct stats_t *stats_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) return NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size != (off_t)sizeof(struct stats_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    const struct stats_t *stats = mmap(NULL, sizeof(*stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return stats == MAP_FAILED ? NULL : stats;
+}
+
+/**
+ * Marks the start of an update, which readers will wait out, waiting for any update by another thread to end first.
+ * @param stats The statistics.
+ */
+void stats_begin(struct stats_t *stats) {
+    pthread_mutex_lock(&writer);
+    atomic_fetch_add_explicit(&stats->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of an update.
+ * @param stats The statistics.
+ */
+void stats_end(struct stats_t *stats) {
+    atomic_fetch_add_explicit(&stats->seq, 1, memory_order_release);
+    pthread_mutex_unlock(&writer);
+}
+
+/**
+ * Finds the bucket a sample falls in.
+ * @param ns The sample in nanoseconds.
+ * @return The index of the bucket.
+ */
+static size_t bucket_of(uint64_t ns) {
+    if (ns < 4) return ns;
+    unsigned int msb = 63 - __builtin_clzll(ns);
+    size_t bucket = (size_t)(msb - 1) * 4 + ((ns >> (msb - 2)) & 3);
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+/**
+ * Gets the longest sample that falls in a bucket.
+ * @param bucket The index of the bucket.
+ * @return The upper bound of the bucket in nanoseconds, inclusive.
+ */
+uint64_t stats_bucket_limit(size_t bucket) {
+    if (bucket < 4) return bucket;
+    uint64_t width = (uint64_t)1 << (bucket / 4 - 1);
+    return (4 + bucket % 4) * width + width - 1;
+}
+
+/**
+ * Records how long a stage took. Must be called between `stats_begin` and `stats_end`.
+ * @param stats The statistics.
+ * @param stage The stage.
+ * @param priority The priority of the packet.
+ * @param ns How long the stage took in nanoseconds. Negative durations, from a stage that was skipped, are ignored.
+ */
+void stats_record(struct stats_t *stats, Stage stage, unsigned int priority, int64_t ns) {
+    stats_add(&stats->hist[stage][priority < STATS_PRIORITIES ? priority : STATS_PRIORITIES - 1], ns);
+}
+
+/**
+ * Adds a sample to a histogram of one's own, outside the published statistics.
+ * @param hist The histogram.
+ * @param ns The sample in nanoseconds. Negative samples are ignored.
+ */
+void stats_add(struct stats_hist_t *hist, int64_t ns) {
+    if (ns < 0) return;
+    hist->count++;
+    hist->sum_ns += ns;
+    if ((uint64_t)ns > hist->max_ns) hist->max_ns = ns;
+    hist->buckets[bucket_of(ns)]++;
+}
+
+/**
+ * Gets the transmission counters of a priority, for updating between `stats_begin` and `stats_end`.
+ * @param stats The statistics.
+ * @param priority The priority.
+ * @return The counters.
+ */
+struct stats_counters_t *stats_counters(struct stats_t *stats, unsigned int priority) {
+    return &stats->counters[priority < STATS_PRIORITIES ? priority : STATS_PRIORITIES - 1];
+}
+
+/**
+ * Gets the transmission counters of a radio, for updating between `stats_begin` and `stats_end`.
+ * @param stats The statistics.
+ * @param radio The index of the radio. Radios past the last counted are counted with it.
+ * @return The counters.
+ */
+struct stats_counters_t *stats_radio(struct stats_t *stats, unsigned int radio) {
+    return &stats->radios[radio < STATS_RADIOS ? radio : STATS_RADIOS - 1];
+}
+
+/**
+ * Takes a consistent copy of statistics that may be being updated, retrying if an update overlapped the copy.
+ * @param stats The statistics.
+ * @param copy Where to copy them.
+ */
+void stats_snapshot(const struct stats_t *stats, struct stats_t *copy) {
+    unsigned int before, after;
+    do {
+        before = atomic_load_explicit(&stats->seq, memory_order_acquire);
+        memcpy(copy->hist, stats->hist, sizeof(copy->hist));
+        memcpy(copy->counters, stats->counters, sizeof(copy->counters));
+        memcpy(copy->radios, stats->radios, sizeof(copy->radios));
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&stats->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    atomic_init(&copy->seq, after);
+}
+
+/**
+ * Finds a percentile of a histogram.
+ * @param hist The histogram, which must have samples.
+ * @param pct The percentile.
+ * @return The upper bound of the bucket the percentile falls in, or the longest sample if that is less.
+ */
+static uint64_t percentile(const struct stats_hist_t *hist, unsigned int pct) {
+    uint64_t target = (hist->count * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < STATS_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen >= target) {
+            uint64_t limit = stats_bucket_limit(b);
+            return limit < hist->max_ns ? limit : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
+
+/**
+ * Summarizes a histogram.
+ * @param hist The histogram.
+ * @param summary Set to the summary, which is all zeroes if there are no samples.
+ */
+void stats_summarize(const struct stats_hist_t *hist, struct stats_summary_t *summary) {
+    memset(summary, 0, sizeof(*summary));
+    if (hist->count == 0) return;
+    summary->count = hist->count;
+    summary->mean_ns = hist->sum_ns / hist->count;
+    summary->p50_ns = percentile(hist, 50);
+    summary->p90_ns = percentile(hist, 90);
+    summary->p99_ns = percentile(hist, 99);
+    summary->max_ns = hist->max_ns;
+}
@@ -0,0 +1,520 @@
+/**
+ * @file telemetry.c
+ * @brief The packer and unpacker of the records in schema/telemetry.schema, generated by tools/packgen. Do not edit.
+ *
+ * The packer is used by broadcaster, and the unpacker is for the ground station.
+ */
+#include "telemetry.h"
+#include <string.h>
+
+/** Where a record is being packed. */
+struct bit_writer_t {
+    /** The next byte to write. */
+    uint8_t *data;
+    /** Bits written but not yet stored, from the least significant. */
+    uint64_t acc;
+    /** The number of bits in `acc`. */
+    unsigned int count;
+};
+
+/** Where a packed record is being unpacked. */
+struct bit_reader_t {
+    /** The next byte to read. */
+    const uint8_t *data;
+    /** Bits read but not yet taken, from the least significant. */
+    uint64_t acc;
+    /** The number of bits in `acc`. */
+    unsigned int count;
+};
+
+/**
+ * Appends a field to a packed record.
+ * @param bits Where the record is being packed.
+ * @param value The packed field, which must fit in its width.
+ * @param width The width of the packed field in bits, at most 32.
+ */
+static void put_bits(struct bit_writer_t *bits, uint64_t value, unsigned int width) {
+    bits->acc |= value << bits->count;
+    bits->count += width;
+    while (bits->count >= 8) {
+        *bits->data++ = (uint8_t)bits->acc;
+        bits->acc >>= 8;
+        bits->count -= 8;
+    }
+}
+
+/**
+ * Stores the last bits of a packed record.
+ * @param bits Where the record is being packed.
+ */
+static void flush_bits(struct bit_writer_t *bits) {
+    if (bits->count > 0) *bits->data++ = (uint8_t)bits->acc;
+}
+
+/**
+ * Takes the next field from a packed record.
+ * @param bits Where the record is being unpacked.
+ * @param width The width of the packed field in bits, at most 32.
+ * @return The packed field.
+ */
+static uint64_t get_bits(struct bit_reader_t *bits, unsigned int width) {
+    while (bits->count < width) {
+        bits->acc |= (uint64_t)*bits->data++ << bits->count;
+        bits->count += 8;
+    }
+    uint64_t value = bits->acc & ((UINT64_C(1) << width) - 1);
+    bits->acc >>= width;
+    bits->count -= width;
+    return value;
+}
+
+/**
+ * Reads a little-endian unsigned integer.
+ * @param data The integer.
+ * @param size The size of the integer in bytes.
+ * @return The integer.
+ */
+static uint64_t get_le(const uint8_t *data, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) value |= (uint64_t)data[i] << (8 * i);
+    return value;
+}
+
+/**
+ * Writes a little-endian integer.
+ * @param data Where to write the integer.
+ * @param value The integer, of which only the low bytes are written.
+ * @param size The size of the integer in bytes.
+ */
+static void put_le(uint8_t *data, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * Packs an integer as the number of steps above the bottom of its range.
+ * @param value The integer.
+ * @param min The bottom of the range.
+ * @param max The top of the range, a whole number of steps above the bottom.
+ * @param step The step.
+ * @return The nearest number of steps, clamped to the range.
+ */
+static uint64_t quantize_int(int64_t value, int64_t min, int64_t max, int64_t step) {
+    if (value <= min) return 0;
+    if (value >= max) return (uint64_t)(max - min) / (uint64_t)step;
+    return ((uint64_t)(value - min) + (uint64_t)step / 2) / (uint64_t)step;
+}
+
+/**
+ * Reads a little-endian unsigned integer as a signed one, which holds every unsigned field.
+ * @param data The integer.
+ * @param size The size of the integer in bytes, at most 4.
+ * @return The integer.
+ */
+static int64_t get_unsigned(const uint8_t *data, size_t size) {
+    uint64_t value = get_le(data, size);
+    return (int64_t)value;
+}
+
+/**
+ * Reads a little-endian signed integer.
+ * @param data The integer.
+ * @param size The size of the integer in bytes.
+ * @return The integer.
+ */
+static int64_t get_signed(const uint8_t *data, size_t size) {
+    uint64_t value = get_le(data, size), sign = UINT64_C(1) << (8 * size - 1);
+    return (int64_t)(value ^ sign) - (int64_t)sign;
+}
+
+/**
+ * Reads a little-endian float.
+ * @param data The float.
+ * @return The float.
+ */
+static float get_f32(const uint8_t *data) {
+    uint32_t bits = get_le(data, 4);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Writes a little-endian float.
+ * @param data Where to write the float.
+ * @param value The float.
+ */
+static void put_f32(uint8_t *data, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_le(data, bits, 4);
+}
+
+/**
+ * Packs a float as the number of steps above the bottom of its range.
+ * @param value The float.
+ * @param min The bottom of the range.
+ * @param step The step.
+ * @param top The number of steps to the top of the range.
+ * @return The nearest number of steps, clamped to the range, or 0 if the float is not a number.
+ */
+static uint64_t quantize_float(float value, float min, float step, uint64_t top) {
+    if (!(value > min)) return 0;
+    double steps = ((double)value - (double)min) / (double)step;
+    if (steps >= (double)top) return top;
+    return ((uint64_t)(2 * steps) + 1) / 2;
+}
+
+/**
+ * Unpacks a float packed as a number of steps above the bottom of its range.
+ * @param steps The number of steps.
+ * @param min The bottom of the range.
+ * @param step The step.
+ * @return The float.
+ */
+static float dequantize_float(uint64_t steps, float min, float step) {
+    return (float)((double)min + (double)steps * (double)step);
+}
+
+/** The record types, in the order of the schema. */
+const struct telemetry_record_t TELEMETRY_SCHEMA[TELEMETRY_RECORDS] = {
+    {"altitude",
+     1,
+     17,
+     12,
+     4,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"pressure", TELEMETRY_F32, 5, 17, 1, 0, 0, 0, 30000.0f, 110000.0f, 1.0f},
+             {"temperature", TELEMETRY_F32, 9, 14, 1, 0, 0, 0, -40.0f, 85.0f, 0.01f},
+             {"altitude", TELEMETRY_F32, 13, 19, 1, 0, 0, 0, -500.0f, 30000.0f, 0.1f},
+     }},
+    {"acceleration",
+     2,
+     17,
+     11,
+     4,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"x", TELEMETRY_F32, 5, 15, 1, 0, 0, 0, -160.0f, 160.0f, 0.01f},
+             {"y", TELEMETRY_F32, 9, 15, 1, 0, 0, 0, -160.0f, 160.0f, 0.01f},
+             {"z", TELEMETRY_F32, 13, 15, 1, 0, 0, 0, -160.0f, 160.0f, 0.01f},
+     }},
+    {"angular_velocity",
+     3,
+     17,
+     11,
+     4,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"x", TELEMETRY_F32, 5, 16, 1, 0, 0, 0, -2000.0f, 2000.0f, 0.1f},
+             {"y", TELEMETRY_F32, 9, 16, 1, 0, 0, 0, -2000.0f, 2000.0f, 0.1f},
+             {"z", TELEMETRY_F32, 13, 16, 1, 0, 0, 0, -2000.0f, 2000.0f, 0.1f},
+     }},
+    {"coordinates",
+     4,
+     18,
+     16,
+     5,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"latitude", TELEMETRY_I32, 5, 31, 1, -900000000, 900000000, 1, 0.0f, 0.0f, 0.0f},
+             {"longitude", TELEMETRY_I32, 9, 32, 1, -1800000000, 1800000000, 1, 0.0f, 0.0f, 0.0f},
+             {"altitude", TELEMETRY_I32, 13, 16, 1, -1000000, 5000000, 100, 0.0f, 0.0f, 0.0f},
+             {"satellites", TELEMETRY_U8, 17, 5, 1, 0, 31, 1, 0.0f, 0.0f, 0.0f},
+     }},
+    {"voltage",
+     5,
+     10,
+     8,
+     3,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"rail", TELEMETRY_U8, 5, 4, 1, 0, 15, 1, 0.0f, 0.0f, 0.0f},
+             {"voltage", TELEMETRY_F32, 6, 15, 1, 0, 0, 0, 0.0f, 20.0f, 0.001f},
+     }},
+    {"status",
+     6,
+     16,
+     9,
+     10,
+     {
+             {"time", TELEMETRY_U32, 1, 32, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"state", TELEMETRY_U8, 5, 3, 1, 0, 7, 1, 0.0f, 0.0f, 0.0f},
+             {"armed", TELEMETRY_BOOL, 6, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"launched", TELEMETRY_BOOL, 7, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"apogee", TELEMETRY_BOOL, 8, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"drogue", TELEMETRY_BOOL, 9, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"main", TELEMETRY_BOOL, 10, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"landed", TELEMETRY_BOOL, 11, 1, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"pad", TELEMETRY_PAD, 12, 0, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+             {"errors", TELEMETRY_U16, 14, 16, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f},
+     }},
+};
+
+/**
+ * Packs the fields of an altitude record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 11 bytes.
+ */
+static void pack_altitude(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_float(get_f32(&raw[4]), 30000.0f, 1.0f, 80000u), 17); // pressure
+    put_bits(&bits, quantize_float(get_f32(&raw[8]), -40.0f, 0.01f, 12500u), 14); // temperature
+    put_bits(&bits, quantize_float(get_f32(&raw[12]), -500.0f, 0.1f, 305000u), 19); // altitude
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of an altitude record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 16 bytes, which must be zero.
+ */
+static void unpack_altitude(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_f32(&raw[4], dequantize_float(get_bits(&bits, 17), 30000.0f, 1.0f)); // pressure
+    put_f32(&raw[8], dequantize_float(get_bits(&bits, 14), -40.0f, 0.01f)); // temperature
+    put_f32(&raw[12], dequantize_float(get_bits(&bits, 19), -500.0f, 0.1f)); // altitude
+}
+
+/**
+ * Packs the fields of an acceleration record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 10 bytes.
+ */
+static void pack_acceleration(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_float(get_f32(&raw[4]), -160.0f, 0.01f, 32000u), 15); // x
+    put_bits(&bits, quantize_float(get_f32(&raw[8]), -160.0f, 0.01f, 32000u), 15); // y
+    put_bits(&bits, quantize_float(get_f32(&raw[12]), -160.0f, 0.01f, 32000u), 15); // z
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of an acceleration record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 16 bytes, which must be zero.
+ */
+static void unpack_acceleration(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_f32(&raw[4], dequantize_float(get_bits(&bits, 15), -160.0f, 0.01f)); // x
+    put_f32(&raw[8], dequantize_float(get_bits(&bits, 15), -160.0f, 0.01f)); // y
+    put_f32(&raw[12], dequantize_float(get_bits(&bits, 15), -160.0f, 0.01f)); // z
+}
+
+/**
+ * Packs the fields of an angular_velocity record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 10 bytes.
+ */
+static void pack_angular_velocity(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_float(get_f32(&raw[4]), -2000.0f, 0.1f, 40000u), 16); // x
+    put_bits(&bits, quantize_float(get_f32(&raw[8]), -2000.0f, 0.1f, 40000u), 16); // y
+    put_bits(&bits, quantize_float(get_f32(&raw[12]), -2000.0f, 0.1f, 40000u), 16); // z
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of an angular_velocity record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 16 bytes, which must be zero.
+ */
+static void unpack_angular_velocity(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_f32(&raw[4], dequantize_float(get_bits(&bits, 16), -2000.0f, 0.1f)); // x
+    put_f32(&raw[8], dequantize_float(get_bits(&bits, 16), -2000.0f, 0.1f)); // y
+    put_f32(&raw[12], dequantize_float(get_bits(&bits, 16), -2000.0f, 0.1f)); // z
+}
+
+/**
+ * Packs the fields of a coordinates record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 15 bytes.
+ */
+static void pack_coordinates(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_int(get_signed(&raw[4], 4), -900000000LL, 900000000LL, 1LL), 31); // latitude
+    put_bits(&bits, quantize_int(get_signed(&raw[8], 4), -1800000000LL, 1800000000LL, 1LL), 32); // longitude
+    put_bits(&bits, quantize_int(get_signed(&raw[12], 4), -1000000LL, 5000000LL, 100LL), 16); // altitude
+    put_bits(&bits, quantize_int(get_unsigned(&raw[16], 1), 0LL, 31LL, 1LL), 5); // satellites
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of a coordinates record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 17 bytes, which must be zero.
+ */
+static void unpack_coordinates(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_le(&raw[4], (uint64_t)-900000000LL + 1u * get_bits(&bits, 31), 4); // latitude
+    put_le(&raw[8], (uint64_t)-1800000000LL + 1u * get_bits(&bits, 32), 4); // longitude
+    put_le(&raw[12], (uint64_t)-1000000LL + 100u * get_bits(&bits, 16), 4); // altitude
+    put_le(&raw[16], (uint64_t)0LL + 1u * get_bits(&bits, 5), 1); // satellites
+}
+
+/**
+ * Packs the fields of a voltage record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 7 bytes.
+ */
+static void pack_voltage(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_int(get_unsigned(&raw[4], 1), 0LL, 15LL, 1LL), 4); // rail
+    put_bits(&bits, quantize_float(get_f32(&raw[5]), 0.0f, 0.001f, 20000u), 15); // voltage
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of a voltage record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 9 bytes, which must be zero.
+ */
+static void unpack_voltage(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_le(&raw[4], (uint64_t)0LL + 1u * get_bits(&bits, 4), 1); // rail
+    put_f32(&raw[5], dequantize_float(get_bits(&bits, 15), 0.0f, 0.001f)); // voltage
+}
+
+/**
+ * Packs the fields of a status record.
+ * @param raw The fields, after the id byte.
+ * @param out Where to write the packed fields, 8 bytes.
+ */
+static void pack_status(const uint8_t *raw, uint8_t *out) {
+    struct bit_writer_t bits = {.data = out};
+    put_bits(&bits, get_le(&raw[0], 4), 32); // time
+    put_bits(&bits, quantize_int(get_unsigned(&raw[4], 1), 0LL, 7LL, 1LL), 3); // state
+    put_bits(&bits, raw[5] != 0, 1); // armed
+    put_bits(&bits, raw[6] != 0, 1); // launched
+    put_bits(&bits, raw[7] != 0, 1); // apogee
+    put_bits(&bits, raw[8] != 0, 1); // drogue
+    put_bits(&bits, raw[9] != 0, 1); // main
+    put_bits(&bits, raw[10] != 0, 1); // landed
+    put_bits(&bits, get_le(&raw[13], 2), 16); // errors
+    flush_bits(&bits);
+}
+
+/**
+ * Unpacks the fields of a status record.
+ * @param packed The packed fields, after the id byte.
+ * @param raw Where to write the fields, 15 bytes, which must be zero.
+ */
+static void unpack_status(const uint8_t *packed, uint8_t *raw) {
+    struct bit_reader_t bits = {.data = packed};
+    put_le(&raw[0], get_bits(&bits, 32), 4); // time
+    put_le(&raw[4], (uint64_t)0LL + 1u * get_bits(&bits, 3), 1); // state
+    raw[5] = get_bits(&bits, 1); // armed
+    raw[6] = get_bits(&bits, 1); // launched
+    raw[7] = get_bits(&bits, 1); // apogee
+    raw[8] = get_bits(&bits, 1); // drogue
+    raw[9] = get_bits(&bits, 1); // main
+    raw[10] = get_bits(&bits, 1); // landed
+    put_le(&raw[13], get_bits(&bits, 16), 2); // errors
+}
+
+/**
+ * Packs a record, if it is one of the record types.
+ * @param raw The message.
+ * @param len The length of the message in bytes.
+ * @param out Where to write the packed record, with room for `TELEMETRY_MAX_PACKED` bytes.
+ * @return The length of the packed record, or 0 if the message is not a record of any type.
+ */
+size_t telemetry_pack(const uint8_t *raw, size_t len, uint8_t *out) {
+    if (len == 0) return 0;
+    switch (raw[0]) {
+    case 1:
+        if (len != 17) return 0;
+        pack_altitude(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 1;
+        return 12;
+    case 2:
+        if (len != 17) return 0;
+        pack_acceleration(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 2;
+        return 11;
+    case 3:
+        if (len != 17) return 0;
+        pack_angular_velocity(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 3;
+        return 11;
+    case 4:
+        if (len != 18) return 0;
+        pack_coordinates(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 4;
+        return 16;
+    case 5:
+        if (len != 10) return 0;
+        pack_voltage(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 5;
+        return 8;
+    case 6:
+        if (len != 16) return 0;
+        pack_status(&raw[1], &out[1]);
+        out[0] = TELEMETRY_PACKED | 6;
+        return 9;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Unpacks a record packed with `telemetry_pack`.
+ * @param packed The packed record.
+ * @param len The length of the packed record in bytes.
+ * @param out Where to write the record, with room for `TELEMETRY_MAX_RAW` bytes.
+ * @return The length of the record, or 0 if the message is not a packed record of any type.
+ */
+size_t telemetry_unpack(const uint8_t *packed, size_t len, uint8_t *out) {
+    if (len == 0 || !(packed[0] & TELEMETRY_PACKED)) return 0;
+    switch (packed[0] & ~TELEMETRY_PACKED) {
+    case 1:
+        if (len != 12) return 0;
+        memset(out, 0, 17);
+        out[0] = 1;
+        unpack_altitude(&packed[1], &out[1]);
+        return 17;
+    case 2:
+        if (len != 11) return 0;
+        memset(out, 0, 17);
+        out[0] = 2;
+        unpack_acceleration(&packed[1], &out[1]);
+        return 17;
+    case 3:
+        if (len != 11) return 0;
+        memset(out, 0, 17);
+        out[0] = 3;
+        unpack_angular_velocity(&packed[1], &out[1]);
+        return 17;
+    case 4:
+        if (len != 16) return 0;
+        memset(out, 0, 18);
+        out[0] = 4;
+        unpack_coordinates(&packed[1], &out[1]);
+        return 18;
+    case 5:
+        if (len != 8) return 0;
+        memset(out, 0, 10);
+        out[0] = 5;
+        unpack_voltage(&packed[1], &out[1]);
+        return 10;
+    case 6:
+        if (len != 9) return 0;
+        memset(out, 0, 16);
+        out[0] = 6;
+        unpack_status(&packed[1], &out[1]);
+        return 16;
+    default:
+        return 0;
+    }
+}
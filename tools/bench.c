@@ -0,0 +1,891 @@
+/**
+ * @file bench.c
+ * @brief A benchmark driver that pushes packets through broadcaster into the RN2483 emulator.
+ *
+ * The driver starts `rn2483sim` with traffic logging enabled, starts broadcaster on the emulator's pseudo-terminal and
+ * then feeds it packets through the input message queue, a shared memory ring, or stdin as hex lines or binary frames.
+ * Each payload begins with a 32-bit sequence number, which lets the driver match the `radio tx` commands and
+ * `radio_tx_ok` responses in the emulator's log to the time each packet was handed to broadcaster.
+ *
+ * When broadcaster aggregates messages (`-a` is passed to both), each frame is split into its messages first. When it
+ * compresses frames (`-z` is passed to both), each frame is decompressed with the reference decoder before that. When
+ * it protects packets with parity (`-F` is passed to both), the FEC header is removed first and parity packets, which
+ * carry no messages of their own, are skipped. When it adapts its data rate (`-A` is passed to both), the profile
+ * header is removed before anything else, and the profiles are followed the way a receiver would. When it fragments
+ * messages (`-G` is passed to both), each message is put back together with the reference reassembler after the frame
+ * is split, and a message counts as received when its last fragment is. With `-K streams`, each payload starts with a
+ * stream id before its sequence number, cycling through that many streams, so broadcaster's keyed mode (`-K`) can be
+ * measured: only the packets it did not replace with a newer one of their stream are delivered. When it numbers its
+ * frames (`-H` is passed to both), the link header is removed after the profile header and every frame that reaches
+ * the air is fed to the reference analyzer, with the end of its transmission as the time it was received.
+ *
+ * With `-p priority`, packets are sent at that priority rather than 0. Frames the emulator reports lost on the way
+ * down (`-O -D -O percent`) do not count as delivered, so a packet only counts once a frame carrying it reaches the
+ * ground station, and the receive windows broadcaster opens for acknowledgements (`-N`) are counted.
+ *
+ * It reports startup time, throughput and the p50/p99/max latency from hand-off to the packet reaching the module
+ * (UART) and to the end of its transmission (air). Before stopping broadcaster, it also reads the statistics
+ * broadcaster publishes and reports the spread of the time from a packet being taken off the transmit queue to its
+ * command being written to the UART, which with `-L threads` is measured while that many processes keep the CPU busy,
+ * to compare broadcaster's real-time mode (`-T`) with normal scheduling.
+ */
+#define _GNU_SOURCE
+#include "aggregate.h"
+#include "compress.h"
+#include "fec.h"
+#include "fragment.h"
+#include "linkhdr.h"
+#include "ring.h"
+#include "stats.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The largest number of packets a single run can send. */
+#define MAX_PACKETS 100000
+
+/** The largest payload broadcaster accepts from the input queue, unless it fragments messages. */
+#define MAX_PAYLOAD RADIO_MAX_PAYLOAD
+
+/** How long the reassembler waits for the rest of a fragmented message, in milliseconds. */
+#define FRAG_TIMEOUT_MS 10000
+
+/** The maximum number of arguments that can be forwarded to broadcaster or the emulator. */
+#define MAX_ARGS 64
+
+/** How long to wait for outstanding packets after the last one has been sent, in nanoseconds. */
+#define DRAIN_TIMEOUT (3 * NS_PER_S)
+
+/** The number of commands whose first-stage response has not yet been seen that can be tracked. */
+#define MAX_INFLIGHT 64
+
+/** Nanoseconds in one second. */
+#define NS_PER_S 1000000000LL
+
+/** Nanoseconds in one millisecond. */
+#define NS_PER_MS 1000000LL
+
+/** The most processes that can load the CPU. */
+#define MAX_LOAD 64
+
+/** The memory each load process sweeps, larger than most caches so that it also evicts broadcaster's data. */
+#define LOAD_BYTES (8 * 1024 * 1024)
+
+/** Ways of feeding packets to broadcaster. */
+typedef enum {
+    MODE_QUEUE,  /**< Through the POSIX input message queue. */
+    MODE_STDIN,  /**< As hex lines on stdin. */
+    MODE_BINARY, /**< As length-prefixed binary frames on stdin. */
+    MODE_RING,   /**< Through a shared memory input ring. */
+} InputMode;
+
+/** Timestamps collected for one packet, in monotonic nanoseconds. 0 means the event was not seen. */
+struct sample_t {
+    /** When the packet was handed to broadcaster. */
+    int64_t sent;
+    /** When the emulator finished receiving the `radio tx` command carrying the packet. */
+    int64_t uart;
+    /** When the emulator reported the end of transmission with `radio_tx_ok`. */
+    int64_t air;
+};
+
+/** The sequence numbers of the packets carried by one radio frame. */
+struct frame_seqs_t {
+    /** Whether the command was a `radio tx`. */
+    bool is_tx;
+    /** The number of packets in the frame. */
+    size_t count;
+    /** The sequence number of each packet. */
+    unsigned long seq[RADIO_MAX_PAYLOAD / 5 + 1];
+    /** Whether the frame carried a link header. */
+    bool numbered;
+    /** The frame's link header. */
+    struct lhdr_t header;
+    /** The length of the link header in bytes. */
+    size_t header_len;
+    /** The length of the frame in bytes, headers included. */
+    size_t frame_len;
+    /** Whether the ground station did not hear the frame. */
+    bool lost;
+};
+
+/** Results shared between the emulator log reader and the main thread. */
+struct results_t {
+    /** Protects every field of this struct. */
+    pthread_mutex_t lock;
+    /** When broadcaster first finished configuring the module with `mac pause`. */
+    int64_t configured;
+    /** Number of `radio tx` commands the module accepted. */
+    unsigned long accepted;
+    /** Number of `radio_tx_ok` responses. */
+    unsigned long tx_ok;
+    /** Number of `radio_err` responses. */
+    unsigned long tx_err;
+    /** Number of `busy` responses. */
+    unsigned long busy;
+    /** Number of `invalid_param` responses. */
+    unsigned long invalid;
+    /** Number of brown-outs injected by the emulator. */
+    unsigned long brownouts;
+    /** Number of frames that were sent but not heard by the ground station. */
+    unsigned long lost;
+    /** Number of `radio rx` receive windows opened. */
+    unsigned long windows;
+    /** Number of acknowledgements received in a receive window. */
+    unsigned long acks;
+    /** Number of receive windows that closed without an acknowledgement. */
+    unsigned long rx_timeouts;
+    /** Number of acknowledgements the ground station sent that the module did not hear. */
+    unsigned long acks_lost;
+    /** Time of the last event of any kind. */
+    int64_t last_event;
+    /** The baud rate the module's UART ended up at. */
+    unsigned int baud;
+    /** The number of packets sent with each adaptive data rate profile. */
+    unsigned long profile_packets[16];
+    /** The number of times the profile changed between packets. */
+    unsigned long profile_switches;
+    /** The number of packets sent with a different profile than the previous packet announced. */
+    unsigned long profile_errors;
+    /** What the link headers of the frames that reached the air show. */
+    struct lhdr_stats_t link;
+};
+
+/** Default path of the broadcaster binary. Arrays rather than literals, since they end up in argument vectors. */
+static char DEFAULT_BROADCASTER[] = "./build/broadcaster";
+
+/** Default path of the emulator binary. */
+static char DEFAULT_SIM[] = "./build/rn2483sim";
+
+/** Default name of the input queue or ring. */
+static char DEFAULT_QUEUE[] = "/plogger-out";
+
+/** Flag enabling the emulator's traffic log. */
+static char FLAG_VERBOSE[] = "-v";
+
+/** Flag making broadcaster read from stdin. */
+static char FLAG_STDIN[] = "-i";
+
+/** Flag making broadcaster read binary frames from a file, and the name of stdin as that file. */
+static char FLAG_BINARY[] = "-I", FILE_STDIN[] = "-";
+
+/** Flag making broadcaster read from a shared memory ring. */
+static char FLAG_RING[] = "-S";
+
+/** The names of the input modes, as they are given and reported. */
+static const char *const MODE_NAMES[] = {[MODE_QUEUE] = "queue", [MODE_STDIN] = "stdin", [MODE_BINARY] = "binary",
+                                         [MODE_RING] = "ring"};
+
+/** Benchmark configuration. */
+static struct {
+    InputMode mode;
+    unsigned long count;
+    size_t size;
+    unsigned long rate;
+    char *broadcaster;
+    char *sim;
+    char *queue;
+    char *bc_args[MAX_ARGS];
+    int n_bc_args;
+    char *sim_args[MAX_ARGS];
+    int n_sim_args;
+    bool aggregated;
+    bool compressed;
+    bool protected;
+    bool adaptive;
+    bool fragmented;
+    bool numbered;
+    unsigned int streams;
+    unsigned int load;
+    unsigned int priority;
+} config = {.mode = MODE_QUEUE,
+            .count = 1000,
+            .size = 32,
+            .rate = 0,
+            .broadcaster = DEFAULT_BROADCASTER,
+            .sim = DEFAULT_SIM,
+            .queue = DEFAULT_QUEUE};
+
+/** Per-packet timestamps, indexed by sequence number. */
+static struct sample_t samples[MAX_PACKETS];
+
+/** Shared results. */
+static struct results_t results = {.lock = PTHREAD_MUTEX_INITIALIZER, .baud = 57600};
+
+/** Scratch space for sorting latencies. */
+static int64_t sorted[MAX_PACKETS];
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+/**
+ * Finds the sequence numbers of the packets carried by a `radio tx` payload.
+ * @param hex The hex payload of a `radio tx` command.
+ * @param frame Set to the sequence numbers found, which are checked to be within the run.
+ */
+static void decode_frame(const char *hex, struct frame_seqs_t *frame) {
+    static struct comp_decoder_t decoder = {.seq = -1};
+    static struct fec_decoder_t fec_decoder = {.group = -1};
+    static struct frag_decoder_t frag_decoder = {.timeout_ms = FRAG_TIMEOUT_MS};
+    static uint8_t message[FRAG_MAX_MESSAGE];
+    static char last_hex[2 * RADIO_MAX_PAYLOAD + 1];
+    static struct frame_seqs_t last_frame;
+    static int previous = -1, announced = -1;
+
+    /* A retried command carries the same frame, which the stateful decoders must not see twice. */
+    bool stateful = config.compressed || config.protected || config.adaptive || config.fragmented;
+    if (stateful && !strcmp(hex, last_hex)) {
+        *frame = last_frame;
+        return;
+    }
+
+    uint8_t data[RADIO_MAX_PAYLOAD];
+    size_t len = 0;
+    for (; len < sizeof(data) && isxdigit(hex[2 * len]) && isxdigit(hex[2 * len + 1]); len++) {
+        char byte[3] = {hex[2 * len], hex[2 * len + 1], '\0'};
+        data[len] = strtoul(byte, NULL, 16);
+    }
+
+    frame->count = 0;
+    frame->numbered = false;
+    frame->frame_len = len;
+    if (stateful) {
+        snprintf(last_hex, sizeof(last_hex), "%s", hex);
+        last_frame.count = 0;
+    }
+    if (config.adaptive) {
+        if (len < 1) return;
+        int profile = data[0] >> 4;
+        if (announced != -1 && profile != announced) results.profile_errors++;
+        if (previous != -1 && profile != previous) results.profile_switches++;
+        previous = profile;
+        announced = data[0] & 0x0f;
+        results.profile_packets[profile]++;
+        memmove(data, &data[1], --len);
+    }
+    if (config.numbered) {
+        if (lhdr_decode(data, len, &frame->header, &frame->header_len)) return;
+        frame->numbered = true;
+        if (stateful) last_frame = *frame;
+        len -= frame->header_len;
+        memmove(data, &data[frame->header_len], len);
+    }
+    if (config.protected) {
+        const uint8_t *payload;
+        if (fec_decode(&fec_decoder, data, len) || fec_next(&fec_decoder, &payload, &len)) return;
+        memmove(data, payload, len);
+    }
+    if (config.compressed) {
+        uint8_t encoded[RADIO_MAX_PAYLOAD];
+        memcpy(encoded, data, len);
+        if (comp_decode(&decoder, encoded, len, data, &len)) return;
+    }
+
+    const uint8_t *msg = data;
+    size_t msg_len = len, offset = 0;
+    bool first = true;
+    while (config.aggregated ? agg_next(data, len, &offset, &msg, &msg_len) == 0 : first) {
+        first = false;
+        if (config.fragmented) {
+            if (frag_decode(&frag_decoder, msg, msg_len, now_ns() / NS_PER_MS, message, &msg_len)) continue;
+            msg = message;
+        }
+        size_t at = config.streams ? 1 : 0;
+        if (msg_len < at + 4) break;
+        unsigned long seq =
+            (unsigned long)msg[at] << 24 | (unsigned long)msg[at + 1] << 16 | msg[at + 2] << 8 | msg[at + 3];
+        if (seq >= config.count) break;
+        frame->seq[frame->count++] = seq;
+    }
+    if (stateful) last_frame = *frame;
+}
+
+/**
+ * Reads the emulator's traffic log and records events against packets until the log ends.
+ * @param arg A `FILE *` of the emulator's stdout.
+ * @return NULL.
+ */
+static void *log_reader(void *arg) {
+    FILE *log = arg;
+    char line[1100];
+
+    /* First-stage responses arrive in command order, so the sequence number of each command is queued until then. */
+    static struct frame_seqs_t inflight[MAX_INFLIGHT];
+    size_t head = 0, tail = 0;
+    struct frame_seqs_t on_air = {.count = 0};
+    bool listening = false;
+
+    while (fgets(line, sizeof(line), log) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *text;
+        long long when = strtoll(line, &text, 10);
+        if (text[0] != ' ' || text[1] == '\0' || text[2] != ' ') continue;
+        char direction = text[1];
+        text += 3;
+
+        pthread_mutex_lock(&results.lock);
+        // Brown-outs happen whether or not there is traffic, so they do not keep the link from going quiet
+        if (direction != '*' || strcmp(text, "brownout")) results.last_event = when;
+        if (direction == '>') {
+            struct frame_seqs_t *frame = &inflight[tail++ % MAX_INFLIGHT];
+            frame->count = 0;
+            frame->lost = false;
+            frame->is_tx = !strncmp(text, "radio tx ", 9);
+            if (!strncmp(text, "radio rx ", 9)) {
+                results.windows++;
+                listening = true;
+            } else if (!strcmp(text, "radio rxstop")) {
+                listening = false;
+            }
+            if (frame->is_tx) {
+                decode_frame(text + 9, frame);
+                for (size_t i = 0; i < frame->count; i++) {
+                    if (samples[frame->seq[i]].uart == 0) samples[frame->seq[i]].uart = when;
+                }
+            } else if (!strcmp(text, "mac pause") && results.configured == 0) {
+                results.configured = when;
+            }
+        } else if (direction == '<' && !strcmp(text, "radio_tx_ok") && on_air.lost) {
+            results.tx_ok++;
+            results.lost++;
+        } else if (direction == '<' && !strcmp(text, "radio_tx_ok")) {
+            results.tx_ok++;
+            if (on_air.numbered) {
+                lhdr_observe(&results.link, &on_air.header, on_air.header_len, on_air.frame_len, when / NS_PER_MS);
+            }
+            for (size_t i = 0; i < on_air.count; i++) {
+                if (samples[on_air.seq[i]].air == 0) samples[on_air.seq[i]].air = when;
+            }
+        } else if (direction == '<' && !strcmp(text, "radio_err") && listening) {
+            results.rx_timeouts++;
+            listening = false;
+        } else if (direction == '<' && !strncmp(text, "radio_rx", 8)) {
+            results.acks++;
+            listening = false;
+        } else if (direction == '<' && !strcmp(text, "radio_err")) {
+            results.tx_err++;
+        } else if (direction == '*' && !strcmp(text, "brownout")) {
+            results.brownouts++;
+            head = tail; // Responses the module had yet to send are lost
+            on_air.count = 0;
+        } else if (direction == '*' && !strcmp(text, "lost")) {
+            // The emulator decides as soon as it accepts the command, before its response is sent
+            if (head != tail) inflight[(tail - 1) % MAX_INFLIGHT].lost = true;
+        } else if (direction == '*' && !strcmp(text, "ack lost")) {
+            results.acks_lost++;
+        } else if (direction == '*') {
+            sscanf(text, "baud %u", &results.baud);
+        } else if (head != tail) {
+            struct frame_seqs_t *frame = &inflight[head++ % MAX_INFLIGHT];
+            if (!strcmp(text, "ok") && frame->is_tx) {
+                results.accepted++;
+                on_air = *frame;
+            } else if (!strcmp(text, "busy")) {
+                results.busy++;
+            } else if (!strcmp(text, "invalid_param")) {
+                results.invalid++;
+            }
+        }
+        pthread_mutex_unlock(&results.lock);
+    }
+    return NULL;
+}
+
+/**
+ * Starts a child process with its stdin and/or stdout connected to pipes.
+ * @param argv The NULL-terminated argument vector, where argv[0] is the program path.
+ * @param in If not NULL, set to the write end of a pipe connected to the child's stdin.
+ * @param out If not NULL, set to the read end of a pipe connected to the child's stdout.
+ * @return The child's process ID.
+ */
+static pid_t spawn(char *const argv[], int *in, int *out) {
+    int in_pipe[2], out_pipe[2];
+    if ((in != NULL && pipe(in_pipe)) || (out != NULL && pipe(out_pipe))) {
+        fprintf(stderr, "Could not create pipe: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        fprintf(stderr, "Could not fork: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        if (in != NULL) {
+            dup2(in_pipe[0], STDIN_FILENO);
+            close(in_pipe[0]);
+            close(in_pipe[1]);
+        }
+        if (out != NULL) {
+            dup2(out_pipe[1], STDOUT_FILENO);
+            close(out_pipe[0]);
+            close(out_pipe[1]);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "Could not run %s: %s\n", argv[0], strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    if (in != NULL) {
+        close(in_pipe[0]);
+        *in = in_pipe[1];
+    }
+    if (out != NULL) {
+        close(out_pipe[1]);
+        *out = out_pipe[0];
+    }
+    return pid;
+}
+
+/**
+ * Keeps a CPU busy until killed, sweeping through memory so that the caches are kept busy too.
+ */
+static void burn(void) {
+    static volatile uint8_t memory[LOAD_BYTES];
+    for (size_t i = 0;; i = (i + 64) % LOAD_BYTES) memory[i]++;
+}
+
+/**
+ * Reads the time from packets being taken off broadcaster's transmit queue to their `radio tx` commands being written,
+ * at every priority, from the statistics broadcaster publishes while it runs. At a rate the radio keeps up with, this
+ * is how long broadcaster's own threads take to be scheduled and to handle each packet.
+ * @param summary Set to a summary of the times.
+ * @return 0 if successful, or ENOENT if broadcaster published no statistics.
+ */
+static int read_jitter(struct stats_summary_t *summary) {
+    const struct stats_t *published = stats_attach(STATS_SHM_NAME);
+    if (published == NULL) return ENOENT;
+    static struct stats_t snapshot;
+    stats_snapshot(published, &snapshot);
+
+    // The frame stage ends as the command starts being assembled, which is well under a microsecond before the write
+    struct stats_hist_t total = {0};
+    for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+        const struct stats_hist_t *hist = &snapshot.hist[STAGE_FRAME][p];
+        total.count += hist->count;
+        total.sum_ns += hist->sum_ns;
+        if (hist->max_ns > total.max_ns) total.max_ns = hist->max_ns;
+        for (size_t b = 0; b < STATS_BUCKETS; b++) total.buckets[b] += hist->buckets[b];
+    }
+    stats_summarize(&total, summary);
+    return 0;
+}
+
+/**
+ * Compares two latencies for sorting.
+ * @param a The first latency.
+ * @param b The second latency.
+ * @return Negative, zero or positive as a is less than, equal to or greater than b.
+ */
+static int cmp_latency(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Prints the p50, p99 and maximum of the latency from hand-off to one of the packet's events.
+ * @param label The name of the event.
+ * @param event_offset The offset of the event's timestamp within `struct sample_t`.
+ * @return The number of packets that reached the event.
+ */
+static size_t report_latency(const char *label, size_t event_offset) {
+    size_t n = 0;
+    for (unsigned long i = 0; i < config.count; i++) {
+        int64_t event = *(const int64_t *)((const char *)&samples[i] + event_offset);
+        if (event != 0 && samples[i].sent != 0) sorted[n++] = event - samples[i].sent;
+    }
+    if (n == 0) {
+        printf("latency to %-5s: no packets\n", label);
+        return 0;
+    }
+    qsort(sorted, n, sizeof(sorted[0]), cmp_latency);
+    printf("latency to %-5s: p50 %.3f ms, p99 %.3f ms, max %.3f ms (%zu packets)\n", label,
+           (double)sorted[n / 2] / NS_PER_MS, (double)sorted[(n * 99) / 100] / NS_PER_MS,
+           (double)sorted[n - 1] / NS_PER_MS, n);
+    return n;
+}
+
+/**
+ * Prints what the link headers of the frames that reached the air show: their overhead, loss and bursts of loss, and
+ * the latency from queue to radio and from queue to the end of transmission.
+ * @param link What the analyzer measured.
+ */
+static void report_link(const struct lhdr_stats_t *link) {
+    if (link->received == 0) {
+        printf("link header: no frames\n");
+        return;
+    }
+    printf("link header: %.2f bytes per frame (%.1f%% of frame bytes), %llu frames, %llu lost (%.2f%%), %llu "
+           "duplicates, %llu longest burst\n",
+           (double)link->header_bytes / (double)(link->received + link->duplicates),
+           (double)link->header_bytes * 100 / (double)link->frame_bytes, (unsigned long long)link->received,
+           (unsigned long long)link->lost, lhdr_loss(link) * 100, (unsigned long long)link->duplicates,
+           (unsigned long long)link->max_burst);
+    struct stats_summary_t wait, age;
+    stats_summarize(&link->wait, &wait);
+    stats_summarize(&link->age, &age);
+    printf("link latency: queue to radio p50 %.0f ms, p99 %.0f ms, queue to air p50 %.0f ms, p99 %.0f ms\n",
+           (double)wait.p50_ns / NS_PER_MS, (double)wait.p99_ns / NS_PER_MS, (double)age.p50_ns / NS_PER_MS,
+           (double)age.p99_ns / NS_PER_MS);
+}
+
+/**
+ * Prints usage information.
+ * @param prog The name of the program.
+ */
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-m queue|stdin|binary|ring] [-n count] [-s size] [-r rate] [-x broadcaster] [-S sim]\n"
+            "          [-q queue] [-p priority] [-a] [-z] [-F] [-A] [-G] [-H] [-K streams] [-L threads]\n"
+            "          [-O sim-option]...\n"
+            "          [-- broadcaster-options...]\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, ":m:n:s:r:x:S:q:p:O:K:L:azFAGH")) != -1) {
+        switch (c) {
+        case 'm':
+            if (!strcmp(optarg, "queue")) config.mode = MODE_QUEUE;
+            else if (!strcmp(optarg, "stdin")) config.mode = MODE_STDIN;
+            else if (!strcmp(optarg, "binary")) config.mode = MODE_BINARY;
+            else if (!strcmp(optarg, "ring")) config.mode = MODE_RING;
+            else {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'n':
+            config.count = strtoul(optarg, NULL, 10);
+            if (config.count == 0 || config.count > MAX_PACKETS) {
+                fprintf(stderr, "Packet count must be between 1 and %d\n", MAX_PACKETS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            config.size = strtoul(optarg, NULL, 10);
+            if (config.size < 4 || config.size > FRAG_MAX_MESSAGE) {
+                fprintf(stderr, "Payload size must be between 4 and %d\n", FRAG_MAX_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'r':
+            config.rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            config.broadcaster = optarg;
+            break;
+        case 'S':
+            config.sim = optarg;
+            break;
+        case 'q':
+            config.queue = optarg;
+            break;
+        case 'p':
+            config.priority = strtoul(optarg, NULL, 10);
+            if (config.priority > 255) {
+                fprintf(stderr, "Priority must be at most 255\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'a':
+            config.aggregated = true;
+            break;
+        case 'z':
+            config.compressed = true;
+            break;
+        case 'F':
+            config.protected = true;
+            break;
+        case 'A':
+            config.adaptive = true;
+            break;
+        case 'G':
+            config.fragmented = true;
+            break;
+        case 'H':
+            config.numbered = true;
+            break;
+        case 'K':
+            config.streams = strtoul(optarg, NULL, 10);
+            if (config.streams == 0 || config.streams > 256) {
+                fprintf(stderr, "Number of streams must be between 1 and 256\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            config.load = strtoul(optarg, NULL, 10);
+            if (config.load > MAX_LOAD) {
+                fprintf(stderr, "Number of load processes must be at most %d\n", MAX_LOAD);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'O':
+            if (config.n_sim_args < MAX_ARGS - 4) config.sim_args[config.n_sim_args++] = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!config.fragmented && config.size > MAX_PAYLOAD) {
+        fprintf(stderr, "Payloads longer than %d bytes must be fragmented with -G\n", MAX_PAYLOAD);
+        exit(EXIT_FAILURE);
+    }
+    if (config.streams && config.size < 5) {
+        fprintf(stderr, "Payloads must be at least 5 bytes to carry a stream id\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config.priority > 0 && config.mode == MODE_STDIN) {
+        fprintf(stderr, "Hex lines on stdin carry no priority\n");
+        exit(EXIT_FAILURE);
+    }
+    for (; optind < argc && config.n_bc_args < MAX_ARGS - 4; optind++) {
+        config.bc_args[config.n_bc_args++] = argv[optind];
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    /* The queue must exist before broadcaster starts, since it does not create it. */
+    mqd_t queue = (mqd_t)-1;
+    if (config.mode == MODE_QUEUE) {
+        struct mq_attr attr = {.mq_maxmsg = 10, .mq_msgsize = config.size > 512 ? config.size : 512};
+        mq_unlink(config.queue);
+        queue = mq_open(config.queue, O_CREAT | O_WRONLY, 0600, &attr);
+        if (queue == (mqd_t)-1) {
+            fprintf(stderr, "Could not create queue %s: %s\n", config.queue, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    static struct ring_t ring;
+    if (config.mode == MODE_RING) {
+        int err = ring_create(&ring, config.queue, RING_DEFAULT_SIZE);
+        if (err) {
+            fprintf(stderr, "Could not create ring %s: %s\n", config.queue, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Start the emulator and wait for it to report its pseudo-terminal. */
+    char *sim_argv[MAX_ARGS + 3];
+    int n = 0;
+    sim_argv[n++] = config.sim;
+    sim_argv[n++] = FLAG_VERBOSE;
+    for (int i = 0; i < config.n_sim_args; i++) sim_argv[n++] = config.sim_args[i];
+    sim_argv[n] = NULL;
+
+    int sim_out;
+    pid_t sim = spawn(sim_argv, NULL, &sim_out);
+    FILE *sim_log = fdopen(sim_out, "r");
+    char pty[256];
+    char first[sizeof(pty) + 8];
+    if (fgets(first, sizeof(first), sim_log) == NULL || sscanf(first, "pty %255s", pty) != 1) {
+        fprintf(stderr, "Emulator did not report its pseudo-terminal\n");
+        kill(sim, SIGTERM);
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_t reader;
+    pthread_create(&reader, NULL, log_reader, sim_log);
+
+    /* Load the CPU before broadcaster starts, at normal priority. */
+    static pid_t burners[MAX_LOAD];
+    for (unsigned int i = 0; i < config.load; i++) {
+        burners[i] = fork();
+        if (burners[i] == 0) burn();
+    }
+
+    /* Start broadcaster on the emulator. */
+    char *bc_argv[MAX_ARGS + 3];
+    n = 0;
+    bc_argv[n++] = config.broadcaster;
+    for (int i = 0; i < config.n_bc_args; i++) bc_argv[n++] = config.bc_args[i];
+    if (config.mode == MODE_STDIN) bc_argv[n++] = FLAG_STDIN;
+    if (config.mode == MODE_RING) {
+        bc_argv[n++] = FLAG_RING;
+        bc_argv[n++] = config.queue;
+    }
+    if (config.mode == MODE_BINARY) {
+        bc_argv[n++] = FLAG_BINARY;
+        bc_argv[n++] = FILE_STDIN;
+    }
+    bc_argv[n++] = pty;
+    bc_argv[n] = NULL;
+
+    int bc_in = -1;
+    int64_t start = now_ns();
+    bool piped = config.mode == MODE_STDIN || config.mode == MODE_BINARY;
+    pid_t bc = spawn(bc_argv, piped ? &bc_in : NULL, NULL);
+
+    /* Feed packets, each starting with its sequence number. */
+    static uint8_t payload[FRAG_MAX_MESSAGE];
+    static char line[2 * FRAG_MAX_MESSAGE + 2];
+    for (size_t i = 4; i < config.size; i++) payload[i] = (uint8_t)i;
+
+    int64_t interval = config.rate ? NS_PER_S / (int64_t)config.rate : 0;
+    int64_t next = now_ns();
+    for (unsigned long seq = 0; seq < config.count; seq++) {
+        if (interval) {
+            while (now_ns() < next) {
+                struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000};
+                nanosleep(&ts, NULL);
+            }
+            next += interval;
+        }
+
+        size_t at = 0;
+        if (config.streams) payload[at++] = seq % config.streams;
+        payload[at++] = seq >> 24;
+        payload[at++] = seq >> 16;
+        payload[at++] = seq >> 8;
+        payload[at] = seq;
+
+        int64_t sent = now_ns();
+        pthread_mutex_lock(&results.lock);
+        samples[seq].sent = sent;
+        pthread_mutex_unlock(&results.lock);
+
+        if (config.mode == MODE_QUEUE) {
+            if (mq_send(queue, (const char *)payload, config.size, config.priority)) {
+                fprintf(stderr, "Could not send to queue: %s\n", strerror(errno));
+                break;
+            }
+        } else if (config.mode == MODE_RING) {
+            // A full ring is waited out the way a full message queue blocks the sender
+            int err;
+            while ((err = ring_send(&ring, payload, config.size, config.priority)) == EAGAIN) {
+                struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000};
+                nanosleep(&ts, NULL);
+            }
+            if (err) {
+                fprintf(stderr, "Could not send to ring: %s\n", strerror(err));
+                break;
+            }
+        } else {
+            size_t len = 0;
+            if (config.mode == MODE_BINARY) {
+                line[len++] = config.priority;
+                line[len++] = config.size >> 8;
+                line[len++] = config.size;
+                memcpy(&line[len], payload, config.size);
+                len += config.size;
+            } else {
+                for (size_t i = 0; i < config.size; i++) len += sprintf(&line[len], "%02x", payload[i]);
+                line[len++] = '\n';
+            }
+            if (write(bc_in, line, len) != (ssize_t)len) {
+                fprintf(stderr, "Could not write to broadcaster: %s\n", strerror(errno));
+                break;
+            }
+        }
+    }
+    int64_t send_done = now_ns();
+
+    /* Wait for the last packets to drain, or for the link to go quiet. */
+    while (1) {
+        struct timespec ts = {.tv_sec = 0, .tv_nsec = 50 * NS_PER_MS};
+        nanosleep(&ts, NULL);
+
+        pthread_mutex_lock(&results.lock);
+        bool done = samples[config.count - 1].air != 0;
+        int64_t last = results.last_event > send_done ? results.last_event : send_done;
+        pthread_mutex_unlock(&results.lock);
+        if (done || now_ns() - last > DRAIN_TIMEOUT) break;
+    }
+
+    struct stats_summary_t jitter;
+    int jitter_err = read_jitter(&jitter);
+    for (unsigned int i = 0; i < config.load; i++) {
+        kill(burners[i], SIGKILL);
+        waitpid(burners[i], NULL, 0);
+    }
+
+    if (bc_in != -1) close(bc_in);
+    kill(bc, SIGTERM);
+    waitpid(bc, NULL, 0);
+    kill(sim, SIGTERM);
+    waitpid(sim, NULL, 0);
+    pthread_join(reader, NULL);
+    if (queue != (mqd_t)-1) {
+        mq_close(queue);
+        mq_unlink(config.queue);
+    }
+    if (config.mode == MODE_RING) {
+        ring_unmap(&ring);
+        ring_unlink(config.queue);
+    }
+
+    /* Report. */
+    int64_t first_uart = 0, last_air = 0;
+    for (unsigned long i = 0; i < config.count; i++) {
+        if (samples[i].uart && (first_uart == 0 || samples[i].uart < first_uart)) first_uart = samples[i].uart;
+        if (samples[i].air > last_air) last_air = samples[i].air;
+    }
+
+    printf("mode: %s, %lu packets of %zu bytes\n", MODE_NAMES[config.mode], config.count, config.size);
+    printf("startup: %.3f ms to configure, %.3f ms to first packet\n",
+           (double)(results.configured ? results.configured - start : -NS_PER_MS) / NS_PER_MS,
+           (double)(first_uart ? first_uart - start : -NS_PER_MS) / NS_PER_MS);
+    printf("module: %lu accepted, %lu radio_tx_ok, %lu radio_err, %lu busy, %lu invalid_param\n", results.accepted,
+           results.tx_ok, results.tx_err, results.busy, results.invalid);
+    if (results.brownouts > 0) printf("brown-outs: %lu\n", results.brownouts);
+    if (results.lost > 0 || results.windows > 0) {
+        printf("radio link: %lu frames lost on the way down, %lu receive windows, %lu acknowledgements, %lu timed out, "
+               "%lu acknowledgements lost\n",
+               results.lost, results.windows, results.acks, results.rx_timeouts, results.acks_lost);
+    }
+
+    /* A radio tx command is "radio tx ", two hex digits per byte and "\r\n", ten bits per character on the wire. */
+    size_t command_size = config.size < MAX_PAYLOAD ? config.size : MAX_PAYLOAD;
+    double wire_bits = (double)(9 + 2 * command_size + 2) * 10;
+    printf("uart: %u baud, %.3f ms wire time per command, %.3f ms at 57600 baud\n", results.baud,
+           wire_bits * 1000 / results.baud, wire_bits * 1000 / 57600);
+    if (config.adaptive) {
+        printf("profiles: %lu switches, %lu unannounced, packets per profile:", results.profile_switches,
+               results.profile_errors);
+        for (size_t p = 0; p < sizeof(results.profile_packets) / sizeof(results.profile_packets[0]); p++) {
+            if (results.profile_packets[p] > 0) printf(" %zu:%lu", p, results.profile_packets[p]);
+        }
+        printf("\n");
+    }
+    if (config.numbered) report_link(&results.link);
+    report_latency("uart", offsetof(struct sample_t, uart));
+    size_t delivered = report_latency("air", offsetof(struct sample_t, air));
+    if (delivered > 0 && last_air > samples[0].sent) {
+        double seconds = (double)(last_air - samples[0].sent) / NS_PER_S;
+        printf("throughput: %.2f packets/s, %.1f bytes/s\n", delivered / seconds, delivered * config.size / seconds);
+    }
+    if (jitter_err) {
+        printf("dequeue to write: broadcaster published no statistics\n");
+    } else if (jitter.count > 0) {
+        printf("dequeue to write: p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us, spread p50-p99 %.1f us with %u "
+               "load processes\n",
+               (double)jitter.p50_ns / 1000, (double)jitter.p90_ns / 1000, (double)jitter.p99_ns / 1000,
+               (double)jitter.max_ns / 1000, (double)(jitter.p99_ns - jitter.p50_ns) / 1000, config.load);
+    }
+
+    return EXIT_SUCCESS;
+}
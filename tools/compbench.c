@@ -0,0 +1,244 @@
+/**
+ * @file compbench.c
+ * @brief A benchmark of frame compression on recorded telemetry.
+ *
+ * Reads packets as lines of hex, the same format broadcaster accepts on stdin, from the file given with `-f`. Without a
+ * file, a synthetic telemetry stream of slowly changing sensor readings is generated instead. Every packet is
+ * compressed in each mode, decompressed with the reference decoder and checked to match the original, then the
+ * compression ratio, the codecs chosen, the CPU time per packet and the time on air saved at SF7/500 kHz are reported.
+ * With `-a`, consecutive packets are first aggregated into full frames the way broadcaster's `-a` packs them.
+ */
+#define _GNU_SOURCE
+#include "aggregate.h"
+#include "compress.h"
+#include "pqueue.h"
+#include "radio.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The most packets that are benchmarked. */
+#define MAX_PACKETS 10000
+
+/** The number of synthetic packets generated when no file is given. */
+#define SYNTHETIC_PACKETS 2000
+
+/** The number of times each mode is timed over all packets. */
+#define ROUNDS 20
+
+/** A packet of the recorded stream. */
+struct sample_t {
+    /** The number of bytes in `data`. */
+    size_t len;
+    /** The packet contents. */
+    uint8_t data[COMP_MAX_FRAME];
+};
+
+/** The packets being benchmarked. */
+static struct sample_t samples[MAX_PACKETS];
+
+/** The number of packets in `samples`. */
+static size_t nsamples = 0;
+
+/** The radio parameters time on air is calculated for, which are broadcaster's defaults. */
+static const struct lora_params_t PARAMS = {.modulation = LORA,
+                                            .frequency = 433050000,
+                                            .power = 15,
+                                            .spread_factor = 7,
+                                            .coding_rate = CR_4_7,
+                                            .bandwidth = 500,
+                                            .preamble_len = 6,
+                                            .cyclic_redundancy = true,
+                                            .iqi = false,
+                                            .sync_word = 0x43};
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Reads recorded packets from a file of hex lines.
+ * @param path The path of the file.
+ * @return True if at least one packet was read.
+ */
+static bool load_samples(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    char line[2 * PQ_PACKET_MAX + 2];
+    while (nsamples < MAX_PACKETS && fgets(line, sizeof(line), file) != NULL) {
+        struct sample_t *sample = &samples[nsamples];
+        sample->len = 0;
+        for (size_t i = 0; isxdigit(line[i]) && isxdigit(line[i + 1]) && sample->len < COMP_MAX_FRAME; i += 2) {
+            char byte[3] = {line[i], line[i + 1], '\0'};
+            sample->data[sample->len++] = strtoul(byte, NULL, 16);
+        }
+        if (sample->len > 0) nsamples++;
+    }
+    fclose(file);
+    return nsamples > 0;
+}
+
+/**
+ * Appends a big-endian integer to a packet.
+ * @param sample The packet.
+ * @param value The value to append.
+ * @param nbytes The width of the value in bytes.
+ */
+static void put(struct sample_t *sample, int64_t value, size_t nbytes) {
+    for (size_t i = nbytes; i > 0; i--) sample->data[sample->len++] = (uint8_t)(value >> (8 * (i - 1)));
+}
+
+/**
+ * Generates a telemetry stream in which each packet holds a timestamp and several sensor readings that drift slowly
+ * with a little noise, the way flight telemetry does between packets.
+ */
+static void generate_samples(void) {
+    srand(1);
+    int64_t altitude = 0, pressure = 101325, temperature = 2150;
+    for (nsamples = 0; nsamples < SYNTHETIC_PACKETS; nsamples++) {
+        struct sample_t *sample = &samples[nsamples];
+        sample->len = 0;
+        altitude += nsamples < SYNTHETIC_PACKETS / 2 ? 37 + rand() % 5 : -(12 + rand() % 3);
+        pressure = 101325 - altitude * 12 + rand() % 4;
+        temperature = 2150 - altitude / 150 + rand() % 3;
+
+        put(sample, 0x01, 1);                    // Packet type
+        put(sample, (int64_t)nsamples * 50, 4); // Mission time in milliseconds
+        put(sample, altitude, 4);
+        put(sample, pressure, 4);
+        put(sample, temperature, 2);
+        for (int axis = 0; axis < 3; axis++) put(sample, (axis == 2 ? 1000 : 0) + rand() % 16 - 8, 2);
+        put(sample, 0x0b4d, 2); // Battery voltage
+        put(sample, 0, 2);      // Status flags
+    }
+}
+
+/**
+ * Packs consecutive packets into aggregated frames that leave room for the compression header, replacing the packets
+ * with the frames.
+ */
+static void aggregate_samples(void) {
+    static struct frame_t frame;
+    size_t nframes = 0;
+    agg_reset(&frame, COMP_MAX_FRAME - COMP_HEADER_LEN);
+    for (size_t i = 0; i < nsamples; i++) {
+        if (samples[i].len > agg_room(&frame)) {
+            samples[nframes].len = frame.len;
+            memcpy(samples[nframes++].data, frame.data, frame.len);
+            agg_reset(&frame, COMP_MAX_FRAME - COMP_HEADER_LEN);
+        }
+        agg_append(&frame, samples[i].data, samples[i].len, 0);
+    }
+    if (frame.len > 0) {
+        samples[nframes].len = frame.len;
+        memcpy(samples[nframes++].data, frame.data, frame.len);
+    }
+    nsamples = nframes;
+}
+
+/**
+ * Compresses, decompresses and times the whole stream in one mode, then prints the results.
+ * @param name The name of the mode.
+ * @param delta Whether the delta codec may be used.
+ * @return True if every packet was decoded back to its original contents.
+ */
+static bool run_mode(const char *name, bool delta) {
+    static uint8_t encoded[MAX_PACKETS][COMP_MAX_ENCODED];
+    static size_t encoded_len[MAX_PACKETS];
+    struct comp_encoder_t enc;
+    struct comp_decoder_t dec;
+    uint8_t frame[COMP_MAX_FRAME];
+    size_t frame_len;
+
+    /* Check the round trip and count the codecs chosen. */
+    unsigned long codecs[16] = {0};
+    uint64_t bytes_in = 0, bytes_out = 0, toa_raw = 0, toa_compressed = 0;
+    comp_encoder_init(&enc, delta);
+    comp_decoder_init(&dec);
+    for (size_t i = 0; i < nsamples; i++) {
+        comp_encode(&enc, samples[i].data, samples[i].len, encoded[i], &encoded_len[i]);
+        if (comp_decode(&dec, encoded[i], encoded_len[i], frame, &frame_len) || frame_len != samples[i].len ||
+            memcmp(frame, samples[i].data, frame_len)) {
+            fprintf(stderr, "%s: packet %zu did not survive the round trip\n", name, i);
+            return false;
+        }
+        codecs[encoded[i][0] >> 4]++;
+        bytes_in += samples[i].len;
+        bytes_out += encoded_len[i];
+        toa_raw += radio_time_on_air(&PARAMS, samples[i].len);
+        toa_compressed += radio_time_on_air(&PARAMS, encoded_len[i]);
+    }
+
+    int64_t start = now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        comp_encoder_init(&enc, delta);
+        for (size_t i = 0; i < nsamples; i++) {
+            comp_encode(&enc, samples[i].data, samples[i].len, encoded[i], &encoded_len[i]);
+        }
+    }
+    double encode_ns = (double)(now_ns() - start) / ROUNDS / nsamples;
+
+    start = now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        comp_decoder_init(&dec);
+        for (size_t i = 0; i < nsamples; i++) comp_decode(&dec, encoded[i], encoded_len[i], frame, &frame_len);
+    }
+    double decode_ns = (double)(now_ns() - start) / ROUNDS / nsamples;
+
+    printf("%-6s %9.1f%% %7lu %7lu %7lu %11.0f %11.0f %9.3f %9.3f\n", name, (double)bytes_out * 100 / bytes_in,
+           codecs[COMP_RAW], codecs[COMP_LZ], codecs[COMP_DELTA], encode_ns, decode_ns,
+           (double)toa_raw / nsamples / 1000, (double)toa_compressed / nsamples / 1000);
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    const char *path = NULL;
+    bool aggregate = false;
+    int c;
+    while ((c = getopt(argc, argv, ":f:a")) != -1) {
+        switch (c) {
+        case 'f':
+            path = optarg;
+            break;
+        case 'a':
+            aggregate = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f recording] [-a]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (path != NULL) {
+        if (!load_samples(path)) {
+            fprintf(stderr, "Could not read any packets from %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        generate_samples();
+    }
+    if (aggregate) aggregate_samples();
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < nsamples; i++) total += samples[i].len;
+    printf("%zu %s, %.1f bytes on average, from %s\n", nsamples, aggregate ? "aggregated frames" : "packets",
+           (double)total / nsamples, path != NULL ? path : "synthetic telemetry");
+    printf("%-6s %10s %7s %7s %7s %11s %11s %9s %9s\n", "mode", "size", "raw", "lz", "delta", "encode ns",
+           "decode ns", "raw ms", "comp ms");
+
+    bool ok = run_mode("lz", false);
+    ok = run_mode("delta", true) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
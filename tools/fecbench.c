@@ -0,0 +1,175 @@
+/**
+ * @file fecbench.c
+ * @brief A loss simulation of the forward error correction used on the downlink.
+ *
+ * Packets are encoded in groups the way broadcaster's `-F k:m` sends them, random packets are dropped at a range of
+ * loss rates, and the rest are passed through the reference decoder. Every packet that comes out is checked against
+ * the one sent. For each group shape and loss rate the fraction of packets delivered and the goodput, the payload bytes
+ * delivered per second of time on air at SF7/500 kHz, are reported.
+ */
+#define _GNU_SOURCE
+#include "fec.h"
+#include "radio.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The number of data packets sent at each loss rate. */
+#define PACKETS 20000
+
+/** The loss rates simulated, in percent. */
+static const unsigned int LOSS_RATES[] = {0, 1, 5, 10, 20, 30};
+
+/** Group shapes simulated, as data and parity packets per group. A shape with no parity packets sends without FEC. */
+static const struct {
+    unsigned int k;
+    unsigned int m;
+} SHAPES[] = {{1, 0}, {8, 1}, {8, 2}, {8, 4}, {4, 2}, {4, 4}};
+
+/** The radio parameters time on air is calculated for, which are broadcaster's defaults. */
+static const struct lora_params_t PARAMS = {.modulation = LORA,
+                                            .frequency = 433050000,
+                                            .power = 15,
+                                            .spread_factor = 7,
+                                            .coding_rate = CR_4_7,
+                                            .bandwidth = 500,
+                                            .preamble_len = 6,
+                                            .cyclic_redundancy = true,
+                                            .iqi = false,
+                                            .sync_word = 0x43};
+
+/** The length of each data packet in bytes. */
+static size_t payload_len = 32;
+
+/**
+ * Fills a packet with contents that identify it.
+ * @param data The packet.
+ * @param seq The sequence number of the packet.
+ */
+static void fill_packet(uint8_t *data, uint32_t seq) {
+    for (size_t i = 0; i < payload_len; i++) data[i] = (uint8_t)(seq * 31 + i * 7 + (i < 4 ? seq >> (8 * i) : 0));
+    memcpy(data, &seq, sizeof(seq));
+}
+
+/** Totals for one group shape at one loss rate. */
+struct run_t {
+    /** The number of data packets delivered, whether received or rebuilt. */
+    unsigned long delivered;
+    /** The total time on air of every packet sent, in microseconds. */
+    uint64_t airtime;
+    /** Whether any delivered packet differed from the one sent. */
+    bool corrupt;
+};
+
+/**
+ * Passes a packet through the simulated channel and the decoder, collecting any data packets that come out.
+ * @param dec The decoder.
+ * @param packet The packet sent.
+ * @param len The length of the packet.
+ * @param loss_pct The loss rate in percent.
+ * @param run The totals to add to.
+ */
+static void channel(struct fec_decoder_t *dec, const uint8_t *packet, size_t len, unsigned int loss_pct,
+                    struct run_t *run) {
+    run->airtime += radio_time_on_air(&PARAMS, len);
+    if ((unsigned int)(rand() % 100) < loss_pct) return;
+    if (fec_decode(dec, packet, len)) return;
+
+    const uint8_t *data;
+    size_t data_len;
+    while (fec_next(dec, &data, &data_len) == 0) {
+        uint8_t expected[FEC_MAX_DATA];
+        uint32_t seq;
+        memcpy(&seq, data, sizeof(seq));
+        fill_packet(expected, seq);
+        if (data_len != payload_len || memcmp(data, expected, payload_len)) run->corrupt = true;
+        run->delivered++;
+    }
+}
+
+/**
+ * Simulates one group shape at one loss rate.
+ * @param k The number of data packets per group.
+ * @param m The number of parity packets per group, or 0 to send without FEC.
+ * @param loss_pct The loss rate in percent.
+ * @return The totals of the run.
+ */
+static struct run_t simulate(unsigned int k, unsigned int m, unsigned int loss_pct) {
+    static struct fec_encoder_t enc;
+    static struct fec_decoder_t dec;
+    struct run_t run = {0};
+    uint8_t data[FEC_MAX_DATA];
+    uint8_t packet[RADIO_MAX_PAYLOAD];
+    size_t len;
+
+    if (m == 0) {
+        for (uint32_t seq = 0; seq < PACKETS; seq++) {
+            run.airtime += radio_time_on_air(&PARAMS, payload_len);
+            if ((unsigned int)(rand() % 100) >= loss_pct) run.delivered++;
+        }
+        return run;
+    }
+
+    fec_encoder_init(&enc, k, m, m);
+    fec_decoder_init(&dec);
+    for (uint32_t seq = 0; seq < PACKETS; seq++) {
+        fill_packet(data, seq);
+        fec_add(&enc, data, payload_len, false, packet, &len);
+        channel(&dec, packet, len, loss_pct, &run);
+        if (!fec_full(&enc)) continue;
+        for (unsigned int j = 0; fec_parity(&enc, j, packet, &len) == 0; j++) {
+            channel(&dec, packet, len, loss_pct, &run);
+        }
+        fec_next_group(&enc);
+    }
+    return run;
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, ":s:")) != -1) {
+        switch (c) {
+        case 's':
+            payload_len = strtoul(optarg, NULL, 10);
+            if (payload_len < 4 || payload_len > FEC_MAX_DATA) {
+                fprintf(stderr, "Payload size must be between 4 and %d\n", FEC_MAX_DATA);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s size]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    srand(1);
+    printf("%d packets of %zu bytes, delivered %% / goodput bytes/s of airtime\n", PACKETS, payload_len);
+    printf("%-6s", "loss");
+    for (size_t s = 0; s < sizeof(SHAPES) / sizeof(SHAPES[0]); s++) {
+        char name[16];
+        if (SHAPES[s].m == 0) snprintf(name, sizeof(name), "none");
+        else snprintf(name, sizeof(name), "%u:%u", SHAPES[s].k, SHAPES[s].m);
+        printf(" %16s", name);
+    }
+    printf("\n");
+
+    bool ok = true;
+    for (size_t l = 0; l < sizeof(LOSS_RATES) / sizeof(LOSS_RATES[0]); l++) {
+        printf("%5u%%", LOSS_RATES[l]);
+        for (size_t s = 0; s < sizeof(SHAPES) / sizeof(SHAPES[0]); s++) {
+            struct run_t run = simulate(SHAPES[s].k, SHAPES[s].m, LOSS_RATES[l]);
+            double goodput = (double)run.delivered * payload_len * 1000000 / (double)run.airtime;
+            printf(" %7.2f%% %7.0f", (double)run.delivered * 100 / PACKETS, goodput);
+            if (run.corrupt || run.delivered > PACKETS) {
+                ok = false;
+                fprintf(stderr, "\n%u:%u at %u%% loss delivered a corrupt packet\n", SHAPES[s].k, SHAPES[s].m,
+                        LOSS_RATES[l]);
+            }
+        }
+        printf("\n");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
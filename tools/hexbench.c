@@ -0,0 +1,106 @@
+/**
+ * @file hexbench.c
+ * @brief A micro-benchmark of `radio tx` command assembly.
+ *
+ * Compares the original assembly, which formats each payload byte with its own `sprintf` call, against
+ * `radio_hex_encode` writing into a preallocated buffer. Both outputs are checked to be identical for every payload
+ * size before timing. Build with `HOST_ARCH_FLAGS=-march=native` to include the SIMD encoder.
+ */
+#define _GNU_SOURCE
+#include "radio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of commands assembled per measurement. */
+#define ITERATIONS 200000
+
+/** Payload sizes to measure. */
+static const size_t SIZES[] = {16, 32, 64, 128, RADIO_MAX_PAYLOAD};
+
+/** Keeps the compiler from optimizing the assembled commands away. */
+static volatile char sink;
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Assembles a command the way `radio_tx_bytes` originally did.
+ * @param buffer The buffer to assemble into.
+ * @param data The payload.
+ * @param nbytes The length of the payload.
+ * @return The length of the command.
+ */
+static size_t assemble_sprintf(char *buffer, const uint8_t *data, size_t nbytes) {
+    int sent = 0;
+    sent += sprintf(&buffer[sent], "radio tx ");
+    for (size_t i = 0; i < nbytes; i++) {
+        sent += sprintf(&buffer[sent], "%02x", data[i]);
+    }
+    sent += sprintf(&buffer[sent], "\r\n");
+    return sent;
+}
+
+/**
+ * Assembles a command the way `radio_tx_bytes` does now.
+ * @param buffer The buffer to assemble into.
+ * @param data The payload.
+ * @param nbytes The length of the payload.
+ * @return The length of the command.
+ */
+static size_t assemble_table(char *buffer, const uint8_t *data, size_t nbytes) {
+    size_t len = 9;
+    memcpy(buffer, "radio tx ", len);
+    len += radio_hex_encode(&buffer[len], data, nbytes);
+    buffer[len++] = '\r';
+    buffer[len++] = '\n';
+    return len;
+}
+
+/**
+ * Measures the average time taken by a command assembly function.
+ * @param assemble The assembly function.
+ * @param data The payload.
+ * @param nbytes The length of the payload.
+ * @return The average time per command in nanoseconds.
+ */
+static double measure(size_t (*assemble)(char *, const uint8_t *, size_t), const uint8_t *data, size_t nbytes) {
+    char buffer[RADIO_TX_COMMAND_MAX + 1];
+    int64_t start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t len = assemble(buffer, data, nbytes);
+        sink = buffer[len - 3];
+    }
+    return (double)(now_ns() - start) / ITERATIONS;
+}
+
+int main(void) {
+    uint8_t data[RADIO_MAX_PAYLOAD];
+    srand(time(NULL));
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = rand();
+
+    for (size_t n = 0; n <= RADIO_MAX_PAYLOAD; n++) {
+        char expected[RADIO_TX_COMMAND_MAX + 1], actual[RADIO_TX_COMMAND_MAX + 1];
+        size_t len = assemble_sprintf(expected, data, n);
+        if (assemble_table(actual, data, n) != len || memcmp(expected, actual, len)) {
+            fprintf(stderr, "Encoders disagree for a %zu byte payload\n", n);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%8s %14s %14s %8s\n", "payload", "sprintf", "table", "speedup");
+    for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+        double slow = measure(assemble_sprintf, data, SIZES[i]);
+        double fast = measure(assemble_table, data, SIZES[i]);
+        printf("%8zu %11.1f ns %11.1f ns %7.1fx\n", SIZES[i], slow, fast, slow / fast);
+    }
+    return EXIT_SUCCESS;
+}
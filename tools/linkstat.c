@@ -0,0 +1,137 @@
+/**
+ * @file linkstat.c
+ * @brief Measures loss and latency from a capture of frames sent by broadcaster with link headers (`-H`).
+ *
+ * The capture has one received frame per line, in hex as it came out of the receiving radio, optionally preceded by
+ * the time it was received in milliseconds and a space. Receive times must be on broadcaster's monotonic clock, which
+ * `-o` shifts them by when the ground station's clock is known to be off by a fixed amount. Without receive times,
+ * only the latency from queue to radio is known. Each frame is fed to the reference analyzer in `src/linkhdr.c`, and
+ * the loss rate, the bursts of loss, the latency and the header overhead are printed.
+ */
+#define _GNU_SOURCE
+#include "linkhdr.h"
+#include "radio.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Converts a duration to milliseconds for printing.
+ * @param ns The duration in nanoseconds.
+ * @return The duration in milliseconds.
+ */
+static double ms(uint64_t ns) { return (double)ns / 1000000; }
+
+/**
+ * Prints a summary of a latency histogram.
+ * @param label What the latency is from and to.
+ * @param hist The histogram.
+ */
+static void print_latency(const char *label, const struct stats_hist_t *hist) {
+    struct stats_summary_t summary;
+    stats_summarize(hist, &summary);
+    if (summary.count == 0) return;
+    printf("%-16s mean %9.1f ms, p50 %9.1f ms, p90 %9.1f ms, p99 %9.1f ms, max %9.1f ms\n", label, ms(summary.mean_ns),
+           ms(summary.p50_ns), ms(summary.p90_ns), ms(summary.p99_ns), ms(summary.max_ns));
+}
+
+/**
+ * Prints what the analyzer measured.
+ * @param stats What was measured.
+ * @param bad The number of lines that were not a frame with a valid link header.
+ */
+static void print_stats(const struct lhdr_stats_t *stats, unsigned long bad) {
+    printf("%llu frames received, %llu lost (%.2f%%), %llu duplicates, %llu restarts, %lu unreadable\n",
+           (unsigned long long)stats->received, (unsigned long long)stats->lost, lhdr_loss(stats) * 100,
+           (unsigned long long)stats->duplicates, (unsigned long long)stats->restarts, bad);
+    printf("received by priority:");
+    for (unsigned int p = 0; p <= LHDR_MAX_PRIORITY; p++) {
+        printf(" %u%s:%llu", p, p == LHDR_MAX_PRIORITY ? "+" : "", (unsigned long long)stats->priorities[p]);
+    }
+    printf("\n");
+
+    if (stats->lost > 0) {
+        printf("bursts of loss by length:");
+        for (unsigned int n = 1; n <= LHDR_MAX_BURST; n++) {
+            if (stats->bursts[n] > 0) {
+                printf(" %u%s:%llu", n, n == LHDR_MAX_BURST ? "+" : "", (unsigned long long)stats->bursts[n]);
+            }
+        }
+        printf(", longest %llu\n", (unsigned long long)stats->max_burst);
+    }
+
+    uint64_t frames = stats->received + stats->duplicates;
+    printf("header overhead: %.2f bytes per frame, %.1f%% of %llu bytes received\n",
+           (double)stats->header_bytes / (double)frames, (double)stats->header_bytes * 100 / (double)stats->frame_bytes,
+           (unsigned long long)stats->frame_bytes);
+    print_latency("queue to radio", &stats->wait);
+    print_latency("queue to receive", &stats->age);
+}
+
+int main(int argc, char **argv) {
+
+    bool adaptive = false;
+    long long offset_ms = 0;
+    int c;
+    while ((c = getopt(argc, argv, "Ao:")) != -1) {
+        switch (c) {
+        case 'A':
+            adaptive = true;
+            break;
+        case 'o':
+            offset_ms = strtoll(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-A] [-o offset-ms] [capture]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    FILE *capture = stdin;
+    if (optind < argc && strcmp(argv[optind], "-")) capture = fopen(argv[optind], "r");
+    if (capture == NULL) {
+        fprintf(stderr, "Could not open capture %s: %s\n", argv[optind], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    static struct lhdr_stats_t stats;
+    unsigned long bad = 0;
+    char line[2 * RADIO_MAX_PAYLOAD + 32];
+    while (fgets(line, sizeof(line), capture) != NULL) {
+        char *hex = line;
+        int64_t received_ms = -1;
+        if (strchr(line, ' ') != NULL) {
+            received_ms = strtoll(line, &hex, 10) + offset_ms;
+            while (*hex == ' ') hex++;
+        }
+
+        uint8_t frame[RADIO_MAX_PAYLOAD];
+        size_t len = 0;
+        for (; len < sizeof(frame) && isxdigit(hex[2 * len]) && isxdigit(hex[2 * len + 1]); len++) {
+            char byte[3] = {hex[2 * len], hex[2 * len + 1], '\0'};
+            frame[len] = strtoul(byte, NULL, 16);
+        }
+        if (len == 0) continue;
+
+        // The profile header comes before the link header
+        size_t skip = adaptive ? 1 : 0;
+        struct lhdr_t header;
+        size_t header_len;
+        if (len <= skip || lhdr_decode(&frame[skip], len - skip, &header, &header_len)) {
+            bad++;
+            continue;
+        }
+        lhdr_observe(&stats, &header, header_len, len, received_ms);
+    }
+    if (capture != stdin) fclose(capture);
+
+    if (stats.received == 0) {
+        printf("No frames with link headers\n");
+        return EXIT_SUCCESS;
+    }
+    print_stats(&stats, bad);
+    return EXIT_SUCCESS;
+}
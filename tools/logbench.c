@@ -0,0 +1,198 @@
+/**
+ * @file logbench.c
+ * @brief A micro-benchmark of logging a failed transmission on the thread that failed, synchronously with `log_print`
+ * as broadcaster used to and through the asynchronous event log.
+ *
+ * The log is written into a pipe drained by a child process at a limited rate, like a serial console, so that once the
+ * pipe is full a synchronous write waits for the console. Each event is timed on the posting thread. Events cycle
+ * through `-k` different errors: one kind is a flood of the same error, which the event log writes as one summary per
+ * period, while more kinds than the event log tracks defeat the summaries and show it dropping events instead of
+ * waiting when the console cannot keep up.
+ */
+#define _GNU_SOURCE
+#include "evlog.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The largest number of events a run can post. */
+#define MAX_EVENTS 1000000
+
+/** The device named in every event. */
+#define DEVICE "/dev/ser1"
+
+/** The time each event took to log, in nanoseconds. */
+static int64_t cost[MAX_EVENTS];
+
+/** The event log being measured. */
+static struct evlog_t events;
+
+/** Benchmark configuration. */
+static struct {
+    unsigned long count;
+    unsigned long rate;
+    unsigned long console;
+    unsigned int kinds;
+} config = {.count = 20000, .rate = 0, .console = 11520, .kinds = 1};
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Turns an event into text the way broadcaster does for a failed transmission.
+ * @param event The event.
+ * @param text Where to write the text.
+ * @param size The size of `text` in bytes.
+ * @return The level to log the event at.
+ */
+static log_level_e describe(const struct evlog_event_t *event, char *text, size_t size) {
+    snprintf(text, size, "Failed to transmit on %s after %llu tries: %s", event->subject,
+             (unsigned long long)event->args[0], strerror(event->err));
+    return LOG_ERROR;
+}
+
+/**
+ * Reads the log at the console's rate until it is closed, then reports how many lines it read and exits.
+ * @param fd The read end of the log pipe.
+ * @param report Where to write the number of lines.
+ */
+static void console(int fd, int report) {
+    char buffer[256];
+    unsigned long lines = 0;
+    ssize_t nread;
+    while ((nread = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < nread; i++) lines += buffer[i] == '\n';
+        if (config.console) {
+            int64_t ns = (int64_t)nread * 1000000000 / (int64_t)config.console;
+            struct timespec delay = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+            nanosleep(&delay, NULL);
+        }
+    }
+    if (write(report, &lines, sizeof(lines)) != sizeof(lines)) exit(EXIT_FAILURE);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Compares two costs for sorting.
+ * @param a The first cost.
+ * @param b The second cost.
+ * @return Negative, zero or positive as the first is less than, equal to or greater than the second.
+ */
+static int compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Logs every event to a console and prints the cost on the posting thread and what reached the console.
+ * @param async Whether to log through the event log rather than with `log_print`.
+ */
+static void measure(bool async) {
+    int log_pipe[2], report_pipe[2];
+    if (pipe(log_pipe) || pipe(report_pipe)) {
+        fprintf(stderr, "Could not create pipes: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    pid_t reader = fork();
+    if (reader == 0) {
+        close(log_pipe[1]);
+        console(log_pipe[0], report_pipe[1]);
+    }
+    close(log_pipe[0]);
+    FILE *stream = fdopen(log_pipe[1], "w");
+    // Like stderr, every line is written as it is logged
+    setvbuf(stream, NULL, _IONBF, 0);
+
+    if (async) {
+        int err = evlog_start(&events, stream, describe);
+        if (err) {
+            fprintf(stderr, "Could not start event log: %s\n", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int64_t interval = config.rate ? 1000000000 / (int64_t)config.rate : 0;
+    int64_t start = now_ns(), next = start;
+    for (unsigned long i = 0; i < config.count; i++) {
+        if (interval) {
+            next += interval;
+            struct timespec due = {.tv_sec = next / 1000000000, .tv_nsec = next % 1000000000};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+                ;
+        }
+        int err = EIO + (int)(i % config.kinds);
+        int64_t before = now_ns();
+        if (async) {
+            evlog_post(&events, &(struct evlog_event_t){.code = 0, .err = err, .subject = DEVICE, .args = {3}});
+        } else {
+            log_print(stream, LOG_ERROR, "Failed to transmit on %s after %u tries: %s", DEVICE, 3, strerror(err));
+        }
+        cost[i] = now_ns() - before;
+    }
+    int64_t elapsed = now_ns() - start;
+
+    if (async) evlog_stop(&events);
+    fclose(stream);
+    unsigned long lines = 0;
+    if (read(report_pipe[0], &lines, sizeof(lines)) != sizeof(lines)) lines = 0;
+    waitpid(reader, NULL, 0);
+    close(report_pipe[0]);
+    close(report_pipe[1]);
+
+    qsort(cost, config.count, sizeof(cost[0]), compare);
+    printf("%-6s %12.1f %12.1f %12.1f %12.1f %9lu %9llu %9llu\n", async ? "evlog" : "sync", (double)elapsed / 1000000,
+           (double)cost[config.count / 2] / 1000, (double)cost[config.count * 99 / 100] / 1000,
+           (double)cost[config.count - 1] / 1000, lines,
+           async ? (unsigned long long)atomic_load(&events.suppressed) : 0,
+           async ? (unsigned long long)atomic_load(&events.dropped) : 0);
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, "n:r:c:k:")) != -1) {
+        switch (c) {
+        case 'n':
+            config.count = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            config.rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            config.console = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            config.kinds = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n count] [-r rate] [-c console-bytes/s] [-k kinds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (config.count == 0 || config.count > MAX_EVENTS || config.kinds == 0 || config.kinds > 64) {
+        fprintf(stderr, "Count must be 1-%d and kinds 1-64\n", MAX_EVENTS);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%lu events of %u kinds", config.count, config.kinds);
+    if (config.rate) printf(" at %lu/s", config.rate);
+    if (config.console) printf(", console at %lu bytes/s\n", config.console);
+    else printf(", console unlimited\n");
+    printf("%-6s %12s %12s %12s %12s %9s %9s %9s\n", "log", "total ms", "p50 us", "p99 us", "max us", "lines",
+           "repeats", "dropped");
+    measure(false);
+    measure(true);
+    return EXIT_SUCCESS;
+}
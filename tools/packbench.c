@@ -0,0 +1,386 @@
+/**
+ * @file packbench.c
+ * @brief A round-trip test and benchmark of the telemetry bit-packing generated from schema/telemetry.schema.
+ *
+ * For every record type in the schema, records are generated with each field set to random values and to the values at
+ * and beyond the edges of its range, including not-a-number and infinities for floats. Every record is packed the way
+ * broadcaster's `-X` sends it, unpacked with the ground station's unpacker and checked field by field: a number sent as
+ * is must come back bit for bit, a ranged number must come back as the nearest step to the value clamped to its range,
+ * a bool as 0 or 1 and padding as zero. Messages of the wrong length or with an unknown id must be left alone. For
+ * each record type the bytes saved, the CPU time to pack and unpack a record and the time on air at SF7/500 kHz are
+ * reported.
+ */
+#define _GNU_SOURCE
+#include "radio.h"
+#include "telemetry.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The most records of each type that are generated. */
+#define MAX_SAMPLES 100000
+
+/** The number of times each record type is timed over all its records. */
+#define ROUNDS 20
+
+/** A record of one type and what it packs into. */
+struct sample_t {
+    /** The record, starting with its id byte. */
+    uint8_t raw[TELEMETRY_MAX_RAW];
+    /** The packed record. */
+    uint8_t packed[TELEMETRY_MAX_PACKED];
+};
+
+/** The records of the type being benchmarked. */
+static struct sample_t samples[MAX_SAMPLES];
+
+/** The number of records generated of each type. */
+static size_t nsamples = 2000;
+
+/** The radio parameters time on air is calculated for, which are broadcaster's defaults. */
+static const struct lora_params_t PARAMS = {.modulation = LORA,
+                                            .frequency = 433050000,
+                                            .power = 15,
+                                            .spread_factor = 7,
+                                            .coding_rate = CR_4_7,
+                                            .bandwidth = 500,
+                                            .preamble_len = 6,
+                                            .cyclic_redundancy = true,
+                                            .iqi = false,
+                                            .sync_word = 0x43};
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Generates 32 random bits.
+ * @return The bits.
+ */
+static uint32_t random32(void) {
+    uint32_t high = (uint32_t)rand() & 0xffff, low = (uint32_t)rand() & 0xffff;
+    return high << 16 | low;
+}
+
+/**
+ * Gets the size of a field in a record.
+ * @param record The record type.
+ * @param index The index of the field.
+ * @return The size of the field in bytes.
+ */
+static size_t field_size(const struct telemetry_record_t *record, size_t index) {
+    size_t end = index + 1 < record->nfields ? record->fields[index + 1].offset : record->raw_len;
+    return end - record->fields[index].offset;
+}
+
+/**
+ * Checks whether a field holds a signed integer.
+ * @param field The field.
+ * @return True if it does.
+ */
+static bool is_signed(const struct telemetry_field_t *field) {
+    return field->type == TELEMETRY_I8 || field->type == TELEMETRY_I16 || field->type == TELEMETRY_I32;
+}
+
+/**
+ * Reads a little-endian integer field.
+ * @param data The field.
+ * @param size The size of the field in bytes.
+ * @param sign Whether the field is signed.
+ * @return The integer.
+ */
+static int64_t get_int(const uint8_t *data, size_t size, bool sign) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) value |= (uint64_t)data[i] << (8 * i);
+    if (!sign) return (int64_t)value;
+    uint64_t bit = UINT64_C(1) << (8 * size - 1);
+    return (int64_t)(value ^ bit) - (int64_t)bit;
+}
+
+/**
+ * Writes a little-endian integer field.
+ * @param data Where to write the field.
+ * @param value The integer, of which only the low bytes are written.
+ * @param size The size of the field in bytes.
+ */
+static void put_int(uint8_t *data, int64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)((uint64_t)value >> (8 * i));
+}
+
+/**
+ * Reads a little-endian float field.
+ * @param data The field.
+ * @return The float.
+ */
+static float get_float(const uint8_t *data) {
+    uint32_t bits = (uint32_t)get_int(data, 4, false);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Writes a little-endian float field.
+ * @param data Where to write the field.
+ * @param value The float.
+ */
+static void put_float(uint8_t *data, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_int(data, bits, 4);
+}
+
+/**
+ * Fills a ranged integer field with a random value, or one at or beyond an edge of its range that the field's type
+ * can hold.
+ * @param field The field.
+ * @param data Where to write the field.
+ * @param size The size of the field in bytes.
+ * @param which Which value to use: the first few are edges and the rest are random.
+ */
+static void fill_int(const struct telemetry_field_t *field, uint8_t *data, size_t size, size_t which) {
+    int64_t lowest = is_signed(field) ? -((int64_t)1 << (8 * size - 1)) : 0;
+    int64_t highest = is_signed(field) ? ((int64_t)1 << (8 * size - 1)) - 1 : ((int64_t)1 << (8 * size)) - 1;
+    int64_t value;
+    switch (which) {
+    case 0:
+        value = field->min;
+        break;
+    case 1:
+        value = field->max;
+        break;
+    case 2:
+        value = lowest;
+        break;
+    case 3:
+        value = highest;
+        break;
+    case 4:
+        value = field->min + field->step / 2;
+        break;
+    default: {
+        // Mostly within the range, with a margin of a few steps on either side
+        int64_t margin = 3 * field->step, span = field->max - field->min + 2 * margin;
+        value = field->min - margin + (int64_t)(((uint64_t)random32() << 32 | random32()) % (uint64_t)(span + 1));
+        break;
+    }
+    }
+    if (value < lowest) value = lowest;
+    if (value > highest) value = highest;
+    put_int(data, value, size);
+}
+
+/**
+ * Fills a ranged float field with a random value, or one at or beyond an edge of its range.
+ * @param field The field.
+ * @param data Where to write the field.
+ * @param which Which value to use: the first few are edges and the rest are random.
+ */
+static void fill_float(const struct telemetry_field_t *field, uint8_t *data, size_t which) {
+    static const float EDGES[] = {NAN, INFINITY, -INFINITY, 0.0f, -0.0f};
+    float value;
+    if (which < sizeof(EDGES) / sizeof(EDGES[0])) {
+        value = EDGES[which];
+    } else if (which == 5) {
+        value = field->fmin;
+    } else if (which == 6) {
+        value = field->fmax;
+    } else if (which == 7) {
+        value = nextafterf(field->fmin, -INFINITY);
+    } else if (which == 8) {
+        value = nextafterf(field->fmax, INFINITY);
+    } else {
+        // Mostly within the range, with a margin of a few steps on either side
+        double margin = 3 * (double)field->fstep, span = (double)field->fmax - (double)field->fmin + 2 * margin;
+        value = (float)((double)field->fmin - margin + span * random32() / UINT32_MAX);
+    }
+    put_float(data, value);
+}
+
+/**
+ * Generates records of one type, the first few with every field at an edge and the rest random.
+ * @param record The record type.
+ */
+static void generate_samples(const struct telemetry_record_t *record) {
+    for (size_t s = 0; s < nsamples; s++) {
+        uint8_t *raw = samples[s].raw;
+        raw[0] = record->id;
+        for (size_t i = 0; i < record->nfields; i++) {
+            const struct telemetry_field_t *field = &record->fields[i];
+            size_t size = field_size(record, i);
+            uint8_t *data = &raw[field->offset];
+            if (field->type == TELEMETRY_BOOL) {
+                data[0] = s % 3 == 0 ? 0 : (uint8_t)(1 + rand() % 255);
+            } else if (field->ranged && field->type == TELEMETRY_F32) {
+                fill_float(field, data, s);
+            } else if (field->ranged) {
+                fill_int(field, data, size, s);
+            } else {
+                // Anything goes, every bit pattern of a float included
+                for (size_t b = 0; b < size; b++) data[b] = (uint8_t)rand();
+            }
+        }
+    }
+}
+
+/**
+ * Checks that a field came back from being packed as the schema says it should.
+ * @param record The record type.
+ * @param index The index of the field.
+ * @param raw The record that was packed.
+ * @param back The record it was unpacked into.
+ * @return True if the field is right.
+ */
+static bool check_field(const struct telemetry_record_t *record, size_t index, const uint8_t *raw,
+                        const uint8_t *back) {
+    const struct telemetry_field_t *field = &record->fields[index];
+    size_t size = field_size(record, index);
+    const uint8_t *sent = &raw[field->offset], *got = &back[field->offset];
+
+    if (field->type == TELEMETRY_PAD) {
+        for (size_t b = 0; b < size; b++) {
+            if (got[b] != 0) return false;
+        }
+        return true;
+    }
+    if (field->type == TELEMETRY_BOOL) return got[0] == (sent[0] != 0);
+    if (!field->ranged) return !memcmp(sent, got, size);
+
+    if (field->type == TELEMETRY_F32) {
+        float value = get_float(sent), result = get_float(got);
+        if (isnan(value)) {
+            uint8_t bottom[4];
+            put_float(bottom, field->fmin);
+            return !memcmp(got, bottom, sizeof(bottom));
+        }
+        double clamped = fmin(fmax((double)value, (double)field->fmin), (double)field->fmax);
+        // Half a step, and the rounding of the result to a float
+        double ulp = fmax(fabs((double)field->fmin), fabs((double)field->fmax)) * (double)FLT_EPSILON;
+        return (double)result >= (double)field->fmin - ulp && (double)result <= (double)field->fmax + ulp &&
+               fabs((double)result - clamped) <= (double)field->fstep / 2 + ulp;
+    }
+
+    int64_t value = get_int(sent, size, is_signed(field)), result = get_int(got, size, is_signed(field));
+    int64_t clamped = value < field->min ? field->min : value > field->max ? field->max : value;
+    int64_t error = result > clamped ? result - clamped : clamped - result;
+    return result >= field->min && result <= field->max && (result - field->min) % field->step == 0 &&
+           2 * error <= field->step;
+}
+
+/**
+ * Checks that messages which are not records of a type are neither packed nor unpacked.
+ * @param record The record type.
+ * @return The number of messages that were wrongly packed or unpacked.
+ */
+static unsigned long check_rejects(const struct telemetry_record_t *record) {
+    uint8_t message[TELEMETRY_MAX_RAW + 1] = {record->id}, out[TELEMETRY_MAX_RAW + 1];
+    unsigned long failures = 0;
+    failures += telemetry_pack(message, record->raw_len - 1, out) != 0;
+    failures += telemetry_pack(message, record->raw_len + 1, out) != 0;
+    failures += telemetry_unpack(message, record->packed_len, out) != 0;
+    message[0] = TELEMETRY_PACKED | record->id;
+    failures += telemetry_unpack(message, record->packed_len - 1, out) != 0;
+    failures += telemetry_unpack(message, record->packed_len + 1, out) != 0;
+    return failures;
+}
+
+/**
+ * Packs, unpacks, checks and times the records of one type, then prints the results.
+ * @param record The record type.
+ * @return True if every record came back as it should.
+ */
+static bool run_record(const struct telemetry_record_t *record) {
+    generate_samples(record);
+
+    unsigned long failures = check_rejects(record);
+    uint8_t back[TELEMETRY_MAX_RAW];
+    for (size_t s = 0; s < nsamples; s++) {
+        size_t packed_len = telemetry_pack(samples[s].raw, record->raw_len, samples[s].packed);
+        if (packed_len != record->packed_len ||
+            telemetry_unpack(samples[s].packed, packed_len, back) != record->raw_len || back[0] != record->id) {
+            failures++;
+            continue;
+        }
+        for (size_t i = 0; i < record->nfields; i++) {
+            if (!check_field(record, i, samples[s].raw, back)) {
+                if (failures < 5) {
+                    fprintf(stderr, "%s: field %s of record %zu did not survive the round trip\n", record->name,
+                            record->fields[i].name, s);
+                }
+                failures++;
+            }
+        }
+    }
+
+    // Sum the results so the compiler cannot drop the calls
+    size_t sink = 0;
+    int64_t start = now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t s = 0; s < nsamples; s++) {
+            sink += telemetry_pack(samples[s].raw, record->raw_len, samples[s].packed);
+        }
+    }
+    double pack_ns = (double)(now_ns() - start) / ROUNDS / nsamples;
+
+    start = now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t s = 0; s < nsamples; s++) sink += telemetry_unpack(samples[s].packed, record->packed_len, back);
+    }
+    double unpack_ns = (double)(now_ns() - start) / ROUNDS / nsamples;
+    if (sink != (size_t)ROUNDS * nsamples * (record->raw_len + record->packed_len)) failures++;
+
+    uint32_t toa_raw = radio_time_on_air(&PARAMS, record->raw_len);
+    uint32_t toa_packed = radio_time_on_air(&PARAMS, record->packed_len);
+    printf("%-18s %5zu %7zu %7zu %7.1f%% %9.1f %9.1f %9.3f %9.3f %9lu\n", record->name, record->raw_len,
+           record->packed_len, record->raw_len - record->packed_len,
+           (double)(record->raw_len - record->packed_len) * 100 / record->raw_len, pack_ns, unpack_ns,
+           (double)toa_raw / 1000, (double)toa_packed / 1000, failures);
+    return failures == 0;
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        switch (c) {
+        case 'n':
+            nsamples = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n records-per-type]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (nsamples < 16 || nsamples > MAX_SAMPLES) {
+        fprintf(stderr, "Records per type must be 16-%d\n", MAX_SAMPLES);
+        exit(EXIT_FAILURE);
+    }
+
+    srand(1);
+    printf("%zu records of each of %d types\n", nsamples, TELEMETRY_RECORDS);
+    printf("%-18s %5s %7s %7s %8s %9s %9s %9s %9s %9s\n", "record", "raw", "packed", "saved", "saved", "pack ns",
+           "unpack ns", "raw ms", "pack ms", "failures");
+    bool ok = true;
+    for (size_t r = 0; r < TELEMETRY_RECORDS; r++) ok = run_record(&TELEMETRY_SCHEMA[r]) && ok;
+
+    // An id that is no record type must go out as it is
+    uint8_t unknown[TELEMETRY_MAX_RAW] = {0x7f}, out[TELEMETRY_MAX_PACKED];
+    for (size_t len = 1; len <= TELEMETRY_MAX_RAW; len++) {
+        if (telemetry_pack(unknown, len, out) != 0) {
+            fprintf(stderr, "A message with unknown id 0x7f and %zu bytes was packed\n", len);
+            ok = false;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
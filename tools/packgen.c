@@ -0,0 +1,864 @@
+/**
+ * @file packgen.c
+ * @brief Generates a bit-packing codec for telemetry records from a schema.
+ *
+ * Reads a schema of record types and their fields, in the format described at the top of `schema/telemetry.schema`,
+ * and writes a C source file and header with a packer, for broadcaster, and the matching unpacker, for the ground
+ * station. Every record gets its own straight-line packer and unpacker, with every offset, width, range and step a
+ * constant. The prefix of every name in the generated code is the name of the schema file without its extension.
+ */
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** The most record types a schema can have, which is every id. */
+#define MAX_RECORDS 128
+
+/** The most fields a record can have. */
+#define MAX_FIELDS 32
+
+/** The longest name, including its terminating null. */
+#define MAX_NAME 32
+
+/** The longest a schema line can be. */
+#define MAX_LINE 256
+
+/** The widest a packed field can be, in bits. */
+#define MAX_BITS 32
+
+/** The types a field can have. */
+typedef enum {
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_I8,
+    TYPE_I16,
+    TYPE_I32,
+    TYPE_F32,
+    TYPE_BOOL,
+    TYPE_PAD,
+} FieldType;
+
+/** The number of types. */
+#define TYPES 9
+
+/** What the generator needs to know about each type. */
+static const struct {
+    /** The name of the type in a schema, and in the generated code in upper case. */
+    const char *name;
+    /** The size of a field of the type in a record, in bytes. */
+    size_t size;
+    /** The smallest value of an integer type. */
+    int64_t min;
+    /** The largest value of an integer type. */
+    int64_t max;
+} TYPE_INFO[TYPES] = {
+    [TYPE_U8] = {"u8", 1, 0, UINT8_MAX},          [TYPE_U16] = {"u16", 2, 0, UINT16_MAX},
+    [TYPE_U32] = {"u32", 4, 0, UINT32_MAX},       [TYPE_I8] = {"i8", 1, INT8_MIN, INT8_MAX},
+    [TYPE_I16] = {"i16", 2, INT16_MIN, INT16_MAX}, [TYPE_I32] = {"i32", 4, INT32_MIN, INT32_MAX},
+    [TYPE_F32] = {"f32", 4, 0, 0},                [TYPE_BOOL] = {"bool", 1, 0, 1},
+    [TYPE_PAD] = {"pad", 0, 0, 0},
+};
+
+/** A field of a record. */
+struct field_t {
+    /** The name of the field. */
+    char name[MAX_NAME];
+    /** The type of the field. */
+    FieldType type;
+    /** Where the field starts in the record, after the id byte. */
+    size_t offset;
+    /** The size of the field in the record, in bytes. */
+    size_t size;
+    /** Whether the field has a range. */
+    bool ranged;
+    /** The range and step of an integer field. */
+    int64_t min, max, step;
+    /** The range and step of a float field, as the float constants the generated code uses. */
+    float fmin, fmax, fstep;
+    /** The largest code the field is packed as. */
+    uint64_t top;
+    /** The width of the packed field, in bits. */
+    unsigned int bits;
+};
+
+/** A record type. */
+struct record_t {
+    /** The name of the record. */
+    char name[MAX_NAME];
+    /** The id byte every message holding the record starts with. */
+    unsigned int id;
+    /** The number of fields. */
+    size_t nfields;
+    /** The fields, in the order they are laid out. */
+    struct field_t fields[MAX_FIELDS];
+    /** The length of the record, including its id byte. */
+    size_t raw_len;
+    /** The width of the packed fields, in bits. */
+    unsigned int bits;
+};
+
+/** The records in the schema. */
+static struct record_t records[MAX_RECORDS];
+
+/** The number of records in the schema. */
+static size_t nrecords = 0;
+
+/** The path of the schema, for error messages. */
+static const char *schema_path;
+
+/** The line of the schema being read, for error messages. */
+static unsigned int line_number = 0;
+
+/**
+ * Reports an error in the schema and exits.
+ * @param fmt The format of the message.
+ */
+__attribute__((format(printf, 1, 2), noreturn)) static void fail(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s:%u: ", schema_path, line_number);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Checks that a name can be used as a C identifier.
+ * @param name The name.
+ * @return True if it can.
+ */
+static bool valid_name(const char *name) {
+    if (strlen(name) >= MAX_NAME || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return false;
+    for (const char *c = name; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') return false;
+    }
+    return true;
+}
+
+/**
+ * Copies a name in upper case.
+ * @param out Where to write the name, with room for `MAX_NAME` characters.
+ * @param name The name.
+ */
+static void upper_case(char *out, const char *name) {
+    size_t i = 0;
+    for (; name[i] != '\0' && i < MAX_NAME - 1; i++) out[i] = toupper((unsigned char)name[i]);
+    out[i] = '\0';
+}
+
+/**
+ * Gets the number of bits needed to hold every code up to the largest.
+ * @param top The largest code.
+ * @return The number of bits.
+ */
+static unsigned int bits_for(uint64_t top) {
+    unsigned int bits = 0;
+    while (bits < 64 && top >> bits) bits++;
+    return bits;
+}
+
+/**
+ * Parses a number in the schema as an integer.
+ * @param text The number.
+ * @param what What the number is, for error messages.
+ * @return The number.
+ */
+static int64_t parse_integer(const char *text, const char *what) {
+    char *end;
+    errno = 0;
+    long long value = strtoll(text, &end, 0);
+    if (end == text || *end != '\0' || errno) fail("Invalid %s '%s'", what, text);
+    return value;
+}
+
+/**
+ * Parses a number in the schema as a float.
+ * @param text The number.
+ * @param what What the number is, for error messages.
+ * @return The number.
+ */
+static float parse_float(const char *text, const char *what) {
+    char *end;
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0' || isnan(value)) fail("Invalid %s '%s'", what, text);
+    return value;
+}
+
+/**
+ * Adds a field to the last record from a line of the schema.
+ * @param words The words of the line.
+ * @param nwords The number of words.
+ */
+static void parse_field(char **words, size_t nwords) {
+    if (nrecords == 0) fail("Field '%s' before any record", words[0]);
+    struct record_t *record = &records[nrecords - 1];
+    if (record->nfields == MAX_FIELDS) fail("Record '%s' has more than %d fields", record->name, MAX_FIELDS);
+    struct field_t *field = &record->fields[record->nfields];
+    memset(field, 0, sizeof(*field));
+
+    if (!strcmp(words[0], "pad")) {
+        if (nwords != 2) fail("Padding takes a number of bytes");
+        int64_t bytes = parse_integer(words[1], "number of bytes");
+        if (bytes < 1 || bytes > 64) fail("Padding must be 1 to 64 bytes");
+        snprintf(field->name, sizeof(field->name), "pad");
+        field->type = TYPE_PAD;
+        field->size = bytes;
+    } else {
+        if (!valid_name(words[0])) fail("Invalid field name '%s'", words[0]);
+        if (nwords < 2 || nwords == 3 || nwords > 5) fail("Field '%s' needs a type and optionally a range", words[0]);
+        for (size_t i = 0; i < record->nfields; i++) {
+            if (!strcmp(record->fields[i].name, words[0])) fail("Field '%s' given twice", words[0]);
+        }
+        snprintf(field->name, sizeof(field->name), "%s", words[0]);
+        FieldType type = 0;
+        while (type < TYPE_PAD && strcmp(TYPE_INFO[type].name, words[1])) type++;
+        if (type == TYPE_PAD) fail("Unknown type '%s'", words[1]);
+        field->type = type;
+        field->size = TYPE_INFO[type].size;
+        field->ranged = nwords > 2;
+        if (type == TYPE_BOOL && field->ranged) fail("Field '%s' is a bool, which takes no range", field->name);
+    }
+
+    if (field->type == TYPE_PAD || field->type == TYPE_BOOL) {
+        field->bits = field->type == TYPE_BOOL ? 1 : 0;
+    } else if (!field->ranged) {
+        field->bits = 8 * field->size;
+    } else if (field->type == TYPE_F32) {
+        field->fmin = parse_float(words[2], "minimum");
+        field->fmax = parse_float(words[3], "maximum");
+        field->fstep = nwords > 4 ? parse_float(words[4], "step") : 1;
+        if (!(field->fmin < field->fmax) || !(field->fstep > 0)) fail("Field '%s' has an empty range", field->name);
+        // Rounded the same way the generated code rounds
+        double steps = ((double)field->fmax - (double)field->fmin) / (double)field->fstep;
+        field->top = ((uint64_t)(2 * steps) + 1) / 2;
+        field->bits = bits_for(field->top);
+    } else {
+        field->min = parse_integer(words[2], "minimum");
+        field->max = parse_integer(words[3], "maximum");
+        field->step = nwords > 4 ? parse_integer(words[4], "step") : 1;
+        if (field->min < TYPE_INFO[field->type].min || field->max > TYPE_INFO[field->type].max) {
+            fail("Field '%s' has a range its type cannot hold", field->name);
+        }
+        if (field->min >= field->max || field->step < 1) fail("Field '%s' has an empty range", field->name);
+        if ((field->max - field->min) % field->step) {
+            fail("Field '%s' has a range that is not a whole number of steps", field->name);
+        }
+        field->top = (uint64_t)(field->max - field->min) / (uint64_t)field->step;
+        field->bits = bits_for(field->top);
+    }
+    if (field->bits > MAX_BITS) fail("Field '%s' would be packed in more than %d bits", field->name, MAX_BITS);
+
+    field->offset = record->raw_len - 1;
+    record->raw_len += field->size;
+    record->bits += field->bits;
+    record->nfields++;
+}
+
+/**
+ * Starts a record from a line of the schema.
+ * @param words The words of the line.
+ * @param nwords The number of words.
+ */
+static void parse_record(char **words, size_t nwords) {
+    if (nwords != 3) fail("A record takes a name and an id");
+    if (!valid_name(words[1])) fail("Invalid record name '%s'", words[1]);
+    int64_t id = parse_integer(words[2], "id");
+    if (id < 0 || id >= MAX_RECORDS) fail("Record ids must be 0 to %d", MAX_RECORDS - 1);
+    for (size_t i = 0; i < nrecords; i++) {
+        if (records[i].id == id) fail("Record id %" PRId64 " given twice", id);
+        if (!strcmp(records[i].name, words[1])) fail("Record '%s' given twice", words[1]);
+    }
+    struct record_t *record = &records[nrecords++];
+    snprintf(record->name, sizeof(record->name), "%s", words[1]);
+    record->id = id;
+    record->raw_len = 1;
+}
+
+/**
+ * Reads a schema.
+ * @param file The schema.
+ */
+static void parse_schema(FILE *file) {
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        if (strchr(line, '\n') == NULL && !feof(file)) fail("Line longer than %d characters", MAX_LINE - 2);
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char *words[8];
+        size_t nwords = 0;
+        for (char *word = strtok(line, " \t\r\n"); word != NULL; word = strtok(NULL, " \t\r\n")) {
+            if (nwords == 8) fail("Too many words");
+            words[nwords++] = word;
+        }
+        if (nwords == 0) continue;
+        if (!strcmp(words[0], "record")) parse_record(words, nwords);
+        else parse_field(words, nwords);
+    }
+    line_number = 0;
+    if (nrecords == 0) fail("No records");
+    for (size_t i = 0; i < nrecords; i++) {
+        line_number = 0;
+        if (records[i].nfields == 0) fail("Record '%s' has no fields", records[i].name);
+    }
+}
+
+/**
+ * Gets the length of a packed record.
+ * @param record The record.
+ * @return The length in bytes, including the id byte.
+ */
+static size_t packed_len(const struct record_t *record) { return 1 + (record->bits + 7) / 8; }
+
+/**
+ * Writes a float as a C float constant.
+ * @param out Where to write it.
+ * @param value The float.
+ */
+static void put_float(FILE *out, float value) {
+    // The fewest digits that read back as the same float, but never fewer than the integer part needs, so that
+    // whole numbers are not written in exponent form
+    char text[32];
+    int first = 1;
+    if (fabsf(value) >= 1.0f && fabsf(value) < 1e9f) first = snprintf(text, sizeof(text), "%.0f", fabs((double)value));
+    for (int digits = first; digits <= 9; digits++) {
+        snprintf(text, sizeof(text), "%.*g", digits, (double)value);
+        float back = strtof(text, NULL);
+        if (!memcmp(&back, &value, sizeof(back))) break;
+    }
+    fprintf(out, "%s%sf", text, strpbrk(text, ".e") ? "" : ".0");
+}
+
+/**
+ * Checks whether any field in the schema satisfies a condition.
+ * @param match The condition.
+ * @return True if one does.
+ */
+static bool any_field(bool (*match)(const struct field_t *)) {
+    for (size_t r = 0; r < nrecords; r++) {
+        for (size_t f = 0; f < records[r].nfields; f++) {
+            if (match(&records[r].fields[f])) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks whether a field is a float packed in steps.
+ * @param field The field.
+ * @return True if it is.
+ */
+static bool quantized_float(const struct field_t *field) { return field->type == TYPE_F32 && field->ranged; }
+
+/**
+ * Checks whether a field is a signed integer packed in steps.
+ * @param field The field.
+ * @return True if it is.
+ */
+static bool quantized_signed(const struct field_t *field) {
+    return field->ranged && (field->type == TYPE_I8 || field->type == TYPE_I16 || field->type == TYPE_I32);
+}
+
+/**
+ * Checks whether a field is more than a bool, so its bytes are read and written.
+ * @param field The field.
+ * @return True if it is.
+ */
+static bool byte_field(const struct field_t *field) { return field->type != TYPE_BOOL && field->type != TYPE_PAD; }
+
+/**
+ * Checks whether a field is an unsigned integer packed in steps.
+ * @param field The field.
+ * @return True if it is.
+ */
+static bool quantized_unsigned(const struct field_t *field) {
+    return field->ranged && (field->type == TYPE_U8 || field->type == TYPE_U16 || field->type == TYPE_U32);
+}
+
+/**
+ * Checks whether a field is an integer packed in steps.
+ * @param field The field.
+ * @return True if it is.
+ */
+static bool quantized_integer(const struct field_t *field) {
+    return field->ranged && field->type != TYPE_F32;
+}
+
+/**
+ * Writes the generated header.
+ * @param out Where to write it.
+ * @param prefix The prefix of every name, in lower case.
+ * @param upper The prefix in upper case.
+ * @param source Where the schema is, as it is mentioned in the generated code.
+ * @param header_name The file name of the header.
+ */
+static void write_header(FILE *out, const char *prefix, const char *upper, const char *source,
+                         const char *header_name) {
+    size_t max_raw = 0, max_packed = 0, max_fields = 0;
+    for (size_t r = 0; r < nrecords; r++) {
+        if (records[r].raw_len > max_raw) max_raw = records[r].raw_len;
+        if (packed_len(&records[r]) > max_packed) max_packed = packed_len(&records[r]);
+        if (records[r].nfields > max_fields) max_fields = records[r].nfields;
+    }
+
+    fprintf(out, "/**\n * @file %s\n", header_name);
+    fprintf(out, " * @brief Bit-packing of the records in %s, generated by tools/packgen. Do not edit.\n", source);
+    fprintf(out, " *\n");
+    fprintf(out, " * A record is a message whose first byte is the id of its type, followed by its fields as laid out "
+                 "in the\n * schema. A packed record starts with the id with `%s_PACKED` set, followed by each field "
+                 "packed into\n * the bits it needs, least significant bit first.\n */\n",
+            upper);
+    fprintf(out, "#ifndef _%s_H_\n#define _%s_H_\n\n", upper, upper);
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(out, "/** Set in the id byte of a packed record. */\n#define %s_PACKED 0x80\n\n", upper);
+    fprintf(out, "/** The number of record types. */\n#define %s_RECORDS %zu\n\n", upper, nrecords);
+    fprintf(out, "/** The most fields a record type has. */\n#define %s_MAX_FIELDS %zu\n\n", upper, max_fields);
+    fprintf(out, "/** The longest record, including its id byte. */\n#define %s_MAX_RAW %zu\n\n", upper, max_raw);
+    fprintf(out, "/** The longest packed record, including its id byte. */\n#define %s_MAX_PACKED %zu\n\n", upper,
+            max_packed);
+
+    fprintf(out, "/** The types a field can have. */\ntypedef enum {\n");
+    for (FieldType t = 0; t < TYPES; t++) {
+        char name[MAX_NAME];
+        upper_case(name, TYPE_INFO[t].name);
+        fprintf(out, "    %s_%s,\n", upper, name);
+    }
+    fprintf(out, "} %c%sType;\n\n", toupper((unsigned char)prefix[0]), &prefix[1]);
+
+    fprintf(out, "/** A field of a record type. */\nstruct %s_field_t {\n", prefix);
+    fprintf(out, "    /** The name of the field. */\n    const char *name;\n");
+    fprintf(out, "    /** The type of the field. */\n    %c%sType type;\n", toupper((unsigned char)prefix[0]),
+            &prefix[1]);
+    fprintf(out, "    /** Where the field starts in the record, counting the id byte. */\n    size_t offset;\n");
+    fprintf(out, "    /** The width of the packed field, in bits. */\n    unsigned int bits;\n");
+    fprintf(out, "    /** Whether the field is clamped to a range and rounded to steps. */\n    int ranged;\n");
+    fprintf(out, "    /** The range and step of an integer field. */\n    int64_t min, max, step;\n");
+    fprintf(out, "    /** The range and step of a float field. */\n    float fmin, fmax, fstep;\n};\n\n");
+
+    fprintf(out, "/** A record type. */\nstruct %s_record_t {\n", prefix);
+    fprintf(out, "    /** The name of the record type. */\n    const char *name;\n");
+    fprintf(out, "    /** The id byte its records start with. */\n    uint8_t id;\n");
+    fprintf(out, "    /** The length of a record, including its id byte. */\n    size_t raw_len;\n");
+    fprintf(out, "    /** The length of a packed record, including its id byte. */\n    size_t packed_len;\n");
+    fprintf(out, "    /** The number of fields. */\n    size_t nfields;\n");
+    fprintf(out, "    /** The fields, in the order they are laid out. */\n");
+    fprintf(out, "    struct %s_field_t fields[%s_MAX_FIELDS];\n", prefix, upper);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "extern const struct %s_record_t %s_SCHEMA[%s_RECORDS];\n\n", prefix, upper, upper);
+    fprintf(out, "size_t %s_pack(const uint8_t *raw, size_t len, uint8_t *out);\n", prefix);
+    fprintf(out, "size_t %s_unpack(const uint8_t *packed, size_t len, uint8_t *out);\n\n", prefix);
+    fprintf(out, "#endif // _%s_H_\n", upper);
+}
+
+/**
+ * Writes the statement that packs one field.
+ * @param out Where to write it.
+ * @param field The field.
+ */
+static void write_pack_field(FILE *out, const struct field_t *field) {
+    if (field->type == TYPE_PAD) return;
+    size_t at = field->offset;
+    fprintf(out, "    put_bits(&bits, ");
+    if (field->type == TYPE_BOOL) {
+        fprintf(out, "raw[%zu] != 0", at);
+    } else if (!field->ranged) {
+        fprintf(out, "get_le(&raw[%zu], %zu)", at, field->size);
+    } else if (field->type == TYPE_F32) {
+        fprintf(out, "quantize_float(get_f32(&raw[%zu]), ", at);
+        put_float(out, field->fmin);
+        fprintf(out, ", ");
+        put_float(out, field->fstep);
+        fprintf(out, ", %" PRIu64 "u)", field->top);
+    } else if (quantized_signed(field)) {
+        fprintf(out, "quantize_int(get_signed(&raw[%zu], %zu), %" PRId64 "LL, %" PRId64 "LL, %" PRId64 "LL)", at,
+                field->size, field->min, field->max, field->step);
+    } else {
+        fprintf(out, "quantize_int(get_unsigned(&raw[%zu], %zu), %" PRId64 "LL, %" PRId64 "LL, %" PRId64 "LL)", at,
+                field->size, field->min, field->max, field->step);
+    }
+    fprintf(out, ", %u); // %s\n", field->bits, field->name);
+}
+
+/**
+ * Writes the statement that unpacks one field.
+ * @param out Where to write it.
+ * @param field The field.
+ */
+static void write_unpack_field(FILE *out, const struct field_t *field) {
+    if (field->type == TYPE_PAD) return;
+    size_t at = field->offset;
+    if (field->type == TYPE_BOOL) {
+        fprintf(out, "    raw[%zu] = get_bits(&bits, 1); // %s\n", at, field->name);
+    } else if (!field->ranged) {
+        fprintf(out, "    put_le(&raw[%zu], get_bits(&bits, %u), %zu); // %s\n", at, field->bits, field->size,
+                field->name);
+    } else if (field->type == TYPE_F32) {
+        fprintf(out, "    put_f32(&raw[%zu], dequantize_float(get_bits(&bits, %u), ", at, field->bits);
+        put_float(out, field->fmin);
+        fprintf(out, ", ");
+        put_float(out, field->fstep);
+        fprintf(out, ")); // %s\n", field->name);
+    } else {
+        // Unsigned arithmetic wraps to the same bytes a signed value has
+        fprintf(out, "    put_le(&raw[%zu], (uint64_t)%" PRId64 "LL + %" PRId64 "u * get_bits(&bits, %u), %zu);",
+                at, field->min, field->step, field->bits, field->size);
+        fprintf(out, " // %s\n", field->name);
+    }
+}
+
+/** The helpers every generated codec has. */
+static const char *const COMMON_HELPERS =
+    "/** Where a record is being packed. */\n"
+    "struct bit_writer_t {\n"
+    "    /** The next byte to write. */\n"
+    "    uint8_t *data;\n"
+    "    /** Bits written but not yet stored, from the least significant. */\n"
+    "    uint64_t acc;\n"
+    "    /** The number of bits in `acc`. */\n"
+    "    unsigned int count;\n"
+    "};\n"
+    "\n"
+    "/** Where a packed record is being unpacked. */\n"
+    "struct bit_reader_t {\n"
+    "    /** The next byte to read. */\n"
+    "    const uint8_t *data;\n"
+    "    /** Bits read but not yet taken, from the least significant. */\n"
+    "    uint64_t acc;\n"
+    "    /** The number of bits in `acc`. */\n"
+    "    unsigned int count;\n"
+    "};\n"
+    "\n"
+    "/**\n"
+    " * Appends a field to a packed record.\n"
+    " * @param bits Where the record is being packed.\n"
+    " * @param value The packed field, which must fit in its width.\n"
+    " * @param width The width of the packed field in bits, at most 32.\n"
+    " */\n"
+    "static void put_bits(struct bit_writer_t *bits, uint64_t value, unsigned int width) {\n"
+    "    bits->acc |= value << bits->count;\n"
+    "    bits->count += width;\n"
+    "    while (bits->count >= 8) {\n"
+    "        *bits->data++ = (uint8_t)bits->acc;\n"
+    "        bits->acc >>= 8;\n"
+    "        bits->count -= 8;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Stores the last bits of a packed record.\n"
+    " * @param bits Where the record is being packed.\n"
+    " */\n"
+    "static void flush_bits(struct bit_writer_t *bits) {\n"
+    "    if (bits->count > 0) *bits->data++ = (uint8_t)bits->acc;\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Takes the next field from a packed record.\n"
+    " * @param bits Where the record is being unpacked.\n"
+    " * @param width The width of the packed field in bits, at most 32.\n"
+    " * @return The packed field.\n"
+    " */\n"
+    "static uint64_t get_bits(struct bit_reader_t *bits, unsigned int width) {\n"
+    "    while (bits->count < width) {\n"
+    "        bits->acc |= (uint64_t)*bits->data++ << bits->count;\n"
+    "        bits->count += 8;\n"
+    "    }\n"
+    "    uint64_t value = bits->acc & ((UINT64_C(1) << width) - 1);\n"
+    "    bits->acc >>= width;\n"
+    "    bits->count -= width;\n"
+    "    return value;\n"
+    "}\n";
+
+/** The helpers for fields that are more than a bool. */
+static const char *const BYTE_HELPERS =
+    "\n"
+    "/**\n"
+    " * Reads a little-endian unsigned integer.\n"
+    " * @param data The integer.\n"
+    " * @param size The size of the integer in bytes.\n"
+    " * @return The integer.\n"
+    " */\n"
+    "static uint64_t get_le(const uint8_t *data, size_t size) {\n"
+    "    uint64_t value = 0;\n"
+    "    for (size_t i = 0; i < size; i++) value |= (uint64_t)data[i] << (8 * i);\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Writes a little-endian integer.\n"
+    " * @param data Where to write the integer.\n"
+    " * @param value The integer, of which only the low bytes are written.\n"
+    " * @param size The size of the integer in bytes.\n"
+    " */\n"
+    "static void put_le(uint8_t *data, uint64_t value, size_t size) {\n"
+    "    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(value >> (8 * i));\n"
+    "}\n";
+
+/** The helpers for integers packed in steps. */
+static const char *const INTEGER_HELPERS =
+    "\n"
+    "/**\n"
+    " * Packs an integer as the number of steps above the bottom of its range.\n"
+    " * @param value The integer.\n"
+    " * @param min The bottom of the range.\n"
+    " * @param max The top of the range, a whole number of steps above the bottom.\n"
+    " * @param step The step.\n"
+    " * @return The nearest number of steps, clamped to the range.\n"
+    " */\n"
+    "static uint64_t quantize_int(int64_t value, int64_t min, int64_t max, int64_t step) {\n"
+    "    if (value <= min) return 0;\n"
+    "    if (value >= max) return (uint64_t)(max - min) / (uint64_t)step;\n"
+    "    return ((uint64_t)(value - min) + (uint64_t)step / 2) / (uint64_t)step;\n"
+    "}\n";
+
+/** The helpers for unsigned integers packed in steps. */
+static const char *const UNSIGNED_HELPERS =
+    "\n"
+    "/**\n"
+    " * Reads a little-endian unsigned integer as a signed one, which holds every unsigned field.\n"
+    " * @param data The integer.\n"
+    " * @param size The size of the integer in bytes, at most 4.\n"
+    " * @return The integer.\n"
+    " */\n"
+    "static int64_t get_unsigned(const uint8_t *data, size_t size) {\n"
+    "    uint64_t value = get_le(data, size);\n"
+    "    return (int64_t)value;\n"
+    "}\n";
+
+/** The helpers for signed integers packed in steps. */
+static const char *const SIGNED_HELPERS =
+    "\n"
+    "/**\n"
+    " * Reads a little-endian signed integer.\n"
+    " * @param data The integer.\n"
+    " * @param size The size of the integer in bytes.\n"
+    " * @return The integer.\n"
+    " */\n"
+    "static int64_t get_signed(const uint8_t *data, size_t size) {\n"
+    "    uint64_t value = get_le(data, size), sign = UINT64_C(1) << (8 * size - 1);\n"
+    "    return (int64_t)(value ^ sign) - (int64_t)sign;\n"
+    "}\n";
+
+/** The helpers for floats packed in steps. */
+static const char *const FLOAT_HELPERS =
+    "\n"
+    "/**\n"
+    " * Reads a little-endian float.\n"
+    " * @param data The float.\n"
+    " * @return The float.\n"
+    " */\n"
+    "static float get_f32(const uint8_t *data) {\n"
+    "    uint32_t bits = get_le(data, 4);\n"
+    "    float value;\n"
+    "    memcpy(&value, &bits, sizeof(value));\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Writes a little-endian float.\n"
+    " * @param data Where to write the float.\n"
+    " * @param value The float.\n"
+    " */\n"
+    "static void put_f32(uint8_t *data, float value) {\n"
+    "    uint32_t bits;\n"
+    "    memcpy(&bits, &value, sizeof(bits));\n"
+    "    put_le(data, bits, 4);\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Packs a float as the number of steps above the bottom of its range.\n"
+    " * @param value The float.\n"
+    " * @param min The bottom of the range.\n"
+    " * @param step The step.\n"
+    " * @param top The number of steps to the top of the range.\n"
+    " * @return The nearest number of steps, clamped to the range, or 0 if the float is not a number.\n"
+    " */\n"
+    "static uint64_t quantize_float(float value, float min, float step, uint64_t top) {\n"
+    "    if (!(value > min)) return 0;\n"
+    "    double steps = ((double)value - (double)min) / (double)step;\n"
+    "    if (steps >= (double)top) return top;\n"
+    "    return ((uint64_t)(2 * steps) + 1) / 2;\n"
+    "}\n"
+    "\n"
+    "/**\n"
+    " * Unpacks a float packed as a number of steps above the bottom of its range.\n"
+    " * @param steps The number of steps.\n"
+    " * @param min The bottom of the range.\n"
+    " * @param step The step.\n"
+    " * @return The float.\n"
+    " */\n"
+    "static float dequantize_float(uint64_t steps, float min, float step) {\n"
+    "    return (float)((double)min + (double)steps * (double)step);\n"
+    "}\n";
+
+/**
+ * Writes a field's entry in the schema table.
+ * @param out Where to write it.
+ * @param field The field.
+ * @param upper The prefix in upper case.
+ */
+static void write_field_entry(FILE *out, const struct field_t *field, const char *upper) {
+    char type[MAX_NAME];
+    upper_case(type, TYPE_INFO[field->type].name);
+    fprintf(out, "             {\"%s\", %s_%s, %zu, %u, %d, %" PRId64 ", %" PRId64 ", %" PRId64 ", ", field->name,
+            upper, type, field->offset + 1, field->bits, field->ranged, field->min, field->max, field->step);
+    put_float(out, field->fmin);
+    fprintf(out, ", ");
+    put_float(out, field->fmax);
+    fprintf(out, ", ");
+    put_float(out, field->fstep);
+    fprintf(out, "},\n");
+}
+
+/**
+ * Writes the generated source.
+ * @param out Where to write it.
+ * @param prefix The prefix of every name, in lower case.
+ * @param upper The prefix in upper case.
+ * @param source Where the schema is, as it is mentioned in the generated code.
+ * @param source_name The file name of the source.
+ * @param header_name The file name of the header.
+ */
+static void write_source(FILE *out, const char *prefix, const char *upper, const char *source,
+                         const char *source_name, const char *header_name) {
+    fprintf(out, "/**\n * @file %s\n", source_name);
+    fprintf(out, " * @brief The packer and unpacker of the records in %s, generated by tools/packgen. Do not edit.\n",
+            source);
+    fprintf(out, " *\n * The packer is used by broadcaster, and the unpacker is for the ground station.\n */\n");
+    fprintf(out, "#include \"%s\"\n", header_name);
+    fprintf(out, "#include <string.h>\n");
+    fprintf(out, "\n%s", COMMON_HELPERS);
+    if (any_field(byte_field)) fprintf(out, "%s", BYTE_HELPERS);
+    if (any_field(quantized_integer)) fprintf(out, "%s", INTEGER_HELPERS);
+    if (any_field(quantized_unsigned)) fprintf(out, "%s", UNSIGNED_HELPERS);
+    if (any_field(quantized_signed)) fprintf(out, "%s", SIGNED_HELPERS);
+    if (any_field(quantized_float)) fprintf(out, "%s", FLOAT_HELPERS);
+
+    fprintf(out, "\n/** The record types, in the order of the schema. */\n");
+    fprintf(out, "const struct %s_record_t %s_SCHEMA[%s_RECORDS] = {\n", prefix, upper, upper);
+    for (size_t r = 0; r < nrecords; r++) {
+        const struct record_t *record = &records[r];
+        fprintf(out, "    {\"%s\",\n     %u,\n     %zu,\n     %zu,\n     %zu,\n     {\n", record->name, record->id,
+                record->raw_len, packed_len(record), record->nfields);
+        for (size_t f = 0; f < record->nfields; f++) write_field_entry(out, &record->fields[f], upper);
+        fprintf(out, "     }},\n");
+    }
+    fprintf(out, "};\n");
+
+    for (size_t r = 0; r < nrecords; r++) {
+        const struct record_t *record = &records[r];
+        fprintf(out, "\n/**\n * Packs the fields of %s %s record.\n", strchr("aeiou", record->name[0]) ? "an" : "a",
+                record->name);
+        fprintf(out, " * @param raw The fields, after the id byte.\n");
+        fprintf(out, " * @param out Where to write the packed fields, %zu bytes.\n */\n", packed_len(record) - 1);
+        fprintf(out, "static void pack_%s(const uint8_t *raw, uint8_t *out) {\n", record->name);
+        fprintf(out, "    struct bit_writer_t bits = {.data = out};\n");
+        for (size_t f = 0; f < record->nfields; f++) write_pack_field(out, &record->fields[f]);
+        fprintf(out, "    flush_bits(&bits);\n}\n");
+
+        fprintf(out, "\n/**\n * Unpacks the fields of %s %s record.\n", strchr("aeiou", record->name[0]) ? "an" : "a",
+                record->name);
+        fprintf(out, " * @param packed The packed fields, after the id byte.\n");
+        fprintf(out, " * @param raw Where to write the fields, %zu bytes, which must be zero.\n */\n",
+                record->raw_len - 1);
+        fprintf(out, "static void unpack_%s(const uint8_t *packed, uint8_t *raw) {\n", record->name);
+        fprintf(out, "    struct bit_reader_t bits = {.data = packed};\n");
+        for (size_t f = 0; f < record->nfields; f++) write_unpack_field(out, &record->fields[f]);
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "\n/**\n * Packs a record, if it is one of the record types.\n");
+    fprintf(out, " * @param raw The message.\n * @param len The length of the message in bytes.\n");
+    fprintf(out, " * @param out Where to write the packed record, with room for `%s_MAX_PACKED` bytes.\n", upper);
+    fprintf(out, " * @return The length of the packed record, or 0 if the message is not a record of any type.\n */\n");
+    fprintf(out, "size_t %s_pack(const uint8_t *raw, size_t len, uint8_t *out) {\n", prefix);
+    fprintf(out, "    if (len == 0) return 0;\n    switch (raw[0]) {\n");
+    for (size_t r = 0; r < nrecords; r++) {
+        const struct record_t *record = &records[r];
+        fprintf(out, "    case %u:\n        if (len != %zu) return 0;\n", record->id, record->raw_len);
+        fprintf(out, "        pack_%s(&raw[1], &out[1]);\n", record->name);
+        fprintf(out, "        out[0] = %s_PACKED | %u;\n        return %zu;\n", upper, record->id, packed_len(record));
+    }
+    fprintf(out, "    default:\n        return 0;\n    }\n}\n");
+
+    fprintf(out, "\n/**\n * Unpacks a record packed with `%s_pack`.\n", prefix);
+    fprintf(out, " * @param packed The packed record.\n * @param len The length of the packed record in bytes.\n");
+    fprintf(out, " * @param out Where to write the record, with room for `%s_MAX_RAW` bytes.\n", upper);
+    fprintf(out, " * @return The length of the record, or 0 if the message is not a packed record of any type.\n */\n");
+    fprintf(out, "size_t %s_unpack(const uint8_t *packed, size_t len, uint8_t *out) {\n", prefix);
+    fprintf(out, "    if (len == 0 || !(packed[0] & %s_PACKED)) return 0;\n", upper);
+    fprintf(out, "    switch (packed[0] & ~%s_PACKED) {\n", upper);
+    for (size_t r = 0; r < nrecords; r++) {
+        const struct record_t *record = &records[r];
+        fprintf(out, "    case %u:\n        if (len != %zu) return 0;\n", record->id, packed_len(record));
+        fprintf(out, "        memset(out, 0, %zu);\n", record->raw_len);
+        fprintf(out, "        out[0] = %u;\n", record->id);
+        fprintf(out, "        unpack_%s(&packed[1], &out[1]);\n        return %zu;\n", record->name, record->raw_len);
+    }
+    fprintf(out, "    default:\n        return 0;\n    }\n}\n");
+}
+
+int main(int argc, char **argv) {
+
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s schema source header\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    schema_path = argv[1];
+    FILE *schema = fopen(schema_path, "r");
+    if (schema == NULL) {
+        fprintf(stderr, "Could not open schema %s: %s\n", schema_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    parse_schema(schema);
+    fclose(schema);
+
+    // The prefix is the schema's file name without its extension
+    char path[MAX_LINE], prefix[MAX_NAME], upper[MAX_NAME];
+    snprintf(path, sizeof(path), "%s", schema_path);
+    snprintf(prefix, sizeof(prefix), "%s", basename(path));
+    char *dot = strchr(prefix, '.');
+    if (dot != NULL) *dot = '\0';
+    if (!valid_name(prefix)) {
+        fprintf(stderr, "Schema file name %s does not make a valid prefix\n", schema_path);
+        exit(EXIT_FAILURE);
+    }
+    upper_case(upper, prefix);
+
+    char source_name[MAX_LINE], header_name[MAX_LINE];
+    snprintf(path, sizeof(path), "%s", argv[2]);
+    snprintf(source_name, sizeof(source_name), "%s", basename(path));
+    snprintf(path, sizeof(path), "%s", argv[3]);
+    snprintf(header_name, sizeof(header_name), "%s", basename(path));
+
+    FILE *source = fopen(argv[2], "w"), *header = fopen(argv[3], "w");
+    if (source == NULL || header == NULL) {
+        fprintf(stderr, "Could not create %s and %s: %s\n", argv[2], argv[3], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    write_header(header, prefix, upper, schema_path, header_name);
+    write_source(source, prefix, upper, schema_path, source_name, header_name);
+    if (fclose(header) || fclose(source)) {
+        fprintf(stderr, "Could not write %s and %s: %s\n", argv[2], argv[3], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t r = 0; r < nrecords; r++) {
+        printf("%-20s id %3u: %3zu bytes packed into %3zu\n", records[r].name, records[r].id, records[r].raw_len,
+               packed_len(&records[r]));
+    }
+    return EXIT_SUCCESS;
+}
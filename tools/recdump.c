@@ -0,0 +1,131 @@
+/**
+ * @file recdump.c
+ * @brief Prints a recording of the messages broadcaster took off its transmit queue.
+ *
+ * The recording is summarized by priority, with the time messages waited in the queue and what became of them, so that
+ * the same traffic replayed under different settings can be compared. With `-v`, every message is printed as well, in
+ * the order it was queued.
+ */
+#define _GNU_SOURCE
+#include "record.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The number of priorities summarized separately. Higher priorities are counted with the highest. */
+#define PRIORITIES 4
+
+/** The names of the outcomes, as they are printed. */
+static const char *const OUTCOME_NAMES[] = {[OUTCOME_PENDING] = "pending", [OUTCOME_SENT] = "sent",
+                                            [OUTCOME_FAILED] = "failed"};
+
+/** The order entries were queued in. */
+static uint32_t order[RECORD_MAX_ENTRIES];
+
+/** Totals for the messages of one priority. */
+struct totals_t {
+    unsigned long messages;
+    unsigned long bytes;
+    unsigned long outcomes[3];
+    int64_t wait_ns;
+    int64_t max_wait_ns;
+};
+
+/**
+ * Converts a duration to milliseconds for printing.
+ * @param ns The duration in nanoseconds.
+ * @return The duration in milliseconds.
+ */
+static double ms(int64_t ns) { return (double)ns / 1000000; }
+
+/**
+ * Prints every message of a recording in the order it was queued.
+ * @param recording The recording.
+ */
+static void print_entries(const struct recording_t *recording) {
+    int64_t start = record_entry(recording, order[0])->queued_ns;
+    printf("%10s %12s %4s %6s %5s %10s %-7s %s\n", "entry", "queued ms", "prio", "input", "len", "wait ms", "outcome",
+           "data");
+    for (uint64_t i = 0; i < recording->count; i++) {
+        const struct record_entry_t *e = record_entry(recording, order[i]);
+        printf("%10llu %12.3f %4u %6u %5u %10.3f %-7s ", (unsigned long long)e->seq, ms(e->queued_ns - start),
+               e->priority, e->source, e->len, ms(e->dequeued_ns - e->queued_ns),
+               e->outcome <= OUTCOME_FAILED ? OUTCOME_NAMES[e->outcome] : "?");
+        for (size_t j = 0; j < e->len && j < PQ_PACKET_MAX; j++) printf("%02x", e->data[j]);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+/**
+ * Prints a summary of a recording by priority.
+ * @param recording The recording.
+ */
+static void print_summary(const struct recording_t *recording) {
+    struct totals_t totals[PRIORITIES] = {0};
+    int64_t first = 0, last = 0;
+    for (uint64_t i = 0; i < recording->count; i++) {
+        const struct record_entry_t *e = record_entry(recording, i);
+        struct totals_t *t = &totals[e->priority < PRIORITIES ? e->priority : PRIORITIES - 1];
+        int64_t wait = e->dequeued_ns - e->queued_ns;
+        t->messages++;
+        t->bytes += e->len;
+        if (e->outcome <= OUTCOME_FAILED) t->outcomes[e->outcome]++;
+        t->wait_ns += wait;
+        if (wait > t->max_wait_ns) t->max_wait_ns = wait;
+        if (i == 0 || e->queued_ns < first) first = e->queued_ns;
+        if (e->queued_ns > last) last = e->queued_ns;
+    }
+
+    printf("%llu messages recorded, %llu kept in a ring of %u, spanning %.3f s\n",
+           (unsigned long long)recording->header->count, (unsigned long long)recording->count,
+           recording->header->capacity, ms(last - first) / 1000);
+    printf("%4s %9s %11s %9s %9s %9s %13s %13s\n", "prio", "messages", "bytes", "sent", "failed", "pending",
+           "mean wait ms", "max wait ms");
+    for (unsigned int p = 0; p < PRIORITIES; p++) {
+        const struct totals_t *t = &totals[p];
+        if (t->messages == 0) continue;
+        printf("%3u%s %9lu %11lu %9lu %9lu %9lu %13.3f %13.3f\n", p, p == PRIORITIES - 1 ? "+" : " ", t->messages,
+               t->bytes, t->outcomes[OUTCOME_SENT], t->outcomes[OUTCOME_FAILED], t->outcomes[OUTCOME_PENDING],
+               ms(t->wait_ns / (int64_t)t->messages), ms(t->max_wait_ns));
+    }
+}
+
+int main(int argc, char **argv) {
+
+    bool verbose = false;
+    int c;
+    while ((c = getopt(argc, argv, "v")) != -1) {
+        switch (c) {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-v] recording\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-v] recording\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    struct recording_t recording;
+    int err = record_load(&recording, argv[optind]);
+    if (err) {
+        fprintf(stderr, "Could not read recording %s: %s\n", argv[optind], strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    if (recording.count == 0) {
+        printf("No messages recorded\n");
+        return EXIT_SUCCESS;
+    }
+
+    record_order(&recording, order);
+    if (verbose) print_entries(&recording);
+    print_summary(&recording);
+    record_unload(&recording);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file ringbench.c
+ * @brief A micro-benchmark of the shared memory input ring against the POSIX message queue input.
+ *
+ * A producer process sends messages to a consumer in this process, once through a message queue and once through a
+ * ring, the way a logger would feed broadcaster. The consumer takes each message the way broadcaster's input threads
+ * do, copying it once into a packet as the transmit queue would: from `mq_receive`'s buffer for the queue, straight
+ * from the ring for the ring. Each message carries its sequence number, which is checked, and the time it was sent.
+ *
+ * Both transports are measured flat out, for the cost per message, and paced at a fixed rate, where the consumer is
+ * asleep whenever a message arrives, for the latency of waking it.
+ */
+#define _GNU_SOURCE
+#include "ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The largest number of messages a run can send. */
+#define MAX_MESSAGES 1000000
+
+/** The largest message size. */
+#define MAX_SIZE 4096
+
+/** The name of the message queue and the ring. */
+#define BENCH_NAME "/ringbench"
+
+/** The number of messages a message queue holds, the default limit for unprivileged processes on Linux. */
+#define QUEUE_DEPTH 10
+
+/** The transports compared. */
+typedef enum {
+    TRANSPORT_QUEUE, /**< A POSIX message queue. */
+    TRANSPORT_RING,  /**< A shared memory ring. */
+} Transport;
+
+/** The names of the transports, as they are reported. */
+static const char *const TRANSPORT_NAMES[] = {[TRANSPORT_QUEUE] = "mq", [TRANSPORT_RING] = "ring"};
+
+/** The latency of each message, in nanoseconds. */
+static int64_t latency[MAX_MESSAGES];
+
+/** Where each message is copied to, as the transmit queue would. */
+static uint8_t packet[MAX_SIZE];
+
+/** Keeps the compiler from optimizing the copies away. */
+static volatile uint8_t sink;
+
+/** Benchmark configuration. */
+static struct {
+    unsigned long count;
+    size_t size;
+    unsigned long rate;
+    size_t ring_size;
+} config = {.count = 200000, .size = 64, .rate = 10000, .ring_size = RING_DEFAULT_SIZE};
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Sends every message, each starting with its sequence number and the time it was sent, then exits.
+ * @param transport The transport to send with.
+ * @param q The message queue.
+ * @param ring The producer's side of the ring.
+ * @param rate The messages per second to send, or 0 for as fast as possible.
+ */
+static void produce(Transport transport, mqd_t q, struct ring_t *ring, unsigned long rate) {
+    uint8_t message[MAX_SIZE] = {0};
+    int64_t interval = rate ? 1000000000 / (int64_t)rate : 0;
+    int64_t next = now_ns();
+    for (uint64_t seq = 0; seq < config.count; seq++) {
+        if (interval) {
+            next += interval;
+            struct timespec due = {.tv_sec = next / 1000000000, .tv_nsec = next % 1000000000};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+                ;
+        }
+        int64_t sent = now_ns();
+        if (transport == TRANSPORT_QUEUE) {
+            memcpy(message, &seq, sizeof(seq));
+            memcpy(&message[sizeof(seq)], &sent, sizeof(sent));
+            mq_send(q, (const char *)message, config.size, 0);
+            continue;
+        }
+        // The message is written straight into the ring
+        uint8_t *slot;
+        while (ring_reserve(ring, config.size, &slot) == EAGAIN) sched_yield();
+        memcpy(slot, &seq, sizeof(seq));
+        memcpy(&slot[sizeof(seq)], &sent, sizeof(sent));
+        ring_commit(ring, config.size, 0);
+    }
+    if (transport == TRANSPORT_RING) ring_close(ring);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Takes one message off a transport and copies it into the packet.
+ * @param transport The transport.
+ * @param q The message queue.
+ * @param ring The ring.
+ * @param buffer The buffer `mq_receive` writes into.
+ * @return The sequence number of the message, or -1 if the transport ended or failed.
+ */
+static int64_t consume(Transport transport, mqd_t q, struct ring_t *ring, uint8_t *buffer) {
+    const uint8_t *data = buffer;
+    size_t len;
+    if (transport == TRANSPORT_QUEUE) {
+        ssize_t nread = mq_receive(q, (char *)buffer, MAX_SIZE, NULL);
+        if (nread < 0) return -1;
+        len = nread;
+    } else {
+        unsigned int priority;
+        if (ring_peek(ring, &data, &len, &priority)) return -1;
+    }
+    memcpy(packet, data, len);
+    if (transport == TRANSPORT_RING) ring_release(ring);
+    sink = packet[len - 1];
+
+    uint64_t seq;
+    int64_t sent;
+    memcpy(&seq, packet, sizeof(seq));
+    memcpy(&sent, &packet[sizeof(seq)], sizeof(sent));
+    latency[seq] = now_ns() - sent;
+    return (int64_t)seq;
+}
+
+/**
+ * Compares two latencies for sorting.
+ * @param a The first latency.
+ * @param b The second latency.
+ * @return Negative, zero or positive as the first is less than, equal to or greater than the second.
+ */
+static int compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sends every message through a transport from a producer process and prints the cost and latency.
+ * @param transport The transport.
+ * @param rate The messages per second to send, or 0 for as fast as possible.
+ */
+static void measure(Transport transport, unsigned long rate) {
+    mqd_t q = (mqd_t)-1;
+    struct ring_t producer_ring, ring;
+    if (transport == TRANSPORT_QUEUE) {
+        struct mq_attr attr = {.mq_maxmsg = QUEUE_DEPTH, .mq_msgsize = MAX_SIZE};
+        mq_unlink(BENCH_NAME);
+        q = mq_open(BENCH_NAME, O_CREAT | O_RDWR, 0600, &attr);
+        if (q == (mqd_t)-1) {
+            fprintf(stderr, "Could not create queue %s: %s\n", BENCH_NAME, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        // Both sides are set up before the fork, so the producer inherits its mapping and never races the consumer
+        int err = ring_create(&producer_ring, BENCH_NAME, config.ring_size);
+        if (!err) err = ring_open(&ring, BENCH_NAME);
+        if (err) {
+            fprintf(stderr, "Could not create ring %s: %s\n", BENCH_NAME, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fflush(stdout);
+    int64_t start = now_ns();
+    pid_t producer = fork();
+    if (producer == 0) produce(transport, q, &producer_ring, rate);
+
+    static uint8_t buffer[MAX_SIZE];
+    unsigned long received = 0, out_of_order = 0;
+    int64_t expected = 0;
+    while (received < config.count) {
+        int64_t seq = consume(transport, q, &ring, buffer);
+        if (seq < 0) break;
+        if (seq != expected) out_of_order++;
+        expected = seq + 1;
+        received++;
+    }
+    int64_t elapsed = now_ns() - start;
+    waitpid(producer, NULL, 0);
+
+    if (transport == TRANSPORT_QUEUE) {
+        mq_close(q);
+        mq_unlink(BENCH_NAME);
+    } else {
+        ring_unmap(&ring);
+        ring_unmap(&producer_ring);
+        ring_unlink(BENCH_NAME);
+    }
+
+    qsort(latency, received, sizeof(latency[0]), compare);
+    char label[32];
+    if (rate) snprintf(label, sizeof(label), "%lu/s", rate);
+    else snprintf(label, sizeof(label), "flat out");
+    printf("%-5s %9s %12.0f %12.1f %12.1f %12.1f %8lu\n", TRANSPORT_NAMES[transport], label,
+           (double)received * 1000000000 / (double)elapsed, (double)elapsed / (double)received,
+           (double)latency[received / 2] / 1000, (double)latency[received * 99 / 100] / 1000,
+           config.count - received + out_of_order);
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, "n:s:r:b:")) != -1) {
+        switch (c) {
+        case 'n':
+            config.count = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.size = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            config.rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            config.ring_size = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n count] [-s size] [-r rate] [-b ring-bytes]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (config.count == 0 || config.count > MAX_MESSAGES || config.size < 16 || config.size > MAX_SIZE) {
+        fprintf(stderr, "Count must be 1-%d and size 16-%d\n", MAX_MESSAGES, MAX_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%lu messages of %zu bytes, queue depth %d, ring of %zu bytes\n", config.count, config.size, QUEUE_DEPTH,
+           config.ring_size);
+    printf("%-5s %9s %12s %12s %12s %12s %8s\n", "input", "rate", "msgs/s", "ns/msg", "p50 us", "p99 us", "lost");
+    for (Transport t = TRANSPORT_QUEUE; t <= TRANSPORT_RING; t++) measure(t, 0);
+    if (config.rate) {
+        for (Transport t = TRANSPORT_QUEUE; t <= TRANSPORT_RING; t++) measure(t, config.rate);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,689 @@
+/**
+ * @file rn2483sim.c
+ * @brief A software emulator of the RN2483 LoRa radio module, served over a pseudo-terminal.
+ *
+ * The emulator answers the subset of the RN2483 command set that broadcaster uses (`radio set`, `radio get`,
+ * `mac pause`, `radio tx`, `radio rx`, `radio rxstop`, `sys get ver`, `sys reset`) with the same two-stage responses as
+ * the real module. Time on air
+ * is derived from the currently configured `struct lora_params_t`, and the UART wire time of every byte in both
+ * directions is modelled at the module's baud rate, since a pseudo-terminal would otherwise move bytes instantly. The
+ * baud rate can be changed with the auto-baud sequence, after which characters sent at any other rate are ignored.
+ *
+ * Response delays, time-on-air scaling and error injection are configurable so that broadcaster can be exercised and
+ * benchmarked on a Linux host without a real module attached. Brown-outs can be injected as well: the module loses its
+ * settings, `mac pause` and baud rate as if power had dipped, and optionally stays silent for a while as it restarts.
+ *
+ * A ground station is emulated at the other end of the radio link. Transmissions can be lost on the way down, and the
+ * ground station answers every top priority frame it hears with an acknowledgement of the frames it has heard, sent a
+ * fixed delay after the frame ends. The acknowledgement is received if a `radio rx` window is open at the time and it
+ * is not lost on the way up.
+ *
+ * When started with `-v`, every command received and every response sent is logged to stdout as a line of the form
+ * `<monotonic ns> <direction> <text>`, where direction is `>` for commands, `<` for responses, `!` for commands
+ * whose response was deliberately dropped and `*` for changes of module state such as `baud 115200`, `lost` for a
+ * frame the ground station did not hear or `ack lost` for an acknowledgement the module did not. The first line of
+ * output is always `pty <path>` with the path of the slave device.
+ */
+#define _GNU_SOURCE
+#include "arq.h"
+#include "linkhdr.h"
+#include "radio.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The maximum length of a command line, including the longest possible `radio tx` command. */
+#define LINE_MAX_LEN 1024
+
+/** The maximum number of responses that can be scheduled at once. */
+#define MAX_PENDING 16
+
+/** The maximum payload of a `radio tx` command in bytes. */
+#define MAX_PAYLOAD 255
+
+/** The version string reported by `sys get ver` and `sys reset`. */
+#define VERSION_STRING "RN2483 1.0.5 Oct 31 2018 15:06:52"
+
+/** Nanoseconds in one second. */
+#define NS_PER_S 1000000000LL
+
+/** Nanoseconds in one microsecond. */
+#define NS_PER_US 1000LL
+
+/** A response that will be written to the pseudo-terminal at a future time. */
+struct pending_t {
+    /** The monotonic time in nanoseconds at which the response is sent. */
+    int64_t when;
+    /** The response text, without line terminator. */
+    char text[32];
+};
+
+/** The emulated state of the module. */
+struct module_t {
+    /** The currently configured radio parameters. */
+    struct lora_params_t params;
+    /** The watchdog timeout in milliseconds. */
+    uint32_t wdt;
+    /** Whether the LoRaWAN stack has been paused, which is required before raw radio commands can transmit. */
+    bool mac_paused;
+    /** Monotonic time in nanoseconds at which the current transmission ends. */
+    int64_t busy_until;
+    /** The UART baud rate the module is running at. */
+    unsigned int baud;
+};
+
+/** Command line configuration of the emulator. */
+struct sim_config_t {
+    /** Delay before the first-stage response to a command, in microseconds. */
+    int64_t response_delay_us;
+    /** Percentage of the computed time on air that transmissions actually take. */
+    unsigned int toa_pct;
+    /** Percent chance that a transmission finishes with `radio_err`. */
+    unsigned int tx_err_pct;
+    /** Percent chance that a command gets no response at all. */
+    unsigned int drop_pct;
+    /** UART baud rate the module starts up with. */
+    unsigned int baud;
+    /** The highest baud rate auto-baud detection locks on to. */
+    unsigned int max_baud;
+    /** Whether to log traffic to stdout. */
+    bool verbose;
+    /** Whether the module starts out as a previous broadcaster run left it, rather than freshly reset. */
+    bool warm;
+    /** How often the module browns out, in milliseconds, or 0 for never. */
+    int64_t brownout_ms;
+    /** How long the module ignores everything after a brown-out, in milliseconds. */
+    int64_t silent_ms;
+    /** Percent chance that a transmission that succeeds is not heard by the ground station. */
+    unsigned int down_loss_pct;
+    /** Percent chance that an acknowledgement from the ground station is not heard by the module. */
+    unsigned int up_loss_pct;
+    /** How long after the end of a top priority frame the ground station sends its acknowledgement, in milliseconds. */
+    int64_t reply_delay_ms;
+    /** Path of a symbolic link to create to the slave device, or NULL. */
+    const char *link;
+};
+
+/** Parameters of a module that has just been reset, as documented for the RN2483. */
+static const struct lora_params_t RESET_PARAMS = {.modulation = LORA,
+                                                  .frequency = 868100000,
+                                                  .power = 1,
+                                                  .spread_factor = 12,
+                                                  .coding_rate = CR_4_5,
+                                                  .bandwidth = 125,
+                                                  .preamble_len = 8,
+                                                  .cyclic_redundancy = true,
+                                                  .iqi = false,
+                                                  .sync_word = 0x34};
+
+/** Parameters a module is left with by a previous run of broadcaster with its default settings. */
+static const struct lora_params_t WARM_PARAMS = {.modulation = LORA,
+                                                 .frequency = 433050000,
+                                                 .power = 15,
+                                                 .spread_factor = 7,
+                                                 .coding_rate = CR_4_7,
+                                                 .bandwidth = 500,
+                                                 .preamble_len = 6,
+                                                 .cyclic_redundancy = true,
+                                                 .iqi = false,
+                                                 .sync_word = 0x43};
+
+/** String representation of coding rates, indexed by `CodingRate`. */
+static const char *CODING_RATES[] = {[CR_4_5] = "4/5", [CR_4_6] = "4/6", [CR_4_7] = "4/7", [CR_4_8] = "4/8"};
+
+/** Emulator configuration. */
+static struct sim_config_t config = {
+    .response_delay_us = 2000, .toa_pct = 100, .tx_err_pct = 0, .drop_pct = 0, .baud = 57600, .max_baud = 230400,
+    .reply_delay_ms = 10, .verbose = false};
+
+/** Emulated module state. */
+static struct module_t module;
+
+/** Scheduled responses, kept in order of send time. */
+static struct pending_t pending[MAX_PENDING];
+
+/** Number of scheduled responses. */
+static size_t npending = 0;
+
+/** Monotonic time at which the UART receiver will have finished clocking in all bytes received so far. */
+static int64_t rx_cursor = 0;
+
+/** Monotonic time in nanoseconds of the next brown-out, if they are injected. */
+static int64_t next_brownout = 0;
+
+/** Monotonic time in nanoseconds until which the module ignores everything, while it restarts after a brown-out. */
+static int64_t silent_until = 0;
+
+/** What the emulated ground station has heard of the module's frames. */
+static struct arq_receiver_t ground;
+
+/** Monotonic time in nanoseconds at which the ground station's next acknowledgement starts, or 0 if none is due. */
+static int64_t reply_at = 0;
+
+/** Set by the signal handler to stop the emulator. */
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Gets the current monotonic time.
+ * @return The current monotonic time in nanoseconds.
+ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+/**
+ * Calculates the wire time of a number of bytes on the UART.
+ * @param nbytes The number of bytes, each framed with one start and one stop bit.
+ * @return The wire time in nanoseconds.
+ */
+static int64_t wire_time(size_t nbytes) { return (int64_t)nbytes * 10 * NS_PER_S / module.baud; }
+
+/**
+ * Logs a line of traffic to stdout if verbose output is enabled.
+ * @param when The monotonic time of the event in nanoseconds.
+ * @param direction '>' for commands received, '<' for responses sent, '!' for dropped responses, '*' for changes of
+ * module state.
+ * @param text The text of the command or response.
+ */
+static void log_traffic(int64_t when, char direction, const char *text) {
+    if (config.verbose) printf("%lld %c %s\n", (long long)when, direction, text);
+}
+
+/**
+ * Schedules a response to be sent to broadcaster.
+ * @param when The earliest monotonic time at which the response may start being clocked out.
+ * @param text The response text, without line terminator.
+ */
+static void schedule(int64_t when, const char *text) {
+    if (npending == MAX_PENDING) return;
+
+    /* The response is only complete once its last byte has been clocked out, terminator included. */
+    when += wire_time(strlen(text) + 2);
+
+    size_t i = npending;
+    while (i > 0 && pending[i - 1].when > when) {
+        pending[i] = pending[i - 1];
+        i--;
+    }
+    pending[i].when = when;
+    snprintf(pending[i].text, sizeof(pending[i].text), "%s", text);
+    npending++;
+}
+
+/**
+ * Returns a random outcome with the given probability.
+ * @param pct The probability in percent.
+ * @return True with probability `pct`/100.
+ */
+static bool chance(unsigned int pct) { return pct > 0 && (unsigned int)(rand() % 100) < pct; }
+
+/**
+ * Handles a `radio set` command.
+ * @param param The name of the parameter.
+ * @param value The value to set, or NULL if none was given.
+ * @return True if the parameter and value were valid.
+ */
+static bool sim_radio_set(const char *param, const char *value) {
+    if (value == NULL) return false;
+
+    char *end;
+    struct lora_params_t *p = &module.params;
+    if (!strcmp(param, "mod")) {
+        if (!strcmp(value, "lora")) p->modulation = LORA;
+        else if (!strcmp(value, "fsk")) p->modulation = FSK;
+        else return false;
+    } else if (!strcmp(param, "freq")) {
+        p->frequency = strtoul(value, &end, 10);
+    } else if (!strcmp(param, "pwr")) {
+        p->power = strtol(value, &end, 10);
+    } else if (!strcmp(param, "sf")) {
+        unsigned long sf = strtoul(value + 2, &end, 10);
+        if (strncmp(value, "sf", 2) || sf < 7 || sf > 12) return false;
+        p->spread_factor = sf;
+    } else if (!strcmp(param, "cr")) {
+        for (size_t i = 0; i < sizeof(CODING_RATES) / sizeof(CODING_RATES[0]); i++) {
+            if (!strcmp(value, CODING_RATES[i])) {
+                p->coding_rate = (CodingRate)i;
+                return true;
+            }
+        }
+        return false;
+    } else if (!strcmp(param, "bw")) {
+        unsigned long bw = strtoul(value, &end, 10);
+        if (bw != 125 && bw != 250 && bw != 500) return false;
+        p->bandwidth = bw;
+    } else if (!strcmp(param, "prlen")) {
+        p->preamble_len = strtoul(value, &end, 10);
+    } else if (!strcmp(param, "crc")) {
+        p->cyclic_redundancy = !strcmp(value, "on");
+    } else if (!strcmp(param, "iqi")) {
+        p->iqi = !strcmp(value, "on");
+    } else if (!strcmp(param, "sync")) {
+        p->sync_word = strtoull(value, &end, 16);
+    } else if (!strcmp(param, "wdt")) {
+        module.wdt = strtoul(value, &end, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Handles a `radio get` command.
+ * @param param The name of the parameter.
+ * @param out The buffer to write the response into.
+ * @param len The size of the response buffer.
+ */
+static void sim_radio_get(const char *param, char *out, size_t len) {
+    const struct lora_params_t *p = &module.params;
+    if (!strcmp(param, "mod")) snprintf(out, len, "%s", p->modulation == LORA ? "lora" : "fsk");
+    else if (!strcmp(param, "freq")) snprintf(out, len, "%u", p->frequency);
+    else if (!strcmp(param, "pwr")) snprintf(out, len, "%d", p->power);
+    else if (!strcmp(param, "sf")) snprintf(out, len, "sf%u", p->spread_factor);
+    else if (!strcmp(param, "cr")) snprintf(out, len, "%s", CODING_RATES[p->coding_rate]);
+    else if (!strcmp(param, "bw")) snprintf(out, len, "%u", p->bandwidth);
+    else if (!strcmp(param, "prlen")) snprintf(out, len, "%u", p->preamble_len);
+    else if (!strcmp(param, "crc")) snprintf(out, len, "%s", p->cyclic_redundancy ? "on" : "off");
+    else if (!strcmp(param, "iqi")) snprintf(out, len, "%s", p->iqi ? "on" : "off");
+    else if (!strcmp(param, "sync")) snprintf(out, len, "%llx", (unsigned long long)p->sync_word);
+    else if (!strcmp(param, "wdt")) snprintf(out, len, "%u", module.wdt);
+    else snprintf(out, len, "invalid_param");
+}
+
+/**
+ * Resets the module to its power-on state.
+ */
+static void module_reset(void) {
+    module.params = RESET_PARAMS;
+    module.wdt = 15000;
+    module.mac_paused = false;
+    module.busy_until = 0;
+    module.baud = config.baud;
+}
+
+/**
+ * Browns the module out: it resets to its power-on state, loses any responses it had yet to send and ignores everything
+ * until it has restarted.
+ * @param when The monotonic time of the brown-out.
+ */
+static void module_brownout(int64_t when) {
+    module_reset();
+    npending = 0;
+    silent_until = when + config.silent_ms * 1000000;
+    log_traffic(when, '*', "brownout");
+}
+
+/**
+ * Gets the baud rate broadcaster's end of the link is set to. The slave side of the pseudo-terminal carries the termios
+ * settings broadcaster made.
+ * @param slave The slave side of the pseudo-terminal.
+ * @return The baud rate, or 0 if it is not one the emulator knows.
+ */
+static unsigned int link_baud(int slave) {
+    static const struct {
+        speed_t speed;
+        unsigned int baud;
+    } speeds[] = {{B9600, 9600}, {B19200, 19200}, {B38400, 38400}, {B57600, 57600}, {B115200, 115200},
+                  {B230400, 230400}, {B460800, 460800}};
+    struct termios tty;
+    if (tcgetattr(slave, &tty)) return 0;
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        if (speeds[i].speed == cfgetospeed(&tty)) return speeds[i].baud;
+    }
+    return 0;
+}
+
+/**
+ * Handles the 0x55 character that follows a break in the auto-baud sequence, by locking on to the rate it was sent at.
+ * A pseudo-terminal does not pass breaks on, so a 0x55 at the start of a line is taken as the whole sequence.
+ * @param when The monotonic time at which the character finished arriving.
+ * @param baud The rate the character was sent at.
+ */
+static void module_autobaud(int64_t when, unsigned int baud) {
+    if (baud == 0 || baud > config.max_baud) return;
+    module.baud = baud;
+    char text[32];
+    snprintf(text, sizeof(text), "baud %u", baud);
+    log_traffic(when, '*', text);
+}
+
+/**
+ * Handles a frame reaching the ground station, which keeps track of its link header and answers it if it is top
+ * priority. Frames without a valid link header are heard but not answered.
+ * @param hex The frame in hexadecimal.
+ * @param len The length of the frame in bytes.
+ */
+static void ground_hear(const char *hex, size_t len) {
+    uint8_t frame[LHDR_MAX_LEN];
+    if (len > sizeof(frame)) len = sizeof(frame);
+    for (size_t i = 0; i < len; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        frame[i] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    struct lhdr_t header;
+    size_t header_len;
+    if (lhdr_decode(frame, len, &header, &header_len)) return;
+    arq_heard(&ground, header.seq);
+    if (header.priority >= LHDR_MAX_PRIORITY) reply_at = module.busy_until + config.reply_delay_ms * 1000000;
+}
+
+/**
+ * Handles a `radio tx` command.
+ * @param when The monotonic time at which the command finished arriving.
+ * @param hex The hexadecimal payload.
+ */
+static void sim_radio_tx(int64_t when, const char *hex) {
+    size_t len = hex == NULL ? 0 : strlen(hex);
+    if (len == 0 || len % 2 || len / 2 > MAX_PAYLOAD || strspn(hex, "0123456789abcdefABCDEF") != len) {
+        schedule(when, "invalid_param");
+        return;
+    }
+    if (!module.mac_paused || when < module.busy_until) {
+        schedule(when, "busy");
+        return;
+    }
+
+    schedule(when, "ok");
+    module.busy_until = when + (int64_t)radio_time_on_air(&module.params, len / 2) * NS_PER_US * config.toa_pct / 100;
+    bool failed = chance(config.tx_err_pct);
+    schedule(module.busy_until, failed ? "radio_err" : "radio_tx_ok");
+    if (failed) return;
+    if (chance(config.down_loss_pct)) log_traffic(module.busy_until, '*', "lost");
+    else ground_hear(hex, len / 2);
+}
+
+/**
+ * Handles a `radio rx` command. The window is a number of symbols with LoRa modulation and of milliseconds with FSK,
+ * and 0 listens until a packet arrives. The ground station's acknowledgement is received if it starts in the window.
+ * @param when The monotonic time at which the command finished arriving.
+ * @param size The window size.
+ */
+static void sim_radio_rx(int64_t when, const char *size) {
+    char *end;
+    unsigned long window = size == NULL ? 0 : strtoul(size, &end, 10);
+    if (size == NULL || *end != '\0' || window > UINT16_MAX) {
+        schedule(when, "invalid_param");
+        return;
+    }
+    if (!module.mac_paused || when < module.busy_until) {
+        schedule(when, "busy");
+        return;
+    }
+
+    schedule(when, "ok");
+    const struct lora_params_t *p = &module.params;
+    int64_t unit = p->modulation == FSK ? 1000000 : ((int64_t)1 << p->spread_factor) * 1000000 / p->bandwidth;
+    int64_t closes = window == 0 ? INT64_MAX : when + (int64_t)window * unit;
+    bool heard = reply_at >= when && reply_at <= closes;
+    if (heard && chance(config.up_loss_pct)) {
+        log_traffic(reply_at, '*', "ack lost");
+        heard = false;
+    }
+    if (heard) {
+        uint8_t ack[ARQ_ACK_LEN];
+        char text[32] = "radio_rx  ";
+        radio_hex_encode(&text[10], ack, arq_ack_encode(&ground, ack));
+        module.busy_until = reply_at + (int64_t)radio_time_on_air(p, ARQ_ACK_LEN) * NS_PER_US * config.toa_pct / 100;
+        schedule(module.busy_until, text);
+    } else if (window > 0) {
+        module.busy_until = closes;
+        schedule(closes, "radio_err");
+    } else {
+        module.busy_until = INT64_MAX;
+    }
+    reply_at = 0;
+}
+
+/**
+ * Handles a `radio rxstop` command, which closes the receive window that is open, if any.
+ * @param when The monotonic time at which the command finished arriving.
+ */
+static void sim_radio_rxstop(int64_t when) {
+    size_t kept = 0;
+    for (size_t i = 0; i < npending; i++) {
+        if (strncmp(pending[i].text, "radio_", 6)) pending[kept++] = pending[i];
+    }
+    npending = kept;
+    if (module.busy_until > when) module.busy_until = when;
+    schedule(when, "ok");
+}
+
+/**
+ * Parses and responds to a single command line.
+ * @param when The monotonic time at which the last byte of the command was clocked in.
+ * @param line The command, without line terminator.
+ */
+static void handle_command(int64_t when, char *line) {
+    if (line[0] == '\0') return; /* Stray line terminators are ignored. */
+
+    log_traffic(when, '>', line);
+    if (chance(config.drop_pct)) {
+        log_traffic(when, '!', "dropped");
+        return;
+    }
+
+    int64_t respond = when + config.response_delay_us * NS_PER_US;
+    char *save;
+    char *word = strtok_r(line, " ", &save);
+    char *arg1 = strtok_r(NULL, " ", &save);
+    char *arg2 = strtok_r(NULL, " ", &save);
+
+    if (word == NULL) {
+        schedule(respond, "invalid_param");
+    } else if (!strcmp(word, "radio") && arg1 != NULL && !strcmp(arg1, "set") && arg2 != NULL) {
+        schedule(respond, sim_radio_set(arg2, strtok_r(NULL, " ", &save)) ? "ok" : "invalid_param");
+    } else if (!strcmp(word, "radio") && arg1 != NULL && !strcmp(arg1, "get") && arg2 != NULL) {
+        char out[32];
+        sim_radio_get(arg2, out, sizeof(out));
+        schedule(respond, out);
+    } else if (!strcmp(word, "radio") && arg1 != NULL && !strcmp(arg1, "tx")) {
+        sim_radio_tx(respond, arg2);
+    } else if (!strcmp(word, "radio") && arg1 != NULL && !strcmp(arg1, "rx")) {
+        sim_radio_rx(respond, arg2);
+    } else if (!strcmp(word, "radio") && arg1 != NULL && !strcmp(arg1, "rxstop")) {
+        sim_radio_rxstop(respond);
+    } else if (!strcmp(word, "mac") && arg1 != NULL && !strcmp(arg1, "pause")) {
+        module.mac_paused = true;
+        schedule(respond, "4294967245");
+    } else if (!strcmp(word, "mac") && arg1 != NULL && !strcmp(arg1, "resume")) {
+        module.mac_paused = false;
+        schedule(respond, "ok");
+    } else if (!strcmp(word, "sys") && arg1 != NULL && !strcmp(arg1, "get") && arg2 != NULL && !strcmp(arg2, "ver")) {
+        schedule(respond, VERSION_STRING);
+    } else if (!strcmp(word, "sys") && arg1 != NULL && !strcmp(arg1, "reset")) {
+        module_reset();
+        schedule(respond, VERSION_STRING);
+    } else {
+        schedule(respond, "invalid_param");
+    }
+}
+
+/**
+ * Writes all responses that are due to the pseudo-terminal.
+ * @param master The master side of the pseudo-terminal.
+ */
+static void flush_due(int master) {
+    int64_t now = now_ns();
+    size_t sent = 0;
+    while (sent < npending && pending[sent].when <= now) {
+        dprintf(master, "%s\r\n", pending[sent].text);
+        log_traffic(now, '<', pending[sent].text);
+        sent++;
+    }
+    memmove(pending, &pending[sent], (npending - sent) * sizeof(pending[0]));
+    npending -= sent;
+}
+
+/**
+ * Stops the emulator's main loop.
+ * @param sig The signal that was received.
+ */
+static void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+int main(int argc, char **argv) {
+
+    int c;
+    while ((c = getopt(argc, argv, ":l:d:t:e:n:b:A:o:D:U:R:vw")) != -1) {
+        switch (c) {
+        case 'l':
+            config.link = optarg;
+            break;
+        case 'd':
+            config.response_delay_us = strtoll(optarg, NULL, 10);
+            break;
+        case 't':
+            config.toa_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            config.tx_err_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            config.drop_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            config.baud = strtoul(optarg, NULL, 10);
+            if (config.baud == 0) {
+                fprintf(stderr, "Invalid baud rate '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'A':
+            config.max_baud = strtoul(optarg, NULL, 10);
+            break;
+        case 'o': {
+            char *end;
+            config.brownout_ms = strtoll(optarg, &end, 10);
+            if (*end == ':') config.silent_ms = strtoll(end + 1, &end, 10);
+            if (*end != '\0' || config.brownout_ms <= 0 || config.silent_ms < 0) {
+                fprintf(stderr, "Invalid brown-out interval '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case 'D':
+            config.down_loss_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'U':
+            config.up_loss_pct = strtoul(optarg, NULL, 10);
+            break;
+        case 'R':
+            config.reply_delay_ms = strtoll(optarg, NULL, 10);
+            break;
+        case 'v':
+            config.verbose = true;
+            break;
+        case 'w':
+            config.warm = true;
+            break;
+        case ':':
+            fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+            exit(EXIT_FAILURE);
+        case '?':
+            fprintf(stderr, "Unknown option -%c\n", optopt);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1 || grantpt(master) || unlockpt(master)) {
+        fprintf(stderr, "Could not create pseudo-terminal: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    const char *slave_name = ptsname(master);
+
+    /* Hold the slave open so that the master does not see a hang-up between broadcaster runs. */
+    int slave = open(slave_name, O_RDWR | O_NOCTTY);
+    if (slave == -1) {
+        fprintf(stderr, "Could not open pseudo-terminal slave %s: %s\n", slave_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (config.link != NULL) {
+        unlink(config.link);
+        if (symlink(slave_name, config.link)) {
+            fprintf(stderr, "Could not link %s to %s: %s\n", config.link, slave_name, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    printf("pty %s\n", slave_name);
+
+    struct sigaction sa = {.sa_handler = stop};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    srand(time(NULL));
+    module_reset();
+    if (config.warm) {
+        module.params = WARM_PARAMS;
+        module.wdt = 0;
+        module.mac_paused = true;
+    }
+
+    if (config.brownout_ms > 0) next_brownout = now_ns() + config.brownout_ms * 1000000;
+
+    char line[LINE_MAX_LEN];
+    size_t line_len = 0;
+    while (running) {
+        int64_t due = npending > 0 ? pending[0].when : -1;
+        if (next_brownout > 0 && (due == -1 || next_brownout < due)) due = next_brownout;
+        int timeout = -1;
+        if (due != -1) {
+            int64_t wait = due - now_ns();
+            timeout = wait <= 0 ? 0 : (int)((wait + 999999) / 1000000);
+        }
+
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready == -1 && errno != EINTR) break;
+
+        if (ready > 0 && (pfd.revents & POLLIN)) {
+            char chunk[256];
+            ssize_t nread = read(master, chunk, sizeof(chunk));
+            int64_t arrival = now_ns();
+            unsigned int baud = link_baud(slave);
+            for (ssize_t i = 0; i < nread; i++) {
+                if (rx_cursor < arrival) rx_cursor = arrival;
+                rx_cursor += wire_time(1);
+
+                if (rx_cursor < silent_until) {
+                    line_len = 0; // Characters that arrive while the module restarts are lost
+                } else if (line_len == 0 && chunk[i] == 0x55) {
+                    module_autobaud(rx_cursor, baud);
+                } else if (baud != module.baud) {
+                    continue; // Characters sent at the wrong rate arrive as noise
+                } else if (chunk[i] == '\r' || chunk[i] == '\n') {
+                    line[line_len] = '\0';
+                    handle_command(rx_cursor, line);
+                    line_len = 0;
+                } else if (line_len < sizeof(line) - 1) {
+                    line[line_len++] = chunk[i];
+                }
+            }
+        }
+
+        if (next_brownout > 0 && now_ns() >= next_brownout) {
+            module_brownout(next_brownout);
+            next_brownout += config.brownout_ms * 1000000;
+        }
+        flush_due(master);
+    }
+
+    if (config.link != NULL) unlink(config.link);
+    close(slave);
+    close(master);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file statsdump.c
+ * @brief Prints the latency statistics a running broadcaster publishes in shared memory.
+ *
+ * Every stage that has been timed is summarized at each priority, followed by the transmission counters at each
+ * priority and of each radio that has sent anything. With `-H`,
+ * the full histogram of one stage is printed as well, and with `-i` the statistics are printed again every interval
+ * until interrupted.
+ */
+#define _GNU_SOURCE
+#include "stats.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Converts a duration to milliseconds for printing.
+ * @param ns The duration in nanoseconds.
+ * @return The duration in milliseconds.
+ */
+static double ms(uint64_t ns) { return (double)ns / 1000000; }
+
+/**
+ * Prints a summary of every stage and the transmission counters by priority and by radio.
+ * @param stats A snapshot of the statistics.
+ */
+static void print_summary(const struct stats_t *stats) {
+    printf("%-9s %4s %9s %11s %11s %11s %11s %11s\n", "stage", "prio", "samples", "mean ms", "p50 ms", "p90 ms",
+           "p99 ms", "max ms");
+    for (unsigned int stage = 0; stage < STATS_STAGES; stage++) {
+        for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+            struct stats_summary_t s;
+            stats_summarize(&stats->hist[stage][p], &s);
+            if (s.count == 0) continue;
+            printf("%-9s %3u%s %9llu %11.3f %11.3f %11.3f %11.3f %11.3f\n", STATS_STAGE_NAMES[stage], p,
+                   p == STATS_PRIORITIES - 1 ? "+" : " ", (unsigned long long)s.count, ms(s.mean_ns), ms(s.p50_ns),
+                   ms(s.p90_ns), ms(s.p99_ns), ms(s.max_ns));
+        }
+    }
+
+    printf("\n%4s %9s %11s %9s %9s\n", "prio", "packets", "bytes", "retries", "failures");
+    for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+        const struct stats_counters_t *c = &stats->counters[p];
+        printf("%3u%s %9llu %11llu %9llu %9llu\n", p, p == STATS_PRIORITIES - 1 ? "+" : " ",
+               (unsigned long long)c->packets, (unsigned long long)c->bytes, (unsigned long long)c->retries,
+               (unsigned long long)c->failures);
+    }
+
+    bool header = false;
+    for (unsigned int r = 0; r < STATS_RADIOS; r++) {
+        const struct stats_counters_t *c = &stats->radios[r];
+        if (c->packets == 0 && c->failures == 0) continue;
+        if (!header) printf("\n%5s %9s %11s %9s %9s\n", "radio", "packets", "bytes", "retries", "failures");
+        header = true;
+        printf("%5u %9llu %11llu %9llu %9llu\n", r, (unsigned long long)c->packets, (unsigned long long)c->bytes,
+               (unsigned long long)c->retries, (unsigned long long)c->failures);
+    }
+}
+
+/**
+ * Prints the non-empty buckets of one stage's histograms, merged across priorities.
+ * @param stats A snapshot of the statistics.
+ * @param stage The stage.
+ */
+static void print_histogram(const struct stats_t *stats, Stage stage) {
+    uint64_t total = 0;
+    uint64_t merged[STATS_BUCKETS] = {0};
+    for (unsigned int p = 0; p < STATS_PRIORITIES; p++) {
+        for (size_t b = 0; b < STATS_BUCKETS; b++) merged[b] += stats->hist[stage][p].buckets[b];
+        total += stats->hist[stage][p].count;
+    }
+
+    printf("\n%s histogram, %llu samples\n%12s %9s %7s\n", STATS_STAGE_NAMES[stage], (unsigned long long)total,
+           "up to ms", "samples", "cum %");
+    uint64_t seen = 0;
+    for (size_t b = 0; b < STATS_BUCKETS; b++) {
+        if (merged[b] == 0) continue;
+        seen += merged[b];
+        printf("%12.4f %9llu %6.1f%%\n", ms(stats_bucket_limit(b)), (unsigned long long)merged[b],
+               (double)seen * 100 / (double)total);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    const char *name = STATS_SHM_NAME;
+    int histogram = -1;
+    unsigned int interval = 0;
+    int c;
+    while ((c = getopt(argc, argv, ":n:H:i:")) != -1) {
+        switch (c) {
+        case 'n':
+            name = optarg;
+            break;
+        case 'H':
+            for (histogram = 0; histogram < STATS_STAGES; histogram++) {
+                if (!strcmp(optarg, STATS_STAGE_NAMES[histogram])) break;
+            }
+            if (histogram == STATS_STAGES) {
+                fprintf(stderr, "Unknown stage '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'i':
+            interval = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n shm-name] [-H stage] [-i seconds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    const struct stats_t *stats = stats_attach(name);
+    if (stats == NULL) {
+        fprintf(stderr, "No statistics published at %s, is broadcaster running?\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    static struct stats_t snapshot;
+    while (true) {
+        stats_snapshot(stats, &snapshot);
+        print_summary(&snapshot);
+        if (histogram >= 0) print_histogram(&snapshot, histogram);
+        if (interval == 0) break;
+        printf("\n");
+        fflush(stdout);
+        sleep(interval);
+    }
+    return EXIT_SUCCESS;
+}
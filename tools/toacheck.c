@@ -0,0 +1,64 @@
+/**
+ * @file toacheck.c
+ * @brief A check of the LoRa time-on-air model against the Semtech AN1200.13 formula.
+ *
+ * The expected times were worked out from the formula in the application note for explicit header packets, with low
+ * data rate optimization on whenever a symbol lasts longer than 16 ms. The cases cover every coding rate, both sides of
+ * the low data rate optimization threshold, packets with and without CRC and the smallest and largest payloads. The
+ * emulator takes its timing from the same model, so it cannot catch a wrong formula; this tool can. It exits with a
+ * failure if any time differs.
+ */
+#include "radio.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** One set of radio parameters and payload length with its expected time on air. */
+struct toa_case_t {
+    /** The spread factor. */
+    unsigned int spread_factor;
+    /** The bandwidth in kHz. */
+    unsigned int bandwidth;
+    /** The coding rate. */
+    CodingRate coding_rate;
+    /** The preamble length in symbols. */
+    unsigned int preamble_len;
+    /** Whether the packet carries a CRC. */
+    bool crc;
+    /** The payload length in bytes. */
+    size_t payload_len;
+    /** The time on air the formula gives, in microseconds. */
+    uint32_t expected_us;
+};
+
+/** The cases checked. The first two are broadcaster's default settings at SF7/500 kHz and SF12/125 kHz. */
+static const struct toa_case_t CASES[] = {
+    {7, 500, CR_4_7, 6, true, 8, 10048},       {12, 125, CR_4_7, 6, true, 8, 1056768},
+    {11, 125, CR_4_8, 8, true, 32, 1380352},   {12, 250, CR_4_8, 8, true, 16, 856064},
+    {11, 250, CR_4_8, 8, true, 16, 362496},    {9, 125, CR_4_8, 8, false, 64, 541696},
+    {10, 250, CR_4_5, 8, true, 255, 1147904},  {12, 125, CR_4_5, 8, true, 255, 9019392},
+    {7, 125, CR_4_5, 8, true, 1, 25856},       {8, 125, CR_4_6, 12, true, 20, 123392},
+};
+
+int main(void) {
+    static const char *const RATES[] = {[CR_4_5] = "4/5", [CR_4_6] = "4/6", [CR_4_7] = "4/7", [CR_4_8] = "4/8"};
+    unsigned int failures = 0;
+    printf("%-4s %5s %4s %7s %4s %7s %12s %12s\n", "sf", "bw", "cr", "prlen", "crc", "payload", "expected us",
+           "model us");
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        const struct toa_case_t *c = &CASES[i];
+        struct lora_params_t params = {.modulation = LORA,
+                                       .spread_factor = c->spread_factor,
+                                       .bandwidth = c->bandwidth,
+                                       .coding_rate = c->coding_rate,
+                                       .preamble_len = c->preamble_len,
+                                       .cyclic_redundancy = c->crc};
+        uint32_t toa = radio_time_on_air(&params, c->payload_len);
+        printf("%-4u %5u %4s %7u %4s %7zu %12u %12u%s\n", c->spread_factor, c->bandwidth, RATES[c->coding_rate],
+               c->preamble_len, c->crc ? "on" : "off", c->payload_len, c->expected_us, toa,
+               toa == c->expected_us ? "" : "  MISMATCH");
+        if (toa != c->expected_us) failures++;
+    }
+    printf("%u failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}